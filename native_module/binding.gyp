@@ -1,35 +1,168 @@
 {
+    "variables": {
+        # 核心评分流水线，Electron 插件和命令行工具共用
+        "core_sources": [
+            "src/ModelRunner.cpp",
+            "src/AudioFrontEnd.cpp",
+            "src/Phonemizer.cpp",
+            "src/Align.cpp",
+            "src/Lattice.cpp",
+            "src/CostModel.cpp",
+            "src/MappedFile.cpp",
+            "src/WavReader.cpp",
+            "src/AudioClip.cpp",
+            "src/Waveform.cpp",
+            "src/Fluency.cpp",
+            "src/Log.cpp",
+            "src/Metrics.cpp",
+            "src/OrtProfiler.cpp",
+            "src/Vocab.cpp",
+            "src/ThreadPool.cpp",
+            "src/CtcDecode.cpp",
+            "src/EmissionCache.cpp",
+            "src/EmissionFile.cpp",
+            "src/Thresholds.cpp",
+            "src/Transcript.cpp",
+            "src/Cancel.cpp",
+            "src/Scheduler.cpp",
+            "src/ModelStore.cpp",
+            "src/ModelRegistry.cpp",
+        ],
+    },
+    "target_defaults": {
+        "cflags!": ["-fno-exceptions"],
+        "cflags_cc!": ["-fno-exceptions"],
+        "include_dirs": [
+            "src",
+            "libs/onnxruntime/include",
+            "libs/espeak-ng/include",
+            "libs/dr_libs",
+            "libs/json",
+        ],
+        "conditions": [
+            [
+                'OS=="win"',
+                {
+                    "libraries": [
+                        "-l<(module_root_dir)/libs/onnxruntime/lib/onnxruntime.lib",
+                        "-l<(module_root_dir)/libs/espeak-ng/lib/libespeak-ng.lib",
+                    ],
+                    "msvs_settings": {"VCCLCompilerTool": {"ExceptionHandling": 1}},
+                },
+            ],
+            [
+                'OS=="linux"',
+                {
+                    "libraries": [
+                        "-L<(module_root_dir)/libs/onnxruntime/lib",
+                        "-L<(module_root_dir)/libs/espeak-ng/lib",
+                        "-lonnxruntime",
+                        "-lespeak-ng",
+                        "-lpthread",
+                    ],
+                    "ldflags": [
+                        "-Wl,-rpath,<(module_root_dir)/libs/onnxruntime/lib",
+                        "-Wl,-rpath,<(module_root_dir)/libs/espeak-ng/lib",
+                    ],
+                },
+            ],
+        ],
+    },
     "targets": [
         {
             "target_name": "speech_core",
-            "cflags!": ["-fno-exceptions"],
-            "cflags_cc!": ["-fno-exceptions"],
             "sources": [
                 "src/api.cpp",
-                "src/ModelRunner.cpp",
-                "src/Phonemizer.cpp",
-                "src/Align.cpp",
+                "<@(core_sources)",
             ],
             "include_dirs": [
                 "<!@(node -p \"require('node-addon-api').include\")",
-                "libs/onnxruntime/include",
-                "libs/espeak-ng/include",
-                "libs/dr_libs",
-                "libs/json",
             ],
             "defines": ["NAPI_CPP_EXCEPTIONS"],
-            "conditions": [
-                [
-                    'OS=="win"',
+        },
+        {
+            # 离线批量评分: speech_batch --manifest list.jsonl ...
+            "target_name": "speech_batch",
+            "type": "executable",
+            "sources": [
+                "tools/speech_batch.cpp",
+                "<@(core_sources)",
+            ],
+        },
+        {
+            # 分阶段基准测试: speech_bench --resources ../resources --out bench.json
+            "target_name": "speech_bench",
+            "type": "executable",
+            "sources": [
+                "tools/speech_bench.cpp",
+                "<@(core_sources)",
+            ],
+        },
+        {
+            # 阈值校准: speech_calibrate --manifest labeled.jsonl --emissions emis/ --out thresholds.json
+            "target_name": "speech_calibrate",
+            "type": "executable",
+            "sources": [
+                "tools/speech_calibrate.cpp",
+                "<@(core_sources)",
+            ],
+        },
+        {
+            # 内核差分校验 (与冻结的参考实现对比结果和耗时): speech_verify --cases 500 --seed 1 --json verify.json
+            "target_name": "speech_verify",
+            "type": "executable",
+            "sources": [
+                "tools/speech_verify.cpp",
+                "tools/reference_kernels.cpp",
+                "<@(core_sources)",
+            ],
+        },
+        {
+            # 各组件的行为测试 (缓存、存档、阈值、解码、取消、调度、模型管理、准入): speech_components_test
+            "target_name": "speech_components_test",
+            "type": "executable",
+            "sources": [
+                "tools/speech_components_test.cpp",
+                "<@(core_sources)",
+            ],
+        },
+    ],
+    "conditions": [
+        [
+            'OS!="win"',
+            {
+                "targets": [
                     {
-                        "libraries": [
-                            "-l<(module_root_dir)/libs/onnxruntime/lib/onnxruntime.lib",
-                            "-l<(module_root_dir)/libs/espeak-ng/lib/libespeak-ng.lib",
+                        # 常驻评分服务 (Unix 套接字): speech_daemon --model ... --socket /tmp/speech.sock
+                        "target_name": "speech_daemon",
+                        "type": "executable",
+                        "sources": [
+                            "tools/speech_daemon.cpp",
+                            "src/WireProtocol.cpp",
+                            "<@(core_sources)",
                         ],
-                        "msvs_settings": {"VCCLCompilerTool": {"ExceptionHandling": 1}},
                     },
-                ]
-            ],
-        }
+                    {
+                        # 服务压测: speech_loadgen --wav sample.wav --text "..." --clients 8 --duration 30
+                        "target_name": "speech_loadgen",
+                        "type": "executable",
+                        "sources": [
+                            "tools/speech_loadgen.cpp",
+                            "src/WireProtocol.cpp",
+                            "<@(core_sources)",
+                        ],
+                    },
+                    {
+                        # 套接字协议的编解码测试: speech_protocol_test
+                        "target_name": "speech_protocol_test",
+                        "type": "executable",
+                        "sources": [
+                            "tools/speech_protocol_test.cpp",
+                            "src/WireProtocol.cpp",
+                        ],
+                    },
+                ],
+            },
+        ],
     ]
 }
@@ -1,216 +1,366 @@
 #include "Align.h"
-#include <iostream>
+#include "CtcDecode.h"
+#include "ThreadPool.h"
+#include "Log.h"
 #include <algorithm>
 #include <limits>
 #include <cmath>
+#include <cctype>
 
 // 定义负无穷
 const float NEG_INF = -1e9f;
 
-// 内部使用的结构体，用于记录扁平化后的映射关系
-struct TargetMap {
-    int word_idx;       // 属于第几个单词
-    int phoneme_idx;    // 属于单词里的第几个音素
-    int token_id;       // 模型对应的 ID
-    std::string text;   // 音素文本
+// 分段对齐的一段：words[word_begin, word_end) 对应帧 [frame_begin, frame_end)
+struct AlignSegment {
+    size_t word_begin;
+    size_t word_end;
+    int frame_begin;
+    int frame_end;
 };
 
-bool calculateGOP(const ModelRunner& runner, std::vector<WordAnalysis>& words, int blank_idx) {
-    if (words.empty()) return false;
+struct AlignStats {
+    uint64_t states = 0;
+    uint64_t phonemes = 0;
+    uint64_t bytes = 0;
+    int segments = 1;
+};
 
-    // ==========================================
-    // 第一步：扁平化目标序列 (Flattening)
-    // ==========================================
-    // Viterbi 需要一个连续的 ID 列表，但我们的输入是分词的结构。
-    // 我们需要建立一个映射：FlatIndex -> (WordIndex, PhonemeIndex)
-    std::vector<TargetMap> flat_targets;
+const char* gopHintName(GopHint hint)
+{
+    switch (hint) {
+    case GopHint::Correct: return "correct";
+    case GopHint::Substitution: return "substitution";
+    case GopHint::Unclear: return "unclear";
+    default: return "none";
+    }
+}
+
+// 扩展评分：在已经对齐好的 [start_t, end_t] 段上遍历一次已归一化的对数概率行。
+// 每帧两次连续扫描 (取最大值、累加后验)，没有分支依赖，编译器可以直接向量化
+static void scoreSegmentDetailed(const EmissionView& em, const Vocab& vocab, const std::vector<uint8_t>& phone_mask,
+                                 int start_t, int end_t, const GopOptions& options,
+                                 std::vector<float>& posterior_sum, PhonemeDetail& detail)
+{
+    const int V = em.vocab;
+    const int frames = end_t - start_t + 1;
+    if (frames <= 0 || detail.token_id < 0 || detail.token_id >= V) return;
+
+    posterior_sum.assign(V, 0.0f);
+    float lr_sum = 0.0f;
+
+    for (int t = start_t; t <= end_t; ++t) {
+        const float* row = em.row(t);
+
+        // 自由音素路径：这一帧上概率最大的音素
+        float best = NEG_INF;
+        for (int v = 0; v < V; ++v) {
+            float x = phone_mask[v] ? row[v] : NEG_INF;
+            best = x > best ? x : best;
+        }
+        lr_sum += row[detail.token_id] - best;
 
-    for (size_t w_i = 0; w_i < words.size(); ++w_i) {
-        // 先清空之前的评分详情
-        words[w_i].details.clear();
-        words[w_i].word_score = 0.0f;
+        for (int v = 0; v < V; ++v) {
+            posterior_sum[v] += std::exp(row[v]);
+        }
+    }
 
-        const auto& phoneme_list = words[w_i].phonemes;
-        for (size_t p_i = 0; p_i < phoneme_list.size(); ++p_i) {
-            std::string p_text = phoneme_list[p_i];
-            int tid = runner.getTokenId(p_text);
+    const float inv = 1.0f / frames;
+    detail.gop_lr = lr_sum * inv;
+    detail.posterior = posterior_sum[detail.token_id] * inv;
 
-            if (tid != -1) {
-                flat_targets.push_back({ (int)w_i, (int)p_i, tid, p_text });
-            }
-            else {
-                // 如果模型词表里没有这个音素 (容错处理)
-                // 比如 espeak 输出了一些罕见符号，这里选择跳过或报错
-                std::cerr << "[Warning] Skipping unknown phoneme: " << p_text << " in word: " << words[w_i].word << std::endl;
+    // top-k 竞争音素
+    std::vector<int> candidates;
+    candidates.reserve(V);
+    for (int v = 0; v < V; ++v) {
+        if (phone_mask[v] && v != detail.token_id) candidates.push_back(v);
+    }
+    size_t k = std::min<size_t>(options.top_k > 0 ? options.top_k : 0, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+                      [&](int a, int b) { return posterior_sum[a] > posterior_sum[b]; });
+
+    detail.competitors.clear();
+    for (size_t i = 0; i < k; ++i) {
+        int v = candidates[i];
+        detail.competitors.push_back({ vocab.token(v), v, posterior_sum[v] * inv });
+    }
+
+    // 诊断
+    if (detail.gop_lr >= GOP_LR_CORRECT) {
+        detail.hint = GopHint::Correct;
+    }
+    else if (!detail.competitors.empty() && detail.competitors[0].posterior >= SUBSTITUTION_MIN_POSTERIOR &&
+             detail.competitors[0].posterior > detail.posterior) {
+        detail.hint = GopHint::Substitution;
+        detail.substitute_ipa = detail.competitors[0].ipa;
+    }
+    else {
+        detail.hint = GopHint::Unclear;
+    }
+}
+
+// 每个词标准发音里能在词表中找到的音素数
+static int countValidPhonemes(const WordAnalysis& w, const Vocab& vocab)
+{
+    int n = 0;
+    for (const auto& p : w.phonemes) {
+        if (vocab.contains(p)) n++;
+    }
+    return n;
+}
+
+// 粗对齐：用贪心解码找停顿，把停顿映射到单词边界，切成可以独立精对齐的段
+static std::vector<AlignSegment> planSegments(const EmissionView& em, const Vocab& vocab, const std::vector<WordAnalysis>& words,
+                                              int blank_idx, const SegmentOptions& opt)
+{
+    std::vector<AlignSegment> segments;
+    const size_t W = words.size();
+
+    // 单词边界 k (第 k 个词之前) 处的音素累计数
+    std::vector<int> cum(W + 1, 0);
+    for (size_t w = 0; w < W; ++w) {
+        cum[w + 1] = cum[w] + countValidPhonemes(words[w], vocab);
+    }
+    const int M = cum[W];
+
+    std::vector<CtcToken> greedy = greedyDecode(em, blank_idx);
+    const size_t N = greedy.size();
+
+    if (N > 0 && M > 0) {
+        std::vector<CtcPause> pauses = findPauses(em, blank_idx, opt.min_pause_frames);
+
+        size_t last_word = 0;
+        int last_frame = 0;
+        size_t gi = 0;
+        for (const auto& pause : pauses) {
+            int anchor = (pause.start_frame + pause.end_frame) / 2;
+            if (anchor - last_frame < opt.min_segment_frames) continue;
+            if (em.frames - anchor < opt.min_segment_frames) break;
+
+            // 停顿之前贪心解码出了多少个音素，按比例换算成目标音素的位置
+            while (gi < N && greedy[gi].end_frame < pause.start_frame) gi++;
+            double expected = (double)gi * M / N;
+
+            // 找最近的单词边界，两侧都必须还有音素；距离相同时优先句末/标点后的边界
+            size_t best_k = 0;
+            double best_dist = 0.0;
+            for (size_t k = last_word + 1; k < W; ++k) {
+                if (cum[k] <= cum[last_word] || cum[k] >= M) continue;
+                double dist = std::fabs(cum[k] - expected);
+                const std::string& prev = words[k - 1].word;
+                bool punct = !prev.empty() && std::ispunct((unsigned char)prev.back()) && prev.back() != '\'';
+                if (punct) dist -= 0.5;
+                if (best_k == 0 || dist < best_dist) {
+                    best_k = k;
+                    best_dist = dist;
+                }
             }
+            if (best_k == 0 || best_dist > opt.anchor_tolerance) continue;
+
+            segments.push_back({ last_word, best_k, last_frame, anchor });
+            last_word = best_k;
+            last_frame = anchor;
         }
+        segments.push_back({ last_word, W, last_frame, em.frames });
     }
-
-    if (flat_targets.empty()) {
-        std::cerr << "[Error] No valid targets found for alignment." << std::endl;
-        return false;
+    else {
+        segments.push_back({ 0, W, 0, em.frames });
     }
+    return segments;
+}
 
+// 在一段帧上对齐一段连续的单词，结果写进 words[0 .. count)，帧号加上 em.frame_offset
+static bool alignWords(const EmissionView& em, const Vocab& vocab, WordAnalysis* words, size_t count, int blank_idx,
+                       const GopOptions& options, const std::vector<uint8_t>& phone_mask, AlignStats& stats)
+{
     // ==========================================
-    // 第二步：构建 CTC 扩展图
+    // 第一步：构建发音格 (每个词的各个发音 + 可选的词间停顿 + 可跳过的词)
     // ==========================================
-    // 目标: [A, B] -> 状态: [b, A, b, B, b]
-    std::vector<int> extended_states;
-    extended_states.reserve(flat_targets.size() * 2 + 1);
+    CtcLattice lattice = buildLattice(words, count, vocab, blank_idx, options.lattice);
 
-    for (const auto& t : flat_targets) {
-        extended_states.push_back(blank_idx);
-        extended_states.push_back(t.token_id);
+    if (lattice.label_count == 0) {
+        LOG_ERROR("[Error] No valid targets found for alignment.");
+        return false;
     }
-    extended_states.push_back(blank_idx);
 
-    int T = runner.getTimeSteps();
-    int S = (int)extended_states.size();
+    int T = em.frames;
+    int S = (int)lattice.states.size();
 
-    // DP 表: dp[t * S + s]
-    std::vector<float> dp(T * S, NEG_INF);
-    // 回溯表: backtrack[t * S + s] = prev_state_index
-    std::vector<int> backtrack(T * S, -1);
+    stats.states += S;
+    stats.phonemes += lattice.label_count;
+    stats.bytes += viterbiBytes(T, S, options.low_memory);
 
     // ==========================================
-    // 第三步：Viterbi 前向算法 (Forward)
+    // 第二步：Viterbi 对齐，一次同时选出每个词的发音
     // ==========================================
-
-    // 初始化 t=0
-    float prob0 = runner.getLogProb(0, extended_states[0]);
-    dp[0] = prob0;
-    if (S > 1) {
-        float prob1 = runner.getLogProb(0, extended_states[1]);
-        dp[1] = prob1;
+    std::vector<int> path_states;
+    bool aligned = options.low_memory ? viterbiLatticeLowMemory(em, lattice, path_states, options.cancel)
+                                      : viterbiLattice(em, lattice, path_states, options.cancel);
+    if (!aligned) {
+        return false;
     }
 
-    for (int t = 1; t < T; ++t) {
-        for (int s = 0; s < S; ++s) {
-            int current_token = extended_states[s];
-            float current_prob = runner.getLogProb(t, current_token);
+    // 每个状态在路径上的时间跨度和对数概率之和 (一次遍历路径)
+    std::vector<int> seg_start(S, -1), seg_end(S, -1), seg_count(S, 0);
+    std::vector<float> seg_sum(S, 0.0f);
+    for (int t = 0; t < T; ++t) {
+        int s = path_states[t];
+        if (seg_start[s] == -1) seg_start[s] = t;
+        seg_end[s] = t;
+        seg_sum[s] += em.logProb(t, lattice.states[s].token_id);
+        seg_count[s]++;
+    }
 
-            float max_score = NEG_INF;
-            int best_prev = -1;
+    // 路径经过的发音 (没有经过任何音素状态的词就是被跳过了)
+    std::vector<int> chosen(count, -1);
+    for (int t = 0; t < T; ++t) {
+        const LatticeState& st = lattice.states[path_states[t]];
+        if (st.word >= 0 && st.phoneme >= 0 && chosen[st.word] == -1) chosen[st.word] = st.variant;
+    }
 
-            // 1. Stay (s -> s)
-            if (dp[(t - 1) * S + s] > NEG_INF) {
-                if (dp[(t - 1) * S + s] > max_score) {
-                    max_score = dp[(t - 1) * S + s];
-                    best_prev = s;
-                }
+    // ==========================================
+    // 第三步：计算 GOP 并回填结果
+    // ==========================================
+    std::vector<float> posterior_sum;
+    const ThresholdTable& thresholds = options.thresholds ? *options.thresholds : *ThresholdTable::builtin();
+
+    for (size_t w = 0; w < count; ++w) {
+        const auto& variants = lattice.word_variants[w];
+        if (variants.empty()) continue;
+
+        if (chosen[w] == -1) {
+            // 整词漏读：按标准发音列出音素，全部记最低分
+            words[w].skipped = true;
+            for (size_t i = 0; i < variants[0].ipa.size(); ++i) {
+                PhonemeDetail detail;
+                detail.ipa = *variants[0].ipa[i];
+                detail.token_id = vocab.find(detail.ipa);
+                detail.score = SCORE_FLOOR;
+                words[w].details.push_back(detail);
             }
+            continue;
+        }
 
-            // 2. Transition (s-1 -> s)
-            if (s > 0 && dp[(t - 1) * S + (s - 1)] > NEG_INF) {
-                if (dp[(t - 1) * S + (s - 1)] > max_score) {
-                    max_score = dp[(t - 1) * S + (s - 1)];
-                    best_prev = s - 1;
-                }
-            }
+        const LatticeVariant* v = &variants[0];
+        for (const auto& cand : variants) {
+            if (cand.variant == chosen[w]) v = &cand;
+        }
+        words[w].variant = v->variant;
 
-            // 3. Skip Blank (s-2 -> s)
-            // 条件：当前不是Blank，中间是Blank，且当前音素 != 上一个实音素
-            if (s > 1 && current_token != blank_idx) {
-                if (extended_states[s - 1] == blank_idx) {
-                    if (extended_states[s - 2] != current_token) {
-                        if (dp[(t - 1) * S + (s - 2)] > NEG_INF) {
-                            if (dp[(t - 1) * S + (s - 2)] > max_score) {
-                                max_score = dp[(t - 1) * S + (s - 2)];
-                                best_prev = s - 2;
-                            }
-                        }
-                    }
-                }
+        for (size_t i = 0; i < v->label_states.size(); ++i) {
+            int s = v->label_states[i];
+
+            // 创建详情对象
+            PhonemeDetail detail;
+            detail.ipa = *v->ipa[i];
+            detail.token_id = lattice.states[s].token_id;
+            detail.start_frame = seg_start[s] < 0 ? -1 : seg_start[s] + em.frame_offset;
+            detail.end_frame = seg_end[s] < 0 ? -1 : seg_end[s] + em.frame_offset;
+
+            if (seg_count[s] > 0) {
+                detail.score = seg_sum[s] / seg_count[s];
+            }
+            else {
+                // 极少见情况：该音素被跳过（duration=0）
+                detail.score = SCORE_FLOOR;
             }
 
-            if (best_prev != -1) {
-                dp[t * S + s] = max_score + current_prob;
-                backtrack[t * S + s] = best_prev;
+            // 判定好坏 (按音素查阈值表)
+            const PhonemeThreshold& threshold = thresholds.lookup(detail.ipa);
+            detail.is_good = (detail.score > threshold.good);
+            detail.is_excellent = (detail.score > threshold.excellent);
+
+            if (options.detailed && seg_count[s] > 0) {
+                scoreSegmentDetailed(em, vocab, phone_mask, seg_start[s], seg_end[s], options, posterior_sum, detail);
             }
+
+            words[w].details.push_back(detail);
         }
     }
+    return true;
+}
 
-    // ==========================================
-    // 第四步：回溯最佳路径 (Backtracking)
-    // ==========================================
+static void resetWords(std::vector<WordAnalysis>& words)
+{
+    for (auto& w : words) {
+        // 先清空之前的评分详情
+        w.details.clear();
+        w.word_score = 0.0f;
+        w.variant = 0;
+        w.skipped = false;
+    }
+}
 
-    // 寻找终点：最后必须停在 最后一个Blank 或 最后一个音素
-    int current_s = -1;
-    float score_blank = dp[(T - 1) * S + (S - 1)];
-    float score_last = (S > 1) ? dp[(T - 1) * S + (S - 2)] : NEG_INF;
+bool calculateGOP(const ModelRunner& runner, std::vector<WordAnalysis>& words, int blank_idx, StageTimings* timings, const GopOptions& options) {
+    return calculateGOP(runner.getEmissions(), runner.getVocab(), words, blank_idx, timings, options);
+}
 
-    if (score_blank > score_last) current_s = S - 1;
-    else current_s = S - 2;
+bool calculateGOP(const EmissionView& em, const Vocab& vocab, std::vector<WordAnalysis>& words, int blank_idx, StageTimings* timings, const GopOptions& options) {
+    if (words.empty()) return false;
 
-    // 检查是否对齐失败
-    if (current_s < 0 || dp[(T - 1) * S + current_s] <= NEG_INF) {
-        std::cerr << "[Error] Alignment broken. Audio might not match text." << std::endl;
-        return false;
-    }
+    resetWords(words);
 
-    // path_states[t] 存储的是 t 时刻对应的扩展状态索引 s
-    std::vector<int> path_states(T);
-    for (int t = T - 1; t >= 0; --t) {
-        path_states[t] = current_s;
-        current_s = backtrack[t * S + current_s];
+    std::vector<uint8_t> phone_mask;
+    if (options.detailed) {
+        phone_mask = buildPhoneMask(vocab, em.vocab, blank_idx);
     }
 
-    // ==========================================
-    // 第五步：计算 GOP 并回填结果
-    // ==========================================
-
-    // 我们需要按 flat_targets 的顺序，从 path_states 里提取每一段的平均概率
-    for (size_t i = 0; i < flat_targets.size(); ++i) {
-        const auto& target = flat_targets[i];
-
-        // 扩展状态索引：target[i] 对应的是 state[2*i + 1]
-        // state[0]=blank, state[1]=target[0], state[2]=blank, state[3]=target[1]...
-        int target_state_s = (int)i * 2 + 1;
-
-        int start_t = -1;
-        int end_t = -1;
-        float sum_log_prob = 0.0f;
-        int count = 0;
-
-        // 在路径中寻找该状态的时间跨度
-        for (int t = 0; t < T; ++t) {
-            if (path_states[t] == target_state_s) {
-                if (start_t == -1) start_t = t;
-                end_t = t;
-                sum_log_prob += runner.getLogProb(t, target.token_id);
-                count++;
+    AlignStats stats;
+    bool aligned = false;
+
+    // 分段模式：在停顿处切开，各段并行精对齐
+    if (options.segment.enabled && em.frames >= 2 * options.segment.min_segment_frames) {
+        std::vector<AlignSegment> segments = planSegments(em, vocab, words, blank_idx, options.segment);
+        if (segments.size() > 1) {
+            std::vector<uint8_t> ok(segments.size(), 0);
+            std::vector<AlignStats> seg_stats(segments.size());
+            ThreadPool::shared().parallelFor(segments.size(), [&](size_t i) {
+                const AlignSegment& seg = segments[i];
+                ok[i] = alignWords(em.slice(seg.frame_begin, seg.frame_end), vocab, words.data() + seg.word_begin,
+                                   seg.word_end - seg.word_begin, blank_idx, options, phone_mask, seg_stats[i]);
+            }, options.segment.max_threads);
+
+            aligned = std::all_of(ok.begin(), ok.end(), [](uint8_t v) { return v != 0; });
+            if (!aligned && options.cancel && options.cancel->isCancelled()) {
+                return false;
+            }
+            if (aligned) {
+                for (const auto& st : seg_stats) {
+                    stats.states += st.states;
+                    stats.phonemes += st.phonemes;
+                    stats.bytes += st.bytes;
+                }
+                stats.segments = (int)segments.size();
+                LOG_DEBUG("[Debug] Aligned " << words.size() << " words in " << segments.size() << " segments.");
+            }
+            else {
+                // 某一段对不上 (切分点估计错了)，退回整段对齐
+                LOG_WARNING("[Warning] Segmented alignment failed, falling back to whole-passage alignment.");
+                resetWords(words);
             }
         }
+    }
 
-        // 创建详情对象
-        PhonemeDetail detail;
-        detail.ipa = target.text;
-        detail.token_id = target.token_id;
-        detail.start_frame = start_t;
-        detail.end_frame = end_t;
-
-        if (count > 0) {
-            detail.score = sum_log_prob / count;
-        }
-        else {
-            // 极少见情况：该音素被跳过（duration=0）
-            detail.score = -10.0f;
+    if (!aligned) {
+        stats = AlignStats();
+        if (!alignWords(em, vocab, words.data(), words.size(), blank_idx, options, phone_mask, stats)) {
+            return false;
         }
+    }
 
-        // 判定好坏
-        detail.is_good = (detail.score > THRESHOLD_GOOD);
-
-        // 回填到对应的 WordAnalysis 结构中
-        // 使用 target.word_idx 知道它是哪个词
-        words[target.word_idx].details.push_back(detail);
+    if (timings) {
+        timings->states = stats.states;
+        timings->phonemes = stats.phonemes;
+        timings->words = words.size();
+        timings->segments = stats.segments;
+        timings->bytes_allocated += stats.bytes;
     }
 
     // ==========================================
-    // 第六步：计算单词平均分
+    // 第四步：计算单词平均分
     // ==========================================
     for (auto& w : words) {
         if (w.details.empty()) {
-            w.word_score = -10.0f;
+            w.word_score = SCORE_FLOOR;
             continue;
         }
 
@@ -218,15 +368,64 @@ bool calculateGOP(const ModelRunner& runner, std::vector<WordAnalysis>& words, i
         int valid = 0;
         for (const auto& d : w.details) {
             // 过滤掉极低分（可能是未检测到）避免拉低平均分太多
-            if (d.score > -9.0f) {
+            if (d.score > SCORE_UNDETECTED) {
                 total += d.score;
                 valid++;
             }
         }
 
         if (valid > 0) w.word_score = total / valid;
-        else w.word_score = -10.0f;
+        else w.word_score = SCORE_FLOOR;
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+void markWordsUnaligned(std::vector<WordAnalysis>& words, const Vocab& vocab)
+{
+    resetWords(words);
+    for (auto& w : words) {
+        for (const auto& p : w.phonemes) {
+            // 与对齐一致，词表里没有的音素不列出
+            PhonemeDetail detail;
+            detail.ipa = p;
+            detail.token_id = vocab.find(p);
+            if (detail.token_id < 0) continue;
+            detail.score = SCORE_FLOOR;
+            w.details.push_back(detail);
+        }
+        w.word_score = SCORE_FLOOR;
+    }
+}
+
+void buildScoreTrack(const std::vector<WordAnalysis>& words, int frames, std::vector<float>& track)
+{
+    track.assign(std::max(frames, 0), std::numeric_limits<float>::quiet_NaN());
+    for (const auto& w : words) {
+        if (w.skipped) continue;
+        for (const auto& d : w.details) {
+            if (d.start_frame < 0) continue;
+            // end_frame 是该音素的最后一帧 (含)
+            int begin = std::max(d.start_frame, 0);
+            int end = std::min(d.end_frame + 1, frames);
+            for (int t = begin; t < end; ++t) track[t] = d.score;
+        }
+    }
+}
+
+float calculateOverallScore(const std::vector<WordAnalysis>& words) {
+    float total = 0.0f;
+    int valid = 0;
+    for (const auto& w : words) {
+        // 漏读的词按最低分计入，否则跳过反而不扣分
+        if (w.skipped) {
+            total += SCORE_FLOOR;
+            valid++;
+        }
+        else if (w.word_score > SCORE_FLOOR) {
+            total += w.word_score;
+            valid++;
+        }
+    }
+    return (valid > 0) ? (total / valid) : SCORE_FLOOR;
+}
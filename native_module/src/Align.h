@@ -3,18 +3,80 @@
 #include <vector>
 #include "Phonemizer.h"  // 包含 WordAnalysis 和 PhonemeDetail 定义
 #include "ModelRunner.h" // 包含模型推理和词表查询
+#include "Lattice.h"     // 发音格 (多发音、可跳词)
+#include "Emission.h"
+#include "Thresholds.h"   // 评分阈值表和哨兵值
 
-// 评分阈值配置 (经验值，基于对数概率)
-// 0.0 是满分, 负无穷是最低分
-const float THRESHOLD_EXCELLENT = -1.0f; // > -1.0 优秀
-const float THRESHOLD_GOOD = -2.5f;      // > -2.5 合格
+// 扩展评分的诊断阈值
+const float GOP_LR_CORRECT = -1.0f;            // 似然比 GOP >= -1.0 视为读对
+const float SUBSTITUTION_MIN_POSTERIOR = 0.3f; // 竞争音素平均后验超过它 (且高于目标) 才判为替换
+
+// 长段落分段对齐选项
+struct SegmentOptions {
+    // 先用贪心解码找出句间停顿，把停顿对应到单词边界，再把各段分别 (并行) 精对齐。
+    // 对齐开销从 O(T x S) 降为各段之和，长文本的 DP 表也小得多；任何一段失败都会退回整段对齐
+    bool enabled = false;
+    int min_pause_frames = 15;     // 至少这么多连续 blank 帧才算停顿 (20ms/帧，约 0.3 秒)
+    int min_segment_frames = 250;  // 每段至少这么多帧 (约 5 秒)，太短的段不值得切
+    float anchor_tolerance = 2.0f; // 停顿位置换算出的音素数与单词边界最多差几个音素
+    int max_threads = 0;           // 0 = 共享线程池的全部线程
+};
+
+// 评分选项
+struct GopOptions {
+    // 扩展评分：额外计算 top-k 竞争音素、似然比 GOP 和替换提示。
+    // 复用同一个对数概率矩阵和对齐段，只多一次 O(T x V) 的遍历
+    bool detailed = false;
+    int top_k = 3;
+    // 发音格选项 (跳词、变体罚分)。备选发音本身放在 WordAnalysis::variants 里
+    LatticeOptions lattice;
+    SegmentOptions segment;
+    // 判定 is_good / is_excellent 用的阈值表 (按音素)，为空时用内置的 THRESHOLD_GOOD / THRESHOLD_EXCELLENT
+    std::shared_ptr<const ThresholdTable> thresholds;
+    // 非空时 Viterbi 周期性检查，取消后 calculateGOP 返回 false (不再退回整段对齐)
+    const CancelToken* cancel = nullptr;
+    // 用检查点 Viterbi 代替完整回溯表：结果相同，DP 内存 O(sqrt(T) x S)，对齐耗时约两倍
+    bool low_memory = false;
+};
+
+const char* gopHintName(GopHint hint);
 
 /**
  * 全局函数：执行强制对齐并计算 GOP 得分
  * * @param runner: 已经执行完 runInference() 的模型运行器
  * @param words: [输入/输出] 也就是 Phonemizer::analyzeText 的结果。
- * 函数会直接修改这个 vector，填充里面的 details 和 word_score。
+ * 函数会直接修改这个 vector，填充里面的 details、word_score、variant 和 skipped。
+ * 有 variants 的词会在一次 Viterbi 里同时选出最匹配的发音。
  * @param blank_idx: CTC Blank 的 ID (Wav2Vec2 通常是 0)
- * @return: true 表示计算成功，false 表示失败
+ * @param timings: 可选，记录状态数、音素数和 DP 表大小
+ * @param options: 评分选项 (是否开启扩展评分)
+ * @return: true 表示计算成功，false 表示失败 (或 options.cancel 已取消)
+ */
+bool calculateGOP(const ModelRunner& runner, std::vector<WordAnalysis>& words, int blank_idx = 0,
+                  StageTimings* timings = nullptr, const GopOptions& options = GopOptions());
+
+/**
+ * 同上，但直接在对数概率矩阵视图上对齐 (不需要 ModelRunner，例如缓存或离线的发射矩阵)
+ */
+bool calculateGOP(const EmissionView& em, const Vocab& vocab, std::vector<WordAnalysis>& words, int blank_idx = 0,
+                  StageTimings* timings = nullptr, const GopOptions& options = GopOptions());
+
+/**
+ * 不做对齐，直接把每个词的标准发音记为最低分 (SCORE_FLOOR)
+ * 用于预检判定音频和文本对不上时，保持返回结构与正常评分一致
+ */
+void markWordsUnaligned(std::vector<WordAnalysis>& words, const Vocab& vocab);
+
+/**
+ * 按 CTC 帧展开的得分轨 (界面按帧着色用)
+ * @param track: [输出] 长度为 frames，第 t 帧为覆盖它的音素得分；不属于任何音素的帧 (blank、漏读) 为 NaN
+ */
+void buildScoreTrack(const std::vector<WordAnalysis>& words, int frames, std::vector<float>& track);
+
+/**
+ * 全局函数：计算整句得分 (所有有效单词得分的平均值)
+ * @param words: calculateGOP 处理过的单词列表
+ * 漏读 (skipped) 的词按 SCORE_FLOOR 计入
+ * @return: 整句得分，没有有效单词时返回 SCORE_FLOOR
  */
-bool calculateGOP(const ModelRunner& runner, std::vector<WordAnalysis>& words, int blank_idx = 0);
\ No newline at end of file
+float calculateOverallScore(const std::vector<WordAnalysis>& words);
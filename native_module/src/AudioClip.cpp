@@ -0,0 +1,106 @@
+#include "AudioClip.h"
+#include "AudioFrontEnd.h"
+
+#include <algorithm>
+#include <cmath>
+
+size_t frameToSourceSample(int frame, unsigned int sample_rate)
+{
+    if (frame <= 0) return 0;
+    return (size_t)std::llround((double)frame * MODEL_FRAME_STRIDE * sample_rate / TARGET_SAMPLE_RATE);
+}
+
+std::vector<WordClip> planWordClips(const std::vector<WordAnalysis>& words, size_t total_frames, unsigned int sample_rate,
+                                    const ClipOptions& options)
+{
+    // 1. 有对齐位置的词，按得分从低到高取前 max_clips 个
+    std::vector<WordClip> picked;
+    for (size_t w = 0; w < words.size(); ++w) {
+        const WordAnalysis& word = words[w];
+        if (word.skipped || word.word_score >= options.max_score) continue;
+
+        int start = -1, end = -1;
+        for (const auto& d : word.details) {
+            if (d.start_frame < 0) continue;
+            if (start < 0 || d.start_frame < start) start = d.start_frame;
+            end = std::max(end, d.end_frame);
+        }
+        if (start < 0) continue;
+
+        WordClip clip;
+        clip.words.push_back((int)w);
+        clip.text = word.word;
+        clip.score = word.word_score;
+        clip.start_frame = start;
+        clip.end_frame = end;
+        picked.push_back(std::move(clip));
+    }
+    std::stable_sort(picked.begin(), picked.end(), [](const WordClip& a, const WordClip& b) { return a.score < b.score; });
+    if (options.max_clips > 0 && picked.size() > (size_t)options.max_clips) {
+        picked.resize(options.max_clips);
+    }
+    std::sort(picked.begin(), picked.end(), [](const WordClip& a, const WordClip& b) { return a.start_frame < b.start_frame; });
+
+    // 2. 换算成源采样率下的样本范围 (结束帧要算上卷积感受野) 并加留白
+    const size_t pad = (size_t)std::max(0, options.pad_ms) * sample_rate / 1000;
+    const size_t field = (size_t)std::llround((double)MODEL_RECEPTIVE_FIELD * sample_rate / TARGET_SAMPLE_RATE);
+    for (auto& clip : picked) {
+        size_t begin = frameToSourceSample(clip.start_frame, sample_rate);
+        size_t end = frameToSourceSample(clip.end_frame, sample_rate) + field;
+        clip.begin = begin > pad ? begin - pad : 0;
+        clip.end = std::min(total_frames, end + pad);
+    }
+
+    // 3. 重叠或相接的片段合并，同一段音频不重复上传
+    std::vector<WordClip> clips;
+    for (auto& clip : picked) {
+        if (clip.begin >= clip.end) continue;
+        if (!clips.empty() && clip.begin <= clips.back().end) {
+            WordClip& last = clips.back();
+            last.words.insert(last.words.end(), clip.words.begin(), clip.words.end());
+            last.text += " " + clip.text;
+            last.score = std::min(last.score, clip.score);
+            last.end_frame = std::max(last.end_frame, clip.end_frame);
+            last.end = std::max(last.end, clip.end);
+            continue;
+        }
+        clips.push_back(std::move(clip));
+    }
+    return clips;
+}
+
+void encodeWavClip(const float* interleaved, unsigned int channels, unsigned int sample_rate, size_t begin, size_t end,
+                   std::vector<uint8_t>& out)
+{
+    const size_t frames = end > begin ? end - begin : 0;
+    const uint32_t data_bytes = (uint32_t)(frames * sizeof(int16_t));
+
+    out.clear();
+    out.reserve(44 + data_bytes);
+    auto u16 = [&](uint16_t v) { for (int i = 0; i < 2; ++i) out.push_back((uint8_t)(v >> (8 * i))); };
+    auto u32 = [&](uint32_t v) { for (int i = 0; i < 4; ++i) out.push_back((uint8_t)(v >> (8 * i))); };
+    auto tag = [&](const char* s) { out.insert(out.end(), s, s + 4); };
+
+    tag("RIFF");
+    u32(36 + data_bytes);
+    tag("WAVE");
+    tag("fmt ");
+    u32(16);
+    u16(1); // PCM
+    u16(1); // 单声道
+    u32(sample_rate);
+    u32(sample_rate * sizeof(int16_t));
+    u16(sizeof(int16_t));
+    u16(16);
+    tag("data");
+    u32(data_bytes);
+
+    const float inv = channels > 0 ? 1.0f / channels : 1.0f;
+    for (size_t f = begin; f < begin + frames; ++f) {
+        const float* frame = interleaved + f * channels;
+        float sum = 0.0f;
+        for (unsigned int c = 0; c < channels; ++c) sum += frame[c];
+        float x = std::max(-1.0f, std::min(1.0f, sum * inv));
+        u16((uint16_t)(int16_t)std::lrintf(x * 32767.0f));
+    }
+}
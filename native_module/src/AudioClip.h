@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Phonemizer.h"
+
+// 按词切音频片段的选项
+struct ClipOptions {
+    int max_clips = 3;        // 最多选几个词 (按词得分从低到高，0 = 不限)，相邻的片段重叠时合并成一段
+    int pad_ms = 150;         // 每段前后各多留的时长，避免把词首辅音切掉
+    float max_score = 1e9f;   // 只选得分低于它的词，默认不限
+};
+
+// 一段要切出来的音频
+struct WordClip {
+    std::vector<int> words;   // 包含的词 (words 下标，升序)
+    std::string text;         // 这些词用空格连起来
+    float score = 0.0f;       // 其中最低的词得分
+    int start_frame = 0;      // 模型帧 (不含前后留白)
+    int end_frame = 0;
+    size_t begin = 0;         // 源采样率下的样本帧 [begin, end)，含留白
+    size_t end = 0;
+};
+
+/**
+ * 从 calculateGOP 的结果里选出得分最低的几个词，换算成原始 PCM 上的范围。
+ * 漏读和没有对齐位置的词不参与；结果按时间顺序排列
+ * @param total_frames: 原始 PCM 的样本帧数 (源采样率，不乘声道数)
+ */
+std::vector<WordClip> planWordClips(const std::vector<WordAnalysis>& words, size_t total_frames, unsigned int sample_rate,
+                                    const ClipOptions& options = ClipOptions());
+
+// 模型帧号对应的源采样率样本帧
+size_t frameToSourceSample(int frame, unsigned int sample_rate);
+
+/**
+ * 把交错 PCM 的 [begin, end) 样本帧编码成 16-bit 单声道 WAV (多声道取平均，保持源采样率)
+ * @param out: [输出] 完整的 WAV 文件内容 (44 字节头 + 数据)
+ */
+void encodeWavClip(const float* interleaved, unsigned int channels, unsigned int sample_rate, size_t begin, size_t end,
+                   std::vector<uint8_t>& out);
@@ -0,0 +1,87 @@
+#include "AudioFrontEnd.h"
+
+#include <cmath>
+#include <numeric>
+
+void mixToMono(std::vector<float>& audio, unsigned int channels, size_t total_frames)
+{
+	if (channels == 1) {
+		// Already mono
+		return;
+	}
+
+	for (size_t i = 0; i < total_frames; ++i) {
+		float sum = 0.0f;
+		for (unsigned int c = 0; c < channels; ++c) {
+			sum += audio[i * channels + c];
+		}
+		audio[i] = sum / channels;
+	}
+
+	audio.erase(audio.begin() + total_frames, audio.end());
+}
+
+void resampleAudio(std::vector<float>& audio, unsigned int src_rate)
+{
+	if (src_rate == TARGET_SAMPLE_RATE) {
+		// No resampling needed
+		return;
+	}
+
+	// 计算目标长度
+	double ratio = (double)src_rate / TARGET_SAMPLE_RATE;
+	size_t output_size = (size_t)(audio.size() / ratio);
+
+	std::vector<float> resampled(output_size);
+	for (size_t i = 0; i < output_size; ++i) {
+		double src_index = i * ratio;
+		size_t idx = (size_t)std::floor(src_index);
+		float frac = (float)(src_index - idx);
+		if (idx + 1 < audio.size()) {
+			// Linear interpolation
+			resampled[i] = audio[idx] * (1.0f - frac) + audio[idx + 1] * frac;
+		}
+		else {
+			resampled[i] = audio[idx];
+		}
+	}
+
+	audio = std::move(resampled);
+}
+
+uint64_t resampledLength(uint64_t src_frames, unsigned int src_rate)
+{
+    if (src_rate == TARGET_SAMPLE_RATE || src_rate == 0) return src_frames;
+    double ratio = (double)src_rate / TARGET_SAMPLE_RATE;
+    return (uint64_t)(src_frames / ratio);
+}
+
+uint64_t framesForSamples(uint64_t samples)
+{
+    if (samples < MODEL_RECEPTIVE_FIELD) return 0;
+    return (samples - MODEL_RECEPTIVE_FIELD) / MODEL_FRAME_STRIDE + 1;
+}
+
+void normalizeAudio(std::vector<float>& audio)
+{
+	if (audio.empty()) return;
+
+	// 1. 计算均值
+	double sum = std::accumulate(audio.begin(), audio.end(), 0.0);
+	double mean = sum / audio.size();
+
+	// 2. 计算方差
+	double sq_sum = 0.0;
+	for (float val : audio) {
+		sq_sum += (val - mean) * (val - mean);
+	}
+	double std_dev = std::sqrt(sq_sum / audio.size());
+
+	// 防止除以 0
+	if (std_dev < 1e-5) std_dev = 1e-5;
+
+	// 3. 应用归一化
+	for (float& val : audio) {
+		val = (float)((val - mean) / std_dev);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+const unsigned int TARGET_SAMPLE_RATE = 16000;
+// Wav2Vec2 的卷积前端：第 t 帧覆盖 16k 样本 [t * MODEL_FRAME_STRIDE, t * MODEL_FRAME_STRIDE + MODEL_RECEPTIVE_FIELD)
+const unsigned int MODEL_FRAME_STRIDE = 320;
+const unsigned int MODEL_RECEPTIVE_FIELD = 400;
+
+// 16k 样本数对应的模型输出帧数
+uint64_t framesForSamples(uint64_t samples);
+// 源采样率下 src_frames 帧重采样到 16k 之后的样本数 (与 resampleAudio 的输出长度一致)，
+// 用来在解码之前预估请求的代价
+uint64_t resampledLength(uint64_t src_frames, unsigned int src_rate);
+
+// 音频前端处理 (ModelRunner::loadAudio 依次调用，基准测试也单独调用)
+
+// 交错多声道 -> 单声道 (原地，结果保留前 total_frames 个样本)
+void mixToMono(std::vector<float>& audio, unsigned int channels, size_t total_frames);
+// 线性插值重采样到 TARGET_SAMPLE_RATE
+void resampleAudio(std::vector<float>& audio, unsigned int src_rate);
+// 零均值、单位方差归一化 (Wav2Vec2 的输入要求)
+void normalizeAudio(std::vector<float>& audio);
@@ -0,0 +1,154 @@
+#include "Cancel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <thread>
+
+const char* cancelReasonName(CancelReason reason)
+{
+    switch (reason) {
+    case CancelReason::Cancelled: return "cancelled";
+    case CancelReason::DeadlineExceeded: return "deadline_exceeded";
+    default: return "none";
+    }
+}
+
+static int64_t toNanos(CancelToken::Clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+}
+
+namespace {
+
+// 截止时间计时线程：进程内一个，第一次设置截止时间时启动。
+// 到期时在这个线程上调用 cancel()，从而触发注册的回调 (比如终止正在跑的推理)
+class DeadlineTimer {
+public:
+    static DeadlineTimer& shared()
+    {
+        static DeadlineTimer timer;
+        return timer;
+    }
+
+    void arm(const CancelToken* token, CancelToken::Clock::time_point deadline)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!thread.joinable()) {
+                thread = std::thread([this]() { run(); });
+            }
+            pending[token] = deadline;
+        }
+        cv.notify_one();
+    }
+
+    // 返回后保证不会再对 token 调用 cancel() (到期处理在持锁时进行)
+    void disarm(const CancelToken* token)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.erase(token);
+    }
+
+    ~DeadlineTimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_one();
+        if (thread.joinable()) thread.join();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (pending.empty()) {
+                cv.wait(lock);
+                continue;
+            }
+
+            auto next = std::min_element(pending.begin(), pending.end(),
+                                         [](const auto& a, const auto& b) { return a.second < b.second; });
+            if (CancelToken::Clock::now() < next->second) {
+                cv.wait_until(lock, next->second);
+                continue;
+            }
+            const CancelToken* token = next->first;
+            pending.erase(next);
+            token->cancel(CancelReason::DeadlineExceeded);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    // 同时在跑的请求只有几个，线性找最早的截止时间即可
+    std::map<const CancelToken*, CancelToken::Clock::time_point> pending;
+    bool stopping = false;
+};
+
+} // namespace
+
+CancelToken::~CancelToken()
+{
+    if (has_deadline) DeadlineTimer::shared().disarm(this);
+}
+
+void CancelToken::cancel(CancelReason reason) const
+{
+    // 原因在锁内置位，与 addCallback 互斥：每个回调恰好被调用一次
+    std::lock_guard<std::mutex> lock(mutex);
+    if (reason_.load() != (int)CancelReason::None) return;
+    reason_.store((int)reason);
+    for (auto& cb : callbacks) cb.second();
+}
+
+bool CancelToken::isCancelled() const
+{
+    if (reason_.load(std::memory_order_relaxed) != (int)CancelReason::None) return true;
+
+    int64_t deadline = deadline_ns.load(std::memory_order_relaxed);
+    if (deadline != INT64_MAX && toNanos(Clock::now()) >= deadline) {
+        // 计时线程可能还没来得及触发，由先发现的一方取消
+        cancel(CancelReason::DeadlineExceeded);
+        return true;
+    }
+    return false;
+}
+
+CancelReason CancelToken::reason() const
+{
+    isCancelled();
+    return (CancelReason)reason_.load();
+}
+
+void CancelToken::setDeadline(Clock::time_point deadline)
+{
+    if (has_deadline) return;
+    has_deadline = true;
+    deadline_ns.store(toNanos(deadline));
+    DeadlineTimer::shared().arm(this, deadline);
+}
+
+int CancelToken::addCallback(std::function<void()> fn) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int id = next_id++;
+    // 已经取消：cancel() 里的回调循环已经跑过，这里直接调用
+    if (reason_.load() != (int)CancelReason::None) {
+        fn();
+    }
+    callbacks.emplace_back(id, std::move(fn));
+    return id;
+}
+
+void CancelToken::removeCallback(int id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                   [id](const auto& cb) { return cb.first == id; }),
+                    callbacks.end());
+}
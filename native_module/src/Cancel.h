@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+enum class CancelReason {
+    None,
+    Cancelled,         // 调用方主动取消 (例如用户重新录音)
+    DeadlineExceeded,  // 超过截止时间
+};
+
+const char* cancelReasonName(CancelReason reason);
+
+// 长循环里每隔多少帧检查一次取消状态 (一次检查约几十纳秒)
+const int CANCEL_CHECK_FRAMES = 32;
+
+/**
+ * 取消令牌 (线程安全)。cancel() 或截止时间到达后置位，不可复位。
+ * 对齐等长循环周期性调用 isCancelled() 自行退出；
+ * 不能轮询的阻塞调用 (ORT 推理) 通过 addCallback 注册回调，取消时立即被调用。
+ * 设置了截止时间的令牌由后台计时线程在到期时触发，即使没有人轮询回调也会执行。
+ * 令牌注册在计时线程里，所以不可复制、不可移动。
+ */
+class CancelToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CancelToken() = default;
+    ~CancelToken();
+
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    // 只有第一次取消生效 (保留最初的原因)
+    void cancel(CancelReason reason = CancelReason::Cancelled) const;
+    bool isCancelled() const;
+    CancelReason reason() const;
+
+    // 到 deadline 时以 DeadlineExceeded 取消；只能设置一次
+    void setDeadline(Clock::time_point deadline);
+    bool hasDeadline() const { return has_deadline; }
+
+    // 注册取消回调 (已经取消时在当前线程立即调用)，返回值用于注销。
+    // 回调在持有令牌内部锁的情况下执行，必须很快且不能再操作这个令牌
+    int addCallback(std::function<void()> fn) const;
+    // 注销返回后回调保证不会再被调用
+    void removeCallback(int id) const;
+
+private:
+    mutable std::atomic<int> reason_{ (int)CancelReason::None };
+    std::atomic<int64_t> deadline_ns{ INT64_MAX }; // Clock 纪元起的纳秒数
+    bool has_deadline = false;
+
+    mutable std::mutex mutex;
+    mutable std::vector<std::pair<int, std::function<void()>>> callbacks;
+    mutable int next_id = 0;
+};
+
+// 作用域内的取消回调 (token 为空时什么都不做)
+class ScopedCancelCallback {
+public:
+    ScopedCancelCallback(const CancelToken* token, std::function<void()> fn)
+        : token_(token), id_(token ? token->addCallback(std::move(fn)) : -1) {}
+    ~ScopedCancelCallback() { if (token_) token_->removeCallback(id_); }
+
+    ScopedCancelCallback(const ScopedCancelCallback&) = delete;
+    ScopedCancelCallback& operator=(const ScopedCancelCallback&) = delete;
+
+private:
+    const CancelToken* token_;
+    int id_;
+};
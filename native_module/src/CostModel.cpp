@@ -0,0 +1,122 @@
+#include "CostModel.h"
+#include "Lattice.h"
+
+#include <cctype>
+
+// 耗时系数的滑动平均权重
+static const double OBSERVE_WEIGHT = 0.1;
+
+const char* admissionDecisionName(AdmissionDecision decision)
+{
+    switch (decision) {
+    case AdmissionDecision::Full: return "full";
+    case AdmissionDecision::LowMemory: return "low_memory";
+    case AdmissionDecision::Rejected: return "rejected";
+    default: return "unknown";
+    }
+}
+
+uint64_t estimateStatesFromText(const std::string& text)
+{
+    uint64_t letters = 0;
+    for (unsigned char c : text) {
+        // UTF-8 的后续字节不单独计数
+        if ((c & 0xC0) == 0x80) continue;
+        if (c >= 0x80 || std::isalnum(c)) letters++;
+    }
+    // 每个音素一个状态，音素间和词间各一个 blank：n 个音素的词占 2n 个状态
+    return 2 * letters + 1;
+}
+
+CostEstimate CostModel::estimate(uint64_t audio_samples, uint64_t frames, uint64_t vocab_size, uint64_t states,
+                                 bool low_memory) const
+{
+    Coefficients c;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        c = coef_;
+    }
+
+    CostEstimate e;
+    e.frames = frames;
+    e.states = states;
+
+    const uint64_t emission_bytes = frames * vocab_size * sizeof(float);
+    if (audio_samples > 0) {
+        double f = (double)frames;
+        e.inference_bytes = audio_samples * sizeof(float) + (uint64_t)(audio_samples * c.feature_bytes_per_sample) +
+                            (uint64_t)(f * f * c.attention_bytes_per_frame2 + f * c.activation_bytes_per_frame) +
+                            2 * emission_bytes;
+        e.inference_ms = f * c.inference_ms_per_frame;
+    }
+
+    e.align_bytes = emission_bytes + viterbiBytes(frames, states, low_memory);
+    e.align_ms = (double)frames * states * c.align_ns_per_cell * 1e-6 * (low_memory ? LOW_MEMORY_TIME_FACTOR : 1.0);
+    return e;
+}
+
+Admission CostModel::plan(const AdmissionPolicy& policy, uint64_t audio_samples, uint64_t frames, uint64_t vocab_size,
+                          uint64_t states) const
+{
+    auto fits = [&](const CostEstimate& e) {
+        return (policy.max_bytes == 0 || e.peakBytes() <= policy.max_bytes) &&
+               (policy.max_ms <= 0.0 || e.totalMs() <= policy.max_ms);
+    };
+
+    Admission a;
+    a.estimate = estimate(audio_samples, frames, vocab_size, states, false);
+    if (!fits(a.estimate) && policy.degrade) {
+        a.decision = AdmissionDecision::LowMemory;
+        a.estimate = estimate(audio_samples, frames, vocab_size, states, true);
+    }
+    if (!fits(a.estimate)) {
+        a.decision = AdmissionDecision::Rejected;
+        if (policy.max_bytes > 0 && a.estimate.peakBytes() > policy.max_bytes) {
+            a.reason = "Request exceeds the memory budget (estimated " + std::to_string(a.estimate.peakBytes() >> 20) +
+                       " MB > " + std::to_string(policy.max_bytes >> 20) + " MB)";
+        }
+        else {
+            a.reason = "Request exceeds the time budget (estimated " + std::to_string((int64_t)a.estimate.totalMs()) +
+                       " ms > " + std::to_string((int64_t)policy.max_ms) + " ms)";
+        }
+    }
+    return a;
+}
+
+void CostModel::record(AdmissionDecision decision)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    decisions_[(int)decision]++;
+}
+
+void CostModel::observe(const StageTimings& timings, bool low_memory)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timings.frames == 0) return;
+
+    if (timings.measured[(int)Stage::Inference]) {
+        double ms = timings.ms[(int)Stage::Inference] + timings.ms[(int)Stage::LogSoftmax];
+        double per_frame = ms / timings.frames;
+        coef_.inference_ms_per_frame += OBSERVE_WEIGHT * (per_frame - coef_.inference_ms_per_frame);
+    }
+    if (timings.measured[(int)Stage::Align] && timings.states > 0 && timings.segments <= 1) {
+        double ns = timings.ms[(int)Stage::Align] * 1e6 / ((double)timings.frames * timings.states);
+        if (low_memory) ns /= LOW_MEMORY_TIME_FACTOR;
+        coef_.align_ns_per_cell += OBSERVE_WEIGHT * (ns - coef_.align_ns_per_cell);
+    }
+}
+
+CostModel::Stats CostModel::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    s.coefficients = coef_;
+    for (int i = 0; i < 3; ++i) s.decisions[i] = decisions_[i];
+    return s;
+}
+
+void CostModel::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& d : decisions_) d = 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "AudioFrontEnd.h" // framesForSamples
+#include "Metrics.h"
+
+// 准入决定：按什么方式执行一个请求
+enum class AdmissionDecision {
+    Full,      // 按原方式执行
+    LowMemory, // 检查点 Viterbi (音频足够长时同时分段对齐)
+    Rejected   // 最省的方式也超出预算
+};
+
+const char* admissionDecisionName(AdmissionDecision decision);
+
+// 单个请求的资源预算
+struct AdmissionPolicy {
+    uint64_t max_bytes = 0; // 峰值内存上限，0 = 不限制
+    double max_ms = 0.0;    // 预计耗时上限，0 = 不限制
+    bool degrade = true;    // 超出时先改用低内存对齐，仍超出才拒绝；false 时直接拒绝
+};
+
+// 一次请求的资源估算
+struct CostEstimate {
+    uint64_t frames = 0;          // 模型输出帧数 T
+    uint64_t states = 0;          // 发音格状态数 S (上界)
+    uint64_t inference_bytes = 0; // 推理时的峰值：前端输出、卷积特征、注意力矩阵、logits 及缓存副本
+    uint64_t align_bytes = 0;     // 对齐时的峰值：对数概率矩阵 + DP 表
+    double inference_ms = 0.0;
+    double align_ms = 0.0;
+
+    uint64_t peakBytes() const { return inference_bytes > align_bytes ? inference_bytes : align_bytes; }
+    double totalMs() const { return inference_ms + align_ms; }
+};
+
+struct Admission {
+    AdmissionDecision decision = AdmissionDecision::Full;
+    CostEstimate estimate; // 按选定的方式估算 (被拒绝时为最省的方式)
+    std::string reason;    // 被拒绝的原因
+};
+
+/**
+ * 请求的内存和耗时估算 (线程安全)。
+ * 内存按 wav2vec2-base 的结构估算 (卷积特征随样本数线性增长，自注意力随帧数平方增长)；
+ * 耗时系数从实际完成的请求里滑动平均校准，冷启动时用保守的默认值
+ */
+class CostModel {
+public:
+    struct Coefficients {
+        double feature_bytes_per_sample = 600.0;  // 前两层卷积的输出 (512 通道，步长 5 和 10)
+        double attention_bytes_per_frame2 = 96.0; // 12 个头的注意力得分 + softmax (一层)
+        double activation_bytes_per_frame = 32768.0; // 隐层和 FFN 的中间结果 (一层)
+        double inference_ms_per_frame = 1.0;      // 推理 + LogSoftmax
+        double align_ns_per_cell = 5.0;           // 完整 Viterbi 每个 (帧, 状态) 格子的耗时
+    };
+
+    // 低内存 Viterbi 多算一遍前向
+    static constexpr double LOW_MEMORY_TIME_FACTOR = 2.0;
+
+    /**
+     * @param audio_samples: 前端输出的 16k 单声道样本数；0 表示推理已经做过 (缓存或存档)，只估算对齐
+     * @param frames: 模型输出帧数，推理之前用 framesForSamples 换算
+     */
+    CostEstimate estimate(uint64_t audio_samples, uint64_t frames, uint64_t vocab_size, uint64_t states, bool low_memory) const;
+
+    // 依次尝试原方式和低内存方式，选第一个不超预算的
+    Admission plan(const AdmissionPolicy& policy, uint64_t audio_samples, uint64_t frames, uint64_t vocab_size,
+                   uint64_t states) const;
+    // 计入一次最终的决定 (推理前的预估和对齐前的复核只记一次)
+    void record(AdmissionDecision decision);
+
+    // 用完成的请求校准耗时系数 (分段对齐的段长不一，不用来校准对齐)
+    void observe(const StageTimings& timings, bool low_memory);
+
+    struct Stats {
+        Coefficients coefficients;
+        uint64_t decisions[3] = {}; // 按 AdmissionDecision 计数
+    };
+    Stats stats() const;
+    void resetStats();
+
+private:
+    mutable std::mutex mutex_;
+    Coefficients coef_;
+    uint64_t decisions_[3] = {};
+};
+
+// 推理之前还没有分词结果：按参考文本的字符数粗估状态数 (每个字母算一个音素)
+uint64_t estimateStatesFromText(const std::string& text);
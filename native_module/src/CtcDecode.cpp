@@ -0,0 +1,196 @@
+#include "CtcDecode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// 一帧的 argmax
+static int argmaxRow(const float* row, int vocab)
+{
+    int best = 0;
+    float best_val = row[0];
+    for (int v = 1; v < vocab; ++v) {
+        if (row[v] > best_val) {
+            best_val = row[v];
+            best = v;
+        }
+    }
+    return best;
+}
+
+std::vector<CtcToken> greedyDecode(const EmissionView& em, int blank_idx)
+{
+    std::vector<CtcToken> tokens;
+    int prev = -1;
+    for (int t = 0; t < em.frames; ++t) {
+        int tok = argmaxRow(em.row(t), em.vocab);
+        if (tok != blank_idx) {
+            if (tok == prev && !tokens.empty()) {
+                tokens.back().end_frame = t;
+            }
+            else {
+                tokens.push_back({ tok, t, t });
+            }
+        }
+        prev = tok;
+    }
+    return tokens;
+}
+
+std::vector<CtcPause> findPauses(const EmissionView& em, int blank_idx, int min_frames)
+{
+    std::vector<CtcPause> pauses;
+    int run_start = -1;
+    bool seen_speech = false;
+
+    for (int t = 0; t < em.frames; ++t) {
+        bool is_blank = argmaxRow(em.row(t), em.vocab) == blank_idx;
+        if (is_blank) {
+            if (run_start == -1) run_start = t;
+            continue;
+        }
+        // 开头的静音不算停顿
+        if (run_start != -1 && seen_speech && t - run_start >= min_frames) {
+            pauses.push_back({ run_start, t });
+        }
+        run_start = -1;
+        seen_speech = true;
+    }
+    // 结尾的静音 (run_start 到最后一帧) 也不算停顿
+    return pauses;
+}
+
+std::vector<uint8_t> buildPhoneMask(const Vocab& vocab, int vocab_size, int blank_idx)
+{
+    std::vector<uint8_t> mask(vocab_size, 0);
+    for (int v = 0; v < vocab_size; ++v) {
+        const std::string& tok = vocab.token(v);
+        if (v == blank_idx || tok.empty() || tok == "|" || tok[0] == '<') continue;
+        mask[v] = 1;
+    }
+    return mask;
+}
+
+// ==========================================
+// 前缀束搜索
+// ==========================================
+
+namespace {
+
+const float LOG_ZERO = -1e30f;
+
+inline float logAdd(float a, float b)
+{
+    if (a < b) std::swap(a, b);
+    if (b <= LOG_ZERO) return a;
+    return a + std::log1p(std::exp(b - a));
+}
+
+// 前缀树节点：前缀 = 根到该节点的 token 序列
+struct PrefixNode {
+    int parent;
+    int token;       // 根节点为 -1
+    int start_frame; // 最后一个 token 的起始帧：最近一次扩展的概率超过延续概率的帧
+};
+
+struct Beam {
+    int node;
+    float p_blank;     // 以 blank 结尾的概率
+    float p_non_blank; // 以最后一个 token 结尾的概率
+    float p_extend;    // 本帧由父前缀扩展而来的部分
+    float p_stay;      // 本帧由同一前缀延续 (blank 或重复) 的部分
+    float total() const { return logAdd(p_blank, p_non_blank); }
+};
+
+} // namespace
+
+std::vector<CtcToken> beamDecode(const EmissionView& em, int blank_idx, int beam_width)
+{
+    if (beam_width <= 1) return greedyDecode(em, blank_idx);
+
+    std::vector<PrefixNode> nodes;
+    nodes.push_back({ -1, -1, 0 });
+    std::unordered_map<uint64_t, int> children; // (parent << 32 | token) -> node
+
+    auto extend = [&](int parent, int token, int t) {
+        uint64_t key = ((uint64_t)(uint32_t)parent << 32) | (uint32_t)token;
+        auto it = children.find(key);
+        if (it != children.end()) return it->second;
+        nodes.push_back({ parent, token, t });
+        int id = (int)nodes.size() - 1;
+        children.emplace(key, id);
+        return id;
+    };
+
+    std::vector<Beam> beams = { { 0, 0.0f, LOG_ZERO, LOG_ZERO, LOG_ZERO } };
+    std::unordered_map<int, size_t> next_index; // node -> next_beams 下标
+    std::vector<Beam> next_beams;
+    std::vector<int> candidates(em.vocab);
+
+    for (int t = 0; t < em.frames; ++t) {
+        const float* row = em.row(t);
+
+        // 本帧只考虑概率最高的 beam_width 个非 blank token
+        candidates.clear();
+        for (int v = 0; v < em.vocab; ++v) {
+            if (v != blank_idx) candidates.push_back(v);
+        }
+        size_t k = std::min<size_t>(beam_width, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+                          [row](int a, int b) { return row[a] > row[b]; });
+        candidates.resize(k);
+
+        next_beams.clear();
+        next_index.clear();
+        auto slot = [&](int node) -> Beam& {
+            auto it = next_index.find(node);
+            if (it != next_index.end()) return next_beams[it->second];
+            next_index.emplace(node, next_beams.size());
+            next_beams.push_back({ node, LOG_ZERO, LOG_ZERO, LOG_ZERO, LOG_ZERO });
+            return next_beams.back();
+        };
+
+        for (const Beam& b : beams) {
+            float total = b.total();
+            int last = nodes[b.node].token;
+
+            // 输出 blank：前缀不变
+            Beam& same = slot(b.node);
+            same.p_blank = logAdd(same.p_blank, total + row[blank_idx]);
+            same.p_stay = logAdd(same.p_stay, total + row[blank_idx]);
+            // 重复最后一个 token：合并，前缀不变
+            if (last >= 0) {
+                same.p_non_blank = logAdd(same.p_non_blank, b.p_non_blank + row[last]);
+                same.p_stay = logAdd(same.p_stay, b.p_non_blank + row[last]);
+            }
+
+            for (int tok : candidates) {
+                int child = extend(b.node, tok, t);
+                Beam& ext = slot(child);
+                // 与最后一个 token 相同的必须隔着 blank 才算新 token
+                float from = (tok == last) ? b.p_blank : total;
+                ext.p_non_blank = logAdd(ext.p_non_blank, from + row[tok]);
+                ext.p_extend = logAdd(ext.p_extend, from + row[tok]);
+            }
+        }
+
+        size_t keep = std::min<size_t>(beam_width, next_beams.size());
+        std::partial_sort(next_beams.begin(), next_beams.begin() + keep, next_beams.end(),
+                          [](const Beam& a, const Beam& b) { return a.total() > b.total(); });
+        next_beams.resize(keep);
+        // 前缀在更早的帧可能以很低的概率被扩展过，起始帧取主要概率来自扩展的最后一帧
+        for (const Beam& b : next_beams) {
+            if (b.p_extend > b.p_stay) nodes[b.node].start_frame = t;
+        }
+        beams.swap(next_beams);
+    }
+
+    // 最优前缀回溯
+    int best = beams.empty() ? 0 : beams[0].node;
+    std::vector<CtcToken> tokens;
+    for (int n = best; n > 0; n = nodes[n].parent) {
+        tokens.push_back({ nodes[n].token, nodes[n].start_frame, nodes[n].start_frame });
+    }
+    std::reverse(tokens.begin(), tokens.end());
+    return tokens;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Emission.h"
+#include "Vocab.h"
+
+// 贪心解码得到的一个 token (连续相同的帧合并，blank 去掉)
+struct CtcToken {
+    int token_id;
+    int start_frame; // 包含
+    int end_frame;   // 包含
+};
+
+// 连续的 blank 帧 (停顿)
+struct CtcPause {
+    int start_frame; // 包含
+    int end_frame;   // 不包含
+    int length() const { return end_frame - start_frame; }
+};
+
+/**
+ * 贪心 CTC 解码：逐帧取 argmax，合并重复并去掉 blank
+ * 帧号为视图内的帧号 (不含 frame_offset)
+ */
+std::vector<CtcToken> greedyDecode(const EmissionView& em, int blank_idx);
+
+/**
+ * CTC 前缀束搜索 (不带语言模型)。每帧只扩展概率最高的 beam_width 个 token。
+ * beam_width <= 1 时等同于 greedyDecode。束搜索只记录每个 token 的起始帧 (end_frame == start_frame)
+ */
+std::vector<CtcToken> beamDecode(const EmissionView& em, int blank_idx, int beam_width);
+
+// 真正的音素 token 为 1：排除 blank、"|" 词边界和 <s> / <unk> 之类的特殊符号
+std::vector<uint8_t> buildPhoneMask(const Vocab& vocab, int vocab_size, int blank_idx);
+
+/**
+ * 查找 argmax 连续为 blank、长度不少于 min_frames 的停顿 (开头和结尾的静音除外)
+ */
+std::vector<CtcPause> findPauses(const EmissionView& em, int blank_idx, int min_frames);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Waveform.h"
+
+/**
+ * 对数概率矩阵 [frames x vocab] 的只读视图 (不持有数据)。
+ * 可以是整段音频，也可以是其中连续的一段帧 (slice)，对齐和评分只依赖这个视图。
+ */
+struct EmissionView {
+    const float* data = nullptr; // 第 0 帧的起始位置
+    int frames = 0;
+    int vocab = 0;
+    int frame_offset = 0;        // 第 0 帧在整段音频中的帧号
+
+    // 越界返回极小的概率 (与 ModelRunner::getLogProb 一致)
+    float logProb(int t, int token) const
+    {
+        if (t < 0 || t >= frames || token < 0 || token >= vocab) return -1e9f;
+        return data[(size_t)t * vocab + token];
+    }
+
+    const float* row(int t) const { return data + (size_t)t * vocab; }
+
+    // [start, end) 帧的子视图
+    EmissionView slice(int start, int end) const
+    {
+        EmissionView v;
+        v.data = data + (size_t)start * vocab;
+        v.frames = end - start;
+        v.vocab = vocab;
+        v.frame_offset = frame_offset + start;
+        return v;
+    }
+};
+
+/**
+ * 持有数据的对数概率矩阵 (推理结果的一份快照)。
+ * 构建后只读，可以用 shared_ptr<const EmissionMatrix> 在多个请求之间共享
+ */
+struct EmissionMatrix {
+    std::vector<float> data;
+    int frames = 0;
+    int vocab = 0;
+    uint64_t audio_samples = 0; // 产生它的 16k 音频样本数
+    uint64_t model_hash = 0;    // 产生它的模型 (ModelRunner::getModelHash)，模型热切换后旧结果不再命中
+    std::shared_ptr<const AudioSummary> summary; // 同一段音频的波形包络和能量轮廓 (从存档读回的没有)
+
+    EmissionView view() const
+    {
+        EmissionView v;
+        v.data = data.data();
+        v.frames = frames;
+        v.vocab = vocab;
+        return v;
+    }
+
+    size_t bytes() const { return data.size() * sizeof(float) + (summary ? summary->bytes() : 0); }
+};
@@ -0,0 +1,101 @@
+#include "EmissionCache.h"
+#include "Log.h"
+
+std::string formatAudioHandle(uint64_t key)
+{
+    return formatHashHex(key);
+}
+
+bool parseAudioHandle(const std::string& handle, uint64_t& key)
+{
+    if (handle.empty() || handle.size() > 16) return false;
+    uint64_t v = 0;
+    for (char c : handle) {
+        int d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else return false;
+        v = (v << 4) | (uint64_t)d;
+    }
+    key = v;
+    return true;
+}
+
+EmissionCache::EmissionCache(size_t max_bytes, size_t max_entries)
+{
+    stats_.max_bytes = max_bytes;
+    stats_.max_entries = max_entries;
+}
+
+std::shared_ptr<const EmissionMatrix> EmissionCache::find(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        stats_.misses++;
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    stats_.hits++;
+    return it->second->second;
+}
+
+void EmissionCache::insert(uint64_t key, std::shared_ptr<const EmissionMatrix> matrix)
+{
+    if (!matrix) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (matrix->bytes() > stats_.max_bytes || stats_.max_entries == 0) {
+        LOG_DEBUG("[Debug] Emission matrix (" << matrix->bytes() << " bytes) not cached: over the cache limit.");
+        return;
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        stats_.bytes -= it->second->second->bytes();
+        it->second->second = matrix;
+        lru_.splice(lru_.begin(), lru_, it->second);
+    }
+    else {
+        lru_.emplace_front(key, matrix);
+        index_[key] = lru_.begin();
+    }
+    stats_.bytes += matrix->bytes();
+    evictLocked();
+}
+
+void EmissionCache::setLimits(size_t max_bytes, size_t max_entries)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.max_bytes = max_bytes;
+    stats_.max_entries = max_entries;
+    evictLocked();
+}
+
+void EmissionCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_.bytes = 0;
+}
+
+EmissionCache::Stats EmissionCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s = stats_;
+    s.entries = lru_.size();
+    return s;
+}
+
+void EmissionCache::evictLocked()
+{
+    while (!lru_.empty() && (stats_.bytes > stats_.max_bytes || lru_.size() > stats_.max_entries)) {
+        const Entry& victim = lru_.back();
+        stats_.bytes -= victim.second->bytes();
+        index_.erase(victim.first);
+        lru_.pop_back();
+        stats_.evictions++;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Emission.h"
+#include "Hash.h"
+
+// 默认缓存上限：10 秒音频的矩阵约 1 MB (500 帧 x ~400 token x 4 字节)
+const size_t EMISSION_CACHE_DEFAULT_BYTES = 64 * 1024 * 1024;
+const size_t EMISSION_CACHE_DEFAULT_ENTRIES = 128;
+
+// 音频内容哈希 (hashContent) 与 JS 侧的 audioHandle (16 位十六进制字符串) 互转
+std::string formatAudioHandle(uint64_t key);
+bool parseAudioHandle(const std::string& handle, uint64_t& key);
+
+/**
+ * 按音频内容哈希缓存对数概率矩阵的 LRU (线程安全)。
+ * 同一段录音换参考文本或换口音重新评分时，跳过前端和推理，只做 G2P 和对齐。
+ * 同时受总字节数和条目数限制，超出时淘汰最久未用的条目；
+ * 正在被使用的矩阵由 shared_ptr 保活，淘汰只是不再命中。
+ */
+class EmissionCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t max_bytes = 0;
+        size_t max_entries = 0;
+    };
+
+    explicit EmissionCache(size_t max_bytes = EMISSION_CACHE_DEFAULT_BYTES, size_t max_entries = EMISSION_CACHE_DEFAULT_ENTRIES);
+
+    // 命中时移到最近使用的位置，未命中返回 nullptr
+    std::shared_ptr<const EmissionMatrix> find(uint64_t key);
+    // 插入或替换。单个矩阵超过 max_bytes 时不缓存
+    void insert(uint64_t key, std::shared_ptr<const EmissionMatrix> matrix);
+
+    // 修改上限并立即淘汰超出的部分。max_bytes 或 max_entries 为 0 表示关闭缓存
+    void setLimits(size_t max_bytes, size_t max_entries);
+    void clear();
+
+    Stats stats() const;
+
+private:
+    typedef std::pair<uint64_t, std::shared_ptr<const EmissionMatrix>> Entry;
+
+    void evictLocked();
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // 头部是最近使用的
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+    Stats stats_;
+};
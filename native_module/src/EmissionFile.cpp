@@ -0,0 +1,383 @@
+#include "EmissionFile.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+
+// 文件头，固定 64 字节
+struct EmissionFileHeader {
+    char magic[4];          // "EMIS"
+    uint16_t version;
+    uint8_t encoding;
+    uint8_t reserved;
+    uint32_t frames;
+    uint32_t vocab;
+    uint32_t top_k;
+    float frame_rate;
+    uint64_t model_hash;
+    uint64_t vocab_hash;
+    uint64_t audio_samples;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+};
+static_assert(sizeof(EmissionFileHeader) == 64, "EmissionFileHeader must be 64 bytes");
+
+static const char EMISSION_MAGIC[4] = { 'E', 'M', 'I', 'S' };
+static const uint16_t EMISSION_VERSION = 1;
+
+const char* emissionEncodingName(EmissionEncoding encoding)
+{
+    switch (encoding) {
+    case EmissionEncoding::Float32: return "fp32";
+    case EmissionEncoding::Float16: return "fp16";
+    case EmissionEncoding::Int8: return "int8";
+    }
+    return "unknown";
+}
+
+bool parseEmissionEncoding(const std::string& name, EmissionEncoding& encoding)
+{
+    if (name == "fp32") encoding = EmissionEncoding::Float32;
+    else if (name == "fp16") encoding = EmissionEncoding::Float16;
+    else if (name == "int8") encoding = EmissionEncoding::Int8;
+    else return false;
+    return true;
+}
+
+// ==========================================
+// 值编码
+// ==========================================
+
+static size_t valueBytes(EmissionEncoding encoding)
+{
+    switch (encoding) {
+    case EmissionEncoding::Float32: return 4;
+    case EmissionEncoding::Float16: return 2;
+    case EmissionEncoding::Int8: return 1;
+    }
+    return 0;
+}
+
+// IEEE 754 binary16，就近舍入，溢出到无穷
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exp = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mant = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return (uint16_t)(sign | 0x7C00 | (mant ? 0x200 : 0)); // Inf / NaN
+    }
+    if (exp >= 31) {
+        return (uint16_t)(sign | 0x7C00);
+    }
+    if (exp <= 0) {
+        if (exp < -10) return (uint16_t)sign;
+        // 非规格化数
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++; // 进位可能顺延到指数，结果仍然正确
+    return (uint16_t)half;
+}
+
+static float halfToFloat(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t bits;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        }
+        else {
+            // 非规格化数：规格化后再拼
+            exp = 127 - 15 + 1;
+            while ((mant & 0x400) == 0) {
+                mant <<= 1;
+                exp--;
+            }
+            mant &= 0x3FF;
+            bits = sign | (exp << 23) | (mant << 13);
+        }
+    }
+    else if (exp == 31) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    }
+    else {
+        bits = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+static void encodeValue(float lp, EmissionEncoding encoding, unsigned char* out)
+{
+    switch (encoding) {
+    case EmissionEncoding::Float32:
+        std::memcpy(out, &lp, 4);
+        break;
+    case EmissionEncoding::Float16: {
+        uint16_t h = floatToHalf(lp);
+        std::memcpy(out, &h, 2);
+        break;
+    }
+    case EmissionEncoding::Int8: {
+        // 平方根压扩：接近 0 (高概率) 的部分分得更细，对评分影响大的正是这一段
+        float clipped = std::min(0.0f, std::max(EMISSION_INT8_FLOOR, lp));
+        *out = (uint8_t)std::lround(255.0f * std::sqrt(clipped / EMISSION_INT8_FLOOR));
+        break;
+    }
+    }
+}
+
+static float decodeValue(const unsigned char* in, EmissionEncoding encoding)
+{
+    switch (encoding) {
+    case EmissionEncoding::Float32: {
+        float v;
+        std::memcpy(&v, in, 4);
+        return v;
+    }
+    case EmissionEncoding::Float16: {
+        uint16_t h;
+        std::memcpy(&h, in, 2);
+        return halfToFloat(h);
+    }
+    case EmissionEncoding::Int8: {
+        float r = (float)(*in) / 255.0f;
+        return EMISSION_INT8_FLOOR * r * r;
+    }
+    }
+    return 0.0f;
+}
+
+static size_t frameBytes(EmissionEncoding encoding, int vocab, int top_k)
+{
+    size_t vb = valueBytes(encoding);
+    if (top_k <= 0) return (size_t)vocab * vb;
+    return (size_t)top_k * (sizeof(uint16_t) + vb) + vb;
+}
+
+// ==========================================
+// 写
+// ==========================================
+
+bool writeEmissionFile(const std::string& path, const EmissionView& em, const EmissionFileInfo& info)
+{
+    if (em.frames <= 0 || em.vocab <= 0) {
+        LOG_ERROR("[Error] No emissions to save.");
+        return false;
+    }
+    int top_k = info.top_k;
+    if (top_k >= em.vocab) top_k = 0; // 保留全部 token 时直接存稠密
+    if (top_k > 0 && em.vocab > 65535) {
+        LOG_ERROR("[Error] Vocab too large for sparse emission file: " << em.vocab);
+        return false;
+    }
+
+    EmissionFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, EMISSION_MAGIC, 4);
+    header.version = EMISSION_VERSION;
+    header.encoding = (uint8_t)info.encoding;
+    header.frames = (uint32_t)em.frames;
+    header.vocab = (uint32_t)em.vocab;
+    header.top_k = (uint32_t)top_k;
+    header.frame_rate = info.frame_rate;
+    header.model_hash = info.model_hash;
+    header.vocab_hash = info.vocab_hash;
+    header.audio_samples = info.audio_samples;
+    header.data_offset = sizeof(EmissionFileHeader);
+    header.data_bytes = (uint64_t)em.frames * frameBytes(info.encoding, em.vocab, top_k);
+
+    // UTF-8 路径 (Windows 下 u8path 负责转成宽字符)
+    std::ofstream out(std::filesystem::u8path(path), std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        LOG_ERROR("[Error] Cannot create emission file: " << path);
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const size_t vb = valueBytes(info.encoding);
+    std::vector<unsigned char> frame(frameBytes(info.encoding, em.vocab, top_k));
+    std::vector<int> order(em.vocab);
+
+    for (int t = 0; t < em.frames; ++t) {
+        const float* row = em.row(t);
+        if (top_k == 0) {
+            for (int v = 0; v < em.vocab; ++v) {
+                encodeValue(row[v], info.encoding, &frame[(size_t)v * vb]);
+            }
+        }
+        else {
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + top_k, order.end(),
+                              [row](int a, int b) { return row[a] > row[b]; });
+
+            // 其余 token 平分剩下的概率质量
+            double kept = 0.0;
+            unsigned char* ids = frame.data();
+            unsigned char* vals = frame.data() + (size_t)top_k * sizeof(uint16_t);
+            for (int i = 0; i < top_k; ++i) {
+                uint16_t id = (uint16_t)order[i];
+                std::memcpy(ids + i * sizeof(uint16_t), &id, sizeof(uint16_t));
+                encodeValue(row[id], info.encoding, vals + (size_t)i * vb);
+                kept += std::exp((double)row[id]);
+            }
+            double rest = std::max(1.0 - kept, 1e-12) / (em.vocab - top_k);
+            encodeValue((float)std::log(rest), info.encoding, vals + (size_t)top_k * vb);
+        }
+        out.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+    }
+
+    if (!out.good()) {
+        LOG_ERROR("[Error] Failed to write emission file: " << path);
+        return false;
+    }
+    return true;
+}
+
+// ==========================================
+// 读
+// ==========================================
+
+bool EmissionFile::open(const std::string& path)
+{
+    close();
+    if (!file_.open(path)) {
+        LOG_ERROR("[Error] Cannot open emission file: " << path);
+        return false;
+    }
+
+    EmissionFileHeader header;
+    if (file_.size() < sizeof(header)) {
+        LOG_ERROR("[Error] Emission file too small: " << path);
+        close();
+        return false;
+    }
+    std::memcpy(&header, file_.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, EMISSION_MAGIC, 4) != 0 || header.version != EMISSION_VERSION) {
+        LOG_ERROR("[Error] Not an emission file (or unsupported version): " << path);
+        close();
+        return false;
+    }
+    if (header.encoding > (uint8_t)EmissionEncoding::Int8 || header.frames == 0 || header.frames > (uint32_t)INT32_MAX || header.vocab == 0 ||
+        header.vocab > 65535 || header.top_k >= header.vocab) {
+        LOG_ERROR("[Error] Corrupt emission file header: " << path);
+        close();
+        return false;
+    }
+
+    info_.model_hash = header.model_hash;
+    info_.vocab_hash = header.vocab_hash;
+    info_.frames = (int)header.frames;
+    info_.vocab = (int)header.vocab;
+    info_.frame_rate = header.frame_rate;
+    info_.encoding = (EmissionEncoding)header.encoding;
+    info_.top_k = (int)header.top_k;
+    info_.audio_samples = header.audio_samples;
+
+    // 帧数小于 2^31、每帧不超过 2^19 字节，乘积不会溢出；data_offset 来自文件，先和文件大小比再相减
+    uint64_t expected = (uint64_t)info_.frames * frameBytes(info_.encoding, info_.vocab, info_.top_k);
+    if (header.data_bytes != expected || header.data_offset < sizeof(header) || header.data_offset > file_.size() ||
+        expected > file_.size() - header.data_offset) {
+        LOG_ERROR("[Error] Truncated emission file: " << path);
+        close();
+        return false;
+    }
+
+    const unsigned char* data = file_.data() + header.data_offset;
+    if (info_.encoding == EmissionEncoding::Float32 && info_.top_k == 0 && header.data_offset % sizeof(float) == 0) {
+        dense_ = reinterpret_cast<const float*>(data);
+        return true;
+    }
+    return decode(data);
+}
+
+bool EmissionFile::decode(const unsigned char* data)
+{
+    const size_t vb = valueBytes(info_.encoding);
+    const size_t fb = frameBytes(info_.encoding, info_.vocab, info_.top_k);
+    decoded_.resize((size_t)info_.frames * info_.vocab);
+
+    for (int t = 0; t < info_.frames; ++t) {
+        const unsigned char* frame = data + (size_t)t * fb;
+        float* row = decoded_.data() + (size_t)t * info_.vocab;
+
+        if (info_.top_k == 0) {
+            for (int v = 0; v < info_.vocab; ++v) {
+                row[v] = decodeValue(frame + (size_t)v * vb, info_.encoding);
+            }
+            continue;
+        }
+
+        const unsigned char* vals = frame + (size_t)info_.top_k * sizeof(uint16_t);
+        std::fill(row, row + info_.vocab, decodeValue(vals + (size_t)info_.top_k * vb, info_.encoding));
+        for (int i = 0; i < info_.top_k; ++i) {
+            uint16_t id;
+            std::memcpy(&id, frame + i * sizeof(uint16_t), sizeof(uint16_t));
+            if (id >= info_.vocab) {
+                LOG_ERROR("[Error] Corrupt emission file: token id " << id << " out of range.");
+                close();
+                return false;
+            }
+            row[id] = decodeValue(vals + (size_t)i * vb, info_.encoding);
+        }
+    }
+
+    // 解码完映射就没用了
+    file_.close();
+    dense_ = decoded_.data();
+    return true;
+}
+
+void EmissionFile::close()
+{
+    file_.close();
+    decoded_.clear();
+    decoded_.shrink_to_fit();
+    dense_ = nullptr;
+    info_ = EmissionFileInfo();
+}
+
+EmissionView EmissionFile::view() const
+{
+    EmissionView v;
+    if (!dense_) return v;
+    v.data = dense_;
+    v.frames = info_.frames;
+    v.vocab = info_.vocab;
+    return v;
+}
+
+std::shared_ptr<const EmissionMatrix> EmissionFile::toMatrix() const
+{
+    auto m = std::make_shared<EmissionMatrix>();
+    if (dense_) {
+        m->data.assign(dense_, dense_ + (size_t)info_.frames * info_.vocab);
+        m->frames = info_.frames;
+        m->vocab = info_.vocab;
+    }
+    m->audio_samples = info_.audio_samples;
+    m->model_hash = info_.model_hash;
+    return m;
+}
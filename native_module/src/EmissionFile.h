@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Emission.h"
+#include "MappedFile.h"
+
+/**
+ * 推理结果 ([T x V] 对数概率矩阵) 的离线存档格式 (.emis)
+ *
+ * 布局 (小端)：64 字节文件头 + 数据区
+ *   - 稠密：T x V 个值
+ *   - top-k 稀疏：每帧 k 个 uint16 token id，k 个值，再加 1 个值表示其余 token 平均分到的对数概率
+ * 值的编码：fp32 / fp16 / int8 (对数概率截断到 [EMISSION_INT8_FLOOR, 0]，按平方根压扩后量化)
+ * 读回误差：fp16 相对误差不超过 2^-11；int8 不超过 sqrt(64·|x|)/255 + 64/255² (x = -1 时约 0.03，x = -64 时约 0.25)，
+ * 低于 EMISSION_INT8_FLOOR 的值读回为 EMISSION_INT8_FLOOR
+ *
+ * fp32 稠密文件映射后直接当 EmissionView 用 (零拷贝)，所以默认写 fp32；fp16 / int8 / top-k 是按需选用的
+ * 压缩格式，在打开时一次性解码成堆上的 fp32 矩阵 (Viterbi 和扩展评分要逐帧随机访问整行，
+ * 在热循环里解码反而更慢)，换来 1/2 ~ 1/4 的磁盘占用
+ */
+
+enum class EmissionEncoding : uint8_t {
+    Float32 = 0,
+    Float16 = 1,
+    Int8 = 2,
+};
+
+const char* emissionEncodingName(EmissionEncoding encoding);
+bool parseEmissionEncoding(const std::string& name, EmissionEncoding& encoding);
+
+// Wav2Vec2 的帧率：16kHz 下每 320 个样本一帧
+const float EMISSION_DEFAULT_FRAME_RATE = 50.0f;
+// int8 编码的对数概率下限，更低的概率对评分没有区别
+const float EMISSION_INT8_FLOOR = -64.0f;
+
+struct EmissionFileInfo {
+    uint64_t model_hash = 0;  // ModelRunner::getModelHash()
+    uint64_t vocab_hash = 0;  // Vocab::fingerprint()
+    int frames = 0;
+    int vocab = 0;
+    float frame_rate = EMISSION_DEFAULT_FRAME_RATE;
+    EmissionEncoding encoding = EmissionEncoding::Float32;
+    int top_k = 0;            // 0 = 稠密
+    uint64_t audio_samples = 0;
+};
+
+/**
+ * 写存档。info 里的 frames / vocab 以 em 为准，其余字段原样写入
+ * top_k > 0 时每帧只保留概率最高的 top_k 个 token
+ */
+bool writeEmissionFile(const std::string& path, const EmissionView& em, const EmissionFileInfo& info);
+
+/**
+ * 只读打开存档 (内存映射)
+ */
+class EmissionFile {
+public:
+    // 打开并校验文件头和数据区大小
+    bool open(const std::string& path);
+    void close();
+
+    // 解码过的存档已经关掉了映射，以数据是否可用为准
+    bool isOpen() const { return dense_ != nullptr; }
+    const EmissionFileInfo& info() const { return info_; }
+
+    // 整个矩阵的视图，在 close() 之前有效
+    EmissionView view() const;
+
+    // 复制成可以放进 EmissionCache 的矩阵
+    std::shared_ptr<const EmissionMatrix> toMatrix() const;
+
+private:
+    bool decode(const unsigned char* data);
+
+    MappedFile file_;
+    EmissionFileInfo info_;
+    const float* dense_ = nullptr; // fp32 稠密时直接指向映射区
+    std::vector<float> decoded_;   // 其余编码解码后的数据
+};
@@ -0,0 +1,138 @@
+#include "Fluency.h"
+#include "AudioFrontEnd.h"
+#include "Waveform.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const float FRAME_MS = 1000.0f * MODEL_FRAME_STRIDE / TARGET_SAMPLE_RATE;
+
+// 典型时长 (毫秒)：大致取朗读语料里各类音素的平均时长
+static const PhoneDuration DURATION_VOWEL = { 90.0f, 35.0f };
+static const PhoneDuration DURATION_LONG_VOWEL = { 140.0f, 50.0f }; // 长元音 (ː) 和双元音
+static const PhoneDuration DURATION_FRICATIVE = { 95.0f, 30.0f };   // 擦音和塞擦音
+static const PhoneDuration DURATION_CONSONANT = { 65.0f, 25.0f };
+
+// 逐个取 UTF-8 码位 (IPA 只用到 BMP)，非法字节按单字节跳过
+static char32_t nextCodePoint(std::string_view s, size_t& i)
+{
+    unsigned char c = (unsigned char)s[i];
+    int len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : 1;
+    if (i + len > s.size()) len = 1;
+    char32_t cp = len == 1 ? c : len == 2 ? (c & 0x1F) : (c & 0x0F);
+    for (int k = 1; k < len; ++k) cp = (cp << 6) | ((unsigned char)s[i + k] & 0x3F);
+    i += len;
+    return cp;
+}
+
+static bool contains(std::u32string_view set, char32_t c)
+{
+    return set.find(c) != std::u32string_view::npos;
+}
+
+PhoneDuration expectedPhoneDuration(std::string_view ipa)
+{
+    // 用转义写码位，源文件不依赖编译器的源字符集设置
+    // 元音: aeiouyæɑɒɐəɘɚɛɜɝɞɤɨɪʉʊʌʏøœɶɯɵɔ；擦音: fvθðszʃʒçʝxɣχʁħʕhɦɸβ；U+02D0 为长音符 ː
+    static const std::u32string_view VOWELS = U"aeiouy\u00E6\u0251\u0252\u0250\u0259\u0258\u025A\u025B\u025C\u025D\u025E\u0264\u0268\u026A\u0289\u028A\u028C\u028F\u00F8\u0153\u0276\u026F\u0275\u0254";
+    static const std::u32string_view FRICATIVES = U"fv\u03B8\u00F0sz\u0283\u0292\u00E7\u029Dx\u0263\u03C7\u0281\u0127\u0295h\u0266\u0278\u03B2";
+
+    int vowels = 0;
+    bool fricative = false, length_mark = false;
+    for (size_t i = 0; i < ipa.size();) {
+        char32_t c = nextCodePoint(ipa, i);
+        if (contains(VOWELS, c)) vowels++;
+        else if (contains(FRICATIVES, c)) fricative = true;
+        else if (c == U'\u02D0') length_mark = true;
+    }
+
+    if (vowels >= 2 || (vowels == 1 && length_mark)) return DURATION_LONG_VOWEL;
+    if (vowels == 1) return DURATION_VOWEL;
+    if (fricative) return DURATION_FRICATIVE;
+    return DURATION_CONSONANT;
+}
+
+void computeFluency(const std::vector<WordAnalysis>& words, int frames, const std::vector<float>* energy_db,
+                    const FluencyOptions& options, FluencyMetrics& out)
+{
+    out = FluencyMetrics();
+    out.words.resize(words.size());
+
+    // 1. 对上帧的音素段，按时间排列 (对齐路径单调，词序就是时间序)
+    struct Span {
+        int start; // 包含
+        int end;   // 不包含
+        int word;
+    };
+    std::vector<Span> spans;
+    std::vector<PhoneDuration> expected(words.size());
+    for (size_t w = 0; w < words.size(); ++w) {
+        if (words[w].skipped) continue;
+        for (const auto& d : words[w].details) {
+            if (d.start_frame < 0) continue;
+            spans.push_back({ d.start_frame, std::min(d.end_frame + 1, frames), (int)w });
+            PhoneDuration p = expectedPhoneDuration(d.ipa);
+            expected[w].mean_ms += p.mean_ms;
+            expected[w].sd_ms += p.sd_ms * p.sd_ms; // 先累计方差
+        }
+    }
+    if (spans.empty()) return;
+    out.phones = (int)spans.size();
+
+    // 2. 相邻音素之间的 blank 段够长就是停顿 (开头和结尾的静音不算)
+    std::vector<int> inner_pause(words.size(), 0); // 词中间的停顿帧数
+    int pause_frames = 0;
+    for (size_t i = 1; i < spans.size(); ++i) {
+        int gap = spans[i].start - spans[i - 1].end;
+        if (gap < options.min_pause_frames) continue;
+        out.pauses.push_back({ spans[i - 1].end, spans[i].start, spans[i - 1].word });
+        pause_frames += gap;
+        if (spans[i].word == spans[i - 1].word) inner_pause[spans[i].word] += gap;
+    }
+
+    // 3. 单词时长：从第一个音素开始，到下一个读出的词开始 (词间有停顿时到本词最后一个音素结束)
+    double observed_ms = 0.0, typical_ms = 0.0;
+    for (size_t i = 0; i < spans.size();) {
+        int w = spans[i].word;
+        size_t j = i;
+        while (j < spans.size() && spans[j].word == w) ++j;
+
+        WordFluency& wf = out.words[w];
+        wf.measured = true;
+        wf.start_frame = spans[i].start;
+        wf.end_frame = spans[j - 1].end;
+        if (j < spans.size() && spans[j].start - wf.end_frame < options.min_pause_frames) {
+            wf.end_frame = spans[j].start;
+        }
+        wf.duration_ms = (wf.end_frame - wf.start_frame - inner_pause[w]) * FRAME_MS;
+        observed_ms += wf.duration_ms;
+        typical_ms += expected[w].mean_ms;
+        i = j;
+    }
+
+    // 4. 整句语速，以及按语速缩放后的单词时长 z 分数 (只看相对整句拖长或吞掉的词)
+    out.tempo = typical_ms > 0.0 ? (float)(observed_ms / typical_ms) : 1.0f;
+    const size_t energy_frames = energy_db ? energy_db->size() : 0;
+    for (size_t w = 0; w < words.size(); ++w) {
+        WordFluency& wf = out.words[w];
+        if (!wf.measured) continue;
+        wf.expected_ms = out.tempo * expected[w].mean_ms;
+        float sd = out.tempo * std::sqrt(expected[w].sd_ms);
+        wf.z = sd > 0.0f ? (wf.duration_ms - wf.expected_ms) / sd : 0.0f;
+
+        wf.energy_db = ENERGY_FLOOR_DB;
+        size_t begin = (size_t)wf.start_frame, end = std::min((size_t)wf.end_frame, energy_frames);
+        if (begin < end) {
+            double sum = 0.0;
+            for (size_t t = begin; t < end; ++t) sum += (*energy_db)[t];
+            wf.energy_db = (float)(sum / (end - begin));
+        }
+    }
+
+    // 5. 语速和发音速率
+    out.speech_ms = (spans.back().end - spans.front().start) * FRAME_MS;
+    out.pause_ms = pause_frames * FRAME_MS;
+    out.articulation_ms = out.speech_ms - out.pause_ms;
+    if (out.speech_ms > 0.0f) out.speech_rate = out.phones * 1000.0f / out.speech_ms;
+    if (out.articulation_ms > 0.0f) out.articulation_rate = out.phones * 1000.0f / out.articulation_ms;
+}
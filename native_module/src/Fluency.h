@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include "Phonemizer.h"
+
+// 流利度指标的选项
+struct FluencyOptions {
+    int min_pause_frames = 13; // 至少这么多连续 blank 帧才算停顿 (20ms/帧，约 0.25 秒)，更短的是音素间正常的 blank
+};
+
+// 一次停顿：对齐路径上两个音素之间连续 blank 帧
+struct FluencyPause {
+    int start_frame = 0; // 包含
+    int end_frame = 0;   // 不包含
+    int after_word = -1; // 停顿前最后一个读出的词 (words 下标)，停顿在词中间时就是这个词
+};
+
+// 单词的时长和能量
+struct WordFluency {
+    bool measured = false;   // 漏读或没有对齐位置的词为 false，其余字段无意义
+    int start_frame = 0;     // 第一个音素的起始帧 (包含)
+    int end_frame = 0;       // 不包含：下一个词的起始帧 (中间有停顿时为本词最后一个音素之后)
+    float duration_ms = 0.0f;  // 不含词内停顿
+    float expected_ms = 0.0f;  // 各音素典型时长之和，按整句语速 (tempo) 缩放
+    float z = 0.0f;            // (duration - expected) / 缩放后的标准差，> 0 偏长 (拖音)，< 0 偏短 (吞音)
+    float energy_db = 0.0f;    // 词内各帧 RMS 能量的平均 (dBFS)，没有能量轮廓时为 ENERGY_FLOOR_DB
+};
+
+struct FluencyMetrics {
+    int phones = 0;                 // 对上帧的音素数
+    float speech_ms = 0.0f;         // 第一个音素开始到最后一个音素结束 (含停顿)
+    float articulation_ms = 0.0f;   // speech_ms 扣掉停顿
+    float speech_rate = 0.0f;       // 音素 / 秒 (含停顿)
+    float articulation_rate = 0.0f; // 音素 / 秒 (不含停顿)
+    float tempo = 1.0f;             // 实际时长 / 典型时长，> 1 说得比典型语速慢
+    float pause_ms = 0.0f;          // 停顿总时长
+    std::vector<FluencyPause> pauses;
+    std::vector<WordFluency> words; // 与 words 一一对应
+};
+
+// 音素的典型时长 (毫秒)
+struct PhoneDuration {
+    float mean_ms = 0.0f;
+    float sd_ms = 0.0f;
+};
+
+// 按音素类别 (元音、长元音/双元音、擦音/塞擦音、其他辅音) 给出的典型时长
+PhoneDuration expectedPhoneDuration(std::string_view ipa);
+
+/**
+ * 从对齐结果里算流利度指标 (不再扫音频或对数概率矩阵，开销与音素数和帧数成线性关系)。
+ * 音素在 Viterbi 路径上占的帧以外都是 blank 状态，音素之间的 blank 段够长就是停顿
+ * @param words: calculateGOP 处理过的单词列表
+ * @param frames: 模型输出帧数
+ * @param energy_db: 可选，前端算出的逐帧能量 (AudioSummary::energy_db)
+ */
+void computeFluency(const std::vector<WordAnalysis>& words, int frames, const std::vector<float>* energy_db,
+                    const FluencyOptions& options, FluencyMetrics& out);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/**
+ * 内容哈希 (64 位 FNV-1a 变体，按 8 字节分组混入)。
+ * 只用来做缓存键和文件指纹，不是密码学哈希。seed 用来区分同样字节的不同解释方式
+ */
+inline uint64_t hashContent(const void* data, size_t bytes, uint64_t seed = 0)
+{
+    const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    uint64_t h = FNV_OFFSET ^ seed;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+
+    // 按 8 字节一组混入，比逐字节快得多 (几 MB 的 WAV 也只要零点几毫秒)
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        h ^= word;
+        h *= FNV_PRIME;
+        h ^= h >> 32;
+    }
+    for (; i < bytes; ++i) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    // 长度也算进去，避免前缀相同的两段数据只差末尾补零时撞车
+    h ^= (uint64_t)bytes;
+    h *= FNV_PRIME;
+    return h;
+}
+
+// 64 位哈希的 16 位小写十六进制表示 (音频句柄、模型指纹都用这个格式)
+inline std::string formatHashHex(uint64_t h)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+    return buf;
+}
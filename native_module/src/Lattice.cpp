@@ -0,0 +1,439 @@
+#include "Lattice.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const float NEG_INF = -1e9f;
+
+namespace {
+
+// 按状态顺序逐个添加，前驱边先按添加顺序放到一个列表里，最后按目标状态稳定排序成 CSR
+struct LatticeBuilder {
+    CtcLattice& lattice;
+    std::vector<std::pair<int, LatticeArc>> pending; // (目标状态, 边)
+
+    int addState(int token_id, int word, int variant, int phoneme)
+    {
+        lattice.states.push_back({ token_id, word, variant, phoneme });
+        return (int)lattice.states.size() - 1;
+    }
+
+    void addArc(int to, int from, float penalty = 0.0f) { pending.push_back({ to, { from, penalty } }); }
+
+    void finish()
+    {
+        const size_t S = lattice.states.size();
+        lattice.arc_begin.assign(S + 1, 0);
+        for (const auto& p : pending) lattice.arc_begin[p.first + 1]++;
+        for (size_t s = 0; s < S; ++s) lattice.arc_begin[s + 1] += lattice.arc_begin[s];
+        lattice.arcs.resize(pending.size());
+        std::vector<int> next(lattice.arc_begin.begin(), lattice.arc_begin.end() - 1);
+        for (const auto& p : pending) lattice.arcs[next[p.first]++] = p.second;
+
+        // 判断是否是线性 CTC 链：每个状态的前驱恰好是 s-1 或 s-1、s-2，且都不扣分
+        lattice.tokens.resize(S);
+        lattice.skip_prev.assign(S, 0);
+        lattice.linear = S > 0 && lattice.arc_begin[1] == 0;
+        for (size_t s = 0; s < S; ++s) {
+            lattice.tokens[s] = lattice.states[s].token_id;
+            if (s == 0 || !lattice.linear) continue;
+            const int begin = lattice.arc_begin[s];
+            const int n = lattice.arc_begin[s + 1] - begin;
+            const LatticeArc* a = lattice.arcs.data() + begin;
+            bool ok = n >= 1 && n <= 2 && a[0].from == (int)s - 1 && a[0].penalty == 0.0f;
+            if (ok && n == 2) ok = a[1].from == (int)s - 2 && a[1].penalty == 0.0f;
+            lattice.linear = ok;
+            lattice.skip_prev[s] = n == 2;
+        }
+    }
+};
+
+} // namespace
+
+CtcLattice buildLattice(const WordAnalysis* words, size_t count, const Vocab& vocab, int blank_idx,
+                        const LatticeOptions& options)
+{
+    CtcLattice lattice;
+    LatticeBuilder b{ lattice, {} };
+    lattice.word_variants.resize(count);
+
+    // 按音素总数预留 (每个音素最多两个状态、三条边)，建格时不再反复扩容
+    size_t phonemes = 0;
+    for (size_t w = 0; w < count; ++w) {
+        phonemes += words[w].phonemes.size();
+        for (const auto& v : words[w].variants) phonemes += v.size();
+    }
+    lattice.states.reserve(2 * phonemes + count + 1);
+    b.pending.reserve(3 * phonemes + 2 * count);
+
+    // 上一个 (非空) 单词之后的词间 blank 和它各发音的最后一个音素
+    int junction = b.addState(blank_idx, -1, -1, -1);
+    std::vector<int> prev_exits;
+    lattice.initial.push_back(junction);
+
+    // 跳过当前单词时可以从这些状态出发 (即当前单词的前驱)
+    std::vector<int> skip_sources;
+    bool has_skip_sources = false;
+    bool first_word = true;
+
+    for (size_t w = 0; w < count; ++w) {
+        const WordAnalysis& word = words[w];
+
+        // 1. 收集有效发音 (把词表里没有的音素去掉，去掉后为空或重复的发音丢弃)
+        std::vector<std::vector<int>> variant_tokens;
+        for (size_t k = 0; k <= word.variants.size(); ++k) {
+            const std::vector<std::string>& src = k == 0 ? word.phonemes : word.variants[k - 1];
+            LatticeVariant v;
+            v.variant = (int)k;
+            v.ipa.reserve(src.size());
+            std::vector<int> tokens;
+            tokens.reserve(src.size());
+            for (const std::string& p : src) {
+                int tid = vocab.find(p);
+                if (tid != -1) {
+                    tokens.push_back(tid);
+                    v.ipa.push_back(&p);
+                }
+                else {
+                    // 如果模型词表里没有这个音素 (容错处理)
+                    // 比如 espeak 输出了一些罕见符号，这里选择跳过
+                    LOG_WARNING("[Warning] Skipping unknown phoneme: " << p << " in word: " << word.word);
+                }
+            }
+            if (tokens.empty()) continue;
+
+            bool duplicate = false;
+            for (const auto& t : variant_tokens) {
+                if (t == tokens) duplicate = true;
+            }
+            if (duplicate) continue;
+
+            variant_tokens.push_back(std::move(tokens));
+            lattice.word_variants[w].push_back(std::move(v));
+        }
+        if (variant_tokens.empty()) continue;
+
+        // 2. 当前单词的每个发音各是一条 CTC 链
+        const float skip_pen = -options.skip_penalty;
+        std::vector<int> exits;
+        for (size_t k = 0; k < variant_tokens.size(); ++k) {
+            const std::vector<int>& tokens = variant_tokens[k];
+            LatticeVariant& v = lattice.word_variants[w][k];
+            const float entry_pen = v.variant > 0 ? -options.variant_penalty : 0.0f;
+            v.label_states.reserve(tokens.size());
+
+            int prev_label = -1;
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                int tok = tokens[i];
+                if (i == 0) {
+                    int label = b.addState(tok, (int)w, v.variant, 0);
+                    // 从词间 blank 进入，或者 (音素不同时) 从上一个词的结尾直接进入
+                    b.addArc(label, junction, entry_pen);
+                    for (int e : prev_exits) {
+                        if (lattice.states[e].token_id != tok) b.addArc(label, e, entry_pen);
+                    }
+                    // 跳过上一个词
+                    if (has_skip_sources) {
+                        for (int s : skip_sources) {
+                            if (lattice.states[s].token_id != tok) b.addArc(label, s, entry_pen + skip_pen);
+                        }
+                    }
+                    if (first_word) lattice.initial.push_back(label);
+                    prev_label = label;
+                }
+                else {
+                    int blank = b.addState(blank_idx, (int)w, v.variant, -1);
+                    b.addArc(blank, prev_label);
+                    int label = b.addState(tok, (int)w, v.variant, (int)i);
+                    b.addArc(label, blank);
+                    // 相邻音素不同时可以不经过 blank
+                    if (tokens[i - 1] != tok) b.addArc(label, prev_label);
+                    prev_label = label;
+                }
+                v.label_states.push_back(prev_label);
+                lattice.label_count++;
+            }
+            exits.push_back(prev_label);
+        }
+
+        // 3. 单词之后的词间 blank
+        int next_junction = b.addState(blank_idx, -1, -1, -1);
+        for (int e : exits) b.addArc(next_junction, e);
+        // 跳过当前单词：从它的前驱直接到词后 blank (每跳过一个词只扣一次分)
+        if (options.allow_skip) {
+            b.addArc(next_junction, junction, skip_pen);
+            for (int e : prev_exits) b.addArc(next_junction, e, skip_pen);
+        }
+
+        // 跳过下一个词时的出发点：当前单词的前驱
+        has_skip_sources = options.allow_skip;
+        skip_sources.clear();
+        if (options.allow_skip) {
+            skip_sources.push_back(junction);
+            skip_sources.insert(skip_sources.end(), prev_exits.begin(), prev_exits.end());
+        }
+
+        junction = next_junction;
+        prev_exits = exits;
+        first_word = false;
+    }
+
+    // 结尾：最后一个音素或最后的 blank (与线性对齐一样，得分相同时优先音素)
+    lattice.final = prev_exits;
+    lattice.final.push_back(junction);
+
+    b.finish();
+    return lattice;
+}
+
+uint64_t estimateLatticeStates(const WordAnalysis* words, size_t count, const Vocab& vocab)
+{
+    uint64_t states = 1; // 开头的词间 blank
+    for (size_t w = 0; w < count; ++w) {
+        uint64_t word_states = 0;
+        auto addVariant = [&](const std::vector<std::string>& phonemes) {
+            uint64_t n = 0;
+            for (const auto& p : phonemes) {
+                if (vocab.contains(p)) n++;
+            }
+            if (n > 0) word_states += 2 * n - 1;
+        };
+        addVariant(words[w].phonemes);
+        for (const auto& v : words[w].variants) addVariant(v);
+        if (word_states > 0) states += word_states + 1;
+    }
+    return states;
+}
+
+uint64_t viterbiBytes(uint64_t frames, uint64_t states, bool low_memory)
+{
+    const uint64_t rows = 2 * states * sizeof(float);
+    if (!low_memory) {
+        return frames * states * sizeof(int) + rows;
+    }
+    uint64_t block = viterbiBlockFrames(frames);
+    uint64_t blocks = (frames + block - 1) / block;
+    return blocks * states * sizeof(float) + block * states * sizeof(int) + rows;
+}
+
+uint64_t viterbiBlockFrames(uint64_t frames)
+{
+    uint64_t block = (uint64_t)std::ceil(std::sqrt((double)frames));
+    return block > 0 ? block : 1;
+}
+
+// t = 0 帧的得分
+static void viterbiInit(const EmissionView& em, const CtcLattice& lattice, float* row)
+{
+    std::fill(row, row + lattice.states.size(), NEG_INF);
+    for (int s : lattice.initial) {
+        row[s] = em.logProb(0, lattice.states[s].token_id);
+    }
+}
+
+// 由 t-1 帧的得分 prev 算出 t 帧的得分 cur 和回溯指针 back (为空时不写)
+static void viterbiStep(const EmissionView& em, const CtcLattice& lattice, int t, const float* prev, float* cur, int* back)
+{
+    const int S = (int)lattice.states.size();
+    const int* arc_begin = lattice.arc_begin.data();
+    const LatticeArc* arcs = lattice.arcs.data();
+    for (int s = 0; s < S; ++s) {
+        float max_score = NEG_INF;
+        int best_prev = -1;
+
+        // 1. Stay (s -> s)
+        if (prev[s] > NEG_INF && prev[s] > max_score) {
+            max_score = prev[s];
+            best_prev = s;
+        }
+
+        // 2. 沿前驱边转移 (包括跳过 blank、跨词、跳词)
+        for (int a = arc_begin[s]; a < arc_begin[s + 1]; ++a) {
+            const LatticeArc& arc = arcs[a];
+            if (prev[arc.from] > NEG_INF) {
+                float score = prev[arc.from] + arc.penalty;
+                if (score > max_score) {
+                    max_score = score;
+                    best_prev = arc.from;
+                }
+            }
+        }
+
+        if (best_prev != -1) {
+            cur[s] = max_score + em.logProb(t, lattice.tokens[s]);
+        }
+        else {
+            cur[s] = NEG_INF;
+        }
+        if (back) back[s] = best_prev;
+    }
+}
+
+// 线性链上的一次松弛：p0、p1、p2 依次是 stay、s-1、s-2 的得分，cur[s] 进来时是这一帧的发射概率。
+// 先取最大值，再按 stay、s-1、s-2 的顺序取第一个等于最大值的前驱，与严格大于才替换的顺序比较选出的是同一个；
+// 下标由比较结果算出来，不走分支，循环可以向量化。back 为空时只算得分。
+// 不可达的状态 (得分 <= NEG_INF) 统一记为 NEG_INF，后面的比较只区分是否大于 NEG_INF，路径不变
+static inline void viterbiRelaxLinear(int s, float p0, float p1, float p2, float* cur, int* back)
+{
+    const float max_score = std::max(std::max(std::max(NEG_INF, p0), p1), p2);
+    if (back) {
+        const int stay = p0 == max_score;
+        const int from_prev = p1 == max_score;
+        const int reachable = max_score > NEG_INF;
+        back[s] = reachable * (s - 1 + stay + (stay | from_prev)) - 1;
+    }
+    cur[s] = std::max(max_score + cur[s], NEG_INF);
+}
+
+// 线性链的快速路径：转移固定为 s、s-1、(skip_prev[s] 时) s-2，得到的路径与 viterbiStep 完全一致。
+// 随机得分下 viterbiStep 逐个比较的分支几乎总是预测失败，线性链不用读边，可以改成无分支的写法
+static void viterbiStepLinear(const EmissionView& em, const CtcLattice& lattice, int t, const float* prev, float* cur,
+                              int* back)
+{
+    const int S = (int)lattice.tokens.size();
+    const int* tokens = lattice.tokens.data();
+    const uint8_t* skip_prev = lattice.skip_prev.data();
+    const float* row = em.row(t);
+    const unsigned V = (unsigned)em.vocab;
+
+    // 1. 先取出每个状态的发射概率 (按 token 间接读，单独一遍)
+    for (int s = 0; s < S; ++s) {
+        cur[s] = (unsigned)tokens[s] < V ? row[tokens[s]] : NEG_INF;
+    }
+
+    // 2. 没有的边用 stay 的得分代替 (平局时 stay 优先，不会被选中)
+    if (S > 0) viterbiRelaxLinear(0, prev[0], prev[0], prev[0], cur, back);
+    if (S > 1) viterbiRelaxLinear(1, prev[1], prev[0], prev[1], cur, back);
+    for (int s = 2; s < S; ++s) {
+        const float p0 = prev[s];
+        const float p2 = prev[s - 2];
+        viterbiRelaxLinear(s, p0, prev[s - 1], skip_prev[s] ? p2 : p0, cur, back);
+    }
+}
+
+static inline void viterbiForward(const EmissionView& em, const CtcLattice& lattice, int t, const float* prev,
+                                  float* cur, int* back)
+{
+    if (lattice.linear) {
+        viterbiStepLinear(em, lattice, t, prev, cur, back);
+    }
+    else {
+        viterbiStep(em, lattice, t, prev, cur, back);
+    }
+}
+
+// 在最后一帧的得分里选终点，对齐失败返回 -1
+static int viterbiFinal(const CtcLattice& lattice, const float* last)
+{
+    int current_s = -1;
+    float best = NEG_INF;
+    for (int s : lattice.final) {
+        if (current_s == -1 || last[s] > best) {
+            best = last[s];
+            current_s = s;
+        }
+    }
+
+    // 检查是否对齐失败
+    if (current_s < 0 || best <= NEG_INF) {
+        LOG_ERROR("[Error] Alignment broken. Audio might not match text.");
+        return -1;
+    }
+    return current_s;
+}
+
+static bool viterbiCancelled(const CancelToken* cancel, int t, int T)
+{
+    if (cancel && t % CANCEL_CHECK_FRAMES == 0 && cancel->isCancelled()) {
+        LOG_INFO("[Info] Alignment " << cancelReasonName(cancel->reason()) << " at frame " << t << "/" << T << ".");
+        return true;
+    }
+    return false;
+}
+
+bool viterbiLattice(const EmissionView& em, const CtcLattice& lattice, std::vector<int>& path_states,
+                    const CancelToken* cancel)
+{
+    const int T = em.frames;
+    const int S = (int)lattice.states.size();
+    if (T <= 0 || S == 0) return false;
+
+    // 得分只需要相邻两帧；回溯表: backtrack[t * S + s] = prev_state_index
+    std::vector<float> prev(S), cur(S);
+    std::vector<int> backtrack((size_t)T * S, -1);
+
+    viterbiInit(em, lattice, prev.data());
+    for (int t = 1; t < T; ++t) {
+        if (viterbiCancelled(cancel, t, T)) return false;
+        viterbiForward(em, lattice, t, prev.data(), cur.data(), backtrack.data() + (size_t)t * S);
+        prev.swap(cur);
+    }
+
+    // 寻找终点
+    int current_s = viterbiFinal(lattice, prev.data());
+    if (current_s < 0) return false;
+
+    // path_states[t] 存储的是 t 时刻对应的状态索引 s
+    path_states.assign(T, -1);
+    for (int t = T - 1; t >= 0; --t) {
+        path_states[t] = current_s;
+        current_s = backtrack[(size_t)t * S + current_s];
+    }
+    return true;
+}
+
+bool viterbiLatticeLowMemory(const EmissionView& em, const CtcLattice& lattice, std::vector<int>& path_states,
+                             const CancelToken* cancel)
+{
+    const int T = em.frames;
+    const int S = (int)lattice.states.size();
+    if (T <= 0 || S == 0) return false;
+
+    // 第 k 块 = 帧 [k * B, (k + 1) * B)，checkpoints 的第 k 行存第 k * B - 1 帧的得分 (k >= 1)
+    const int B = (int)viterbiBlockFrames(T);
+    const int blocks = (T + B - 1) / B;
+    std::vector<float> checkpoints((size_t)blocks * S, NEG_INF);
+    std::vector<float> prev(S), cur(S);
+
+    // 前向：只保留每块开始前一帧的得分
+    viterbiInit(em, lattice, prev.data());
+    for (int t = 1; t < T; ++t) {
+        if ((t % B) == 0) {
+            std::copy(prev.begin(), prev.end(), checkpoints.begin() + (size_t)(t / B) * S);
+        }
+        if (viterbiCancelled(cancel, t, T)) return false;
+        // 这里用不上回溯指针，只算得分
+        viterbiForward(em, lattice, t, prev.data(), cur.data(), nullptr);
+        prev.swap(cur);
+    }
+
+    int current_s = viterbiFinal(lattice, prev.data());
+    if (current_s < 0) return false;
+
+    // 回溯：从最后一块往前，每块从检查点重算一遍得到这一块的回溯指针
+    std::vector<int> block_back((size_t)B * S, -1);
+    path_states.assign(T, -1);
+    for (int k = blocks - 1; k >= 0; --k) {
+        const int begin = k * B;
+        const int end = std::min(T, begin + B);
+        int first = begin;
+        if (k == 0) {
+            viterbiInit(em, lattice, prev.data());
+            first = 1;
+        }
+        else {
+            std::copy(checkpoints.begin() + (size_t)k * S, checkpoints.begin() + (size_t)(k + 1) * S, prev.begin());
+        }
+        for (int t = first; t < end; ++t) {
+            if (viterbiCancelled(cancel, t, T)) return false;
+            viterbiForward(em, lattice, t, prev.data(), cur.data(), block_back.data() + (size_t)(t - begin) * S);
+            prev.swap(cur);
+        }
+        for (int t = end - 1; t >= begin; --t) {
+            path_states[t] = current_s;
+            if (t > 0) current_s = block_back[(size_t)(t - begin) * S + current_s];
+        }
+    }
+    return true;
+}
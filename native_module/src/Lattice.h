@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Phonemizer.h"
+#include "Vocab.h"
+#include "Emission.h"
+#include "Cancel.h"
+
+// 发音格的构建选项
+struct LatticeOptions {
+    bool allow_skip = false;     // 允许整词跳过 (漏读)
+    float skip_penalty = 10.0f;  // 每跳过一个词扣的对数分
+    float variant_penalty = 0.0f; // 选择非标准发音 (variants) 时扣的对数分，0 表示各发音平等
+};
+
+// 格中的一个 CTC 状态 (每帧发射一个 token)
+struct LatticeState {
+    int token_id = 0;  // 发射的 token (blank 或音素)
+    int word = -1;     // 所属单词 (words 下标)，词间 blank 为 -1
+    int variant = -1;  // 所属发音：0 = phonemes，k = variants[k - 1]
+    int phoneme = -1;  // 在该发音里的音素下标，音素之间的 blank 为 -1
+};
+
+// 前驱边 (上一帧的状态 -> 当前状态)，penalty 为对数域加分 (<= 0)
+struct LatticeArc {
+    int from;
+    float penalty;
+};
+
+// 单词的一个发音在格中的位置
+struct LatticeVariant {
+    int variant = 0;                       // 同 LatticeState::variant
+    std::vector<int> label_states;         // 每个音素对应的状态下标
+    std::vector<const std::string*> ipa;   // 每个音素的文本 (指向 WordAnalysis 里的字符串)
+};
+
+/**
+ * CTC 发音格：
+ *   [b] (词0 发音A | 词0 发音B | 跳过) [b] (词1 ...) [b] ...
+ * 每个发音内部是标准 CTC 链 (音素之间可选 blank，相邻不同音素可以直接相连)，
+ * 词间 blank 就是可选的停顿 / 静音。状态数和边数都与所有发音的音素总数成线性关系。
+ */
+struct CtcLattice {
+    std::vector<LatticeState> states;
+    // 前驱边 (CSR)：状态 s 的前驱是 arcs[arc_begin[s] .. arc_begin[s + 1])，
+    // 按原线性目标里的顺序 (s-1 在 s-2 之前) 排列，保证没有变体时结果与线性对齐完全一致
+    std::vector<int> arc_begin;
+    std::vector<LatticeArc> arcs;
+    std::vector<int> tokens;           // states[s].token_id 连续存放，Viterbi 热循环只读这一列
+    // 没有备选发音、不跳词时格就是线性 CTC 链：状态 s 的前驱只有 s-1 和 (skip_prev[s] 时) s-2，都不扣分。
+    // 这时 Viterbi 走固定转移的快速路径，不再逐条读边
+    bool linear = false;
+    std::vector<uint8_t> skip_prev;
+    std::vector<int> initial;  // 第 0 帧允许的状态
+    std::vector<int> final;    // 最后一帧允许的状态 (得分相同时靠前的优先)
+    // words[w] 的所有可用发音，没有任何有效音素的词为空
+    std::vector<std::vector<LatticeVariant>> word_variants;
+    int label_count = 0;       // 音素状态总数
+};
+
+/**
+ * 由分词结果构建发音格。words[w].phonemes 为标准发音，words[w].variants 为备选发音。
+ * 词表里没有的音素会被跳过 (打印警告)。状态里的单词下标相对于 words
+ */
+CtcLattice buildLattice(const WordAnalysis* words, size_t count, const Vocab& vocab, int blank_idx,
+                        const LatticeOptions& options = LatticeOptions());
+
+inline CtcLattice buildLattice(const std::vector<WordAnalysis>& words, const Vocab& vocab, int blank_idx,
+                               const LatticeOptions& options = LatticeOptions())
+{
+    return buildLattice(words.data(), words.size(), vocab, blank_idx, options);
+}
+
+/**
+ * 在发音格上做一次 Viterbi，输出每一帧所在的状态
+ * @param em: 对数概率矩阵 (可以是整段或其中一段帧)
+ * @param path_states: [输出] 长度为 em.frames
+ * @param cancel: 非空时每 CANCEL_CHECK_FRAMES 帧检查一次，取消后立即返回并释放 DP 表
+ * @return: false 表示对齐失败 (音频与文本不匹配) 或被取消
+ */
+bool viterbiLattice(const EmissionView& em, const CtcLattice& lattice, std::vector<int>& path_states,
+                    const CancelToken* cancel = nullptr);
+
+/**
+ * 同 viterbiLattice，结果完全一致，但不保存 T x S 的回溯表：
+ * 前向时每 B = ceil(sqrt(T)) 帧存一行得分作为检查点，回溯时逐块从检查点重算出这一块的回溯指针。
+ * 内存从 O(T x S) 降到 O(sqrt(T) x S)，代价是前向多算一遍 (耗时约两倍)
+ */
+bool viterbiLatticeLowMemory(const EmissionView& em, const CtcLattice& lattice, std::vector<int>& path_states,
+                             const CancelToken* cancel = nullptr);
+
+// 低内存 Viterbi 的块长 (帧)
+uint64_t viterbiBlockFrames(uint64_t frames);
+
+// Viterbi 的 DP 表和回溯表占用的字节数
+uint64_t viterbiBytes(uint64_t frames, uint64_t states, bool low_memory);
+
+/**
+ * 不建格，按音素数估算 buildLattice 的状态数 (不去掉重复的发音，所以是上界)，
+ * 用于对齐前估算内存和耗时
+ */
+uint64_t estimateLatticeStates(const WordAnalysis* words, size_t count, const Vocab& vocab);
@@ -0,0 +1,55 @@
+#include "Log.h"
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
+static std::atomic<int> g_log_level{ (int)LogLevel::Info };
+static std::mutex g_log_mutex;
+static LogSink g_log_sink;
+
+void setLogLevel(LogLevel level)
+{
+    g_log_level.store((int)level, std::memory_order_relaxed);
+}
+
+LogLevel getLogLevel()
+{
+    return (LogLevel)g_log_level.load(std::memory_order_relaxed);
+}
+
+bool logEnabled(LogLevel level)
+{
+    return (int)level >= g_log_level.load(std::memory_order_relaxed);
+}
+
+bool parseLogLevel(const std::string& name, LogLevel& out)
+{
+    if (name == "debug") out = LogLevel::Debug;
+    else if (name == "info") out = LogLevel::Info;
+    else if (name == "warning" || name == "warn") out = LogLevel::Warning;
+    else if (name == "error") out = LogLevel::Error;
+    else if (name == "off" || name == "none") out = LogLevel::Off;
+    else return false;
+    return true;
+}
+
+void setLogSink(LogSink sink)
+{
+    std::lock_guard<std::mutex> lock(g_log_mutex);
+    g_log_sink = std::move(sink);
+}
+
+void logWrite(LogLevel level, const std::string& message)
+{
+    // 多线程 (批处理 / 线程池) 同时写日志时保证一行不被打断
+    std::lock_guard<std::mutex> lock(g_log_mutex);
+    if (g_log_sink) {
+        g_log_sink(level, message);
+        return;
+    }
+
+    std::ostream& os = (level <= LogLevel::Info) ? std::cout : std::cerr;
+    os << message << '\n';
+    if (level >= LogLevel::Warning) os.flush();
+}
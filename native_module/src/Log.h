@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <functional>
+
+// 日志级别 (数值越大越严重)
+enum class LogLevel {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3,
+    Off = 4,
+};
+
+// 全局日志级别，默认 Info。热路径上只有一次原子读，被过滤掉的日志不会格式化字符串
+void setLogLevel(LogLevel level);
+LogLevel getLogLevel();
+bool logEnabled(LogLevel level);
+
+// "debug" / "info" / "warning" / "error" / "off"，无法识别时返回 false
+bool parseLogLevel(const std::string& name, LogLevel& out);
+
+// 自定义日志输出 (例如转发到 JS)。传入空函数恢复默认：Info 及以下写 stdout，其余写 stderr
+using LogSink = std::function<void(LogLevel, const std::string&)>;
+void setLogSink(LogSink sink);
+
+void logWrite(LogLevel level, const std::string& message);
+
+#define SPEECH_LOG(level, expr)                   \
+    do {                                          \
+        if (logEnabled(level)) {                  \
+            std::ostringstream speech_log_stream; \
+            speech_log_stream << expr;            \
+            logWrite(level, speech_log_stream.str()); \
+        }                                         \
+    } while (0)
+
+#define LOG_DEBUG(expr) SPEECH_LOG(LogLevel::Debug, expr)
+#define LOG_INFO(expr) SPEECH_LOG(LogLevel::Info, expr)
+#define LOG_WARNING(expr) SPEECH_LOG(LogLevel::Warning, expr)
+#define LOG_ERROR(expr) SPEECH_LOG(LogLevel::Error, expr)
@@ -0,0 +1,162 @@
+#include "MappedFile.h"
+#include "Log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    // UTF-8 路径转宽字符
+    int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.size(), NULL, 0);
+    std::wstring wpath(len, 0);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.size(), &wpath[0], len);
+
+    HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("[Error] Cannot open file: " << path);
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        LOG_ERROR("[Error] Empty or unreadable file: " << path);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        LOG_ERROR("[Error] CreateFileMapping failed: " << path);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        LOG_ERROR("[Error] MapViewOfFile failed: " << path);
+        return false;
+    }
+
+    file_handle_ = file;
+    mapping_handle_ = mapping;
+    data_ = static_cast<const unsigned char*>(view);
+    size_ = (size_t)file_size.QuadPart;
+    released_ = 0;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_handle_) CloseHandle(mapping_handle_);
+    if (file_handle_) CloseHandle(file_handle_);
+    data_ = nullptr;
+    mapping_handle_ = nullptr;
+    file_handle_ = nullptr;
+    size_ = 0;
+    released_ = 0;
+}
+
+void MappedFile::adviseSequential() const
+{
+    // Windows 上已经在 CreateFileW 时通过 FILE_FLAG_SEQUENTIAL_SCAN 提示
+}
+
+void MappedFile::releaseBefore(size_t offset)
+{
+    if (!data_ || offset <= released_) return;
+
+    // 只读文件映射的页是干净页，Unlock 之后系统可以直接回收
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    size_t page = si.dwPageSize;
+    size_t end = (offset / page) * page;
+    if (end <= released_) return;
+
+    VirtualUnlock((LPVOID)(data_ + released_), end - released_);
+    released_ = end;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("[Error] Cannot open file: " << path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        LOG_ERROR("[Error] Empty or unreadable file: " << path);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立后 fd 就可以关闭了
+    ::close(fd);
+
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("[Error] mmap failed: " << path);
+        return false;
+    }
+
+    data_ = static_cast<const unsigned char*>(addr);
+    size_ = (size_t)st.st_size;
+    released_ = 0;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_) {
+        munmap((void*)data_, size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    released_ = 0;
+}
+
+void MappedFile::adviseSequential() const
+{
+    if (data_) {
+        madvise((void*)data_, size_, MADV_SEQUENTIAL);
+    }
+}
+
+void MappedFile::releaseBefore(size_t offset)
+{
+    if (!data_ || offset <= released_) return;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = (offset / page) * page;
+    if (end <= released_) return;
+
+    // 只读私有映射：丢弃后再次访问会重新从文件读入，不会丢数据
+    madvise((void*)(data_ + released_), end - released_, MADV_DONTNEED);
+    released_ = end;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/**
+ * 只读内存映射文件 (RAII)
+ * 用于大文件的零拷贝读取：数据页由操作系统按需换入，
+ * 读过的部分可以通过 release() 主动归还，不计入常驻内存。
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 打开并映射整个文件 (path 为 UTF-8)，失败返回 false
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // 提示内核按顺序预读
+    void adviseSequential() const;
+    // 归还 [0, offset) 范围内已经读完的页 (只影响常驻内存，不影响映射本身)
+    void releaseBefore(size_t offset);
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t released_ = 0; // 已归还的字节数 (页对齐)
+
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
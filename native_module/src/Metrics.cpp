@@ -0,0 +1,108 @@
+#include "Metrics.h"
+
+#include <algorithm>
+
+const char* stageName(Stage stage)
+{
+    switch (stage) {
+    case Stage::FrontEnd: return "frontend";
+    case Stage::Inference: return "inference";
+    case Stage::LogSoftmax: return "log_softmax";
+    case Stage::G2P: return "g2p";
+    case Stage::Align: return "align";
+    case Stage::Decode: return "decode";
+    case Stage::Total: return "total";
+    default: return "unknown";
+    }
+}
+
+RollingHistogram::RollingHistogram(size_t capacity) : capacity_(capacity == 0 ? 1 : capacity)
+{
+    window_.reserve(capacity_);
+}
+
+void RollingHistogram::add(double value)
+{
+    if (window_.size() < capacity_) {
+        window_.push_back(value);
+    }
+    else {
+        window_[next_] = value;
+    }
+    next_ = (next_ + 1) % capacity_;
+
+    count_++;
+    sum_ += value;
+    if (value > max_) max_ = value;
+}
+
+void RollingHistogram::reset()
+{
+    window_.clear();
+    next_ = 0;
+    count_ = 0;
+    sum_ = 0.0;
+    max_ = 0.0;
+}
+
+double RollingHistogram::percentile(double p) const
+{
+    if (window_.empty()) return 0.0;
+
+    // 只在查询时排序一份拷贝，记录路径上没有额外开销
+    std::vector<double> sorted = window_;
+    size_t k = (size_t)(p * (sorted.size() - 1) + 0.5);
+    if (k >= sorted.size()) k = sorted.size() - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+void PipelineStats::record(const StageTimings& timings, bool ok)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    totals_.requests++;
+    if (!ok) totals_.failures++;
+
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        if (timings.measured[s]) stages_[s].add(timings.ms[s]);
+    }
+
+    totals_.input_samples += timings.input_samples;
+    totals_.audio_samples += timings.audio_samples;
+    totals_.frames += timings.frames;
+    totals_.states += timings.states;
+    totals_.bytes_allocated += timings.bytes_allocated;
+    totals_.max_bytes_allocated = std::max(totals_.max_bytes_allocated, timings.bytes_allocated);
+}
+
+void PipelineStats::recordCancelled()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    totals_.cancelled++;
+}
+
+PipelineStats::Snapshot PipelineStats::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Snapshot snap = totals_;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const RollingHistogram& h = stages_[s];
+        StageSummary& out = snap.stages[s];
+        out.count = h.count();
+        out.mean = h.mean();
+        out.max = h.max();
+        out.p50 = h.percentile(0.50);
+        out.p95 = h.percentile(0.95);
+        out.p99 = h.percentile(0.99);
+    }
+    return snap;
+}
+
+void PipelineStats::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& h : stages_) h.reset();
+    totals_ = Snapshot();
+}
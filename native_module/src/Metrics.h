@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// 流水线阶段
+enum class Stage {
+    FrontEnd = 0, // 解码 + 下混 + 重采样 + 归一化
+    Inference,    // ORT session->Run
+    LogSoftmax,   // logits -> 对数概率
+    G2P,          // espeak + IPA 分词
+    Align,        // Viterbi 强制对齐 + GOP
+    Decode,       // 自由解码 + 编辑距离 (转写 / 预检)
+    Total,        // 整个 analyze 调用
+    Count
+};
+
+const int STAGE_COUNT = (int)Stage::Count;
+
+// 阶段名 (用于 JS 字段名和日志)，如 "frontend"、"inference"
+const char* stageName(Stage stage);
+
+// 单次请求的耗时和计数器
+struct StageTimings {
+    double ms[STAGE_COUNT] = {};
+    bool measured[STAGE_COUNT] = {};
+
+    uint64_t input_samples = 0;   // 输入的交错样本数 (源采样率)
+    uint64_t audio_samples = 0;   // 前端输出的样本数 (16k 单声道)
+    uint64_t frames = 0;          // 模型输出帧数 T
+    uint64_t vocab_size = 0;      // 词表大小 V
+    uint64_t states = 0;          // CTC 扩展状态数 S
+    uint64_t phonemes = 0;        // 参与对齐的音素数
+    uint64_t words = 0;
+    uint64_t segments = 0;        // 分段对齐的段数 (整段对齐为 1)
+    uint64_t bytes_allocated = 0; // 主要缓冲区 (音频、logits、DP 表) 的字节数
+
+    void add(Stage stage, double elapsed_ms) {
+        ms[(int)stage] += elapsed_ms;
+        measured[(int)stage] = true;
+    }
+};
+
+// RAII 计时器：构造时开始，析构或 stop() 时把耗时累加到 timings (为空时什么都不做)
+class ScopedStageTimer {
+public:
+    ScopedStageTimer(StageTimings* timings, Stage stage)
+        : timings_(timings), stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedStageTimer() { stop(); }
+
+    void stop() {
+        if (!timings_) return;
+        auto end = std::chrono::steady_clock::now();
+        timings_->add(stage_, std::chrono::duration<double, std::milli>(end - start_).count());
+        timings_ = nullptr;
+    }
+
+private:
+    StageTimings* timings_;
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 滚动窗口直方图：保留最近 capacity 个样本用于分位数，总数 / 均值 / 最大值按全量累计
+class RollingHistogram {
+public:
+    explicit RollingHistogram(size_t capacity = 1024);
+
+    void add(double value);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    double mean() const { return count_ ? sum_ / count_ : 0.0; }
+    double max() const { return max_; }
+    // p 取 0 ~ 1，只统计窗口内的样本
+    double percentile(double p) const;
+
+private:
+    std::vector<double> window_;
+    size_t capacity_;
+    size_t next_ = 0;
+    uint64_t count_ = 0;
+    double sum_ = 0.0;
+    double max_ = 0.0;
+};
+
+struct StageSummary {
+    uint64_t count = 0;
+    double mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+// 引擎级别的聚合统计 (线程安全)
+class PipelineStats {
+public:
+    struct Snapshot {
+        uint64_t requests = 0;
+        uint64_t failures = 0;
+        uint64_t cancelled = 0;  // 被取消或超时的请求 (不计入 requests / failures)
+        StageSummary stages[STAGE_COUNT];
+
+        uint64_t input_samples = 0;
+        uint64_t audio_samples = 0;
+        uint64_t frames = 0;
+        uint64_t states = 0;
+        uint64_t bytes_allocated = 0;     // 累计
+        uint64_t max_bytes_allocated = 0; // 单次请求峰值
+    };
+
+    void record(const StageTimings& timings, bool ok);
+    void recordCancelled();
+    Snapshot snapshot() const;
+    void reset();
+
+private:
+    mutable std::mutex mutex_;
+    RollingHistogram stages_[STAGE_COUNT];
+    Snapshot totals_;
+};
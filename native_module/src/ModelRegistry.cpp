@@ -0,0 +1,219 @@
+#include "ModelRegistry.h"
+#include "Log.h"
+
+#include <chrono>
+#include <filesystem>
+
+// 保留最近多少条加载/淘汰事件
+static const size_t MAX_EVENTS = 32;
+
+const char* modelEventName(ModelEventType type)
+{
+    switch (type) {
+    case ModelEventType::Load: return "load";
+    case ModelEventType::LoadFailed: return "load_failed";
+    case ModelEventType::Evict: return "evict";
+    default: return "unknown";
+    }
+}
+
+size_t estimateModelBytes(const ModelSource& source, bool has_background_session)
+{
+    std::error_code ec;
+    // 模型路径是 UTF-8 (Windows 下 u8path 负责转成宽字符)
+    uintmax_t size = std::filesystem::file_size(std::filesystem::u8path(source.model_path), ec);
+    if (ec) return 0;
+    return (size_t)size * (has_background_session ? 2 : 1);
+}
+
+static int64_t nowUnixMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void ModelRegistry::registerLanguage(const std::string& language, const ModelSource& source, const std::string& voice)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& e = entries_[language];
+    if (e.model) resident_ -= e.bytes;
+    e.source = source;
+    e.voice = voice.empty() ? language : voice;
+    e.model.reset();
+    e.bytes = 0;
+    e.generation++;
+    LOG_INFO("[Info] Language " << language << " registered: " << source.model_path);
+}
+
+bool ModelRegistry::has(const std::string& language) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(language) > 0;
+}
+
+std::string ModelRegistry::voiceFor(const std::string& language) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(language);
+    return it == entries_.end() ? language : it->second.voice;
+}
+
+std::shared_ptr<const ModelRunner> ModelRegistry::acquire(const std::string& language)
+{
+    std::vector<ModelEvent> fired;
+    ModelSource source;
+    uint64_t generation = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = entries_.find(language);
+        if (it == entries_.end()) return nullptr;
+
+        // 别的线程正在加载同一语言：等它的结果
+        loaded_cv_.wait(lock, [&]() { return !it->second.loading; });
+        Entry& e = it->second;
+        e.last_used = ++clock_;
+        if (e.model) {
+            e.hits++;
+            return e.model;
+        }
+        e.loading = true;
+        source = e.source;
+        generation = e.generation;
+    }
+
+    std::shared_ptr<const ModelRunner> model;
+    for (;;) {
+        // 加载在锁外进行，不挡其他语言的请求
+        auto t0 = std::chrono::steady_clock::now();
+        std::shared_ptr<ModelRunner> loaded = loadModelVersion(source);
+        double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& e = entries_[language];
+        // 加载期间被重新注册过：这次的结果作废，按新的路径再加载一次 (等待的调用方继续等)
+        if (e.generation != generation) {
+            source = e.source;
+            generation = e.generation;
+            continue;
+        }
+        e.loading = false;
+
+        ModelEvent event;
+        event.language = language;
+        event.load_ms = load_ms;
+        if (loaded) {
+            model = loaded;
+            e.model = model;
+            e.bytes = estimateModelBytes(source, loaded->hasBackgroundSession());
+            e.loads++;
+            resident_ += e.bytes;
+            loads_++;
+            event.type = ModelEventType::Load;
+            event.bytes = e.bytes;
+            recordLocked(event, fired);
+            evictLocked(language, fired);
+        }
+        else {
+            load_failures_++;
+            event.type = ModelEventType::LoadFailed;
+            recordLocked(event, fired);
+        }
+        break;
+    }
+    loaded_cv_.notify_all();
+    emit(fired);
+    return model;
+}
+
+void ModelRegistry::evictLocked(const std::string& keep, std::vector<ModelEvent>& fired)
+{
+    while (budget_ > 0 && resident_ > budget_) {
+        Entry* victim = nullptr;
+        const std::string* victim_name = nullptr;
+        for (auto& kv : entries_) {
+            Entry& e = kv.second;
+            if (!e.model || kv.first == keep) continue;
+            if (!victim || e.last_used < victim->last_used) {
+                victim = &e;
+                victim_name = &kv.first;
+            }
+        }
+        // 只剩 keep 一个：预算比单个模型还小，只能超预算运行
+        if (!victim) {
+            LOG_WARNING("[Warning] Model " << keep << " alone exceeds the memory budget (" << resident_ << " > " << budget_ << " bytes).");
+            break;
+        }
+
+        ModelEvent event;
+        event.type = ModelEventType::Evict;
+        event.language = *victim_name;
+        event.bytes = victim->bytes;
+        resident_ -= victim->bytes;
+        victim->model.reset();
+        victim->bytes = 0;
+        victim->evictions++;
+        evictions_++;
+        recordLocked(event, fired);
+    }
+}
+
+void ModelRegistry::recordLocked(const ModelEvent& event, std::vector<ModelEvent>& fired)
+{
+    ModelEvent e = event;
+    e.unix_ms = nowUnixMs();
+    events_.push_back(e);
+    if (events_.size() > MAX_EVENTS) events_.pop_front();
+    fired.push_back(e);
+}
+
+void ModelRegistry::emit(const std::vector<ModelEvent>& fired)
+{
+    for (const auto& e : fired) {
+        if (e.type == ModelEventType::Load) {
+            LOG_INFO("[Info] Model for " << e.language << " loaded in " << e.load_ms << " ms (~" << (e.bytes >> 20) << " MB resident).");
+        }
+        else if (e.type == ModelEventType::Evict) {
+            LOG_INFO("[Info] Model for " << e.language << " evicted (~" << (e.bytes >> 20) << " MB).");
+        }
+        else {
+            LOG_ERROR("[Error] Failed to load model for " << e.language << ".");
+        }
+    }
+}
+
+void ModelRegistry::setBudget(size_t budget_bytes)
+{
+    std::vector<ModelEvent> fired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = budget_bytes;
+        evictLocked(std::string(), fired);
+    }
+    emit(fired);
+}
+
+ModelRegistry::Stats ModelRegistry::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Stats s;
+    s.budget_bytes = budget_;
+    s.resident_bytes = resident_;
+    s.loads = loads_;
+    s.load_failures = load_failures_;
+    s.evictions = evictions_;
+    for (const auto& kv : entries_) {
+        const Entry& e = kv.second;
+        LanguageStats ls;
+        ls.language = kv.first;
+        ls.model_path = e.source.model_path;
+        ls.voice = e.voice;
+        ls.resident = (e.model != nullptr);
+        ls.bytes = e.bytes;
+        ls.loads = e.loads;
+        ls.evictions = e.evictions;
+        ls.hits = e.hits;
+        s.languages.push_back(ls);
+    }
+    s.events.assign(events_.begin(), events_.end());
+    return s;
+}
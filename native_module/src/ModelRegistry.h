@@ -0,0 +1,110 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ModelStore.h"
+
+enum class ModelEventType {
+    Load,       // 首次使用时加载 (或淘汰后重新加载)
+    LoadFailed,
+    Evict       // 超出内存预算被淘汰
+};
+
+const char* modelEventName(ModelEventType type);
+
+struct ModelEvent {
+    ModelEventType type = ModelEventType::Load;
+    std::string language;
+    size_t bytes = 0;       // 估算的常驻内存
+    double load_ms = 0.0;   // 只对 Load 有意义
+    int64_t unix_ms = 0;    // 发生时间
+};
+
+/**
+ * 多语言模型注册表 (线程安全)：语言 -> (ONNX 模型, vocab.json, espeak 口音)。
+ * 注册只记录路径，第一次 acquire 时才在调用线程上加载；同一语言的并发请求只加载一次。
+ * 加载后常驻内存估算值之和超过预算时，淘汰最久未用的语言 (正在加载的和刚加载的除外)。
+ * 淘汰只是注册表不再持有：正在使用它的请求照常跑完，最后一个持有者释放时才真正卸载。
+ */
+class ModelRegistry {
+public:
+    struct LanguageStats {
+        std::string language;
+        std::string model_path;
+        std::string voice;
+        bool resident = false;
+        size_t bytes = 0;       // 常驻时的估算内存
+        uint64_t loads = 0;
+        uint64_t evictions = 0;
+        uint64_t hits = 0;      // 命中已加载模型的次数
+    };
+
+    struct Stats {
+        size_t budget_bytes = 0;   // 0 = 不限制
+        size_t resident_bytes = 0;
+        uint64_t loads = 0;
+        uint64_t load_failures = 0;
+        uint64_t evictions = 0;
+        std::vector<LanguageStats> languages;
+        std::vector<ModelEvent> events; // 最近的加载/淘汰事件，旧的在前
+    };
+
+    // budget_bytes 为 0 表示不限制
+    explicit ModelRegistry(size_t budget_bytes = 0) : budget_(budget_bytes) {}
+
+    // 注册 (或覆盖) 一个语言。voice 为空时与 language 相同。已加载的旧模型会被丢弃
+    void registerLanguage(const std::string& language, const ModelSource& source, const std::string& voice = "");
+    bool has(const std::string& language) const;
+    // 注册的 espeak 口音，未注册时返回 language 本身
+    std::string voiceFor(const std::string& language) const;
+
+    // 取语言对应的模型，未加载时加载 (阻塞调用线程)。未注册或加载失败返回 nullptr。
+    // 加载期间语言被重新注册时，丢掉旧路径的结果按新路径重新加载
+    std::shared_ptr<const ModelRunner> acquire(const std::string& language);
+
+    // 修改预算并立即淘汰超出的部分
+    void setBudget(size_t budget_bytes);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        ModelSource source;
+        std::string voice;
+        std::shared_ptr<const ModelRunner> model;
+        size_t bytes = 0;
+        bool loading = false;
+        uint64_t generation = 0; // 每次注册加一，加载完成时据此判断期间有没有被重新注册
+        uint64_t last_used = 0; // 单调递增的使用序号，越小越久未用
+        uint64_t loads = 0;
+        uint64_t evictions = 0;
+        uint64_t hits = 0;
+    };
+
+    // 超预算时淘汰，keep 不参与淘汰 (调用时持锁)，被淘汰的事件追加到 fired
+    void evictLocked(const std::string& keep, std::vector<ModelEvent>& fired);
+    void recordLocked(const ModelEvent& event, std::vector<ModelEvent>& fired);
+    // 在锁外写日志
+    void emit(const std::vector<ModelEvent>& fired);
+
+    mutable std::mutex mutex_;
+    std::condition_variable loaded_cv_;
+    std::map<std::string, Entry> entries_;
+    size_t budget_;
+    size_t resident_ = 0;
+    uint64_t clock_ = 0;
+    uint64_t loads_ = 0;
+    uint64_t load_failures_ = 0;
+    uint64_t evictions_ = 0;
+    std::deque<ModelEvent> events_;
+};
+
+// 模型常驻内存的估算：ONNX 文件大小 (权重基本原样驻留)，有后台 session 时按两份算
+size_t estimateModelBytes(const ModelSource& source, bool has_background_session);
@@ -1,169 +1,269 @@
 #include "ModelRunner.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Hash.h"
 
+#include <algorithm>
 #include <cmath>
-#include <numeric>
-#include <iostream>
-#include <json.hpp>
-#include <fstream>
+#include <limits>
+#include <filesystem>
 
-using json = nlohmann::json;
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
-ModelRunner::ModelRunner() : session(nullptr)
+// UTF-8 路径转 ONNX Runtime 的路径类型 (Windows 为 wchar_t，其他平台为 char)
+static std::basic_string<ORTCHAR_T> toOrtPath(const std::string& path)
+{
+#ifdef _WIN32
+    if (path.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &path[0], (int)path.size(), NULL, 0);
+    std::wstring wpath(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &path[0], (int)path.size(), &wpath[0], size_needed);
+    return wpath;
+#else
+    return path;
+#endif
+}
+
+ModelRunner::ModelRunner() : session(nullptr), vocab(std::make_shared<Vocab>())
 {
 	audio.clear();
 	session_options = new Ort::SessionOptions;
 	session_options->SetIntraOpNumThreads(1);
-
-	env = new Ort::Env(ORT_LOGGING_LEVEL_WARNING, "SpeechEngine");
 }
 
 ModelRunner::~ModelRunner()
 {
+	// session 先于 env 释放
+	profile_session.reset();
+	background_session.reset();
+	session.reset();
+	env.reset();
 	delete session_options;
-	delete env;
+}
 
-	if (session) {
-		delete session;
-	}
+void ModelRunner::setIntraOpThreads(int threads)
+{
+    session_options->SetIntraOpNumThreads(threads > 0 ? threads : 1);
 }
 
-void ModelRunner::loadAudio(const float* input, size_t input_size, unsigned int src_rate, unsigned int channels)
+bool ModelRunner::loadBackgroundSession(int intra_threads)
 {
-	audio.assign(input, input + input_size);
+    if (!session || model_path.empty()) {
+        LOG_ERROR("[Error] Model not loaded!");
+        return false;
+    }
 
-	mixToMono(channels, input_size);
-	resampleAudio(src_rate);
-	normalizeAudio();
+    try {
+        Ort::SessionOptions options = session_options->Clone();
+        options.SetIntraOpNumThreads(intra_threads > 0 ? intra_threads : 1);
+        background_session = std::make_shared<Ort::Session>(*env, toOrtPath(model_path).c_str(), options);
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("[Error] Failed to create background session: " << e.what());
+        background_session.reset();
+        return false;
+    }
+    LOG_INFO("[Info] Background session created with " << intra_threads << " intra-op threads.");
+    return true;
+}
 
-	std::cout << "[Info] Audio Loaded. Final Input Size: " << audio.size() << " samples." << std::endl;
+void ModelRunner::shareModelFrom(const ModelRunner& other)
+{
+    env = other.env;
+    session = other.session;
+    background_session = other.background_session;
+    model_path = other.model_path;
+    model_hash = other.model_hash;
+    model_version = other.model_version;
+    vocab = other.vocab;
 }
 
-bool ModelRunner::loadModel(const std::wstring& model_path)
+void ModelRunner::releaseModel()
 {
-	if (session) {
-		std::cout << "[Info] Unloading Previous Model." << std::endl;
-		delete session;
-		session = nullptr;
-	}
+    // session 先于 env 释放
+    profile_session.reset();
+    profile_remaining = 0;
+    session.reset();
+    background_session.reset();
+    env.reset();
+    model_path.clear();
+    model_hash = 0;
+    model_version = 0;
+}
 
-    try {
-        session = new Ort::Session(*env, model_path.c_str(), *session_options);
-        std::cout << "[Info] Model Loaded from: " << std::string(model_path.begin(), model_path.end()) << std::endl;
+void ModelRunner::loadAudio(const float* input, size_t input_size, unsigned int src_rate, unsigned int channels)
+{
+	audio.assign(input, input + input_size);
+	input_samples = input_size;
 
-        return true;
-    } catch (const Ort::Exception& e) {
-        std::cerr << "[Error] Failed to load model: " << e.what() << std::endl;
-        return false;
-	}
+	// input_size 是交错样本总数，下混需要的是帧数
+	if (channels == 0) channels = 1;
+	mixToMono(audio, channels, input_size / channels);
+	resampleAudio(audio, src_rate);
+	buildSummary();
+	normalizeAudio(audio);
+
+	LOG_INFO("[Info] Audio Loaded. Final Input Size: " << audio.size() << " samples.");
 }
 
-void ModelRunner::mixToMono(unsigned int channels, size_t total_frames)
+void ModelRunner::buildSummary()
 {
-	if (channels == 1) {
-		// Already mono
-		return;
-	}
-
-	for (size_t i = 0; i < total_frames; ++i) {
-		float sum = 0.0f;
-		for (unsigned int c = 0; c < channels; ++c) {
-			sum += audio[i * channels + c];
-		}
-		audio[i] = sum / channels;
-	}
-
-	audio.erase(audio.begin() + total_frames, audio.end());
+    auto s = std::make_shared<AudioSummary>();
+    buildAudioSummary(audio.data(), audio.size(), *s);
+    summary = std::move(s);
 }
 
-void ModelRunner::resampleAudio(unsigned int src_rate)
+void ModelRunner::beginAudioStream(unsigned int src_rate, unsigned int channels, size_t total_frames_hint)
 {
-	if (src_rate == TARGET_SAMPLE_RATE) {
-		// No resampling needed
-		return;
-	}
-
-	// 计算目标长度
-	double ratio = (double)src_rate / TARGET_SAMPLE_RATE;
-	size_t output_size = (size_t)(audio.size() / ratio);
-
-	std::vector<float> resampled(output_size);
-	for (size_t i = 0; i < output_size; ++i) {
-		double src_index = i * ratio;
-		size_t idx = (size_t)std::floor(src_index);
-		float frac = (float)(src_index - idx);
-		if (idx + 1 < audio.size()) {
-			// Linear interpolation
-			resampled[i] = audio[idx] * (1.0f - frac) + audio[idx + 1] * frac;
-		}
-		else {
-			resampled[i] = audio[idx];
-		}
-	}
-
-	audio = std::move(resampled);
+    audio.clear();
+    input_samples = 0;
+
+    stream_rate = src_rate;
+    stream_channels = channels == 0 ? 1 : channels;
+    stream_ratio = (double)src_rate / TARGET_SAMPLE_RATE;
+    stream_consumed = 0;
+    stream_next_out = 0;
+    stream_hist.clear();
+    stream_hist_base = 0;
+
+    // 预先按最终长度预留，避免 push_back 过程中反复扩容拷贝
+    if (total_frames_hint > 0) {
+        audio.reserve((size_t)(total_frames_hint / stream_ratio) + 1);
+    }
 }
 
-void ModelRunner::normalizeAudio()
+void ModelRunner::appendAudioFrames(const float* interleaved, size_t frames)
 {
-	if (audio.empty()) return;
-
-	// 1. 计算均值
-	double sum = std::accumulate(audio.begin(), audio.end(), 0.0);
-	double mean = sum / audio.size();
-
-	// 2. 计算方差
-	double sq_sum = 0.0;
-	for (float val : audio) {
-		sq_sum += (val - mean) * (val - mean);
-	}
-	double std_dev = std::sqrt(sq_sum / audio.size());
-
-	// 防止除以 0
-	if (std_dev < 1e-5) std_dev = 1e-5;
-
-	// 3. 应用归一化
-	for (float& val : audio) {
-		val = (float)((val - mean) / std_dev);
-	}
+    if (frames == 0) return;
+
+    // 不需要重采样时直接下混到输出
+    std::vector<float>& dst = (stream_rate == TARGET_SAMPLE_RATE) ? audio : stream_hist;
+
+    // 1. 下混 (与 mixToMono 相同的累加顺序，保证结果逐位一致)
+    if (stream_channels == 1) {
+        dst.insert(dst.end(), interleaved, interleaved + frames);
+    }
+    else {
+        for (size_t i = 0; i < frames; ++i) {
+            float sum = 0.0f;
+            for (unsigned int c = 0; c < stream_channels; ++c) {
+                sum += interleaved[i * stream_channels + c];
+            }
+            dst.push_back(sum / stream_channels);
+        }
+    }
+    stream_consumed += frames;
+    input_samples += frames * stream_channels;
+
+    if (stream_rate == TARGET_SAMPLE_RATE) return;
+
+    // 2. 重采样
+    // stream_hist 保存源样本 [stream_hist_base, stream_consumed)。
+    // 总长度 N 未知，只输出一定存在于最终结果里的样本: i < floor(已到达长度 / ratio) <= floor(N / ratio)
+    size_t end = stream_consumed;
+    size_t cap = (size_t)(end / stream_ratio);
+
+    while (stream_next_out < cap) {
+        double src_index = stream_next_out * stream_ratio;
+        size_t idx = (size_t)std::floor(src_index);
+        // 线性插值需要 idx 和 idx + 1 都已到达，否则等下一块
+        if (idx + 1 >= end) break;
+
+        float frac = (float)(src_index - idx);
+        size_t k = idx - stream_hist_base;
+        audio.push_back(stream_hist[k] * (1.0f - frac) + stream_hist[k + 1] * frac);
+        stream_next_out++;
+    }
+
+    // 丢掉后续输出不会再用到的历史样本，只保留从下一个插值起点开始的部分
+    size_t keep_from = (size_t)std::floor(stream_next_out * stream_ratio);
+    if (keep_from > end - 1) keep_from = end - 1;
+    if (keep_from > stream_hist_base) {
+        stream_hist.erase(stream_hist.begin(), stream_hist.begin() + (keep_from - stream_hist_base));
+        stream_hist_base = keep_from;
+    }
 }
 
-bool ModelRunner::loadVocab(const std::string& json_path)
+void ModelRunner::endAudioStream()
 {
-    std::ifstream f(json_path);
-    if (!f.is_open()) {
-        std::cerr << "[Error] Cannot open vocab file: " << json_path << std::endl;
-        return false;
+    if (stream_rate != TARGET_SAMPLE_RATE && stream_consumed > 0) {
+        // 收尾：与 resampleAudio 相同，末尾样本没有右邻居时直接取原值
+        size_t output_size = (size_t)(stream_consumed / stream_ratio);
+        while (stream_next_out < output_size) {
+            double src_index = stream_next_out * stream_ratio;
+            size_t idx = (size_t)std::floor(src_index);
+            float frac = (float)(src_index - idx);
+            size_t k = idx - stream_hist_base;
+            if (idx + 1 < stream_consumed) {
+                audio.push_back(stream_hist[k] * (1.0f - frac) + stream_hist[k + 1] * frac);
+            }
+            else {
+                audio.push_back(stream_hist[k]);
+            }
+            stream_next_out++;
+        }
     }
 
-    try {
-        json j = json::parse(f);
-        token_to_id.clear();
-        id_to_token.clear();
+    stream_hist.clear();
+    stream_hist.shrink_to_fit();
 
-        for (auto& element : j.items()) {
-            std::string token = element.key();
-            int id = element.value();
+    buildSummary();
+    normalizeAudio(audio);
 
-            token_to_id[token] = id;
-            id_to_token[id] = token;
+    LOG_INFO("[Info] Audio Streamed. Final Input Size: " << audio.size() << " samples.");
+}
+
+bool ModelRunner::loadModel(const std::string& model_path)
+{
+    try {
+        // env 延迟到第一次加载模型时创建；通过 shareModelFrom 共享模型的 runner 不需要自己的 env
+        if (!env) {
+            env = std::make_shared<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "SpeechEngine");
+        }
+        // 先建好新 session 再替换：加载失败时旧模型照常可用，
+        // 旧 session 由共享它的 runner 持有，最后一个 runner 释放时才卸载
+        auto loaded = std::make_shared<Ort::Session>(*env, toOrtPath(model_path).c_str(), *session_options);
+        if (session) {
+            LOG_INFO("[Info] Replacing Previous Model.");
         }
-        std::cout << "[Info] Vocab Loaded. Total tokens: " << token_to_id.size() << std::endl;
+        profile_session.reset();
+        profile_remaining = 0;
+        background_session.reset();
+        session = loaded;
+        this->model_path = model_path;
+
+        // ORT 刚读完整个文件，再映射一遍读的是页缓存
+        MappedFile file;
+        model_hash = file.open(model_path) ? hashContent(file.data(), file.size()) : 0;
+        LOG_INFO("[Info] Model Loaded from: " << model_path);
+
         return true;
+    } catch (const Ort::Exception& e) {
+        LOG_ERROR("[Error] Failed to load model: " << e.what());
+        return false;
     }
-    catch (json::parse_error& e) {
-        std::cerr << "[Error] JSON parse error: " << e.what() << std::endl;
+}
+
+bool ModelRunner::loadVocab(const std::string& json_path)
+{
+    auto loaded = std::make_shared<Vocab>();
+    if (!loaded->loadFromJson(json_path)) {
         return false;
     }
+    vocab = loaded;
+    return true;
 }
 
-bool ModelRunner::runInference()
+bool ModelRunner::runInference(StageTimings* timings, const CancelToken* cancel)
 {
     if (!session) {
-        std::cerr << "[Error] Model not loaded!" << std::endl;
+        LOG_ERROR("[Error] Model not loaded!");
         return false;
     }
     if (audio.empty()) {
-        std::cerr << "[Error] Audio not loaded!" << std::endl;
+        LOG_ERROR("[Error] Audio not loaded!");
         return false;
     }
 
@@ -183,11 +283,27 @@ bool ModelRunner::runInference()
         const char* input_names[] = { "input_values" }; // 必须和你导出 ONNX 时的名字一致
         const char* output_names[] = { "logits" };
 
-        auto output_tensors = session->Run(
-            Ort::RunOptions{ nullptr },
+        // profiling 期间改用开启了 profiler 的 session；后台请求用线程更少的 session
+        Ort::Session* active = session.get();
+        if (profile_session) active = profile_session.get();
+        else if (use_background && background_session) active = background_session.get();
+
+        // 取消时从其他线程 (JS 线程或截止时间计时线程) 调 SetTerminate，ORT 在下一个算子边界退出 Run
+        Ort::RunOptions run_options;
+        ScopedCancelCallback terminate(cancel, [&run_options]() { run_options.SetTerminate(); });
+        if (cancel && cancel->isCancelled()) {
+            LOG_INFO("[Info] Inference skipped: " << cancelReasonName(cancel->reason()) << ".");
+            releaseBuffers();
+            return false;
+        }
+
+        ScopedStageTimer run_timer(timings, Stage::Inference);
+        auto output_tensors = active->Run(
+            run_options,
             input_names, &input_tensor, 1,
             output_names, 1
         );
+        run_timer.stop();
 
         // 3. 获取输出维度
         // Output shape: [1, TimeSteps, VocabSize]
@@ -208,27 +324,121 @@ bool ModelRunner::runInference()
 
         // 5. [关键] 执行 Log-Softmax
         // 原始模型输出的是 logits，我们需要对数概率来进行 Viterbi 计算
-        computeLogSoftmax();
+        {
+            ScopedStageTimer softmax_timer(timings, Stage::LogSoftmax);
+            computeLogSoftmax(output_log_probs.data(), time_steps, vocab_size);
+        }
+
+        if (timings) {
+            timings->audio_samples = audio.size();
+            timings->frames = time_steps;
+            timings->vocab_size = vocab_size;
+            // ORT 输出张量 + 我们的对数概率副本
+            timings->bytes_allocated += 2 * (uint64_t)time_steps * vocab_size * sizeof(float);
+        }
 
-        std::cout << "[Info] Inference Done. Matrix Shape: [" << time_steps << " x " << vocab_size << "]" << std::endl;
+        LOG_INFO("[Info] Inference Done. Matrix Shape: [" << time_steps << " x " << vocab_size << "]");
+
+        if (profile_session && --profile_remaining <= 0) {
+            stopProfiling();
+        }
         return true;
     }
     catch (const Ort::Exception& e) {
-        std::cerr << "[ONNX Error] " << e.what() << std::endl;
+        if (cancel && cancel->isCancelled()) {
+            LOG_INFO("[Info] Inference " << cancelReasonName(cancel->reason()) << ".");
+            releaseBuffers();
+            return false;
+        }
+        LOG_ERROR("[ONNX Error] " << e.what());
         return false;
     }
 }
 
+void ModelRunner::releaseBuffers()
+{
+    std::vector<float>().swap(audio);
+    std::vector<float>().swap(output_log_probs);
+    summary.reset();
+    time_steps = 0;
+    vocab_size = 0;
+}
+
+bool ModelRunner::startProfiling(int runs, const std::string& trace_prefix)
+{
+    if (!session || model_path.empty()) {
+        LOG_ERROR("[Error] Model not loaded!");
+        return false;
+    }
+    if (runs <= 0) {
+        LOG_ERROR("[Error] Profiling run count must be positive.");
+        return false;
+    }
+
+    std::string prefix = trace_prefix;
+    profile_keep_trace = !prefix.empty();
+    if (prefix.empty()) {
+        std::error_code ec;
+        std::filesystem::path tmp = std::filesystem::temp_directory_path(ec);
+        prefix = (tmp / "speech_ort_profile").string();
+    }
+
+    try {
+        // profiler 只能在创建 session 时打开，所以复制一份配置单独建 session，
+        // 不影响其他共享正常 session 的 runner
+        Ort::SessionOptions options = session_options->Clone();
+        options.EnableProfiling(toOrtPath(prefix).c_str());
+        profile_session = std::make_shared<Ort::Session>(*env, toOrtPath(model_path).c_str(), options);
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("[Error] Failed to create profiling session: " << e.what());
+        profile_session.reset();
+        return false;
+    }
+
+    profile_remaining = runs;
+    has_profile_report = false;
+    LOG_INFO("[Info] ORT profiling enabled for the next " << runs << " runs.");
+    return true;
+}
+
+bool ModelRunner::stopProfiling()
+{
+    if (!profile_session) return false;
+
+    std::string trace_path;
+    try {
+        Ort::AllocatorWithDefaultOptions allocator;
+        Ort::AllocatedStringPtr file = profile_session->EndProfilingAllocated(allocator);
+        trace_path = file.get();
+    }
+    catch (const Ort::Exception& e) {
+        LOG_ERROR("[Error] Failed to end profiling: " << e.what());
+    }
+    profile_session.reset();
+    profile_remaining = 0;
+
+    if (trace_path.empty()) return false;
+
+    has_profile_report = parseOrtProfile(trace_path, profile_report);
+    if (!profile_keep_trace) {
+        std::error_code ec;
+        std::filesystem::remove(trace_path, ec);
+        profile_report.trace_path.clear();
+    }
+    return has_profile_report;
+}
+
 // LogSoftmax (数值稳定版)
 // LogSoftmax(x_i) = x_i - log(sum(exp(x_j)))
 // 为了防止 exp 溢出，使用 trick: log(sum(exp(x_j))) = max + log(sum(exp(x_j - max)))
-void ModelRunner::computeLogSoftmax()
+void computeLogSoftmax(float* logits, int time_steps, int vocab_size)
 {
     // 对每一帧 (Time Step) 独立进行 Softmax
     for (int t = 0; t < time_steps; ++t) {
 
         // 指向当前帧的起始位置
-        float* frame_data = &output_log_probs[t * vocab_size];
+        float* frame_data = logits + (size_t)t * vocab_size;
 
         // A. 找最大值 (Max)
         float max_val = -std::numeric_limits<float>::infinity();
@@ -263,20 +473,30 @@ float ModelRunner::getLogProb(int time_step, int token_id) const
     return output_log_probs[time_step * vocab_size + token_id];
 }
 
-int ModelRunner::getTokenId(const std::string& token) const
+const float* ModelRunner::getLogProbRow(int time_step) const
 {
-    auto it = token_to_id.find(token);
-    if (it != token_to_id.end()) {
-        return it->second;
-    }
-    return -1; // Not found
+    if (time_step < 0 || time_step >= time_steps) return nullptr;
+    return output_log_probs.data() + (size_t)time_step * vocab_size;
 }
 
-std::string ModelRunner::getTokenString(int id) const
+EmissionView ModelRunner::getEmissions() const
 {
-    auto it = id_to_token.find(id);
-    if (it != id_to_token.end()) {
-        return it->second;
-    }
-    return "<unk>";
+    EmissionView v;
+    v.data = output_log_probs.data();
+    v.frames = time_steps;
+    v.vocab = vocab_size;
+    return v;
+}
+
+std::shared_ptr<const EmissionMatrix> ModelRunner::copyEmissions() const
+{
+    auto m = std::make_shared<EmissionMatrix>();
+    size_t count = (size_t)time_steps * vocab_size;
+    m->data.assign(output_log_probs.begin(), output_log_probs.begin() + std::min(count, output_log_probs.size()));
+    m->frames = time_steps;
+    m->vocab = vocab_size;
+    m->audio_samples = audio.size();
+    m->model_hash = model_hash;
+    m->summary = summary;
+    return m;
 }
@@ -2,53 +2,141 @@
 #include <string>
 #include <vector>
 #include <onnxruntime_cxx_api.h>
-#include <map>
-
-const unsigned int TARGET_SAMPLE_RATE = 16000;
+#include <memory>
+#include "AudioFrontEnd.h"
+#include "Metrics.h"
+#include "OrtProfiler.h"
+#include "Vocab.h"
+#include "Emission.h"
+#include "Cancel.h"
 
 class ModelRunner {
 public:
 	ModelRunner();
 	~ModelRunner();
+	// input_size 为交错样本总数 (帧数 * 声道数)
 	void loadAudio(const float* input, size_t input_size, unsigned int src_rate, unsigned int channels);
-	bool loadModel(const std::wstring& model_path);
+
+    // 流式加载音频 (用于文件解码)：分块送入交错 PCM，边读边下混和重采样，
+    // 结束时统一归一化。结果与 loadAudio 一次性加载完全一致，
+    // 但不需要保留整段原始多声道数据。
+    // total_frames_hint: 预计总帧数 (源采样率下)，用于一次性预留输出缓冲区，0 表示未知
+    void beginAudioStream(unsigned int src_rate, unsigned int channels, size_t total_frames_hint = 0);
+    void appendAudioFrames(const float* interleaved, size_t frames);
+    void endAudioStream();
+	// model_path 为 UTF-8 路径，Windows 下内部转换为宽字符。
+	// 加载失败时保留之前的模型；成功时替换 (已共享旧模型的 runner 继续用旧的)
+	bool loadModel(const std::string& model_path);
+    // 设置推理使用的线程数 (需在 loadModel 之前调用)
+    void setIntraOpThreads(int threads);
+    // 再建一个 intra-op 线程更少的 session 给后台任务用，避免和交互请求抢核 (需在 loadModel 之后调用)。
+    // 代价是模型权重多占一份内存；shareModelFrom 会一并共享
+    bool loadBackgroundSession(int intra_threads);
+    bool hasBackgroundSession() const { return background_session != nullptr; }
+    // 之后的 runInference 是否使用后台 session (没有后台 session 时总是用主 session)
+    void setBackground(bool background) { use_background = background; }
+    // 与另一个 runner 共享已加载的模型和词表 (Ort::Session::Run 本身是线程安全的，词表只读)
+    // 多线程批处理时每个线程持有一个 runner，只各自保存音频和推理结果，模型只占一份内存
+    void shareModelFrom(const ModelRunner& other);
+    // 放掉模型 (推理和 profiling 的 session)，词表保留，之后可以再 shareModelFrom。
+    // 共享来的模型被淘汰或替换后调用，让它的内存不必等到下一次切换才释放
+    void releaseModel();
     // 加载 Vocab.json
+    // 每次加载都会生成新的词表对象，之前通过 getVocab() 拿到的引用随之失效 (Phonemizer 需要重建)
     bool loadVocab(const std::string& json_path);
 
     // 运行推理
     // 返回 true 表示成功
-    bool runInference();
+    // timings 非空时记录 ORT Run 和 LogSoftmax 的耗时以及输出矩阵大小
+    // cancel 非空时取消会通过 RunOptions::SetTerminate 中止正在进行的 Run，并释放音频和输出缓冲区
+    bool runInference(StageTimings* timings = nullptr, const CancelToken* cancel = nullptr);
+
+    // ORT 算子级 profiling (需在 loadModel 之后调用)
+    // 另建一个开启 profiler 的 session 跑接下来的 runs 次推理，跑完后自动解析 trace 生成热点报告。
+    // trace_prefix 为空时写到系统临时目录并在解析后删除，否则保留 trace 文件
+    bool startProfiling(int runs, const std::string& trace_prefix = "");
+    // 提前结束 profiling 并生成报告 (已跑的次数不足 runs 时使用)
+    bool stopProfiling();
+    bool isProfiling() const { return profile_remaining > 0; }
+    bool hasProfileReport() const { return has_profile_report; }
+    const ProfileReport& getProfileReport() const { return profile_report; }
 
     // 获取推理结果的接口 (给 Viterbi 算法用)
     // 获取时间步数 (Frames)
     int getTimeSteps() const { return time_steps; }
     // 获取词表大小 (Vocab Size)
     int getVocabSize() const { return vocab_size; }
+    // 获取前端处理后 (16k 单声道) 的样本数
+    size_t getAudioSize() const { return audio.size(); }
+    // 获取最近一次加载的原始输入样本数 (交错，源采样率)
+    size_t getInputSamples() const { return input_samples; }
+    // 前端顺带算出的波形包络和能量轮廓 (归一化之前的 16k 单声道)，copyEmissions 一并带上
+    std::shared_ptr<const AudioSummary> getAudioSummary() const { return summary; }
     // 获取某一帧、某一个Token的对数概率 (Log Probability)
     float getLogProb(int time_step, int token_id) const;
-    // 根据 Token 字符串获取 ID (例如 "a" -> 7)
-    int getTokenId(const std::string& token) const;
+    // 获取某一帧完整的对数概率行 (长度为 vocab_size)，越界返回 nullptr
+    const float* getLogProbRow(int time_step) const;
+    // 整个对数概率矩阵的只读视图 (下一次 runInference 之前有效)
+    EmissionView getEmissions() const;
+    // 复制一份对数概率矩阵 (给缓存用，之后的 runInference 不影响它)
+    std::shared_ptr<const EmissionMatrix> copyEmissions() const;
+    // 根据 Token 字符串获取 ID (例如 "a" -> 7)，找不到返回 -1
+    int getTokenId(std::string_view token) const { return vocab->find(token); }
     // 根据 ID 获取 Token 字符串 (调试用)
-    std::string getTokenString(int id) const;
-    // 获取完整词表的常量引用 (给 Phonemizer 分词用)
-    const std::map<std::string, int>& getVocab() const { return token_to_id; }
+    const std::string& getTokenString(int id) const { return vocab->token(id); }
+    // 获取完整词表的常量引用 (给 Phonemizer 分词和 Align 查表用)
+    const Vocab& getVocab() const { return *vocab; }
+    // 模型文件内容的指纹 (loadModel 时计算)，写进离线保存的推理结果
+    uint64_t getModelHash() const { return model_hash; }
+    // 模型版本号 (ModelStore 发布时分配，shareModelFrom 一并复制)，0 表示不由 ModelStore 管理
+    uint64_t getModelVersion() const { return model_version; }
+    void setModelVersion(uint64_t version) { model_version = version; }
+    // 词表的共享引用 (需要让词表比这个 runner 活得更久时用)
+    std::shared_ptr<const Vocab> shareVocab() const { return vocab; }
 
 private:
+    // 请求被取消后释放音频和推理结果 (不再有人读，没必要留到下一次请求)
+    void releaseBuffers();
+    // 前端归一化之前调用：给刚加载的音频建概要 (每次新建，已缓存的推理结果继续引用旧的)
+    void buildSummary();
+
 	std::vector<float> audio;
+	size_t input_samples = 0;
+	std::shared_ptr<const AudioSummary> summary;
 
 	Ort::SessionOptions* session_options;
-	Ort::Env* env;
-	Ort::Session* session;
+	// env 必须比 session 活得久，所以声明在前 (析构顺序相反)
+	std::shared_ptr<Ort::Env> env;
+	std::shared_ptr<Ort::Session> session;
+	std::shared_ptr<Ort::Session> background_session;
+	bool use_background = false;
+	std::string model_path;
+	uint64_t model_hash = 0;
+	uint64_t model_version = 0;
+
+    // profiling 状态
+    std::shared_ptr<Ort::Session> profile_session;
+    int profile_remaining = 0;
+    bool profile_keep_trace = false;
+    bool has_profile_report = false;
+    ProfileReport profile_report;
 
-	void mixToMono(unsigned int channels, size_t total_frames);
-	void resampleAudio(unsigned int src_rate);
-	void normalizeAudio();
-    void computeLogSoftmax();
+    // 只读，多个 runner 之间共享
+    std::shared_ptr<const Vocab> vocab;
 
-    std::map<std::string, int> token_to_id;
-    std::map<int, std::string> id_to_token;
+    // 流式前端的状态
+    unsigned int stream_channels = 1;
+    unsigned int stream_rate = TARGET_SAMPLE_RATE;
+    double stream_ratio = 1.0;      // src_rate / TARGET_SAMPLE_RATE
+    size_t stream_consumed = 0;     // 已送入的源帧数
+    size_t stream_next_out = 0;     // 下一个待输出的目标样本下标
+    std::vector<float> stream_hist; // 尚未用完的单声道源样本 (一个块 + 少量跨块插值用的历史)
+    size_t stream_hist_base = 0;    // stream_hist[0] 对应的源样本下标
 
     std::vector<float> output_log_probs;
     int time_steps = 0;
     int vocab_size = 0;
 };
+
+// 对 [time_steps x vocab_size] 的 logits 逐帧原地做数值稳定的 LogSoftmax
+void computeLogSoftmax(float* logits, int time_steps, int vocab_size);
@@ -0,0 +1,89 @@
+#include "ModelStore.h"
+#include "Log.h"
+
+std::shared_ptr<ModelRunner> loadModelVersion(const ModelSource& source)
+{
+    auto model = std::make_shared<ModelRunner>();
+    model->setIntraOpThreads(source.intra_threads);
+    if (!model->loadModel(source.model_path)) {
+        return nullptr;
+    }
+    // 后台任务线程更少时单独建一个 session (多占一份权重内存)，否则和交互请求共用
+    if (source.background_intra_threads > 0 && source.background_intra_threads < source.intra_threads) {
+        model->loadBackgroundSession(source.background_intra_threads);
+    }
+    if (!model->loadVocab(source.vocab_path)) {
+        return nullptr;
+    }
+    return model;
+}
+
+ModelStore::~ModelStore()
+{
+    if (loader_.joinable()) loader_.join();
+}
+
+std::shared_ptr<const ModelRunner> ModelStore::acquire() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+}
+
+uint64_t ModelStore::version() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return version_;
+}
+
+ModelSource ModelStore::source() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return source_;
+}
+
+uint64_t ModelStore::publish(std::shared_ptr<ModelRunner> model, const ModelSource& source)
+{
+    std::shared_ptr<const ModelRunner> previous;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        version = ++version_;
+        model->setModelVersion(version);
+        previous = std::move(current_);
+        current_ = std::move(model);
+        source_ = source;
+    }
+    LOG_INFO("[Info] Model version " << version << " published (" << source.model_path << ").");
+    // previous 在锁外释放：没有其他持有者时旧 session 在这里卸载
+    return version;
+}
+
+bool ModelStore::load(const ModelSource& source)
+{
+    std::shared_ptr<ModelRunner> model = loadModelVersion(source);
+    if (!model) return false;
+    publish(std::move(model), source);
+    return true;
+}
+
+bool ModelStore::loadAsync(const ModelSource& source, LoadCallback done)
+{
+    bool expected = false;
+    if (!loading_.compare_exchange_strong(expected, true)) {
+        LOG_WARNING("[Warning] A model is already loading, request ignored.");
+        return false;
+    }
+    // 上一次的加载线程已经结束 (loading_ 为 false)，回收它
+    if (loader_.joinable()) loader_.join();
+
+    loader_ = std::thread([this, source, done]() {
+        std::shared_ptr<ModelRunner> model = loadModelVersion(source);
+        uint64_t version = model ? publish(std::move(model), source) : 0;
+        if (!version) {
+            LOG_ERROR("[Error] Failed to load model " << source.model_path << ", keeping version " << this->version() << ".");
+        }
+        loading_.store(false);
+        if (done) done(version != 0, version);
+    });
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ModelRunner.h"
+
+// 一个模型版本的来源和 session 配置
+struct ModelSource {
+    std::string model_path;
+    std::string vocab_path;
+    int intra_threads = 1;
+    int background_intra_threads = 0; // > 0 且小于 intra_threads 时另建后台 session
+};
+
+/**
+ * 按 source 加载一个完整的模型版本 (session、可选的后台 session、词表)。
+ * 返回的 runner 只用作共享的模板 (shareModelFrom)，不保存音频。失败返回 nullptr
+ */
+std::shared_ptr<ModelRunner> loadModelVersion(const ModelSource& source);
+
+/**
+ * 当前生效的模型版本 (线程安全)。
+ * acquire() 返回带引用计数的只读句柄；publish() 只是指针交换：
+ * 之后的新请求拿到新版本，已经拿到旧句柄 (或 shareModelFrom 过旧版本) 的请求照常在旧模型上跑完，
+ * 最后一个持有者释放时旧的 session 和词表才被卸载。
+ */
+class ModelStore {
+public:
+    // 后台加载完成时在加载线程上调用；ok 为 false 时当前版本不变，version 为 0
+    using LoadCallback = std::function<void(bool ok, uint64_t version)>;
+
+    ModelStore() = default;
+    // 等正在进行的后台加载结束
+    ~ModelStore();
+
+    ModelStore(const ModelStore&) = delete;
+    ModelStore& operator=(const ModelStore&) = delete;
+
+    // 当前版本，还没有发布过时返回 nullptr
+    std::shared_ptr<const ModelRunner> acquire() const;
+    uint64_t version() const;
+    ModelSource source() const;
+
+    // 发布一个已加载的版本，分配并返回新的版本号
+    uint64_t publish(std::shared_ptr<ModelRunner> model, const ModelSource& source);
+
+    // 在调用线程上加载并发布
+    bool load(const ModelSource& source);
+    // 在后台线程加载，成功后发布。已有加载在进行时返回 false (done 不会被调用)
+    bool loadAsync(const ModelSource& source, LoadCallback done);
+    bool isLoading() const { return loading_.load(); }
+
+private:
+    mutable std::mutex mutex_;
+    std::shared_ptr<const ModelRunner> current_;
+    ModelSource source_;
+    uint64_t version_ = 0;
+
+    std::thread loader_;
+    std::atomic<bool> loading_{ false };
+};
@@ -0,0 +1,165 @@
+#include "OrtProfiler.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+// ORT 的 kernel 事件名为 "<节点名>_kernel_time"，同一节点还有 _fence_before / _fence_after 事件
+static const std::string KERNEL_SUFFIX = "_kernel_time";
+
+const char* classifyWav2Vec2Node(const std::string& node_name)
+{
+    // 顺序有关系：pos_conv_embed 在 encoder 下面，但它是卷积而不是注意力
+    if (node_name.find("feature_extractor") != std::string::npos || node_name.find("conv_layers") != std::string::npos)
+        return "feature_extractor";
+    if (node_name.find("feature_projection") != std::string::npos)
+        return "feature_projection";
+    if (node_name.find("pos_conv") != std::string::npos)
+        return "positional_conv";
+    if (node_name.find("attention") != std::string::npos)
+        return "attention";
+    if (node_name.find("feed_forward") != std::string::npos)
+        return "ffn";
+    if (node_name.find("layer_norm") != std::string::npos || node_name.find("LayerNorm") != std::string::npos)
+        return "layer_norm";
+    if (node_name.find("lm_head") != std::string::npos)
+        return "lm_head";
+    return "other";
+}
+
+// trace 里的大小字段在不同 ORT 版本中可能是字符串或数字
+static uint64_t readSize(const json& args, const char* key)
+{
+    auto it = args.find(key);
+    if (it == args.end()) return 0;
+    if (it->is_number_unsigned() || it->is_number_integer()) return it->get<uint64_t>();
+    if (it->is_string()) {
+        try {
+            return std::stoull(it->get<std::string>());
+        }
+        catch (...) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// 按 key 把节点行合并成汇总行 (内存按节点求和)
+static std::vector<OpProfileEntry> rollUp(const std::vector<OpProfileEntry>& nodes, bool by_category)
+{
+    std::map<std::string, OpProfileEntry> groups;
+    for (const auto& n : nodes) {
+        const std::string& key = by_category ? n.category : n.op_type;
+        OpProfileEntry& g = groups[key];
+        g.name = key;
+        if (by_category) g.category = key;
+        else g.op_type = key;
+        g.calls += n.calls;
+        g.total_us += n.total_us;
+        g.output_bytes += n.output_bytes;
+        g.activation_bytes += n.activation_bytes;
+        g.parameter_bytes += n.parameter_bytes;
+    }
+
+    std::vector<OpProfileEntry> out;
+    out.reserve(groups.size());
+    for (auto& kv : groups) out.push_back(std::move(kv.second));
+    return out;
+}
+
+static void finalize(std::vector<OpProfileEntry>& entries, double kernel_us)
+{
+    for (auto& e : entries) {
+        e.mean_us = e.calls ? e.total_us / e.calls : 0.0;
+        e.percent = kernel_us > 0 ? e.total_us * 100.0 / kernel_us : 0.0;
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const OpProfileEntry& a, const OpProfileEntry& b) { return a.total_us > b.total_us; });
+}
+
+bool parseOrtProfile(const std::string& trace_path, ProfileReport& report, size_t top_nodes)
+{
+    report = ProfileReport();
+    report.trace_path = trace_path;
+
+    std::ifstream f(trace_path);
+    if (!f.is_open()) {
+        LOG_ERROR("[Error] Cannot open profile trace: " << trace_path);
+        return false;
+    }
+
+    json trace;
+    try {
+        trace = json::parse(f);
+    }
+    catch (json::parse_error& e) {
+        LOG_ERROR("[Error] Profile trace parse error: " << e.what());
+        return false;
+    }
+    if (!trace.is_array()) {
+        LOG_ERROR("[Error] Unexpected profile trace format: " << trace_path);
+        return false;
+    }
+
+    std::map<std::string, OpProfileEntry> by_node;
+
+    for (const auto& ev : trace) {
+        if (!ev.is_object()) continue;
+        const std::string cat = ev.value("cat", "");
+        const std::string name = ev.value("name", "");
+        double dur = ev.value("dur", 0.0);
+
+        if (cat == "Session") {
+            if (name == "model_run") {
+                report.runs++;
+                report.model_run_us += dur;
+            }
+            continue;
+        }
+        if (cat != "Node") continue;
+        if (name.size() <= KERNEL_SUFFIX.size() ||
+            name.compare(name.size() - KERNEL_SUFFIX.size(), KERNEL_SUFFIX.size(), KERNEL_SUFFIX) != 0) {
+            continue;
+        }
+
+        std::string node_name = name.substr(0, name.size() - KERNEL_SUFFIX.size());
+        OpProfileEntry& n = by_node[node_name];
+        if (n.calls == 0) {
+            n.name = node_name;
+            n.category = classifyWav2Vec2Node(node_name);
+        }
+
+        static const json empty_args = json::object();
+        auto args_it = ev.find("args");
+        const json& args = (args_it != ev.end() && args_it->is_object()) ? *args_it : empty_args;
+        if (n.op_type.empty()) n.op_type = args.value("op_name", "Unknown");
+
+        n.calls++;
+        n.total_us += dur;
+        n.output_bytes = std::max(n.output_bytes, readSize(args, "output_size"));
+        n.activation_bytes = std::max(n.activation_bytes, readSize(args, "activation_size"));
+        n.parameter_bytes = std::max(n.parameter_bytes, readSize(args, "parameter_size"));
+
+        report.kernel_us += dur;
+    }
+
+    std::vector<OpProfileEntry> nodes;
+    nodes.reserve(by_node.size());
+    for (auto& kv : by_node) nodes.push_back(std::move(kv.second));
+
+    report.categories = rollUp(nodes, true);
+    report.op_types = rollUp(nodes, false);
+    finalize(report.categories, report.kernel_us);
+    finalize(report.op_types, report.kernel_us);
+    finalize(nodes, report.kernel_us);
+    if (nodes.size() > top_nodes) nodes.resize(top_nodes);
+    report.nodes = std::move(nodes);
+
+    LOG_INFO("[Info] Profile parsed: " << report.runs << " runs, " << by_node.size() << " nodes, kernel time "
+                                       << report.kernel_us / 1000.0 << " ms");
+    return true;
+}
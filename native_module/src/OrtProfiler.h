@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// 一行热点统计 (可以是一个节点、一种算子类型或一个模块类别)
+struct OpProfileEntry {
+    std::string name;              // 节点名 / 算子类型 / 类别名
+    std::string op_type;           // 算子类型，如 "MatMul"、"Conv"
+    std::string category;          // 所属模块，见 classifyWav2Vec2Node
+    uint64_t calls = 0;            // 被调用的次数 (所有 profile 轮次之和)
+    double total_us = 0.0;         // kernel 总耗时 (微秒)
+    double mean_us = 0.0;          // 平均每次调用耗时
+    double percent = 0.0;          // 占全部 kernel 耗时的百分比
+    // 内存 (字节)：同一节点多次调用取最大值，汇总行按节点求和
+    uint64_t output_bytes = 0;
+    uint64_t activation_bytes = 0;
+    uint64_t parameter_bytes = 0;
+};
+
+// ORT profiler trace 的汇总结果，各列表按 total_us 降序
+struct ProfileReport {
+    int runs = 0;                          // trace 里的 model_run 次数
+    double model_run_us = 0.0;             // model_run 总耗时 (包含调度开销)
+    double kernel_us = 0.0;                // 全部算子 kernel 耗时之和
+    std::vector<OpProfileEntry> categories;
+    std::vector<OpProfileEntry> op_types;
+    std::vector<OpProfileEntry> nodes;     // 只保留最耗时的前 top_nodes 个
+    std::string trace_path;
+};
+
+/**
+ * 按 PyTorch 导出的 wav2vec2 节点名归类:
+ * feature_extractor (卷积特征提取) / feature_projection / positional_conv /
+ * attention / ffn / layer_norm / lm_head / other
+ */
+const char* classifyWav2Vec2Node(const std::string& node_name);
+
+/**
+ * 解析 ORT 的 profiling 输出 (Chrome trace 格式的 JSON)，按节点、算子类型和模块类别汇总 kernel 耗时
+ * @param trace_path: Session::EndProfilingAllocated 返回的文件路径
+ * @param report: [输出] 汇总结果
+ * @param top_nodes: report.nodes 保留的最大条数
+ * @return: true 表示解析成功
+ */
+bool parseOrtProfile(const std::string& trace_path, ProfileReport& report, size_t top_nodes = 30);
@@ -1,9 +1,15 @@
 #include "Phonemizer.h"
+#include "Log.h"
 #include <speak_lib.h>
 #include <cstring>
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <mutex>
+
+// espeak-ng 内部是全局状态 (当前 voice、合成缓冲区)，所有 espeak 调用都必须串行。
+// 多线程批处理时各线程共享同一个 Phonemizer，由这把锁保证安全。
+static std::mutex g_espeak_mutex;
 
 // --- 新增：用于在回调中传递数据的上下文结构 ---
 struct SynthesisContext {
@@ -29,7 +35,9 @@ static int SynthCallback(short* wav, int numsamples, espeak_EVENT* events) {
                 events->text_position >= 0 &&
                 (size_t)(events->text_position + events->length - 1) <= ctx->originalText->length()) {
 				int length = events->length;
-                if (ctx->originalText->at(events->text_position + events->length - 1) == '\'') {
+                // 单词紧跟的字符 (单词在句末时不存在)
+                size_t next_pos = (size_t)(events->text_position + events->length - 1);
+                if (next_pos < ctx->originalText->length() && ctx->originalText->at(next_pos) == '\'') {
                     do {
                         length++;
                     } while (ctx->originalText->size() > events->text_position + length - 1 && ctx->originalText->at(events->text_position + length - 1) != ' ');
@@ -54,7 +62,7 @@ static int SynthCallback(short* wav, int numsamples, espeak_EVENT* events) {
 return 0; // 返回 0 继续合成
 }
 
-Phonemizer::Phonemizer(const std::string& espeakDataPath, const std::map<std::string, int>& _vocab, const std::string& voiceName) : initialized(false), vocab(_vocab) {
+Phonemizer::Phonemizer(const std::string& espeakDataPath, const Vocab& _vocab, const std::string& voiceName) : initialized(false), vocab(_vocab) {
     // 1. 初始化 espeak
     // AUDIO_OUTPUT_RETRIEVAL: 我们不需要播放声音，只需要获取音素
     // 传入 espeak-ng-data 的父目录路径
@@ -62,8 +70,8 @@ Phonemizer::Phonemizer(const std::string& espeakDataPath, const std::map<std::st
     int sampleRate = espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, espeakDataPath.c_str(), options);
 
     if (sampleRate == -1) {
-        std::cerr << "[Phonemizer Error] Failed to initialize espeak-ng. "
-            << "Check if 'espeak-ng-data' exists in: " << espeakDataPath << std::endl;
+        LOG_ERROR("[Phonemizer Error] Failed to initialize espeak-ng. "
+            << "Check if 'espeak-ng-data' exists in: " << espeakDataPath);
         initialized = false;
         return;
     }
@@ -73,19 +81,20 @@ Phonemizer::Phonemizer(const std::string& espeakDataPath, const std::map<std::st
 
     // 2. 设置语音
     if (espeak_SetVoiceByName(voiceName.c_str()) != EE_OK) {
-        std::cerr << "[Phonemizer Error] Failed to set voice: " << voiceName << std::endl;
+        LOG_ERROR("[Phonemizer Error] Failed to set voice: " << voiceName);
         initialized = false;
         return;
     }
 
+    voice = voiceName;
     initialized = true;
-    std::cout << "[Phonemizer] Initialized successfully. Voice: " << voiceName << std::endl;
+    LOG_INFO("[Phonemizer] Initialized successfully. Voice: " << voiceName);
 }
 
 Phonemizer::~Phonemizer() {
     if (initialized) {
         espeak_Terminate();
-        std::cout << "[Phonemizer] Terminated." << std::endl;
+        LOG_INFO("[Phonemizer] Terminated.");
     }
 }
 
@@ -105,18 +114,23 @@ bool Phonemizer::setVoice(const std::string &voiceName)
 {
     if (!initialized) return false;
 
+    std::lock_guard<std::mutex> lock(g_espeak_mutex);
+
     if (espeak_SetVoiceByName(voiceName.c_str()) != EE_OK) {
-        std::cerr << "[Phonemizer Error] Failed to set voice: " << voiceName << std::endl;
+        LOG_ERROR("[Phonemizer Error] Failed to set voice: " << voiceName);
         return false;
     }
 
-    std::cout << "[Phonemizer] Voice changed to: " << voiceName << std::endl;
+    voice = voiceName;
+    LOG_INFO("[Phonemizer] Voice changed to: " << voiceName);
     return true;
 }
 
 std::string Phonemizer::rawEspeakCall(const std::string& text) {
     if (!initialized) return "";
 
+    std::lock_guard<std::mutex> lock(g_espeak_mutex);
+
     std::string result = "";
     const void* text_ptr = text.c_str();
 
@@ -146,12 +160,16 @@ std::string Phonemizer::convertToIPA(const std::string& text) {
 }
 
 // 辅助函数：判断是否是重音符或空格 (需要清洗掉的字符)
-static bool isIgnoredChar(const std::string& s) {
+static bool isIgnoredChar(std::string_view s) {
     return (s == "ˈ" || s == "ˌ" || s == " " || s == "_" || s == "\u00A0");
 }
 
+std::vector<std::string> Phonemizer::cleanAndTokenizeIPA(const std::string& raw_ipa, const Vocab* vocab_override) {
+    return tokenizeIPA(raw_ipa, vocab_override ? *vocab_override : vocab);
+}
+
 // 清洗并拆分 IPA 字符串 (处理 UTF-8 字符)
-std::vector<std::string> Phonemizer::cleanAndTokenizeIPA(const std::string& raw_ipa) {
+std::vector<std::string> tokenizeIPA(const std::string& raw_ipa, const Vocab& vocab) {
     std::string clean_str = "";
 
     // --- 第一步：预清洗 (Pre-cleaning) ---
@@ -167,16 +185,17 @@ std::vector<std::string> Phonemizer::cleanAndTokenizeIPA(const std::string& raw_
         else char_len = 1;
 
         if (i + char_len > raw_ipa.length()) break;
-        std::string symbol = raw_ipa.substr(i, char_len);
+        std::string_view symbol(raw_ipa.data() + i, char_len);
 
         if (!isIgnoredChar(symbol)) {
-            clean_str += symbol;
+            clean_str.append(symbol.data(), symbol.size());
         }
         i += char_len;
     }
 
     // --- 第二步：最大正向匹配 (MaxMatch Tokenization) ---
     std::vector<std::string> tokens;
+    std::string_view clean_view(clean_str);
     size_t i = 0;
 
     while (i < clean_str.length()) {
@@ -188,16 +207,17 @@ std::vector<std::string> Phonemizer::cleanAndTokenizeIPA(const std::string& raw_
         // "eɪ" 可能是 2-4 个字节，"tʃ" 可能是 2-4 个字节。
         // 我们从 8 个字节开始往下试 (足够覆盖 3-4 个 unicode 字符)
 
-        size_t max_try_len = 8;
+        // 比词表里最长的 token 还长的子串不可能匹配，直接跳过
+        size_t max_try_len = std::min<size_t>(8, vocab.maxTokenBytes());
         if (i + max_try_len > clean_str.length()) {
             max_try_len = clean_str.length() - i;
         }
 
         for (size_t len = max_try_len; len >= 1; --len) {
-            std::string sub = clean_str.substr(i, len);
+            std::string_view sub = clean_view.substr(i, len);
 
-            // 查表：如果这个子串在词表里
-            if (vocab.find(sub) != vocab.end()) {
+            // 查表：如果这个子串在词表里 (string_view 查询，不分配内存)
+            if (vocab.contains(sub)) {
                 bool next_is_colon = false;
                 // 检查后两个字节是否是 0xCB 0x90
                 if (i + len + 1 < clean_str.length()) {
@@ -222,7 +242,7 @@ std::vector<std::string> Phonemizer::cleanAndTokenizeIPA(const std::string& raw_
                     continue; // 放弃当前长度，尝试更短的 len
                 }
                 
-                tokens.push_back(sub);
+                tokens.emplace_back(sub);
                 i += len; // 指针前进
                 match_found = true;
                 break; // 找到最长的了，跳出内层循环，继续找下一个
@@ -241,21 +261,19 @@ std::vector<std::string> Phonemizer::cleanAndTokenizeIPA(const std::string& raw_
             else if ((c & 0xF0) == 0xE0) char_len = 3;
             else if ((c & 0xF8) == 0xF0) char_len = 4;
 
-            std::cerr << "Unknown token char: " << clean_str.substr(i, char_len) << std::endl;
+            LOG_WARNING("Unknown token char: " << clean_str.substr(i, char_len));
             i += char_len;
         }
     }
 
-	for (int k = 0; k < tokens.size(); ++k) {
-		 //std::cout << "Token " << k << ": " << tokens[k] << std::endl;    
-	}
-
     return tokens;
 }
 
-// [核心] 句子分析
-std::vector<WordAnalysis> Phonemizer::analyzeText(const std::string& sentence) {
+// 整句转写 (espeak 回调里按单词切分)
+std::vector<WordAnalysis> Phonemizer::synthesizeWords(const std::string& sentence, const std::string* voice_override,
+                                                      const std::string* base_voice, bool* same_voice) {
     std::vector<WordAnalysis> results;
+    if (same_voice) *same_voice = false;
     if (!initialized) return results;
 
     // 准备上下文数据，供回调函数使用
@@ -268,6 +286,18 @@ std::vector<WordAnalysis> Phonemizer::analyzeText(const std::string& sentence) {
     // espeakCHARS_AUTO: 自动检测编码 (UTF-8)
     // user_data: 传入 ctx 指针，这样回调函数就能把数据写回 results
     unsigned int unique_identifier;
+    std::unique_lock<std::mutex> lock(g_espeak_mutex);
+    if (voice_override && same_voice && *voice_override == (base_voice ? *base_voice : voice)) {
+        *same_voice = true;
+        return results;
+    }
+    // 已经是要用的口音时不用切换
+    if (voice_override && *voice_override == voice) voice_override = nullptr;
+    if (voice_override && espeak_SetVoiceByName(voice_override->c_str()) != EE_OK) {
+        LOG_ERROR("[Phonemizer Error] Failed to set voice: " << *voice_override);
+        espeak_SetVoiceByName(voice.c_str());
+        return results;
+    }
     espeak_ERROR err = espeak_Synth(
         sentence.c_str(),
         sentence.length() + 1, // size (包含 null 终止符)
@@ -278,11 +308,21 @@ std::vector<WordAnalysis> Phonemizer::analyzeText(const std::string& sentence) {
         &unique_identifier,
         &ctx // user_data
     );
+    if (voice_override) {
+        espeak_SetVoiceByName(voice.c_str());
+    }
+    lock.unlock();
 
     if (err != EE_OK) {
-        std::cerr << "[Phonemizer Error] espeak_Synth failed with error code: " << err << std::endl;
-        return results;
+        LOG_ERROR("[Phonemizer Error] espeak_Synth failed with error code: " << err);
+        results.clear();
     }
+    return results;
+}
+
+// [核心] 句子分析
+std::vector<WordAnalysis> Phonemizer::analyzeText(const std::string& sentence, const Vocab* vocab_override, const std::string* voice) {
+    std::vector<WordAnalysis> results = synthesizeWords(sentence, voice);
 
     // 因为使用了 AUDIO_OUTPUT_SYNCHRONOUS，代码运行到这里时，
     // 回调函数已经执行完毕，results 中已经填满了单词和对应的 raw_ipa
@@ -290,8 +330,60 @@ std::vector<WordAnalysis> Phonemizer::analyzeText(const std::string& sentence) {
     // 后处理：对每个单词的 raw_ipa 进行清洗和分词 (Tokenization)
     // 这一步复用你现有的逻辑，将 IPA 字符串切分成词表中的 token
     for (auto& wa : results) {
-        wa.phonemes = cleanAndTokenizeIPA(wa.raw_ipa);
+        wa.phonemes = cleanAndTokenizeIPA(wa.raw_ipa, vocab_override);
     }
 
     return results;
-}
\ No newline at end of file
+}
+
+// 加入一个备选发音 (与标准发音或已有备选相同时忽略)
+static void addVariant(WordAnalysis& wa, std::vector<std::string>&& tokens) {
+    if (tokens.empty() || tokens == wa.phonemes) return;
+    for (const auto& v : wa.variants) {
+        if (v == tokens) return;
+    }
+    wa.variants.push_back(std::move(tokens));
+}
+
+void Phonemizer::addVoiceVariants(std::vector<WordAnalysis>& words, const std::string& sentence, const std::vector<std::string>& voices,
+                                  const Vocab* vocab_override, const std::string* base_voice) {
+    for (const auto& v : voices) {
+        bool same_voice = false;
+        std::vector<WordAnalysis> alt = synthesizeWords(sentence, &v, base_voice, &same_voice);
+        if (same_voice) continue;
+        // 不同口音对同一句话的断词一般一致，不一致时无法逐词对应，放弃这个口音
+        if (alt.size() != words.size()) {
+            LOG_WARNING("[Phonemizer] Voice " << v << " split the sentence into " << alt.size()
+                        << " words instead of " << words.size() << ", ignored.");
+            continue;
+        }
+        for (size_t i = 0; i < words.size(); ++i) {
+            addVariant(words[i], cleanAndTokenizeIPA(alt[i].raw_ipa, vocab_override));
+        }
+    }
+}
+
+// 单词比较用的 key：去标点、ASCII 小写
+static std::string variantKey(const std::string& word) {
+    std::string key = Phonemizer::removePunctuation(word);
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return key;
+}
+
+void Phonemizer::addExplicitVariants(std::vector<WordAnalysis>& words, const std::map<std::string, std::vector<std::string>>& ipa_by_word,
+                                     const Vocab* vocab_override) {
+    if (ipa_by_word.empty()) return;
+
+    std::map<std::string, const std::vector<std::string>*> lookup;
+    for (const auto& kv : ipa_by_word) {
+        lookup[variantKey(kv.first)] = &kv.second;
+    }
+
+    for (auto& wa : words) {
+        auto it = lookup.find(variantKey(wa.word));
+        if (it == lookup.end()) continue;
+        for (const auto& ipa : *it->second) {
+            addVariant(wa, cleanAndTokenizeIPA(ipa, vocab_override));
+        }
+    }
+}
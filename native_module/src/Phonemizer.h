@@ -4,6 +4,22 @@
 #include <vector>
 #include <iostream>
 #include <map>
+#include "Vocab.h"
+
+// 扩展评分的诊断结论
+enum class GopHint {
+    None = 0,     // 未开启扩展评分
+    Correct,      // 目标音素就是 (或接近) 自由识别的最佳音素
+    Substitution, // 有一个竞争音素明显占优，可能读成了别的音
+    Unclear,      // 目标音素得分低，但也没有明确的替代音素 (含糊、噪声)
+};
+
+// 竞争音素 (扩展评分模式)
+struct PhonemeCandidate {
+    std::string ipa;
+    int token_id = -1;
+    float posterior = 0.0f; // 对齐段内的平均后验概率
+};
 
 // 单个音素的详细评分信息 (用于 UI 显示)
 struct PhonemeDetail {
@@ -11,8 +27,16 @@ struct PhonemeDetail {
     int token_id = -1;
     float score = 0.0f;   // GOP 分数
     bool is_good = false; // 是否合格
+    bool is_excellent = false; // 是否优秀
     int start_frame = -1; // 音频起始时间帧
     int end_frame = -1;   // 音频结束时间帧
+
+    // 以下字段只在扩展评分模式 (GopOptions::detailed) 下填充
+    float posterior = 0.0f;                    // 目标音素在对齐段内的平均后验概率
+    float gop_lr = 0.0f;                       // 对数似然比 GOP: 平均 log P(目标) - log P(自由识别最佳音素)，<= 0
+    std::vector<PhonemeCandidate> competitors; // 后验概率最高的 top-k 个其他音素
+    GopHint hint = GopHint::None;
+    std::string substitute_ipa;                // hint 为 Substitution 时的替代音素
 };
 
 // 单词分析结果
@@ -21,22 +45,42 @@ struct WordAnalysis {
     std::string clean_word;           // 清洗后的单词 (用于发音)，如 "Hello"
     std::string raw_ipa;              // espeak 原始输出
     std::vector<std::string> phonemes;// 拆分后的音素列表 (用于 Viterbi 对齐)
+    std::vector<std::vector<std::string>> variants; // 可接受的备选发音 (同样已分词)，对齐时与 phonemes 一起竞争
 
     // 评分详情 (合并 Viterbi 结果后填充此项)
     std::vector<PhonemeDetail> details;
     float word_score = 0.0f;          // 单词平均分
+    int variant = 0;                  // 对齐选中的发音：0 = phonemes，k = variants[k - 1]
+    bool skipped = false;             // 整词漏读 (仅在允许跳词时出现)
 };
 
 class Phonemizer {
 public:
-    Phonemizer(const std::string& espeakDataPath, const std::map<std::string, int>& _vocab, const std::string& voiceName = "en-us");
+    Phonemizer(const std::string& espeakDataPath, const Vocab& _vocab, const std::string& voiceName = "en-us");
     ~Phonemizer();
 
     /**
      * [核心功能] 解析句子
-     * 将句子拆分为单词，并生成每个单词的音素列表
+     * 将句子拆分为单词，并生成每个单词的音素列表。
+     * vocab_override 非空时按它分词 (模型热切换后，请求用它所在模型版本的词表)，否则用构造时的词表。
+     * voice 非空时用这个口音转写 (异步请求用发起时的口音)，否则用当前口音
      */
-    std::vector<WordAnalysis> analyzeText(const std::string& sentence);
+    std::vector<WordAnalysis> analyzeText(const std::string& sentence, const Vocab* vocab_override = nullptr,
+                                          const std::string* voice = nullptr);
+
+    /**
+     * 用其他口音 (如 "en-gb") 再转写一遍句子，把不同的发音加入每个词的 variants。
+     * 口音切换和转写在同一把锁里完成，不影响其他线程的 analyzeText。
+     * base_voice 为标准发音所用的口音 (为空时是当前口音)，voices 里与它相同的跳过
+     */
+    void addVoiceVariants(std::vector<WordAnalysis>& words, const std::string& sentence, const std::vector<std::string>& voices,
+                          const Vocab* vocab_override = nullptr, const std::string* base_voice = nullptr);
+
+    /**
+     * 加入调用方指定的备选发音，key 为单词 (不区分大小写，忽略标点)，value 为 IPA 字符串列表
+     */
+    void addExplicitVariants(std::vector<WordAnalysis>& words, const std::map<std::string, std::vector<std::string>>& ipa_by_word,
+                             const Vocab* vocab_override = nullptr);
 
     // 辅助工具：去除标点符号
     static std::string removePunctuation(const std::string& text);
@@ -47,13 +91,23 @@ public:
     // 保留旧接口用于简单测试
     std::string convertToIPA(const std::string& text);
 
+    // 清洗并拆分 IPA 字符串 (按词表做最大正向匹配)
+    std::vector<std::string> cleanAndTokenizeIPA(const std::string& raw_ipa, const Vocab* vocab_override = nullptr);
+
 private:
     bool initialized = false;
-    const std::map<std::string, int>& vocab;
+    const Vocab& vocab;
+    std::string voice; // 当前口音，临时切换口音后用于恢复
+
+    // 整句转写成单词列表 (只填 word / clean_word / raw_ipa)。voice_override 非空时临时切换口音。
+    // same_voice 非空时，voice_override 与 base_voice (为空时是当前口音) 相同就不转写，返回空列表并置 *same_voice 为 true
+    // (比较在 espeak 锁里做，当前口音可能正被 setVoice 修改)
+    std::vector<WordAnalysis> synthesizeWords(const std::string& sentence, const std::string* voice_override,
+                                              const std::string* base_voice = nullptr, bool* same_voice = nullptr);
 
     // 内部调用 espeak API
     std::string rawEspeakCall(const std::string& text);
+};
 
-    // 清洗并拆分 IPA 字符串
-    std::vector<std::string> cleanAndTokenizeIPA(const std::string& raw_ipa);
-};
\ No newline at end of file
+// cleanAndTokenizeIPA 的实现，不依赖 espeak (工具和校验程序直接用词表分词)
+std::vector<std::string> tokenizeIPA(const std::string& raw_ipa, const Vocab& vocab);
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "Scheduler.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+
+const char* priorityName(Priority priority)
+{
+    switch (priority) {
+    case Priority::Interactive: return "interactive";
+    case Priority::Background: return "background";
+    default: return "unknown";
+    }
+}
+
+bool parsePriority(const std::string& name, Priority& priority)
+{
+    for (int p = 0; p < PRIORITY_COUNT; ++p) {
+        if (name == priorityName((Priority)p)) {
+            priority = (Priority)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+RequestScheduler::RequestScheduler(const SchedulerOptions& options) : options_(options)
+{
+    if (options_.workers < 1) options_.workers = 1;
+    if (options_.max_background_running < 1) options_.max_background_running = 1;
+
+    workers_.reserve(options_.workers);
+    for (int i = 0; i < options_.workers; ++i) {
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+RequestScheduler::~RequestScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+bool RequestScheduler::submit(Priority priority, Task task)
+{
+    int p = (int)priority;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queues_[p].size() >= options_.max_queued[p]) {
+            rejected_[p]++;
+            LOG_WARNING("[Warning] " << priorityName(priority) << " queue is full (" << queues_[p].size() << "), request rejected.");
+            return false;
+        }
+        submitted_[p]++;
+        queues_[p].push_back({ std::move(task), std::chrono::steady_clock::now() });
+    }
+    cv_.notify_one();
+    return true;
+}
+
+int RequestScheduler::nextRunnable() const
+{
+    if (!queues_[(int)Priority::Interactive].empty()) return (int)Priority::Interactive;
+
+    int bg = (int)Priority::Background;
+    if (!queues_[bg].empty() && running_[bg] < (size_t)options_.max_background_running) return bg;
+    return -1;
+}
+
+void RequestScheduler::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        int p = -1;
+        cv_.wait(lock, [&]() {
+            p = nextRunnable();
+            return p >= 0 || (stopping_ && std::all_of(std::begin(queues_), std::end(queues_),
+                                                       [](const std::deque<Entry>& q) { return q.empty(); }));
+        });
+        if (p < 0) return;
+
+        Entry entry = std::move(queues_[p].front());
+        queues_[p].pop_front();
+        running_[p]++;
+        double wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - entry.enqueued).count();
+        wait_[p].add(wait_ms);
+        lock.unlock();
+
+        entry.task(wait_ms);
+
+        lock.lock();
+        running_[p]--;
+        completed_[p]++;
+        // 后台名额空出来了，可能有等着的后台任务
+        cv_.notify_all();
+    }
+}
+
+bool RequestScheduler::idle() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int p = 0; p < PRIORITY_COUNT; ++p) {
+        if (!queues_[p].empty() || running_[p] > 0) return false;
+    }
+    return true;
+}
+
+RequestScheduler::Stats RequestScheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Stats s;
+    s.workers = options_.workers;
+    s.max_background_running = options_.max_background_running;
+    for (int p = 0; p < PRIORITY_COUNT; ++p) {
+        ClassStats& c = s.classes[p];
+        c.queued = queues_[p].size();
+        c.running = running_[p];
+        c.max_queued = options_.max_queued[p];
+        c.submitted = submitted_[p];
+        c.rejected = rejected_[p];
+        c.completed = completed_[p];
+
+        const RollingHistogram& h = wait_[p];
+        c.wait_ms.count = h.count();
+        c.wait_ms.mean = h.mean();
+        c.wait_ms.max = h.max();
+        c.wait_ms.p50 = h.percentile(0.50);
+        c.wait_ms.p95 = h.percentile(0.95);
+        c.wait_ms.p99 = h.percentile(0.99);
+    }
+    return s;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Metrics.h"
+
+// 请求优先级：数值越小越优先
+enum class Priority {
+    Interactive, // 练习页面的实时评分
+    Background,  // 历史重评分等批量任务
+    Count
+};
+
+const int PRIORITY_COUNT = (int)Priority::Count;
+
+const char* priorityName(Priority priority);
+// "interactive" / "background"
+bool parsePriority(const std::string& name, Priority& priority);
+
+struct SchedulerOptions {
+    int workers = 2;                // 工作线程数
+    int max_background_running = 1; // 同时执行的后台任务上限，小于 workers 时交互请求总有空闲线程
+    size_t max_queued[PRIORITY_COUNT] = { 16, 256 }; // 各优先级的排队上限，满了直接拒绝
+};
+
+/**
+ * 带优先级的请求调度器 (线程安全)。
+ * 每个优先级一个有界 FIFO 队列；空闲线程总是先取交互队列，
+ * 所以新到的交互请求排在所有已排队的后台任务前面。
+ * 后台任务同时执行的数量有上限，正在执行的任务不会被打断 (需要时用 CancelToken 取消)。
+ */
+class RequestScheduler {
+public:
+    // wait_ms 为排队等待的时间
+    using Task = std::function<void(double wait_ms)>;
+
+    struct ClassStats {
+        size_t queued = 0;      // 当前排队数
+        size_t running = 0;     // 当前执行数
+        size_t max_queued = 0;  // 排队上限
+        uint64_t submitted = 0;
+        uint64_t rejected = 0;  // 队列满被拒绝
+        uint64_t completed = 0;
+        StageSummary wait_ms;   // 排队等待时间 (最近 1024 个)
+    };
+
+    struct Stats {
+        int workers = 0;
+        int max_background_running = 0;
+        ClassStats classes[PRIORITY_COUNT];
+    };
+
+    explicit RequestScheduler(const SchedulerOptions& options = SchedulerOptions());
+    // 等已排队的任务全部执行完再退出
+    ~RequestScheduler();
+
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    // 入队，队列已满时返回 false (task 不会被执行)
+    bool submit(Priority priority, Task task);
+
+    // 没有排队和正在执行的任务
+    bool idle() const;
+    Stats stats() const;
+    const SchedulerOptions& options() const { return options_; }
+
+private:
+    struct Entry {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    void workerLoop();
+    // 下一个可以执行的优先级，没有时返回 -1 (调用时持锁)
+    int nextRunnable() const;
+
+    SchedulerOptions options_;
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Entry> queues_[PRIORITY_COUNT];
+    size_t running_[PRIORITY_COUNT] = {};
+    uint64_t submitted_[PRIORITY_COUNT] = {};
+    uint64_t rejected_[PRIORITY_COUNT] = {};
+    uint64_t completed_[PRIORITY_COUNT] = {};
+    RollingHistogram wait_[PRIORITY_COUNT];
+    bool stopping_ = false;
+};
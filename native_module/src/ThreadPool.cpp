@@ -0,0 +1,107 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0) threads = 1;
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(packaged));
+    }
+    cv.notify_one();
+    return result;
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& fn, size_t max_workers)
+{
+    if (n == 0) return;
+
+    // 排在队列后面的帮手可能在调用返回之后才开始执行，共享状态用 shared_ptr 保活
+    struct State {
+        std::function<void(size_t)> fn;
+        size_t n;
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->fn = fn;
+    state->n = n;
+
+    auto drain = [](const std::shared_ptr<State>& st) {
+        for (;;) {
+            size_t i = st->next.fetch_add(1);
+            if (i >= st->n) return;
+            try {
+                st->fn(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(st->mutex);
+                if (!st->error) st->error = std::current_exception();
+            }
+            if (st->done.fetch_add(1) + 1 == st->n) {
+                std::lock_guard<std::mutex> lock(st->mutex);
+                st->cv.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(n - 1, size());
+    if (max_workers > 0) helpers = std::min(helpers, max_workers - 1);
+    for (size_t h = 0; h < helpers; ++h) {
+        submit([state, drain]() { drain(state); });
+    }
+
+    drain(state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&]() { return state->done.load() == n; });
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
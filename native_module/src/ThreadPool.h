@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// 固定大小的线程池
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::future<void> submit(std::function<void()> task);
+    size_t size() const { return workers.size(); }
+
+    /**
+     * 并行执行 fn(0) ... fn(n - 1)，最多 max_workers 个线程 (含调用线程，0 表示不限)。
+     * 调用线程自己也领任务，只等待已经开始的任务，所以在池内线程里调用也不会死锁
+     */
+    void parallelFor(size_t n, const std::function<void(size_t)>& fn, size_t max_workers = 0);
+
+    // 进程内共享的池 (硬件线程数)，首次使用时创建
+    static ThreadPool& shared();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+};
@@ -0,0 +1,106 @@
+#include "Thresholds.h"
+#include "Log.h"
+
+#include <filesystem>
+#include <fstream>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+const PhonemeThreshold& ThresholdTable::lookup(std::string_view ipa) const
+{
+    auto it = phonemes_.find(ipa);
+    return it != phonemes_.end() ? it->second : defaults_;
+}
+
+std::shared_ptr<const ThresholdTable> ThresholdTable::builtin()
+{
+    static const std::shared_ptr<const ThresholdTable> table = std::make_shared<ThresholdTable>();
+    return table;
+}
+
+static PhonemeThreshold parseThreshold(const json& j, const PhonemeThreshold& fallback)
+{
+    PhonemeThreshold t = fallback;
+    if (j.contains("excellent")) t.excellent = j["excellent"].get<float>();
+    if (j.contains("good")) t.good = j["good"].get<float>();
+    return t;
+}
+
+bool ThresholdSet::loadFromJson(const std::string& json_path)
+{
+    std::ifstream f(std::filesystem::u8path(json_path));
+    if (!f.is_open()) {
+        LOG_ERROR("[Error] Cannot open thresholds file: " << json_path);
+        return false;
+    }
+
+    std::map<std::string, std::shared_ptr<const ThresholdTable>> loaded;
+    try {
+        json j = json::parse(f);
+        for (auto& lang : j.at("languages").items()) {
+            auto table = std::make_shared<ThresholdTable>();
+            const json& lj = lang.value();
+
+            PhonemeThreshold defaults;
+            if (lj.contains("default")) defaults = parseThreshold(lj["default"], defaults);
+            table->setDefaults(defaults);
+
+            if (lj.contains("phonemes")) {
+                for (auto& ph : lj["phonemes"].items()) {
+                    table->setPhoneme(ph.key(), parseThreshold(ph.value(), defaults));
+                }
+            }
+            loaded[lang.key()] = table;
+        }
+    }
+    catch (json::exception& e) {
+        LOG_ERROR("[Error] Thresholds parse error: " << e.what());
+        return false;
+    }
+
+    tables_ = std::move(loaded);
+    LOG_INFO("[Info] Thresholds loaded for " << tables_.size() << " language(s) from: " << json_path);
+    return true;
+}
+
+bool ThresholdSet::saveToJson(const std::string& json_path) const
+{
+    json languages = json::object();
+    for (const auto& kv : tables_) {
+        const ThresholdTable& table = *kv.second;
+        json lj;
+        lj["default"] = { { "excellent", table.defaults().excellent }, { "good", table.defaults().good } };
+        json phs = json::object();
+        for (const auto& ph : table.phonemes()) {
+            phs[ph.first] = { { "excellent", ph.second.excellent }, { "good", ph.second.good } };
+        }
+        lj["phonemes"] = phs;
+        languages[kv.first] = lj;
+    }
+
+    std::ofstream f(std::filesystem::u8path(json_path));
+    if (!f.is_open()) {
+        LOG_ERROR("[Error] Cannot write thresholds file: " << json_path);
+        return false;
+    }
+    f << json{ { "version", 1 }, { "languages", languages } }.dump(2) << std::endl;
+    return f.good();
+}
+
+std::shared_ptr<const ThresholdTable> ThresholdSet::select(const std::string& language) const
+{
+    auto it = tables_.find(language);
+    if (it != tables_.end()) return it->second;
+
+    // "en-us" -> "en"
+    size_t dash = language.find('-');
+    if (dash != std::string::npos) {
+        it = tables_.find(language.substr(0, dash));
+        if (it != tables_.end()) return it->second;
+    }
+
+    it = tables_.find("default");
+    if (it != tables_.end()) return it->second;
+    return ThresholdTable::builtin();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// 评分的哨兵值 (对数概率尺度，0.0 是满分)
+const float SCORE_FLOOR = -10.0f;      // 最低分：漏读的词、没有对上帧的音素、没有有效音素的词
+const float SCORE_UNDETECTED = -9.0f;  // 不高于它的音素视为没检测到，不参与单词平均分
+
+// 内置的默认阈值 (经验值，没有加载阈值表时使用)
+const float THRESHOLD_EXCELLENT = -1.0f; // > -1.0 优秀
+const float THRESHOLD_GOOD = -2.5f;      // > -2.5 合格
+
+struct PhonemeThreshold {
+    float excellent = THRESHOLD_EXCELLENT;
+    float good = THRESHOLD_GOOD;
+};
+
+/**
+ * 一种口音的阈值表：默认阈值 + 按音素覆盖的阈值。
+ * 构建后只读，用 shared_ptr<const ThresholdTable> 在请求之间共享
+ */
+class ThresholdTable {
+public:
+    const PhonemeThreshold& lookup(std::string_view ipa) const;
+    bool isGood(std::string_view ipa, float score) const { return score > lookup(ipa).good; }
+    bool isExcellent(std::string_view ipa, float score) const { return score > lookup(ipa).excellent; }
+
+    const PhonemeThreshold& defaults() const { return defaults_; }
+    void setDefaults(const PhonemeThreshold& t) { defaults_ = t; }
+    void setPhoneme(const std::string& ipa, const PhonemeThreshold& t) { phonemes_[ipa] = t; }
+    const std::map<std::string, PhonemeThreshold, std::less<>>& phonemes() const { return phonemes_; }
+
+    // 内置默认阈值的表 (所有音素都用 THRESHOLD_GOOD / THRESHOLD_EXCELLENT)
+    static std::shared_ptr<const ThresholdTable> builtin();
+
+private:
+    PhonemeThreshold defaults_;
+    std::map<std::string, PhonemeThreshold, std::less<>> phonemes_;
+};
+
+/**
+ * 按口音组织的阈值表集合，对应 thresholds.json：
+ * {
+ *   "version": 1,
+ *   "languages": {
+ *     "en-us": { "default": { "excellent": -1.0, "good": -2.5 },
+ *                "phonemes": { "θ": { "excellent": -1.4, "good": -3.1 }, ... } },
+ *     "en":    { ... }
+ *   }
+ * }
+ * 某个音素只写了 good 或 excellent 时，另一个沿用该口音的默认值
+ */
+class ThresholdSet {
+public:
+    bool loadFromJson(const std::string& json_path);
+    bool saveToJson(const std::string& json_path) const;
+
+    void set(const std::string& language, std::shared_ptr<const ThresholdTable> table) { tables_[language] = table; }
+    bool empty() const { return tables_.empty(); }
+
+    /**
+     * 选择口音对应的表：先精确匹配 ("en-us")，再匹配语言前缀 ("en")，再找 "default"，
+     * 都没有时返回内置默认表
+     */
+    std::shared_ptr<const ThresholdTable> select(const std::string& language) const;
+
+private:
+    std::map<std::string, std::shared_ptr<const ThresholdTable>> tables_;
+};
@@ -0,0 +1,124 @@
+#include "Transcript.h"
+
+#include <algorithm>
+
+const char* editOpName(EditOp op)
+{
+    switch (op) {
+    case EditOp::Match: return "match";
+    case EditOp::Substitution: return "substitution";
+    case EditOp::Insertion: return "insertion";
+    case EditOp::Deletion: return "deletion";
+    }
+    return "unknown";
+}
+
+float Transcript::phoneErrorRate() const
+{
+    int errors = substitutions + insertions + deletions;
+    if (expected == 0) return errors > 0 ? 1.0f : 0.0f;
+    return (float)errors / expected;
+}
+
+// 期望音素 (只保留词表里有的，与对齐时一致)
+struct ExpectedPhone {
+    int token_id;
+    int word;
+    int phoneme;
+};
+
+Transcript decodeTranscript(const EmissionView& em, const Vocab& vocab, const std::vector<WordAnalysis>& words,
+                            int blank_idx, const TranscriptOptions& options)
+{
+    Transcript out;
+
+    // 1. 解码，去掉非音素 token
+    std::vector<uint8_t> phone_mask = buildPhoneMask(vocab, em.vocab, blank_idx);
+    for (const CtcToken& tok : beamDecode(em, blank_idx, options.beam_width)) {
+        if (tok.token_id < 0 || tok.token_id >= em.vocab || !phone_mask[tok.token_id]) continue;
+        CtcToken shifted = tok;
+        shifted.start_frame += em.frame_offset;
+        shifted.end_frame += em.frame_offset;
+        out.tokens.push_back(shifted);
+        out.phones.push_back(vocab.token(tok.token_id));
+    }
+
+    std::vector<ExpectedPhone> expected;
+    for (size_t w = 0; w < words.size(); ++w) {
+        for (size_t i = 0; i < words[w].phonemes.size(); ++i) {
+            int id = vocab.find(words[w].phonemes[i]);
+            if (id >= 0) expected.push_back({ id, (int)w, (int)i });
+        }
+    }
+    out.expected = (int)expected.size();
+
+    // 2. 编辑距离 (Levenshtein)，dp[i][j] = expected 前 i 个 vs 解码前 j 个
+    const size_t N = expected.size();
+    const size_t M = out.tokens.size();
+    std::vector<int> dp((N + 1) * (M + 1));
+    auto at = [&](size_t i, size_t j) -> int& { return dp[i * (M + 1) + j]; };
+
+    for (size_t i = 0; i <= N; ++i) at(i, 0) = (int)i;
+    for (size_t j = 0; j <= M; ++j) at(0, j) = (int)j;
+    for (size_t i = 1; i <= N; ++i) {
+        for (size_t j = 1; j <= M; ++j) {
+            int sub = at(i - 1, j - 1) + (expected[i - 1].token_id == out.tokens[j - 1].token_id ? 0 : 1);
+            at(i, j) = std::min({ sub, at(i - 1, j) + 1, at(i, j - 1) + 1 });
+        }
+    }
+
+    // 3. 回溯 (同分时优先匹配/替换，其次删除，最后插入)
+    size_t i = N, j = M;
+    while (i > 0 || j > 0) {
+        PhoneEdit e;
+        if (i > 0 && j > 0) {
+            bool same = expected[i - 1].token_id == out.tokens[j - 1].token_id;
+            if (at(i, j) == at(i - 1, j - 1) + (same ? 0 : 1)) {
+                e.op = same ? EditOp::Match : EditOp::Substitution;
+                e.word = expected[i - 1].word;
+                e.phoneme = expected[i - 1].phoneme;
+                e.expected_ipa = words[e.word].phonemes[e.phoneme];
+                e.actual_ipa = out.phones[j - 1];
+                e.start_frame = out.tokens[j - 1].start_frame;
+                e.end_frame = out.tokens[j - 1].end_frame;
+                out.edits.push_back(e);
+                i--;
+                j--;
+                continue;
+            }
+        }
+        if (i > 0 && (j == 0 || at(i, j) == at(i - 1, j) + 1)) {
+            e.op = EditOp::Deletion;
+            e.word = expected[i - 1].word;
+            e.phoneme = expected[i - 1].phoneme;
+            e.expected_ipa = words[e.word].phonemes[e.phoneme];
+            out.edits.push_back(e);
+            i--;
+            continue;
+        }
+        e.op = EditOp::Insertion;
+        e.word = i > 0 ? expected[i - 1].word : (N > 0 ? expected[0].word : -1);
+        e.actual_ipa = out.phones[j - 1];
+        e.start_frame = out.tokens[j - 1].start_frame;
+        e.end_frame = out.tokens[j - 1].end_frame;
+        out.edits.push_back(e);
+        j--;
+    }
+    std::reverse(out.edits.begin(), out.edits.end());
+
+    for (const auto& e : out.edits) {
+        switch (e.op) {
+        case EditOp::Match: out.matches++; break;
+        case EditOp::Substitution: out.substitutions++; break;
+        case EditOp::Insertion: out.insertions++; break;
+        case EditOp::Deletion: out.deletions++; break;
+        }
+    }
+    return out;
+}
+
+bool transcriptMatches(const Transcript& transcript, const PrecheckOptions& options)
+{
+    if (transcript.tokens.empty()) return false; // 静音 (或全是噪声)
+    return transcript.phoneErrorRate() <= options.max_phone_error_rate;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Phonemizer.h" // WordAnalysis
+#include "CtcDecode.h"
+
+// 解码音素与期望音素之间的一步编辑
+enum class EditOp {
+    Match = 0,
+    Substitution, // 期望音素被读成了别的音素
+    Insertion,    // 多读了一个音素
+    Deletion,     // 期望音素没读出来
+};
+
+const char* editOpName(EditOp op);
+
+struct PhoneEdit {
+    EditOp op = EditOp::Match;
+    int word = -1;            // 所属单词 (插入归到前一个期望音素所在的词，开头的插入归到第一个词)
+    int phoneme = -1;         // 在该词 phonemes 里的下标，插入为 -1
+    std::string expected_ipa; // 插入时为空
+    std::string actual_ipa;   // 删除时为空
+    int start_frame = -1;     // 解码出的音素的帧范围，删除时为 -1
+    int end_frame = -1;
+};
+
+struct TranscriptOptions {
+    int beam_width = 1; // 1 = 贪心解码，> 1 = 前缀束搜索
+};
+
+// 自由解码的结果："用户实际读了什么"，以及和参考文本的音素级差异
+struct Transcript {
+    std::vector<CtcToken> tokens;     // 解码出的音素 (已去掉 "|"、<unk> 等非音素 token)
+    std::vector<std::string> phones;  // 对应的 IPA
+    std::vector<PhoneEdit> edits;     // 编辑对齐，按时间顺序 (包含 Match)
+    int expected = 0;                 // 参考文本中能在词表里找到的音素数
+    int matches = 0;
+    int substitutions = 0;
+    int insertions = 0;
+    int deletions = 0;
+
+    // 音素错误率 (S + D + I) / N，N 为期望音素数；可能大于 1
+    float phoneErrorRate() const;
+};
+
+/**
+ * 不做强制对齐，直接从对数概率矩阵解码音素串，再和 words 的标准发音 (phonemes) 做编辑距离对齐。
+ * 开销是一次 O(T x V) 的遍历加 O(N x M) 的编辑距离，远小于 Viterbi
+ */
+Transcript decodeTranscript(const EmissionView& em, const Vocab& vocab, const std::vector<WordAnalysis>& words,
+                            int blank_idx = 0, const TranscriptOptions& options = TranscriptOptions());
+
+// 预检选项：音频明显和文本对不上 (静音、读错句子) 时跳过 calculateGOP
+struct PrecheckOptions {
+    bool enabled = false;
+    float max_phone_error_rate = 0.8f; // 超过它就认为不是这句话
+};
+
+/**
+ * 预检：解码结果是否像在读这句话。解码不出任何音素 (静音) 或音素错误率过高时返回 false
+ */
+bool transcriptMatches(const Transcript& transcript, const PrecheckOptions& options);
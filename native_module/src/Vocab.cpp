@@ -0,0 +1,101 @@
+#include "Vocab.h"
+#include "Log.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <fstream>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+bool Vocab::loadFromJson(const std::string& json_path)
+{
+    std::ifstream f(json_path);
+    if (!f.is_open()) {
+        LOG_ERROR("[Error] Cannot open vocab file: " << json_path);
+        return false;
+    }
+
+    try {
+        json j = json::parse(f);
+        std::map<std::string, int> token_to_id;
+        for (auto& element : j.items()) {
+            token_to_id[element.key()] = element.value();
+        }
+        build(token_to_id);
+        LOG_INFO("[Info] Vocab Loaded. Total tokens: " << size());
+        return true;
+    }
+    catch (json::exception& e) {
+        LOG_ERROR("[Error] JSON parse error: " << e.what());
+        return false;
+    }
+}
+
+void Vocab::build(const std::map<std::string, int>& token_to_id)
+{
+    id_to_token_.clear();
+    byte_lengths_.clear();
+    has_id_.clear();
+    keys_.clear();
+    index_.clear();
+    max_token_bytes_ = 0;
+    fingerprint_ = 0;
+
+    int max_id = -1;
+    size_t total_bytes = 0;
+    for (const auto& kv : token_to_id) {
+        if (kv.second > max_id) max_id = kv.second;
+        total_bytes += kv.first.size();
+    }
+
+    id_to_token_.resize(max_id + 1);
+    byte_lengths_.assign(max_id + 1, 0);
+    has_id_.assign(max_id + 1, 0);
+    keys_.reserve(total_bytes);
+    index_.reserve(token_to_id.size());
+
+    // std::map 已经按字节序排好，直接顺序写入即可得到有序索引
+    for (const auto& kv : token_to_id) {
+        const std::string& tok = kv.first;
+        int id = kv.second;
+
+        index_.push_back({ (uint32_t)keys_.size(), (uint32_t)tok.size(), id });
+        keys_ += tok;
+        max_token_bytes_ = std::max(max_token_bytes_, tok.size());
+
+        if (id < 0) continue;
+        // 多个 token 映射到同一个 id 时，反查保留第一个
+        if (!has_id_[id]) {
+            id_to_token_[id] = tok;
+            byte_lengths_[id] = (uint32_t)tok.size();
+            has_id_[id] = 1;
+        }
+    }
+
+    // 有序的 (token, id) 序列决定了整个词表：索引项带着每个 token 的长度和 id
+    fingerprint_ = hashContent(index_.data(), index_.size() * sizeof(IndexEntry), hashContent(keys_.data(), keys_.size()));
+}
+
+int Vocab::find(std::string_view token) const
+{
+    auto it = std::lower_bound(index_.begin(), index_.end(), token,
+                               [this](const IndexEntry& e, std::string_view key) { return keyOf(e) < key; });
+    if (it != index_.end() && keyOf(*it) == token) {
+        return it->id;
+    }
+    return -1;
+}
+
+const std::string& Vocab::token(int id) const
+{
+    static const std::string unk = "<unk>";
+    if (id < 0 || id >= (int)id_to_token_.size() || !has_id_[id]) return unk;
+    return id_to_token_[id];
+}
+
+size_t Vocab::byteLength(int id) const
+{
+    if (id < 0 || id >= (int)byte_lengths_.size()) return 0;
+    return byte_lengths_[id];
+}
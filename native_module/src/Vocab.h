@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+/**
+ * 只读的扁平词表，loadVocab 时构建一次，之后 Phonemizer 和 Align 共享引用。
+ * - id -> token: 按 id 下标的连续数组
+ * - token -> id: 按字节序排好的扁平索引，string_view 二分查找，查询不分配内存
+ * - 预先计算每个 token 的字节长度和最长 token 的字节数 (给最大正向匹配分词限长)
+ */
+class Vocab {
+public:
+    Vocab() = default;
+
+    // 从 {"token": id, ...} 格式的 vocab.json 构建
+    bool loadFromJson(const std::string& json_path);
+    // 从已有的映射构建 (工具和测试用)
+    void build(const std::map<std::string, int>& token_to_id);
+
+    // 找不到返回 -1
+    int find(std::string_view token) const;
+    bool contains(std::string_view token) const { return find(token) >= 0; }
+
+    // 找不到时返回 "<unk>"
+    const std::string& token(int id) const;
+    // token 的 UTF-8 字节长度，id 无效时返回 0
+    size_t byteLength(int id) const;
+
+    // token 数量
+    size_t size() const { return index_.size(); }
+    bool empty() const { return index_.empty(); }
+    // 最大 id + 1 (id 表的长度)
+    int idCount() const { return (int)id_to_token_.size(); }
+    // 最长 token 的字节数
+    size_t maxTokenBytes() const { return max_token_bytes_; }
+    // 词表内容 (token 和 id) 的指纹，用来校验离线保存的推理结果是否还能用这个词表解释
+    uint64_t fingerprint() const { return fingerprint_; }
+
+private:
+    struct IndexEntry {
+        uint32_t offset; // 在 keys_ 里的起始位置
+        uint32_t length;
+        int id;
+    };
+
+    std::string_view keyOf(const IndexEntry& e) const { return std::string_view(keys_.data() + e.offset, e.length); }
+
+    std::vector<std::string> id_to_token_; // 空洞 id 对应空串
+    std::vector<uint32_t> byte_lengths_;
+    std::vector<uint8_t> has_id_;
+    std::string keys_;                     // 所有 token 按排序后的顺序首尾相接
+    std::vector<IndexEntry> index_;        // 按 token 字节序排序
+    size_t max_token_bytes_ = 0;
+    uint64_t fingerprint_ = 0;
+};
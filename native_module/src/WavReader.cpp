@@ -0,0 +1,63 @@
+#include "WavReader.h"
+#include "MappedFile.h"
+#include "Log.h"
+
+#include <vector>
+
+// dr_wav 的实现放在这里，整个模块只能有一个翻译单元定义它
+#define DR_WAV_IMPLEMENTATION
+#include "dr_wav.h"
+
+bool streamWavFile(const std::string& path, ModelRunner& runner, size_t block_frames)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    file.adviseSequential();
+
+    // 直接在映射内存上解析，不经过 fread 拷贝
+    drwav wav;
+    if (!drwav_init_memory(&wav, file.data(), file.size(), NULL)) {
+        LOG_ERROR("[Error] Not a valid WAV file: " << path);
+        return false;
+    }
+
+    if (wav.channels == 0 || wav.sampleRate == 0) {
+        LOG_ERROR("[Error] Invalid WAV format: " << path);
+        drwav_uninit(&wav);
+        return false;
+    }
+
+    if (block_frames == 0) block_frames = WAV_STREAM_BLOCK_FRAMES;
+    std::vector<float> block(block_frames * wav.channels);
+
+    runner.beginAudioStream(wav.sampleRate, wav.channels, (size_t)wav.totalPCMFrameCount);
+
+    for (;;) {
+        drwav_uint64 got = drwav_read_pcm_frames_f32(&wav, block_frames, block.data());
+        if (got == 0) break;
+
+        runner.appendAudioFrames(block.data(), (size_t)got);
+
+        // 已经解码过的页不会再访问，归还给系统
+        file.releaseBefore((size_t)wav.memoryStream.currentReadPos);
+    }
+
+    drwav_uninit(&wav);
+    runner.endAudioStream();
+    return true;
+}
+
+bool readWavFormat(const void* data, size_t size, WavFormat& format)
+{
+    drwav wav;
+    if (!drwav_init_memory(&wav, data, size, NULL)) {
+        return false;
+    }
+    format.sample_rate = wav.sampleRate;
+    format.channels = wav.channels;
+    format.frames = wav.totalPCMFrameCount;
+    drwav_uninit(&wav);
+    return format.sample_rate > 0 && format.channels > 0;
+}
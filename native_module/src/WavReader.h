@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "ModelRunner.h"
+
+// 每次解码的帧数 (源采样率下)。4096 帧 * 8 声道 * 4 字节 = 128KB，足够摊薄调用开销
+const size_t WAV_STREAM_BLOCK_FRAMES = 4096;
+
+/**
+ * 以内存映射 + 分块解码的方式读取 WAV 文件，并直接送入 runner 的流式前端。
+ * 支持 dr_wav 能解码的所有格式 (PCM16/PCM24/PCM32/Float32/A-law/μ-law)。
+ * 峰值内存只有一个解码块 + 最终 16k 单声道缓冲，而不是整段解码后的多份拷贝。
+ *
+ * @param path: WAV 文件路径 (UTF-8)
+ * @param runner: 接收音频的模型运行器
+ * @return: true 表示成功
+ */
+bool streamWavFile(const std::string& path, ModelRunner& runner, size_t block_frames = WAV_STREAM_BLOCK_FRAMES);
+
+// WAV 文件头里的格式
+struct WavFormat {
+    unsigned int sample_rate = 0;
+    unsigned int channels = 0;
+    uint64_t frames = 0; // 源采样率下的帧数，文件头没有写明时为 0
+};
+
+/**
+ * 只解析文件头，不解码样本 (已经映射到内存的文件)。用来在解码之前预估请求的代价
+ * @return: 不是有效的 WAV 时返回 false
+ */
+bool readWavFormat(const void* data, size_t size, WavFormat& format);
@@ -0,0 +1,75 @@
+#include "Waveform.h"
+#include "AudioFrontEnd.h"
+
+#include <algorithm>
+#include <cmath>
+
+static_assert(MODEL_FRAME_STRIDE % PeakPyramid::BASE_BLOCK == 0, "peak blocks must tile the model frame grid");
+
+size_t PeakPyramid::bytes() const
+{
+    size_t total = 0;
+    for (const auto& level : levels) total += level.size() * sizeof(float);
+    return total;
+}
+
+size_t AudioSummary::bytes() const
+{
+    return peaks.bytes() + energy_db.size() * sizeof(float);
+}
+
+void buildAudioSummary(const float* audio, size_t n, AudioSummary& out)
+{
+    PeakPyramid& peaks = out.peaks;
+    peaks.samples = n;
+    peaks.levels.clear();
+    out.energy_db.clear();
+    if (n == 0) return;
+
+    // 1. 最细一层直接扫样本，顺带累计每块的平方和
+    const size_t block = PeakPyramid::BASE_BLOCK;
+    size_t blocks = (n + block - 1) / block;
+    std::vector<float> base(2 * blocks);
+    std::vector<double> energy(blocks);
+    for (size_t b = 0; b < blocks; ++b) {
+        const float* first = audio + b * block;
+        const float* last = audio + std::min(n, (b + 1) * block);
+        float lo = *first, hi = *first;
+        double sq = 0.0;
+        for (const float* p = first; p < last; ++p) {
+            lo = std::min(lo, *p);
+            hi = std::max(hi, *p);
+            sq += (double)*p * *p;
+        }
+        base[2 * b] = lo;
+        base[2 * b + 1] = hi;
+        energy[b] = sq;
+    }
+    peaks.levels.push_back(std::move(base));
+
+    // 2. 往上每层把下一层的相邻两块合并，直到只剩一块 (总大小不超过最细一层的两倍)
+    while (peaks.levels.back().size() > 2) {
+        const std::vector<float>& below = peaks.levels.back();
+        size_t below_blocks = below.size() / 2;
+        size_t up_blocks = (below_blocks + 1) / 2;
+        std::vector<float> up(2 * up_blocks);
+        for (size_t b = 0; b < up_blocks; ++b) {
+            size_t i = 2 * b;
+            size_t j = std::min(i + 1, below_blocks - 1);
+            up[2 * b] = std::min(below[2 * i], below[2 * j]);
+            up[2 * b + 1] = std::max(below[2 * i + 1], below[2 * j + 1]);
+        }
+        peaks.levels.push_back(std::move(up));
+    }
+
+    // 3. 每个模型帧合并它步长内的几块 (帧都落在音频范围内，块都是满的)
+    const size_t per_frame = MODEL_FRAME_STRIDE / block;
+    size_t frames = framesForSamples(n);
+    out.energy_db.resize(frames);
+    for (size_t t = 0; t < frames; ++t) {
+        double sq = 0.0;
+        for (size_t k = 0; k < per_frame; ++k) sq += energy[t * per_frame + k];
+        double mean = sq / MODEL_FRAME_STRIDE;
+        out.energy_db[t] = mean > 0.0 ? std::max(ENERGY_FLOOR_DB, (float)(10.0 * std::log10(mean))) : ENERGY_FLOOR_DB;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * 16k 单声道音频的多分辨率 min/max 包络 (界面画波形用)。
+ * 第 k 层每 BASE_BLOCK << k 个样本一块，每块一对 (min, max) 交错存放，末尾一块可能不满；
+ * 最上层只有一块。界面取块数不少于像素宽度的最粗一层，每个像素只合并一两块
+ */
+struct PeakPyramid {
+    static constexpr unsigned int BASE_BLOCK = 160; // 10 ms，一个模型帧 (MODEL_FRAME_STRIDE) 正好两块
+
+    uint64_t samples = 0;                   // 16k 样本数
+    std::vector<std::vector<float>> levels; // levels[0] 最细
+
+    size_t bytes() const;
+};
+
+// 能量轮廓的下限 (dBFS)，全零的帧取这个值
+const float ENERGY_FLOOR_DB = -100.0f;
+
+/**
+ * 前端顺带算出的音频概要 (归一化之前，保留原始幅度)，随推理结果一起缓存。
+ * 只扫一遍样本：波形包络的最细一层和能量轮廓在同一个循环里累计
+ */
+struct AudioSummary {
+    PeakPyramid peaks;
+    // 每个模型帧一个值：第 t 帧步长 [t * MODEL_FRAME_STRIDE, (t + 1) * MODEL_FRAME_STRIDE) 内的 RMS 能量 (dBFS)，
+    // 长度为 framesForSamples(samples)
+    std::vector<float> energy_db;
+
+    size_t bytes() const;
+};
+
+// 在归一化之前调用 (音量小的录音画出来也小，能量也是真实的)
+void buildAudioSummary(const float* audio, size_t n, AudioSummary& out);
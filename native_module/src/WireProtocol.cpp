@@ -0,0 +1,259 @@
+#include "WireProtocol.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+const char* wireStatusName(WireStatus status)
+{
+    switch (status) {
+    case WireStatus::Ok: return "ok";
+    case WireStatus::BadRequest: return "bad_request";
+    case WireStatus::Busy: return "busy";
+    case WireStatus::Failed: return "failed";
+    case WireStatus::TooLarge: return "too_large";
+    default: return "unknown";
+    }
+}
+
+namespace {
+
+// 按字节拼小端序，不依赖主机字节序
+class WireWriter {
+public:
+    explicit WireWriter(std::vector<uint8_t>& out) : out_(out) { out_.clear(); }
+
+    void u8(uint8_t v) { out_.push_back(v); }
+    void u16(uint16_t v) { for (int i = 0; i < 2; ++i) out_.push_back((uint8_t)(v >> (8 * i))); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; ++i) out_.push_back((uint8_t)(v >> (8 * i))); }
+    void i32(int32_t v) { u32((uint32_t)v); }
+    void f32(float v)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        u32(bits);
+    }
+    void bytes(const std::string& s) { out_.insert(out_.end(), s.begin(), s.end()); }
+
+private:
+    std::vector<uint8_t>& out_;
+};
+
+// 越界读取会让 ok() 变为 false，之后的读取都返回 0
+class WireReader {
+public:
+    WireReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool ok() const { return ok_; }
+    size_t remaining() const { return size_ - pos_; }
+
+    uint8_t u8() { return need(1) ? data_[pos_++] : 0; }
+    uint16_t u16()
+    {
+        if (!need(2)) return 0;
+        uint16_t v = (uint16_t)(data_[pos_] | (data_[pos_ + 1] << 8));
+        pos_ += 2;
+        return v;
+    }
+    uint32_t u32()
+    {
+        if (!need(4)) return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= (uint32_t)data_[pos_ + i] << (8 * i);
+        pos_ += 4;
+        return v;
+    }
+    int32_t i32() { return (int32_t)u32(); }
+    float f32()
+    {
+        uint32_t bits = u32();
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+    std::string bytes(size_t n)
+    {
+        if (!need(n)) return std::string();
+        std::string s((const char*)data_ + pos_, n);
+        pos_ += n;
+        return s;
+    }
+
+private:
+    bool need(size_t n)
+    {
+        if (!ok_ || size_ - pos_ < n) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+} // namespace
+
+bool encodeRequest(const WireRequest& request, std::vector<uint8_t>& body)
+{
+    // 截断文本会让服务端给另一句话打分，直接拒绝
+    if (request.text.size() > WIRE_MAX_TEXT_BYTES) return false;
+
+    WireWriter w(body);
+    body.reserve(28 + request.pcm.size() * sizeof(float) + request.text.size());
+    w.u32(WIRE_REQUEST_MAGIC);
+    w.u16(WIRE_VERSION);
+    w.u16(request.flags);
+    w.u32(request.request_id);
+    w.u32(request.sample_rate);
+    w.u16(request.channels);
+    w.u16((uint16_t)request.text.size());
+    w.u32((uint32_t)request.pcm.size());
+    for (float v : request.pcm) w.f32(v);
+    w.bytes(request.text);
+    return true;
+}
+
+bool decodeRequest(const uint8_t* data, size_t size, WireRequest& request)
+{
+    WireReader r(data, size);
+    if (r.u32() != WIRE_REQUEST_MAGIC || r.u16() != WIRE_VERSION) return false;
+    request.flags = r.u16();
+    request.request_id = r.u32();
+    request.sample_rate = r.u32();
+    request.channels = r.u16();
+    uint16_t text_bytes = r.u16();
+    uint32_t sample_count = r.u32();
+    if (!r.ok() || r.remaining() != (size_t)sample_count * sizeof(float) + text_bytes) return false;
+
+    request.pcm.resize(sample_count);
+    for (uint32_t i = 0; i < sample_count; ++i) request.pcm[i] = r.f32();
+    request.text = r.bytes(text_bytes);
+    return r.ok();
+}
+
+void encodeResponse(const WireResponse& response, std::vector<uint8_t>& body)
+{
+    WireWriter w(body);
+    w.u32(WIRE_RESPONSE_MAGIC);
+    w.u16(WIRE_VERSION);
+    w.u16((uint16_t)response.status);
+    w.u32(response.request_id);
+
+    if (response.status != WireStatus::Ok) {
+        std::string message = response.error.substr(0, 0xFFFF);
+        w.u16((uint16_t)message.size());
+        w.bytes(message);
+        return;
+    }
+
+    w.f32(response.overall_score);
+    w.f32(response.server_ms);
+    w.f32(response.queue_ms);
+    w.u32(response.frames);
+    w.u16(response.flags);
+    w.u16((uint16_t)response.words.size());
+    for (const auto& word : response.words) {
+        std::string text = word.word.substr(0, 0xFFFF);
+        w.f32(word.score);
+        w.u8(word.flags);
+        w.u8(word.variant);
+        w.u16((uint16_t)word.phonemes.size());
+        w.u16((uint16_t)text.size());
+        w.bytes(text);
+        for (const auto& p : word.phonemes) {
+            std::string ipa = p.ipa.substr(0, 0xFF);
+            w.f32(p.score);
+            w.i32(p.start_frame);
+            w.i32(p.end_frame);
+            w.u8(p.flags);
+            w.u8((uint8_t)ipa.size());
+            w.bytes(ipa);
+        }
+    }
+}
+
+bool decodeResponse(const uint8_t* data, size_t size, WireResponse& response)
+{
+    WireReader r(data, size);
+    if (r.u32() != WIRE_RESPONSE_MAGIC || r.u16() != WIRE_VERSION) return false;
+    response.status = (WireStatus)r.u16();
+    response.request_id = r.u32();
+    response.words.clear();
+
+    if (response.status != WireStatus::Ok) {
+        response.error = r.bytes(r.u16());
+        return r.ok();
+    }
+
+    response.overall_score = r.f32();
+    response.server_ms = r.f32();
+    response.queue_ms = r.f32();
+    response.frames = r.u32();
+    response.flags = r.u16();
+    uint16_t word_count = r.u16();
+    response.words.resize(word_count);
+    for (auto& word : response.words) {
+        word.score = r.f32();
+        word.flags = r.u8();
+        word.variant = r.u8();
+        uint16_t phoneme_count = r.u16();
+        word.word = r.bytes(r.u16());
+        word.phonemes.resize(phoneme_count);
+        for (auto& p : word.phonemes) {
+            p.score = r.f32();
+            p.start_frame = r.i32();
+            p.end_frame = r.i32();
+            p.flags = r.u8();
+            p.ipa = r.bytes(r.u8());
+        }
+        if (!r.ok()) return false;
+    }
+    return r.ok();
+}
+
+// 读满 size 字节，EINTR 时重试
+static bool readAll(int fd, uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+bool readFrame(int fd, std::vector<uint8_t>& body)
+{
+    uint8_t prefix[4];
+    if (!readAll(fd, prefix, sizeof(prefix))) return false;
+    uint32_t length = (uint32_t)prefix[0] | ((uint32_t)prefix[1] << 8) | ((uint32_t)prefix[2] << 16) | ((uint32_t)prefix[3] << 24);
+    if (length > WIRE_MAX_FRAME_BYTES) return false;
+
+    body.resize(length);
+    return readAll(fd, body.data(), length);
+}
+
+bool writeFrame(int fd, const std::vector<uint8_t>& body)
+{
+    uint32_t length = (uint32_t)body.size();
+    uint8_t prefix[4] = { (uint8_t)length, (uint8_t)(length >> 8), (uint8_t)(length >> 16), (uint8_t)(length >> 24) };
+    return writeAll(fd, prefix, sizeof(prefix)) && writeAll(fd, body.data(), body.size());
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * speech_daemon 的本地套接字协议 (v1)。所有整数和浮点数都是小端序。
+ * 每条消息是一个帧：u32 body 字节数 + body。一个连接上可以顺序发送多条请求，
+ * 服务端按顺序逐条回复 (同一连接内不乱序)。
+ *
+ * 请求 body:
+ *   u32 magic 'SPRQ' | u16 version | u16 flags | u32 request_id
+ *   u32 sample_rate | u16 channels | u16 text_bytes | u32 sample_count
+ *   f32[sample_count] 交错 PCM | u8[text_bytes] UTF-8 参考文本
+ *
+ * 响应 body:
+ *   u32 magic 'SPRS' | u16 version | u16 status | u32 request_id
+ *   status != Ok: u16 message_bytes | message
+ *   status == Ok: f32 overall_score | f32 server_ms | f32 queue_ms | u32 frames | u16 flags | u16 word_count
+ *     每个词:   f32 score | u8 flags | u8 variant | u16 phoneme_count | u16 word_bytes | word
+ *     每个音素: f32 score | i32 start_frame | i32 end_frame | u8 flags | u8 ipa_bytes | ipa
+ */
+
+const uint32_t WIRE_REQUEST_MAGIC = 0x51525053;  // "SPRQ"
+const uint32_t WIRE_RESPONSE_MAGIC = 0x53525053; // "SPRS"
+const uint16_t WIRE_VERSION = 1;
+// 单帧上限：64 MB 约合 16k 单声道 float 17 分钟，课堂录音远小于此；超过直接断开连接
+const uint32_t WIRE_MAX_FRAME_BYTES = 64u * 1024 * 1024;
+// 请求参考文本的上限 (text_bytes 字段是 u16)
+const size_t WIRE_MAX_TEXT_BYTES = 0xFFFF;
+
+// 请求 flags
+const uint16_t WIRE_FLAG_SEGMENTED = 1 << 0; // 长段落分段并行对齐
+const uint16_t WIRE_FLAG_PRECHECK = 1 << 1;  // 自由解码预检，对不上时不做对齐
+
+// 响应 flags
+const uint16_t WIRE_RESULT_MISMATCH = 1 << 0; // 预检失败，所有音素记最低分
+
+// 词 / 音素 flags
+const uint8_t WIRE_WORD_SKIPPED = 1 << 0;
+const uint8_t WIRE_PHONEME_GOOD = 1 << 0;
+const uint8_t WIRE_PHONEME_EXCELLENT = 1 << 1;
+
+enum class WireStatus : uint16_t {
+    Ok = 0,
+    BadRequest = 1, // 帧格式错误或参数不合法
+    Busy = 2,       // 服务端队列已满，稍后重试
+    Failed = 3,     // 推理或对齐失败
+    TooLarge = 4,   // 预估的内存或耗时超出服务端的单请求预算，重试也不会成功
+};
+
+const char* wireStatusName(WireStatus status);
+
+struct WireRequest {
+    uint32_t request_id = 0;
+    uint16_t flags = 0;
+    uint32_t sample_rate = 16000;
+    uint16_t channels = 1;
+    std::vector<float> pcm; // 交错样本
+    std::string text;
+};
+
+struct WirePhoneme {
+    std::string ipa;
+    float score = 0.0f;
+    int32_t start_frame = -1;
+    int32_t end_frame = -1;
+    uint8_t flags = 0;
+};
+
+struct WireWord {
+    std::string word;
+    float score = 0.0f;
+    uint8_t flags = 0;
+    uint8_t variant = 0;
+    std::vector<WirePhoneme> phonemes;
+};
+
+struct WireResponse {
+    uint32_t request_id = 0;
+    WireStatus status = WireStatus::Ok;
+    std::string error;        // status != Ok 时的说明
+    float overall_score = 0.0f;
+    float server_ms = 0.0f;   // 服务端从收到到算完的耗时 (含排队)
+    float queue_ms = 0.0f;    // 排队等待工作线程的时间
+    uint32_t frames = 0;
+    uint16_t flags = 0;
+    std::vector<WireWord> words;
+};
+
+// 编码成 body (不含长度前缀)。参考文本超过 WIRE_MAX_TEXT_BYTES 时不编码，返回 false
+bool encodeRequest(const WireRequest& request, std::vector<uint8_t>& body);
+void encodeResponse(const WireResponse& response, std::vector<uint8_t>& body);
+
+// 解码 body，格式不对 (magic/版本/长度) 时返回 false
+bool decodeRequest(const uint8_t* data, size_t size, WireRequest& request);
+bool decodeResponse(const uint8_t* data, size_t size, WireResponse& response);
+
+// 阻塞读写一个完整的帧 (POSIX 套接字)。对端关闭、出错或帧超过上限时返回 false
+bool readFrame(int fd, std::vector<uint8_t>& body);
+bool writeFrame(int fd, const std::vector<uint8_t>& body);
@@ -1,26 +1,81 @@
 #include <napi.h>
-#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
-#include <windows.h> // 用于路径转换
+#include <map>
 
 // 引入你的核心类
 #include "ModelRunner.h"
+#include "ModelStore.h"
+#include "ModelRegistry.h"
 #include "Phonemizer.h"
 #include "Align.h"
-#define DR_WAV_IMPLEMENTATION
-#include "dr_wav.h"
+#include "AudioClip.h"
+#include "Fluency.h"
+#include "CostModel.h"
+#include "Transcript.h"
+#include "WavReader.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include "EmissionCache.h"
+#include "EmissionFile.h"
+#include "Metrics.h"
+#include "Cancel.h"
+#include "Scheduler.h"
+#include "Log.h"
 
-// 辅助函数: string (UTF-8) 转 wstring (Windows Unicode)
-std::wstring s2ws(const std::string &str)
+// 每个 JS 环境 (主进程 / worker) 一份的插件数据
+struct AddonData
 {
-    if (str.empty())
-        return std::wstring();
-    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
-    std::wstring wstrTo(size_needed, 0);
-    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
-    return wstrTo;
-}
+    Napi::FunctionReference speechEngine;
+    Napi::FunctionReference cancelToken;
+};
+
+// ==========================================
+// CancelToken：JS 侧的取消令牌
+// const token = new CancelToken(); engine.analyzeAsync(..., { cancelToken: token }); token.cancel()
+// 一个令牌可以同时传给多个请求，取消后不能复用
+// ==========================================
+class JsCancelToken : public Napi::ObjectWrap<JsCancelToken>
+{
+public:
+    static void Init(Napi::Env env, Napi::Object exports, AddonData *data)
+    {
+        Napi::Function func = DefineClass(env, "CancelToken", {
+                                                                  InstanceMethod("cancel", &JsCancelToken::Cancel),
+                                                                  InstanceMethod("isCancelled", &JsCancelToken::IsCancelled),
+                                                                  InstanceMethod("reason", &JsCancelToken::Reason),
+                                                              });
+        data->cancelToken = Napi::Persistent(func);
+        exports.Set("CancelToken", func);
+    }
+
+    JsCancelToken(const Napi::CallbackInfo &info) : Napi::ObjectWrap<JsCancelToken>(info) {}
+
+    // 正在进行的请求持有 shared_ptr，JS 对象被回收不影响它们
+    std::shared_ptr<CancelToken> token() const { return token_; }
+
+private:
+    std::shared_ptr<CancelToken> token_ = std::make_shared<CancelToken>();
+
+    Napi::Value Cancel(const Napi::CallbackInfo &info)
+    {
+        token_->cancel();
+        return info.Env().Undefined();
+    }
+    Napi::Value IsCancelled(const Napi::CallbackInfo &info)
+    {
+        return Napi::Boolean::New(info.Env(), token_->isCancelled());
+    }
+    // "none" / "cancelled" / "deadline_exceeded"
+    Napi::Value Reason(const Napi::CallbackInfo &info)
+    {
+        return Napi::String::New(info.Env(), cancelReasonName(token_->reason()));
+    }
+};
 
 // ==========================================
 // SpeechEngine 类定义
@@ -29,23 +84,41 @@ class SpeechEngine : public Napi::ObjectWrap<SpeechEngine>
 {
 public:
     // 初始化函数：定义 JS 类结构
-    static Napi::Object Init(Napi::Env env, Napi::Object exports)
+    static Napi::Object Init(Napi::Env env, Napi::Object exports, AddonData *data)
     {
         Napi::Function func = DefineClass(env, "SpeechEngine", {// 定义暴露给 JS 的方法名和对应的 C++ 函数
                                                                 InstanceMethod("analyze", &SpeechEngine::Analyze),
+                                                                InstanceMethod("analyzeAsync", &SpeechEngine::AnalyzeAsync),
                                                                 InstanceMethod("phonemize", &SpeechEngine::Phonemize),
+                                                                InstanceMethod("sliceWords", &SpeechEngine::SliceWords),
                                                                 InstanceMethod("setLanguage", &SpeechEngine::SetLanguage),
+                                                                InstanceMethod("getStats", &SpeechEngine::GetStats),
+                                                                InstanceMethod("resetStats", &SpeechEngine::ResetStats),
+                                                                InstanceMethod("setLogLevel", &SpeechEngine::SetLogLevel),
+                                                                InstanceMethod("startProfiling", &SpeechEngine::StartProfiling),
+                                                                InstanceMethod("stopProfiling", &SpeechEngine::StopProfiling),
+                                                                InstanceMethod("getProfileReport", &SpeechEngine::GetProfileReport),
+                                                                InstanceMethod("rescore", &SpeechEngine::Rescore),
+                                                                InstanceMethod("rescoreAsync", &SpeechEngine::RescoreAsync),
+                                                                InstanceMethod("setCacheLimits", &SpeechEngine::SetCacheLimits),
+                                                                InstanceMethod("clearCache", &SpeechEngine::ClearCache),
+                                                                InstanceMethod("saveEmissions", &SpeechEngine::SaveEmissions),
+                                                                InstanceMethod("analyzeEmissions", &SpeechEngine::AnalyzeEmissions),
+                                                                InstanceMethod("analyzeEmissionsAsync", &SpeechEngine::AnalyzeEmissionsAsync),
+                                                                InstanceMethod("loadThresholds", &SpeechEngine::LoadThresholds),
+                                                                InstanceMethod("reloadModel", &SpeechEngine::ReloadModel),
+                                                                InstanceMethod("registerModel", &SpeechEngine::RegisterModel),
+                                                                InstanceMethod("setModelMemoryBudget", &SpeechEngine::SetModelMemoryBudget),
                                                                 });
 
-        Napi::FunctionReference *constructor = new Napi::FunctionReference();
-        *constructor = Napi::Persistent(func);
-        env.SetInstanceData(constructor);
-
+        data->speechEngine = Napi::Persistent(func);
         exports.Set("SpeechEngine", func);
         return exports;
     }
 
-    // 构造函数：对应 JS 的 new SpeechEngine(...)
+    // 构造函数：对应 JS 的 new SpeechEngine(modelPath, vocabPath, espeakPath, [options])
+    // options: { intraOpThreads, backgroundIntraOpThreads, workers, maxBackgroundRunning, maxInteractiveQueue, maxBackgroundQueue,
+    //            modelMemoryBudgetMB, maxRequestMemoryMB, maxRequestMs, overBudget: 'degrade' | 'reject' }
     SpeechEngine(const Napi::CallbackInfo &info) : Napi::ObjectWrap<SpeechEngine>(info)
     {
         Napi::Env env = info.Env();
@@ -60,22 +133,85 @@ public:
         std::string vocabPath = info[1].As<Napi::String>();
         std::string espeakPath = info[2].As<Napi::String>();
 
+        int intraOpThreads = 1;
+        int backgroundIntraOpThreads = 0;
+        size_t modelMemoryBudget = 0;
+        SchedulerOptions schedulerOptions;
+        if (info.Length() >= 4 && info[3].IsObject())
+        {
+            Napi::Object obj = info[3].As<Napi::Object>();
+            if (obj.Has("intraOpThreads") && obj.Get("intraOpThreads").IsNumber())
+            {
+                intraOpThreads = obj.Get("intraOpThreads").As<Napi::Number>().Int32Value();
+            }
+            if (obj.Has("backgroundIntraOpThreads") && obj.Get("backgroundIntraOpThreads").IsNumber())
+            {
+                backgroundIntraOpThreads = obj.Get("backgroundIntraOpThreads").As<Napi::Number>().Int32Value();
+            }
+            if (obj.Has("workers") && obj.Get("workers").IsNumber())
+            {
+                schedulerOptions.workers = obj.Get("workers").As<Napi::Number>().Int32Value();
+            }
+            if (obj.Has("maxBackgroundRunning") && obj.Get("maxBackgroundRunning").IsNumber())
+            {
+                schedulerOptions.max_background_running = obj.Get("maxBackgroundRunning").As<Napi::Number>().Int32Value();
+            }
+            if (obj.Has("maxInteractiveQueue") && obj.Get("maxInteractiveQueue").IsNumber())
+            {
+                schedulerOptions.max_queued[(int)Priority::Interactive] = obj.Get("maxInteractiveQueue").As<Napi::Number>().Uint32Value();
+            }
+            if (obj.Has("maxBackgroundQueue") && obj.Get("maxBackgroundQueue").IsNumber())
+            {
+                schedulerOptions.max_queued[(int)Priority::Background] = obj.Get("maxBackgroundQueue").As<Napi::Number>().Uint32Value();
+            }
+            if (obj.Has("modelMemoryBudgetMB") && obj.Get("modelMemoryBudgetMB").IsNumber())
+            {
+                double mb = obj.Get("modelMemoryBudgetMB").As<Napi::Number>().DoubleValue();
+                modelMemoryBudget = mb > 0 ? (size_t)(mb * 1024 * 1024) : 0;
+            }
+            if (obj.Has("maxRequestMemoryMB") && obj.Get("maxRequestMemoryMB").IsNumber())
+            {
+                double mb = obj.Get("maxRequestMemoryMB").As<Napi::Number>().DoubleValue();
+                admission_.max_bytes = mb > 0 ? (uint64_t)(mb * 1024 * 1024) : 0;
+            }
+            if (obj.Has("maxRequestMs") && obj.Get("maxRequestMs").IsNumber())
+            {
+                admission_.max_ms = obj.Get("maxRequestMs").As<Napi::Number>().DoubleValue();
+            }
+            if (obj.Has("overBudget") && obj.Get("overBudget").IsString())
+            {
+                admission_.degrade = obj.Get("overBudget").As<Napi::String>().Utf8Value() != "reject";
+            }
+        }
+
         try
         {
-            // 1. 初始化 ASR
-            engine_ = new ModelRunner();
-            engine_->loadModel(s2ws(modelPath));
-            if (!engine_->loadVocab(vocabPath))
+            // 1. 初始化 ASR：模型版本由 models_ 管理，engine_ 是同步调用用的 runner (共享当前版本)
+            ModelSource source;
+            source.model_path = modelPath;
+            source.vocab_path = vocabPath;
+            source.intra_threads = intraOpThreads;
+            source.background_intra_threads = backgroundIntraOpThreads;
+            if (!models_.load(source))
             {
-                throw std::runtime_error("Failed to load vocab");
+                throw std::runtime_error("Failed to load model or vocab");
             }
+            engine_ = new ModelRunner();
+            std::shared_ptr<const ModelRunner> initial = models_.acquire();
+            engine_->shareModelFrom(*initial);
+            engine_model_ = initial;
+            registry_.setBudget(modelMemoryBudget);
 
-            // 2. 初始化 G2P
-            phonemizer_ = new Phonemizer(espeakPath, engine_->getVocab(), "en-us");
+            // 2. 初始化 G2P。构造时的词表一直保留，之后的请求都按各自模型版本的词表分词
+            phonemizer_vocab_ = engine_->shareVocab();
+            phonemizer_ = new Phonemizer(espeakPath, *phonemizer_vocab_, language_);
             if (!phonemizer_->isInitialized())
             {
                 throw std::runtime_error("Failed to initialize Espeak");
             }
+
+            // 3. 异步请求的调度器
+            scheduler_ = std::make_unique<RequestScheduler>(schedulerOptions);
         }
         catch (const std::exception &e)
         {
@@ -86,6 +222,8 @@ public:
     // 析构函数：JS 对象被回收时调用，释放 C++ 内存
     ~SpeechEngine()
     {
+        // 异步请求持有引擎对象的引用，走到这里时调度器已经空闲，先停掉它的线程
+        scheduler_.reset();
         if (engine_)
         {
             delete engine_;
@@ -99,11 +237,289 @@ public:
     }
 
 private:
+    ModelStore models_;       // 默认模型的当前版本，reloadModel 在后台加载后原子替换
+    ModelRegistry registry_;  // 按语言注册的其他模型 (registerModel)，首次使用时加载，超出内存预算时淘汰
     ModelRunner *engine_ = nullptr;
+    std::weak_ptr<const ModelRunner> engine_model_; // engine_ 当前共享的模型版本
     Phonemizer *phonemizer_ = nullptr;
+    std::shared_ptr<const Vocab> phonemizer_vocab_; // Phonemizer 构造时引用的词表，模型切换后仍要保活
+    PipelineStats stats_;
+    std::unique_ptr<RequestScheduler> scheduler_; // analyzeAsync 等异步请求按优先级排队执行
+    EmissionCache cache_; // 按音频内容哈希缓存的对数概率矩阵，rescore 直接复用
+    ThresholdSet thresholds_;                            // 按口音的阈值表 (loadThresholds 加载)
+    std::shared_ptr<const ThresholdTable> active_thresholds_ = ThresholdTable::builtin(); // 当前口音对应的表
+    std::string language_ = "en-us";
+    AdmissionPolicy admission_; // 单个请求的内存 / 耗时预算
+    CostModel cost_;            // 执行前估算请求的内存和耗时，耗时系数按完成的请求校准
 
-    // 核心分析方法
-    Napi::Value Analyze(const Napi::CallbackInfo &info)
+    static Napi::Object TimingsToObject(Napi::Env env, const StageTimings &t)
+    {
+        Napi::Object obj = Napi::Object::New(env);
+        for (int s = 0; s < STAGE_COUNT; ++s)
+        {
+            obj.Set(std::string(stageName((Stage)s)) + "_ms", t.ms[s]);
+        }
+        obj.Set("input_samples", (double)t.input_samples);
+        obj.Set("audio_samples", (double)t.audio_samples);
+        obj.Set("frames", (double)t.frames);
+        obj.Set("vocab_size", (double)t.vocab_size);
+        obj.Set("states", (double)t.states);
+        obj.Set("phonemes", (double)t.phonemes);
+        obj.Set("words", (double)t.words);
+        obj.Set("segments", (double)t.segments);
+        obj.Set("bytes_allocated", (double)t.bytes_allocated);
+        return obj;
+    }
+
+    static Napi::Object TranscriptToObject(Napi::Env env, const Transcript &tr)
+    {
+        Napi::Object obj = Napi::Object::New(env);
+        Napi::Array phones = Napi::Array::New(env, tr.phones.size());
+        for (size_t i = 0; i < tr.phones.size(); ++i)
+        {
+            phones[i] = Napi::String::New(env, tr.phones[i]);
+        }
+        obj.Set("phones", phones);
+        obj.Set("phone_error_rate", tr.phoneErrorRate());
+        obj.Set("expected", tr.expected);
+        obj.Set("substitutions", tr.substitutions);
+        obj.Set("insertions", tr.insertions);
+        obj.Set("deletions", tr.deletions);
+
+        // 只列出差异，匹配的音素不返回
+        Napi::Array edits = Napi::Array::New(env);
+        uint32_t n = 0;
+        for (const auto &e : tr.edits)
+        {
+            if (e.op == EditOp::Match)
+                continue;
+            Napi::Object eObj = Napi::Object::New(env);
+            eObj.Set("op", editOpName(e.op));
+            eObj.Set("word", e.word);
+            if (e.phoneme >= 0)
+                eObj.Set("phoneme", e.phoneme);
+            if (!e.expected_ipa.empty())
+                eObj.Set("expected", e.expected_ipa);
+            if (!e.actual_ipa.empty())
+                eObj.Set("actual", e.actual_ipa);
+            if (e.start_frame >= 0)
+            {
+                eObj.Set("start_frame", e.start_frame);
+                eObj.Set("end_frame", e.end_frame);
+            }
+            edits[n++] = eObj;
+        }
+        obj.Set("edits", edits);
+        return obj;
+    }
+
+    static Napi::Float32Array ToFloat32Array(Napi::Env env, const std::vector<float> &values)
+    {
+        Napi::Float32Array arr = Napi::Float32Array::New(env, values.size());
+        std::copy(values.begin(), values.end(), arr.Data());
+        return arr;
+    }
+
+    static Napi::Array ProfileEntriesToArray(Napi::Env env, const std::vector<OpProfileEntry> &entries)
+    {
+        Napi::Array arr = Napi::Array::New(env, entries.size());
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const auto &e = entries[i];
+            Napi::Object obj = Napi::Object::New(env);
+            obj.Set("name", e.name);
+            obj.Set("op_type", e.op_type);
+            obj.Set("category", e.category);
+            obj.Set("calls", (double)e.calls);
+            obj.Set("total_us", e.total_us);
+            obj.Set("mean_us", e.mean_us);
+            obj.Set("percent", e.percent);
+            obj.Set("output_bytes", (double)e.output_bytes);
+            obj.Set("activation_bytes", (double)e.activation_bytes);
+            obj.Set("parameter_bytes", (double)e.parameter_bytes);
+            arr[i] = obj;
+        }
+        return arr;
+    }
+
+    // analyze 的可选参数
+    struct AnalyzeOptions
+    {
+        GopOptions gop;
+        std::vector<std::string> variantVoices;                     // 用这些口音生成备选发音，如 ["en-gb"]
+        std::map<std::string, std::vector<std::string>> variants;   // 指定备选发音 { word: [ipa, ...] }
+        bool transcript = false;                                    // 返回自由解码的转写和音素级差异
+        bool waveform = false;                                      // 返回波形包络和帧级得分轨
+        bool fluency = false;                                       // 返回语速、停顿、单词时长和能量
+        FluencyOptions fluency_options;
+        TranscriptOptions decode;
+        PrecheckOptions precheck;
+        Priority priority = Priority::Interactive;                                      // 异步请求的优先级
+        std::shared_ptr<CancelToken> cancel;                                            // options.cancelToken
+        CancelToken::Clock::time_point deadline = CancelToken::Clock::time_point::max(); // 调用时刻 + options.deadlineMs
+        std::string language;                                                           // 发起请求时的 setLanguage，决定用哪个模型
+        std::string voice;                                                              // language 对应的 espeak 口音，G2P 用它转写
+    };
+
+    static std::vector<std::string> ToStringList(const Napi::Value &value)
+    {
+        std::vector<std::string> out;
+        if (!value.IsArray()) return out;
+        Napi::Array arr = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < arr.Length(); ++i)
+        {
+            if (arr.Get(i).IsString()) out.push_back(arr.Get(i).As<Napi::String>());
+        }
+        return out;
+    }
+
+    // { detailed, topK, allowSkip, skipPenalty, variantPenalty, variantVoices, variants, segmented, alignThreads,
+    //   transcript, beamWidth, precheck, maxPhoneErrorRate, waveform, fluency, minPauseMs, cancelToken, deadlineMs, priority }
+    static void ParseAnalyzeOptions(const Napi::Object &obj, AnalyzeOptions &options)
+    {
+        if (obj.Has("priority") && obj.Get("priority").IsString())
+        {
+            parsePriority(obj.Get("priority").As<Napi::String>(), options.priority);
+        }
+        if (obj.Has("cancelToken") && obj.Get("cancelToken").IsObject())
+        {
+            Napi::Object tokenObj = obj.Get("cancelToken").As<Napi::Object>();
+            AddonData *data = obj.Env().GetInstanceData<AddonData>();
+            if (tokenObj.InstanceOf(data->cancelToken.Value()))
+            {
+                options.cancel = JsCancelToken::Unwrap(tokenObj)->token();
+            }
+        }
+        if (obj.Has("deadlineMs") && obj.Get("deadlineMs").IsNumber())
+        {
+            double ms = obj.Get("deadlineMs").As<Napi::Number>().DoubleValue();
+            if (ms > 0)
+            {
+                options.deadline = CancelToken::Clock::now() + std::chrono::microseconds((int64_t)(ms * 1000.0));
+            }
+        }
+        if (obj.Has("detailed") && obj.Get("detailed").IsBoolean())
+        {
+            options.gop.detailed = obj.Get("detailed").As<Napi::Boolean>();
+        }
+        if (obj.Has("topK") && obj.Get("topK").IsNumber())
+        {
+            options.gop.top_k = obj.Get("topK").As<Napi::Number>().Int32Value();
+        }
+        if (obj.Has("allowSkip") && obj.Get("allowSkip").IsBoolean())
+        {
+            options.gop.lattice.allow_skip = obj.Get("allowSkip").As<Napi::Boolean>();
+        }
+        if (obj.Has("skipPenalty") && obj.Get("skipPenalty").IsNumber())
+        {
+            options.gop.lattice.skip_penalty = obj.Get("skipPenalty").As<Napi::Number>().FloatValue();
+        }
+        if (obj.Has("variantPenalty") && obj.Get("variantPenalty").IsNumber())
+        {
+            options.gop.lattice.variant_penalty = obj.Get("variantPenalty").As<Napi::Number>().FloatValue();
+        }
+        if (obj.Has("segmented") && obj.Get("segmented").IsBoolean())
+        {
+            options.gop.segment.enabled = obj.Get("segmented").As<Napi::Boolean>();
+        }
+        if (obj.Has("alignThreads") && obj.Get("alignThreads").IsNumber())
+        {
+            options.gop.segment.max_threads = obj.Get("alignThreads").As<Napi::Number>().Int32Value();
+        }
+        if (obj.Has("transcript") && obj.Get("transcript").IsBoolean())
+        {
+            options.transcript = obj.Get("transcript").As<Napi::Boolean>();
+        }
+        if (obj.Has("waveform") && obj.Get("waveform").IsBoolean())
+        {
+            options.waveform = obj.Get("waveform").As<Napi::Boolean>();
+        }
+        if (obj.Has("fluency") && obj.Get("fluency").IsBoolean())
+        {
+            options.fluency = obj.Get("fluency").As<Napi::Boolean>();
+        }
+        if (obj.Has("minPauseMs") && obj.Get("minPauseMs").IsNumber())
+        {
+            double ms = obj.Get("minPauseMs").As<Napi::Number>().DoubleValue();
+            options.fluency_options.min_pause_frames = std::max(1, (int)std::lround(ms * TARGET_SAMPLE_RATE / 1000.0 / MODEL_FRAME_STRIDE));
+        }
+        if (obj.Has("beamWidth") && obj.Get("beamWidth").IsNumber())
+        {
+            options.decode.beam_width = obj.Get("beamWidth").As<Napi::Number>().Int32Value();
+        }
+        if (obj.Has("precheck") && obj.Get("precheck").IsBoolean())
+        {
+            options.precheck.enabled = obj.Get("precheck").As<Napi::Boolean>();
+        }
+        if (obj.Has("maxPhoneErrorRate") && obj.Get("maxPhoneErrorRate").IsNumber())
+        {
+            options.precheck.max_phone_error_rate = obj.Get("maxPhoneErrorRate").As<Napi::Number>().FloatValue();
+        }
+        if (obj.Has("variantVoices"))
+        {
+            options.variantVoices = ToStringList(obj.Get("variantVoices"));
+        }
+        if (obj.Has("variants") && obj.Get("variants").IsObject())
+        {
+            Napi::Object map = obj.Get("variants").As<Napi::Object>();
+            Napi::Array keys = map.GetPropertyNames();
+            for (uint32_t i = 0; i < keys.Length(); ++i)
+            {
+                std::string word = keys.Get(i).As<Napi::String>();
+                options.variants[word] = ToStringList(map.Get(word));
+            }
+        }
+    }
+
+    // 读取 info[index] 处的可选参数；阈值表在发起请求时按当前口音选定 (异步请求执行期间切换口音不影响它)
+    AnalyzeOptions ReadOptions(const Napi::CallbackInfo &info, size_t index)
+    {
+        AnalyzeOptions options;
+        options.gop.thresholds = active_thresholds_;
+        options.language = language_;
+        options.voice = registry_.voiceFor(language_);
+        if (info.Length() > index && info[index].IsObject())
+        {
+            ParseAnalyzeOptions(info[index].As<Napi::Object>(), options);
+        }
+        return options;
+    }
+
+    // 一次 analyze 的输入，在 JS 线程上解析好；异步时整个交给工作线程
+    struct AnalyzeRequest
+    {
+        std::string wav_path;        // 文件模式
+        const float *pcm = nullptr;  // PCM 模式：同步时直接指向 JS 内存，异步时指向 pcm_copy
+        size_t pcm_size = 0;
+        int sample_rate = 0;
+        int channels = 0;
+        std::vector<float> pcm_copy;
+        std::string text;
+        AnalyzeOptions options;
+    };
+
+    // 评分的纯 C++ 结果 (不碰 JS 对象，可以在工作线程上产生)，回到 JS 线程再转成返回值
+    struct AnalyzeOutcome
+    {
+        std::vector<WordAnalysis> words;
+        Transcript transcript;
+        bool mismatch = false;
+        bool cached = false;      // 推理结果不是这次算的 (来自缓存或存档)
+        bool has_handle = false;  // 返回值带 audioHandle
+        uint64_t key = 0;
+        StageTimings timings;
+        double wait_ms = -1;      // 异步请求在调度器里排队的时间，同步调用为 -1
+        std::string error;        // 失败原因
+        std::string code;         // 失败时附在 JS 异常上的 code (超出预算为 'E2BIG')
+        CancelReason cancelled = CancelReason::None;
+        Admission admission;      // 准入决定和资源估算
+        std::shared_ptr<const AudioSummary> summary; // options.waveform / fluency: 波形包络和能量轮廓 (随推理结果缓存)
+        std::vector<float> score_track;           // options.waveform: 帧级得分轨
+        FluencyMetrics fluency;                   // options.fluency
+    };
+
+    // 解析 analyze 的参数，参数不对时抛出 TypeError 并返回 false
+    bool ParseAnalyzeRequest(const Napi::CallbackInfo &info, AnalyzeRequest &req)
     {
         Napi::Env env = info.Env();
 
@@ -111,14 +527,12 @@ private:
         if (info.Length() < 2)
         {
             Napi::TypeError::New(env, "Expected at least 2 arguments").ThrowAsJavaScriptException();
-            return env.Null();
+            return false;
         }
 
-        std::string text;
-
         // =======================================================
         // 分支 1: 传入的是 Float32Array (直接内存传递)
-        // 签名: analyze(float32Array, sampleRate, channels, text)
+        // 签名: analyze(float32Array, sampleRate, channels, text, [options])
         // =======================================================
         if (info[0].IsTypedArray())
         {
@@ -126,70 +540,375 @@ private:
             if (info.Length() < 4)
             {
                 Napi::TypeError::New(env, "Raw mode expects: (data, sampleRate, channels, text)").ThrowAsJavaScriptException();
-                return env.Null();
+                return false;
             }
 
+            // pcmData.Data() 返回 float* 指针，pcmData.ElementLength() 返回元素个数
             Napi::Float32Array pcmData = info[0].As<Napi::Float32Array>();
-            int sampleRate = info[1].As<Napi::Number>().Int32Value();
-            int channels = info[2].As<Napi::Number>().Int32Value();
-            text = info[3].As<Napi::String>();
-
-            // 直接加载内存数据！
-            // pcmData.Data() 返回 float* 指针
-            // pcmData.ElementLength() 返回元素个数
-            engine_->loadAudio(pcmData.Data(), pcmData.ElementLength(), sampleRate, channels);
+            req.pcm = pcmData.Data();
+            req.pcm_size = pcmData.ElementLength();
+            req.sample_rate = info[1].As<Napi::Number>().Int32Value();
+            req.channels = info[2].As<Napi::Number>().Int32Value();
+            req.text = info[3].As<Napi::String>();
+            req.options = ReadOptions(info, 4);
         }
         // =======================================================
         // 分支 2: 传入的是 String (文件路径模式)
-        // 签名: analyze(wavPath, text)
+        // 签名: analyze(wavPath, text, [options])
         // =======================================================
         else if (info[0].IsString())
         {
-            std::string wavPath = info[0].As<Napi::String>();
-            text = info[1].As<Napi::String>();
+            req.wav_path = info[0].As<Napi::String>();
+            req.text = info[1].As<Napi::String>();
+            req.options = ReadOptions(info, 2);
+        }
+        else
+        {
+            Napi::TypeError::New(env, "First argument must be path (String) or PCM data (Float32Array)").ThrowAsJavaScriptException();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * 在请求级取消令牌下执行 fn 并记录统计。
+     * 令牌跟随调用方的 cancelToken，并在 deadlineMs 到期时自动取消；
+     * 被取消的请求不计入 requests / failures，只计入 cancelled
+     */
+    bool RunWithCancel(const AnalyzeOptions &options, AnalyzeOutcome &out, const std::function<bool(const CancelToken *)> &fn)
+    {
+        CancelToken token;
+        if (options.deadline != CancelToken::Clock::time_point::max())
+        {
+            token.setDeadline(options.deadline);
+        }
+        const CancelToken *parent = options.cancel.get();
+        ScopedCancelCallback follow(parent, [&token, parent]() { token.cancel(parent->reason()); });
+
+        // 排队期间已经取消或超时的请求直接跳过
+        ScopedStageTimer total_timer(&out.timings, Stage::Total);
+        bool ok = !token.isCancelled() && fn(&token);
+        total_timer.stop();
+
+        if (!ok && token.isCancelled())
+        {
+            out.cancelled = token.reason();
+            stats_.recordCancelled();
+            return false;
+        }
+        stats_.record(out.timings, ok);
+        if (ok)
+        {
+            cost_.observe(out.timings, out.admission.decision == AdmissionDecision::LowMemory);
+            LOG_DEBUG("[Debug] analyze" << (out.cached ? " (cached)" : "") << ": total " << out.timings.ms[(int)Stage::Total]
+                                        << " ms, frames " << out.timings.frames << ", states " << out.timings.states);
+        }
+        return ok;
+    }
+
+    // 前端 + 推理 (缓存未命中时) + 评分。runner 由调用方独占
+    bool RunAnalyze(ModelRunner &runner, const AnalyzeRequest &req, const CancelToken *cancel, AnalyzeOutcome &out)
+    {
+        StageTimings &timings = out.timings;
+        std::shared_ptr<const EmissionMatrix> emissions; // 非空表示缓存命中
+        bool planned = false;                            // 推理前的预估是否已经做过
+        ScopedStageTimer frontend_timer(&timings, Stage::FrontEnd);
+
+        if (req.pcm)
+        {
+            // 同样的 PCM 在不同采样率/声道数下是不同的音频，一起算进哈希
+            out.key = hashContent(req.pcm, req.pcm_size * sizeof(float),
+                                  ((uint64_t)req.sample_rate << 16) | (uint64_t)req.channels);
+            emissions = FindCached(out.key, runner);
+            if (!emissions)
+            {
+                // 前端之前按输入长度预估，超预算的请求连下混和重采样也不做
+                unsigned int channels = req.channels > 0 ? (unsigned int)req.channels : 1;
+                planned = true;
+                if (!PlanInference(runner, resampledLength(req.pcm_size / channels, req.sample_rate), req.text, out))
+                {
+                    return Reject(out);
+                }
+                runner.loadAudio(req.pcm, req.pcm_size, req.sample_rate, req.channels);
+            }
+        }
+        else
+        {
+            // 整个文件 (含文件头) 的哈希作为缓存键，映射只读一遍，随后的解码读的是页缓存
+            WavFormat format;
+            {
+                MappedFile file;
+                if (!file.open(req.wav_path))
+                {
+                    out.error = "Failed to open WAV file";
+                    return false;
+                }
+                out.key = hashContent(file.data(), file.size());
+                readWavFormat(file.data(), file.size(), format);
+            }
+            emissions = FindCached(out.key, runner);
 
-            unsigned int c, r;
-            drwav_uint64 tf;
-            // 使用 dr_wav 读取文件
-            float *pData = drwav_open_file_and_read_pcm_frames_f32(wavPath.c_str(), &c, &r, &tf, NULL);
+            // 文件头写明了长度时在解码之前预估；没写明的 (frames 为 0) 解码之后再按实际长度预估
+            if (!emissions && format.frames > 0)
+            {
+                planned = true;
+                if (!PlanInference(runner, resampledLength(format.frames, format.sample_rate), req.text, out))
+                {
+                    return Reject(out);
+                }
+            }
 
-            if (!pData)
+            // 内存映射 + 分块解码，直接送入前端 (不再整段解码到堆上)
+            if (!emissions && !streamWavFile(req.wav_path, runner))
             {
-                Napi::Error::New(env, "Failed to open WAV file").ThrowAsJavaScriptException();
-                return env.Null();
+                out.error = "Failed to open WAV file";
+                return false;
+            }
+        }
+        out.has_handle = true;
+        frontend_timer.stop();
+
+        bool cached = (emissions != nullptr);
+        if (!cached)
+        {
+            timings.input_samples = runner.getInputSamples();
+            timings.audio_samples = runner.getAudioSize();
+            timings.bytes_allocated += (uint64_t)runner.getAudioSize() * sizeof(float);
+
+            if (!planned && !PlanInference(runner, runner.getAudioSize(), req.text, out))
+            {
+                return Reject(out);
+            }
+
+            // 2. 推理
+            if (!runner.runInference(&timings, cancel))
+            {
+                out.error = "Inference execution failed";
+                return false;
             }
 
-            engine_->loadAudio(pData, tf, r, c);
-            drwav_free(pData, NULL);
+            emissions = runner.copyEmissions();
+            timings.bytes_allocated += emissions->bytes();
+            cache_.insert(out.key, emissions);
         }
-        else
+
+        if (req.options.waveform || req.options.fluency)
         {
-            Napi::TypeError::New(env, "First argument must be path (String) or PCM data (Float32Array)").ThrowAsJavaScriptException();
-            return env.Null();
+            out.summary = emissions->summary;
         }
+        return ScoreEmissions(runner, emissions->view(), emissions->audio_samples, cached, req.text, req.options, cancel, out);
+    }
+
+    // 推理之前按 16k 样本数和参考文本长度预估 (out.admission)，最省的方式也超预算时返回 false
+    bool PlanInference(const ModelRunner &runner, uint64_t audio_samples, const std::string &text, AnalyzeOutcome &out)
+    {
+        out.admission = cost_.plan(admission_, audio_samples, framesForSamples(audio_samples), runner.getVocab().idCount(),
+                                   estimateStatesFromText(text));
+        return out.admission.decision != AdmissionDecision::Rejected;
+    }
 
-        // 2. 推理
-        if (!engine_->runInference())
+    // 缓存查找：其他模型版本算出的结果 (热切换前缓存的) 视为未命中
+    std::shared_ptr<const EmissionMatrix> FindCached(uint64_t key, const ModelRunner &model)
+    {
+        std::shared_ptr<const EmissionMatrix> emissions = cache_.find(key);
+        if (emissions && emissions->model_hash != model.getModelHash())
         {
-            Napi::Error::New(env, "Inference execution failed").ThrowAsJavaScriptException();
-            return env.Null();
+            return nullptr;
+        }
+        return emissions;
+    }
+
+    // G2P + 对齐 (analyze、rescore 和 analyzeEmissions 共用)。
+    // model 是发起请求时的模型版本，分词和对齐都用它的词表
+    bool ScoreEmissions(const ModelRunner &model, const EmissionView &emissions, uint64_t audio_samples, bool cached,
+                        const std::string &text, const AnalyzeOptions &options, const CancelToken *cancel, AnalyzeOutcome &out)
+    {
+        const Vocab &vocab = model.getVocab();
+        StageTimings &timings = out.timings;
+        out.cached = cached;
+        if (cached)
+        {
+            timings.audio_samples = audio_samples;
+            timings.frames = emissions.frames;
+            timings.vocab_size = emissions.vocab;
         }
 
         // 3. 文本转音素
-        std::vector<WordAnalysis> ws = phonemizer_->analyzeText(text);
+        ScopedStageTimer g2p_timer(&timings, Stage::G2P);
+        std::vector<WordAnalysis> &ws = out.words;
+        ws = phonemizer_->analyzeText(text, &vocab, &options.voice);
+        phonemizer_->addVoiceVariants(ws, text, options.variantVoices, &vocab, &options.voice);
+        phonemizer_->addExplicitVariants(ws, options.variants, &vocab);
+        g2p_timer.stop();
 
-        // 4. 强制对齐算分
-        if (!calculateGOP(*engine_, ws, 0))
+        if (cancel && cancel->isCancelled())
         {
-            Napi::Error::New(env, "Alignment failed").ThrowAsJavaScriptException();
-            return env.Null();
+            return false;
+        }
+
+        // 3.5 自由解码 (转写 / 预检)：音频明显不是这句话时不做对齐
+        if (options.transcript || options.precheck.enabled)
+        {
+            ScopedStageTimer decode_timer(&timings, Stage::Decode);
+            out.transcript = decodeTranscript(emissions, vocab, ws, 0, options.decode);
+            out.mismatch = options.precheck.enabled && !transcriptMatches(out.transcript, options.precheck);
+        }
+
+        // 4. 强制对齐算分 (阈值表在发起请求时按当前口音选好)
+        if (out.mismatch)
+        {
+            LOG_INFO("[Info] Precheck rejected the audio (phone error rate " << out.transcript.phoneErrorRate() << "), alignment skipped.");
+            markWordsUnaligned(ws, vocab);
+        }
+        else
+        {
+            // 分词后按实际的状态数复核：超预算时改用低内存对齐 (并分段)，仍超出则拒绝
+            CostEstimate predicted = out.admission.estimate;
+            out.admission = cost_.plan(admission_, 0, emissions.frames, emissions.vocab, estimateLatticeStates(ws.data(), ws.size(), vocab));
+            out.admission.estimate.inference_bytes = predicted.inference_bytes;
+            out.admission.estimate.inference_ms = predicted.inference_ms;
+            if (out.admission.decision == AdmissionDecision::Rejected)
+            {
+                return Reject(out);
+            }
+            cost_.record(out.admission.decision);
+
+            ScopedStageTimer align_timer(&timings, Stage::Align);
+            GopOptions gop = options.gop;
+            gop.cancel = cancel;
+            if (out.admission.decision == AdmissionDecision::LowMemory)
+            {
+                gop.low_memory = true;
+                gop.segment.enabled = true;
+            }
+            if (!calculateGOP(emissions, vocab, ws, 0, &timings, gop))
+            {
+                out.error = "Alignment failed";
+                return false;
+            }
+            align_timer.stop();
+        }
+
+        if (options.waveform)
+        {
+            buildScoreTrack(ws, emissions.frames, out.score_track);
+        }
+        if (options.fluency && !out.mismatch)
+        {
+            computeFluency(ws, emissions.frames, out.summary ? &out.summary->energy_db : nullptr, options.fluency_options, out.fluency);
+        }
+        return true;
+    }
+
+    // 超出预算的请求：记一次拒绝，失败原因带上估算值
+    bool Reject(AnalyzeOutcome &out)
+    {
+        cost_.record(AdmissionDecision::Rejected);
+        out.error = out.admission.reason;
+        out.code = "E2BIG";
+        LOG_WARNING("[Warning] " << out.admission.reason << ", frames " << out.admission.estimate.frames << ", states "
+                                 << out.admission.estimate.states << ".");
+        return false;
+    }
+
+    // 失败的请求转成 JS 异常对象；取消、超时和超出预算带 code，方便调用方区分
+    static Napi::Error OutcomeError(Napi::Env env, const AnalyzeOutcome &out)
+    {
+        if (out.cancelled == CancelReason::None)
+        {
+            Napi::Error err = Napi::Error::New(env, out.error);
+            if (!out.code.empty())
+            {
+                err.Value().Set("code", out.code);
+            }
+            return err;
+        }
+
+        bool timeout = (out.cancelled == CancelReason::DeadlineExceeded);
+        Napi::Error err = Napi::Error::New(env, timeout ? "Analysis deadline exceeded" : "Analysis cancelled");
+        err.Value().Set("code", timeout ? "ETIMEDOUT" : "ECANCELED");
+        return err;
+    }
+
+    // { sample_rate, samples, block, peaks: Float32Array[], frame_ms, score_track: Float32Array }
+    static Napi::Object WaveformToObject(Napi::Env env, const AnalyzeOutcome &out)
+    {
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("sample_rate", TARGET_SAMPLE_RATE);
+        const PeakPyramid *pyramid = out.summary ? &out.summary->peaks : nullptr;
+        obj.Set("samples", (double)(pyramid ? pyramid->samples : out.timings.audio_samples));
+        obj.Set("block", PeakPyramid::BASE_BLOCK);
+        // 从存档读回的推理结果没有音频，只返回得分轨
+        size_t levels = pyramid ? pyramid->levels.size() : 0;
+        Napi::Array peaks = Napi::Array::New(env, levels);
+        for (size_t k = 0; k < levels; ++k)
+        {
+            peaks[k] = ToFloat32Array(env, pyramid->levels[k]);
+        }
+        obj.Set("peaks", peaks);
+        obj.Set("frame_ms", 1000.0 * MODEL_FRAME_STRIDE / TARGET_SAMPLE_RATE);
+        obj.Set("score_track", ToFloat32Array(env, out.score_track));
+        return obj;
+    }
+
+    // { phones, speech_ms, articulation_ms, speech_rate, articulation_rate, tempo, pause_ms,
+    //   pauses: [{ start_ms, duration_ms, after_word }], words: [{ duration_ms, expected_ms, z, energy_db } | null],
+    //   frame_ms, energy_db: Float32Array }
+    static Napi::Object FluencyToObject(Napi::Env env, const AnalyzeOutcome &out)
+    {
+        const FluencyMetrics &f = out.fluency;
+        const double frame_ms = 1000.0 * MODEL_FRAME_STRIDE / TARGET_SAMPLE_RATE;
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("phones", f.phones);
+        obj.Set("speech_ms", f.speech_ms);
+        obj.Set("articulation_ms", f.articulation_ms);
+        obj.Set("speech_rate", f.speech_rate);
+        obj.Set("articulation_rate", f.articulation_rate);
+        obj.Set("tempo", f.tempo);
+        obj.Set("pause_ms", f.pause_ms);
+
+        Napi::Array pauses = Napi::Array::New(env, f.pauses.size());
+        for (size_t i = 0; i < f.pauses.size(); ++i)
+        {
+            const FluencyPause &p = f.pauses[i];
+            Napi::Object pObj = Napi::Object::New(env);
+            pObj.Set("start_ms", p.start_frame * frame_ms);
+            pObj.Set("duration_ms", (p.end_frame - p.start_frame) * frame_ms);
+            pObj.Set("after_word", p.after_word);
+            pauses[i] = pObj;
         }
+        obj.Set("pauses", pauses);
 
-        // 5. 构造 JS 返回对象
+        Napi::Array words = Napi::Array::New(env, f.words.size());
+        for (size_t i = 0; i < f.words.size(); ++i)
+        {
+            const WordFluency &w = f.words[i];
+            if (!w.measured)
+            {
+                words[i] = env.Null();
+                continue;
+            }
+            Napi::Object wObj = Napi::Object::New(env);
+            wObj.Set("duration_ms", w.duration_ms);
+            wObj.Set("expected_ms", w.expected_ms);
+            wObj.Set("z", w.z);
+            wObj.Set("energy_db", w.energy_db);
+            words[i] = wObj;
+        }
+        obj.Set("words", words);
+
+        // 从存档读回的推理结果没有音频，能量轮廓为空
+        obj.Set("frame_ms", frame_ms);
+        obj.Set("energy_db", ToFloat32Array(env, out.summary ? out.summary->energy_db : std::vector<float>()));
+        return obj;
+    }
+
+    // 5. 构造 JS 返回对象
+    static Napi::Object OutcomeToObject(Napi::Env env, const AnalyzeOutcome &out, const AnalyzeOptions &options)
+    {
+        const std::vector<WordAnalysis> &ws = out.words;
         Napi::Object resultObj = Napi::Object::New(env);
         Napi::Array wordsArr = Napi::Array::New(env, ws.size());
-        float total_score_sum = 0.0f;
-        int valid_word_count = 0;
 
         for (size_t i = 0; i < ws.size(); ++i)
         {
@@ -197,12 +916,8 @@ private:
             Napi::Object wObj = Napi::Object::New(env);
             wObj.Set("word", w.word);
             wObj.Set("score", w.word_score);
-
-            if (w.word_score > -10.0f)
-            {
-                total_score_sum += w.word_score;
-                valid_word_count++;
-            }
+            wObj.Set("variant", w.variant);
+            wObj.Set("skipped", w.skipped);
 
             Napi::Array pArr = Napi::Array::New(env, w.details.size());
             for (size_t j = 0; j < w.details.size(); ++j)
@@ -212,21 +927,833 @@ private:
                 dObj.Set("ipa", d.ipa);
                 dObj.Set("score", d.score);
                 dObj.Set("is_good", d.is_good);
+                dObj.Set("is_excellent", d.is_excellent);
                 dObj.Set("start_frame", d.start_frame);
                 dObj.Set("end_frame", d.end_frame);
+                if (options.gop.detailed)
+                {
+                    dObj.Set("posterior", d.posterior);
+                    dObj.Set("gop_lr", d.gop_lr);
+                    dObj.Set("hint", gopHintName(d.hint));
+                    if (d.hint == GopHint::Substitution)
+                    {
+                        dObj.Set("substitute", d.substitute_ipa);
+                    }
+                    Napi::Array cArr = Napi::Array::New(env, d.competitors.size());
+                    for (size_t k = 0; k < d.competitors.size(); ++k)
+                    {
+                        Napi::Object cObj = Napi::Object::New(env);
+                        cObj.Set("ipa", d.competitors[k].ipa);
+                        cObj.Set("posterior", d.competitors[k].posterior);
+                        cArr[k] = cObj;
+                    }
+                    dObj.Set("competitors", cArr);
+                }
                 pArr[j] = dObj;
             }
             wObj.Set("phonemes", pArr);
             wordsArr[i] = wObj;
         }
 
-        float overall = (valid_word_count > 0) ? (total_score_sum / valid_word_count) : -10.0f;
         resultObj.Set("words", wordsArr);
-        resultObj.Set("overall_score", overall);
-
-        return resultObj;
-    }
-    Napi::Value Phonemize(const Napi::CallbackInfo &info)
+        resultObj.Set("overall_score", calculateOverallScore(ws));
+        resultObj.Set("cached", out.cached);
+        if (options.precheck.enabled)
+        {
+            resultObj.Set("mismatch", out.mismatch);
+        }
+        if (options.transcript || out.mismatch)
+        {
+            resultObj.Set("transcript", TranscriptToObject(env, out.transcript));
+        }
+        if (out.has_handle)
+        {
+            resultObj.Set("audioHandle", formatAudioHandle(out.key));
+        }
+        if (options.waveform)
+        {
+            resultObj.Set("waveform", WaveformToObject(env, out));
+        }
+        if (options.fluency && !out.mismatch)
+        {
+            resultObj.Set("fluency", FluencyToObject(env, out));
+        }
+        Napi::Object timingsObj = TimingsToObject(env, out.timings);
+        if (out.wait_ms >= 0)
+        {
+            timingsObj.Set("queue_ms", out.wait_ms);
+        }
+        resultObj.Set("timings", timingsObj);
+        if (!out.mismatch)
+        {
+            const CostEstimate &e = out.admission.estimate;
+            Napi::Object admissionObj = Napi::Object::New(env);
+            admissionObj.Set("decision", admissionDecisionName(out.admission.decision));
+            admissionObj.Set("estimated_bytes", (double)e.peakBytes());
+            admissionObj.Set("estimated_ms", e.totalMs());
+            admissionObj.Set("inference_bytes", (double)e.inference_bytes);
+            admissionObj.Set("align_bytes", (double)e.align_bytes);
+            resultObj.Set("admission", admissionObj);
+        }
+        return resultObj;
+    }
+
+    // 同步调用的收尾：成功返回结果对象，失败抛出 JS 异常
+    static Napi::Value Finish(Napi::Env env, bool ok, const AnalyzeOutcome &out, const AnalyzeOptions &options)
+    {
+        if (!ok)
+        {
+            OutcomeError(env, out).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        return OutcomeToObject(env, out, options);
+    }
+
+    // language 对应的模型：registerModel 注册过的语言走注册表 (可能在这里加载)，否则用默认模型。
+    // 加载失败返回 nullptr
+    std::shared_ptr<const ModelRunner> ModelFor(const std::string &language)
+    {
+        if (registry_.has(language))
+        {
+            return registry_.acquire(language);
+        }
+        return models_.acquire();
+    }
+
+    // 同步调用用的 engine_ 切到 language 当前的模型版本 (JS 线程上调用)，失败时抛出 JS 异常并返回 false。
+    // 切换前先结束 profiling：profiling session 是按旧模型建的
+    bool SyncEngine(Napi::Env env, const std::string &language)
+    {
+        std::shared_ptr<const ModelRunner> current = ModelFor(language);
+        if (!current)
+        {
+            Napi::Error::New(env, "Failed to load model for " + language).ThrowAsJavaScriptException();
+            return false;
+        }
+        if (engine_model_.lock() == current)
+        {
+            return true;
+        }
+        if (engine_->isProfiling())
+        {
+            engine_->stopProfiling();
+        }
+        engine_->shareModelFrom(*current);
+        engine_model_ = current;
+        return true;
+    }
+
+    // engine_ 共享的模型已经没有别的持有者 (被注册表淘汰，或热切换后的旧版本) 时放掉它 (JS 线程上调用)，
+    // 内存不必等到下一次切换语言才释放；下一个同步调用会在 SyncEngine 里重新取模型
+    void ReleaseStaleEngineModel()
+    {
+        if (!engine_ || !engine_model_.expired())
+        {
+            return;
+        }
+        if (engine_->isProfiling())
+        {
+            engine_->stopProfiling();
+        }
+        engine_->releaseModel();
+    }
+
+    // 核心分析方法 (同步，在 JS 线程上执行)
+    // options.deadlineMs 在这里同样生效；cancelToken 只有其他线程能触发，一般配合 analyzeAsync 使用
+    Napi::Value Analyze(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        AnalyzeRequest req;
+        if (!ParseAnalyzeRequest(info, req))
+        {
+            return env.Null();
+        }
+
+        if (!SyncEngine(env, req.options.language))
+        {
+            return env.Null();
+        }
+        AnalyzeOutcome out;
+        bool ok = RunWithCancel(req.options, out, [&](const CancelToken *cancel) { return RunAnalyze(*engine_, req, cancel, out); });
+        return Finish(env, ok, out, req.options);
+    }
+
+    // 一个异步请求：在调度器线程上执行，完成后回到 JS 线程兑现 Promise
+    struct AsyncJob
+    {
+        AsyncJob(Napi::Env env, Napi::Object engine)
+            : self(Napi::Persistent(engine)), deferred(Napi::Promise::Deferred::New(env))
+        {
+        }
+
+        Napi::ObjectReference self; // 请求完成前引擎对象不会被回收
+        Napi::Promise::Deferred deferred;
+        Napi::ThreadSafeFunction tsfn;
+        AnalyzeOptions options;
+        std::function<bool(ModelRunner &, const CancelToken *, AnalyzeOutcome &)> run;
+        AnalyzeOutcome out;
+        bool ok = false;
+    };
+
+    /**
+     * 把请求交给调度器，返回 Promise。
+     * 每个请求一个 runner：共享模型和词表，音频和推理结果各自独立，
+     * 可以和同步调用、其他异步请求同时进行 (profiling 只统计同步 analyze)。
+     * 后台优先级的请求使用线程更少的推理 session；队列满时 Promise 以 code 'EBUSY' 拒绝
+     */
+    Napi::Value Schedule(Napi::Env env, const AnalyzeOptions &options,
+                         std::function<bool(ModelRunner &, const CancelToken *, AnalyzeOutcome &)> run)
+    {
+        AsyncJob *job = new AsyncJob(env, Value());
+        job->options = options;
+        job->run = std::move(run);
+        job->tsfn = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}),
+                                                  "SpeechEngine.async", 0, 1);
+        Napi::Promise promise = job->deferred.Promise();
+
+        bool queued = scheduler_->submit(options.priority, [this, job](double wait_ms) {
+            job->out.wait_ms = wait_ms;
+            job->ok = RunWithCancel(job->options, job->out, [&](const CancelToken *cancel) {
+                // 开始执行时才取模型：排队期间完成的热切换对它生效，注册表里的语言在这里按需加载
+                std::shared_ptr<const ModelRunner> model = ModelFor(job->options.language);
+                if (!model)
+                {
+                    job->out.error = "Failed to load model for " + job->options.language;
+                    return false;
+                }
+                ModelRunner runner;
+                runner.shareModelFrom(*model);
+                runner.setBackground(job->options.priority == Priority::Background);
+                return job->run(runner, cancel, job->out);
+            });
+
+            // 回调里会释放 job，先复制一份句柄
+            Napi::ThreadSafeFunction tsfn = job->tsfn;
+            tsfn.BlockingCall(job, [this](Napi::Env env, Napi::Function, AsyncJob *job) {
+                // 这个请求取模型时可能淘汰了 engine_ 正在共享的语言
+                ReleaseStaleEngineModel();
+                if (job->ok)
+                {
+                    job->deferred.Resolve(OutcomeToObject(env, job->out, job->options));
+                }
+                else
+                {
+                    job->deferred.Reject(OutcomeError(env, job->out).Value());
+                }
+                delete job;
+            });
+            tsfn.Release();
+        });
+
+        if (!queued)
+        {
+            Napi::Error err = Napi::Error::New(env, std::string("Too many queued ") + priorityName(options.priority) + " requests");
+            err.Value().Set("code", "EBUSY");
+            job->deferred.Reject(err.Value());
+            job->tsfn.Release();
+            delete job;
+        }
+        return promise;
+    }
+
+    // 异步分析: analyzeAsync(wavPath, text, [options]) / analyzeAsync(float32Array, sampleRate, channels, text, [options])
+    // 在调度器线程上执行，返回 Promise。options.priority 为 'interactive' (默认) 或 'background'；
+    // options.cancelToken 取消后 Promise 以 code 'ECANCELED' 拒绝，超过 options.deadlineMs (含排队时间) 时以 'ETIMEDOUT' 拒绝
+    Napi::Value AnalyzeAsync(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        std::shared_ptr<AnalyzeRequest> req = std::make_shared<AnalyzeRequest>();
+        if (!ParseAnalyzeRequest(info, *req))
+        {
+            return env.Null();
+        }
+        // JS 侧的数组在请求完成前可能被修改或回收，复制一份
+        if (req->pcm)
+        {
+            req->pcm_copy.assign(req->pcm, req->pcm + req->pcm_size);
+            req->pcm = req->pcm_copy.data();
+        }
+
+        return Schedule(env, req->options, [this, req](ModelRunner &runner, const CancelToken *cancel, AnalyzeOutcome &out) {
+            return RunAnalyze(runner, *req, cancel, out);
+        });
+    }
+
+    // 解析 rescore 的参数，参数不对时抛出 TypeError 并返回 false
+    bool ParseRescoreArgs(const Napi::CallbackInfo &info, uint64_t &key, std::string &text, AnalyzeOptions &options)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString())
+        {
+            Napi::TypeError::New(env, "Expected (audioHandle, text, [options])").ThrowAsJavaScriptException();
+            return false;
+        }
+        if (!parseAudioHandle(info[0].As<Napi::String>(), key))
+        {
+            Napi::TypeError::New(env, "Invalid audio handle").ThrowAsJavaScriptException();
+            return false;
+        }
+        text = info[1].As<Napi::String>().Utf8Value();
+        options = ReadOptions(info, 2);
+        return true;
+    }
+
+    // 对缓存里的推理结果重新做 G2P 和对齐
+    bool RescoreCached(const ModelRunner &model, uint64_t key, const std::string &text, const AnalyzeOptions &options,
+                       const CancelToken *cancel, AnalyzeOutcome &out)
+    {
+        out.key = key;
+        out.has_handle = true;
+        std::shared_ptr<const EmissionMatrix> emissions = FindCached(key, model);
+        if (!emissions)
+        {
+            // 已被淘汰 (或从未分析过)，调用方需要带着音频重新 analyze
+            out.error = "Audio handle is no longer cached";
+            return false;
+        }
+        if (options.waveform || options.fluency)
+        {
+            out.summary = emissions->summary;
+        }
+        return ScoreEmissions(model, emissions->view(), emissions->audio_samples, true, text, options, cancel, out);
+    }
+
+    // 用缓存的推理结果重新评分: rescore(audioHandle, text, [options])
+    // audioHandle 来自之前 analyze 的返回值，只重新做 G2P 和对齐
+    Napi::Value Rescore(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        uint64_t key = 0;
+        std::string text;
+        AnalyzeOptions options;
+        if (!ParseRescoreArgs(info, key, text, options))
+        {
+            return env.Null();
+        }
+
+        if (!SyncEngine(env, options.language))
+        {
+            return env.Null();
+        }
+        AnalyzeOutcome out;
+        bool ok = RunWithCancel(options, out, [&](const CancelToken *cancel) { return RescoreCached(*engine_, key, text, options, cancel, out); });
+        return Finish(env, ok, out, options);
+    }
+
+    // rescore 的异步版本 (历史记录重评分一般用 priority: 'background')
+    Napi::Value RescoreAsync(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        uint64_t key = 0;
+        std::string text;
+        AnalyzeOptions options;
+        if (!ParseRescoreArgs(info, key, text, options))
+        {
+            return env.Null();
+        }
+
+        return Schedule(env, options, [this, key, text, options](ModelRunner &runner, const CancelToken *cancel, AnalyzeOutcome &out) {
+            return RescoreCached(runner, key, text, options, cancel, out);
+        });
+    }
+
+    // 把缓存的推理结果存档: saveEmissions(audioHandle, path, [{ encoding: 'fp32' | 'fp16' | 'int8', topK }])
+    // 默认 fp32 稠密 (打开时零拷贝)；fp16 / int8 体积更小但打开时要解码；
+    // topK > 0 时每帧只保留概率最高的 topK 个 token (有损，体积更小)
+    Napi::Value SaveEmissions(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString())
+        {
+            Napi::TypeError::New(env, "Expected (audioHandle, path, [options])").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        uint64_t key = 0;
+        if (!parseAudioHandle(info[0].As<Napi::String>(), key))
+        {
+            Napi::TypeError::New(env, "Invalid audio handle").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        std::string path = info[1].As<Napi::String>();
+
+        EmissionFileInfo fileInfo;
+        if (info.Length() >= 3 && info[2].IsObject())
+        {
+            Napi::Object obj = info[2].As<Napi::Object>();
+            if (obj.Has("encoding") && obj.Get("encoding").IsString() &&
+                !parseEmissionEncoding(obj.Get("encoding").As<Napi::String>(), fileInfo.encoding))
+            {
+                Napi::TypeError::New(env, "encoding must be one of: fp32, fp16, int8").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            if (obj.Has("topK") && obj.Get("topK").IsNumber())
+            {
+                fileInfo.top_k = obj.Get("topK").As<Napi::Number>().Int32Value();
+            }
+        }
+
+        if (!SyncEngine(env, language_))
+        {
+            return env.Null();
+        }
+        std::shared_ptr<const EmissionMatrix> emissions = FindCached(key, *engine_);
+        if (!emissions)
+        {
+            Napi::Error::New(env, "Audio handle is no longer cached").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        fileInfo.model_hash = engine_->getModelHash();
+        fileInfo.vocab_hash = engine_->getVocab().fingerprint();
+        fileInfo.audio_samples = emissions->audio_samples;
+        if (!writeEmissionFile(path, emissions->view(), fileInfo))
+        {
+            Napi::Error::New(env, "Failed to write emission file").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        return env.Undefined();
+    }
+
+    // 解析 analyzeEmissions 的参数，参数不对时抛出 TypeError 并返回 false
+    bool ParseEmissionArgs(const Napi::CallbackInfo &info, std::string &path, std::string &text, AnalyzeOptions &options)
+    {
+        if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString())
+        {
+            Napi::TypeError::New(info.Env(), "Expected (path, text, [options])").ThrowAsJavaScriptException();
+            return false;
+        }
+        path = info[0].As<Napi::String>().Utf8Value();
+        text = info[1].As<Napi::String>().Utf8Value();
+        options = ReadOptions(info, 2);
+        return true;
+    }
+
+    // 打开存档并评分，词表不一致时失败；模型不一致时只警告 (例如模型升级后复核旧录音)
+    bool ScoreEmissionFile(const ModelRunner &model, const std::string &path, const std::string &text, const AnalyzeOptions &options,
+                           const CancelToken *cancel, AnalyzeOutcome &out)
+    {
+        ScopedStageTimer frontend_timer(&out.timings, Stage::FrontEnd);
+        EmissionFile file;
+        if (!file.open(path))
+        {
+            out.error = "Failed to open emission file";
+            return false;
+        }
+        frontend_timer.stop();
+
+        if (file.info().vocab_hash != model.getVocab().fingerprint())
+        {
+            out.error = "Emission file was produced with a different vocab";
+            return false;
+        }
+        if (file.info().model_hash != model.getModelHash())
+        {
+            LOG_WARNING("[Warning] Emission file " << path << " was produced by a different model.");
+        }
+        return ScoreEmissions(model, file.view(), file.info().audio_samples, true, text, options, cancel, out);
+    }
+
+    // 直接对存档评分，不经过模型: analyzeEmissions(path, text, [options])
+    Napi::Value AnalyzeEmissions(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        std::string path, text;
+        AnalyzeOptions options;
+        if (!ParseEmissionArgs(info, path, text, options))
+        {
+            return env.Null();
+        }
+
+        if (!SyncEngine(env, options.language))
+        {
+            return env.Null();
+        }
+        AnalyzeOutcome out;
+        bool ok = RunWithCancel(options, out, [&](const CancelToken *cancel) { return ScoreEmissionFile(*engine_, path, text, options, cancel, out); });
+        return Finish(env, ok, out, options);
+    }
+
+    // analyzeEmissions 的异步版本
+    Napi::Value AnalyzeEmissionsAsync(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        std::string path, text;
+        AnalyzeOptions options;
+        if (!ParseEmissionArgs(info, path, text, options))
+        {
+            return env.Null();
+        }
+
+        return Schedule(env, options, [this, path, text, options](ModelRunner &runner, const CancelToken *cancel, AnalyzeOutcome &out) {
+            return ScoreEmissionFile(runner, path, text, options, cancel, out);
+        });
+    }
+
+    // 一次后台模型加载：完成后回到 JS 线程兑现 Promise
+    struct ReloadJob
+    {
+        ReloadJob(Napi::Env env, Napi::Object engine)
+            : self(Napi::Persistent(engine)), deferred(Napi::Promise::Deferred::New(env))
+        {
+        }
+
+        Napi::ObjectReference self; // 加载完成前引擎对象不会被回收
+        Napi::Promise::Deferred deferred;
+        Napi::ThreadSafeFunction tsfn;
+        bool ok = false;
+        uint64_t version = 0;
+    };
+
+    /**
+     * 模型热切换: reloadModel(modelPath, [vocabPath]) -> Promise<{ version, hash }>
+     * 在后台线程加载新模型 (vocabPath 省略时沿用当前词表文件)，加载完成后原子替换：
+     * 之后开始的请求用新模型，正在进行的请求在旧模型上跑完，旧模型在最后一个请求结束后卸载。
+     * 加载失败时继续用旧模型；已有加载在进行时以 code 'EBUSY' 拒绝
+     */
+    Napi::Value ReloadModel(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsString())
+        {
+            Napi::TypeError::New(env, "Expected (modelPath, [vocabPath])").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        ModelSource source = models_.source();
+        source.model_path = info[0].As<Napi::String>().Utf8Value();
+        if (info.Length() >= 2 && info[1].IsString())
+        {
+            source.vocab_path = info[1].As<Napi::String>().Utf8Value();
+        }
+
+        ReloadJob *job = new ReloadJob(env, Value());
+        job->tsfn = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}),
+                                                  "SpeechEngine.reloadModel", 0, 1);
+        Napi::Promise promise = job->deferred.Promise();
+
+        bool started = models_.loadAsync(source, [this, job](bool ok, uint64_t version) {
+            job->ok = ok;
+            job->version = version;
+            Napi::ThreadSafeFunction tsfn = job->tsfn;
+            tsfn.BlockingCall(job, [this](Napi::Env env, Napi::Function, ReloadJob *job) {
+                if (job->ok)
+                {
+                    // 旧模型的推理结果不会再命中 (见 FindCached)，直接释放掉
+                    cache_.clear();
+                    ReleaseStaleEngineModel();
+                    Napi::Object result = Napi::Object::New(env);
+                    result.Set("version", (double)job->version);
+                    result.Set("hash", formatHashHex(models_.acquire()->getModelHash()));
+                    job->deferred.Resolve(result);
+                }
+                else
+                {
+                    job->deferred.Reject(Napi::Error::New(env, "Failed to load model").Value());
+                }
+                delete job;
+            });
+            tsfn.Release();
+        });
+
+        if (!started)
+        {
+            Napi::Error err = Napi::Error::New(env, "A model is already loading");
+            err.Value().Set("code", "EBUSY");
+            job->deferred.Reject(err.Value());
+            job->tsfn.Release();
+            delete job;
+        }
+        return promise;
+    }
+
+    // 为一个语言注册单独的模型: registerModel(language, modelPath, vocabPath, [voice])
+    // 只记录路径，setLanguage(language) 之后的第一个请求才加载；voice 为该语言使用的 espeak 口音 (默认同 language)
+    Napi::Value RegisterModel(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 3 || !info[0].IsString() || !info[1].IsString() || !info[2].IsString())
+        {
+            Napi::TypeError::New(env, "Expected (language, modelPath, vocabPath, [voice])").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        // 线程配置和默认模型一致
+        ModelSource source = models_.source();
+        source.model_path = info[1].As<Napi::String>().Utf8Value();
+        source.vocab_path = info[2].As<Napi::String>().Utf8Value();
+        std::string voice;
+        if (info.Length() >= 4 && info[3].IsString())
+        {
+            voice = info[3].As<Napi::String>().Utf8Value();
+        }
+        registry_.registerLanguage(info[0].As<Napi::String>().Utf8Value(), source, voice);
+        ReleaseStaleEngineModel();
+        return env.Undefined();
+    }
+
+    // 注册表常驻模型的内存预算: setModelMemoryBudget(bytes)，0 表示不限制
+    Napi::Value SetModelMemoryBudget(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber())
+        {
+            Napi::TypeError::New(env, "Expected a byte count").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        double bytes = info[0].As<Napi::Number>().DoubleValue();
+        registry_.setBudget(bytes > 0 ? (size_t)bytes : 0);
+        ReleaseStaleEngineModel();
+        return env.Undefined();
+    }
+
+    // 引擎级聚合统计：请求数、失败数、各阶段耗时分布 (最近 1024 次的 p50/p95/p99) 和计数器累计
+    Napi::Value GetStats(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+        PipelineStats::Snapshot snap = stats_.snapshot();
+
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("requests", (double)snap.requests);
+        obj.Set("failures", (double)snap.failures);
+        obj.Set("cancelled", (double)snap.cancelled);
+
+        Napi::Object stages = Napi::Object::New(env);
+        for (int s = 0; s < STAGE_COUNT; ++s)
+        {
+            const StageSummary &st = snap.stages[s];
+            Napi::Object sObj = Napi::Object::New(env);
+            sObj.Set("count", (double)st.count);
+            sObj.Set("mean_ms", st.mean);
+            sObj.Set("p50_ms", st.p50);
+            sObj.Set("p95_ms", st.p95);
+            sObj.Set("p99_ms", st.p99);
+            sObj.Set("max_ms", st.max);
+            stages.Set(stageName((Stage)s), sObj);
+        }
+        obj.Set("stages", stages);
+
+        Napi::Object counters = Napi::Object::New(env);
+        counters.Set("input_samples", (double)snap.input_samples);
+        counters.Set("audio_samples", (double)snap.audio_samples);
+        counters.Set("frames", (double)snap.frames);
+        counters.Set("states", (double)snap.states);
+        counters.Set("bytes_allocated", (double)snap.bytes_allocated);
+        counters.Set("max_bytes_allocated", (double)snap.max_bytes_allocated);
+        obj.Set("counters", counters);
+
+        EmissionCache::Stats cs = cache_.stats();
+        Napi::Object cache = Napi::Object::New(env);
+        cache.Set("hits", (double)cs.hits);
+        cache.Set("misses", (double)cs.misses);
+        cache.Set("evictions", (double)cs.evictions);
+        cache.Set("entries", (double)cs.entries);
+        cache.Set("bytes", (double)cs.bytes);
+        cache.Set("max_bytes", (double)cs.max_bytes);
+        cache.Set("max_entries", (double)cs.max_entries);
+        obj.Set("cache", cache);
+
+        // 调度器：各优先级的队列深度和排队等待时间分布
+        RequestScheduler::Stats ss = scheduler_->stats();
+        Napi::Object scheduler = Napi::Object::New(env);
+        scheduler.Set("workers", ss.workers);
+        scheduler.Set("max_background_running", ss.max_background_running);
+        for (int p = 0; p < PRIORITY_COUNT; ++p)
+        {
+            const RequestScheduler::ClassStats &c = ss.classes[p];
+            Napi::Object cObj = Napi::Object::New(env);
+            cObj.Set("queued", (double)c.queued);
+            cObj.Set("running", (double)c.running);
+            cObj.Set("max_queued", (double)c.max_queued);
+            cObj.Set("submitted", (double)c.submitted);
+            cObj.Set("rejected", (double)c.rejected);
+            cObj.Set("completed", (double)c.completed);
+            cObj.Set("wait_mean_ms", c.wait_ms.mean);
+            cObj.Set("wait_p50_ms", c.wait_ms.p50);
+            cObj.Set("wait_p95_ms", c.wait_ms.p95);
+            cObj.Set("wait_p99_ms", c.wait_ms.p99);
+            cObj.Set("wait_max_ms", c.wait_ms.max);
+            scheduler.Set(priorityName((Priority)p), cObj);
+        }
+        obj.Set("scheduler", scheduler);
+
+        std::shared_ptr<const ModelRunner> current = models_.acquire();
+        Napi::Object model = Napi::Object::New(env);
+        model.Set("version", (double)current->getModelVersion());
+        model.Set("path", models_.source().model_path);
+        model.Set("hash", formatHashHex(current->getModelHash()));
+        model.Set("loading", models_.isLoading());
+        obj.Set("model", model);
+
+        // 准入控制：预算、各决定的次数和当前的耗时系数
+        CostModel::Stats as = cost_.stats();
+        Napi::Object admission = Napi::Object::New(env);
+        admission.Set("max_bytes", (double)admission_.max_bytes);
+        admission.Set("max_ms", admission_.max_ms);
+        admission.Set("over_budget", admission_.degrade ? "degrade" : "reject");
+        for (int d = 0; d < 3; ++d)
+        {
+            admission.Set(admissionDecisionName((AdmissionDecision)d), (double)as.decisions[d]);
+        }
+        admission.Set("inference_ms_per_frame", as.coefficients.inference_ms_per_frame);
+        admission.Set("align_ns_per_cell", as.coefficients.align_ns_per_cell);
+        obj.Set("admission", admission);
+
+        // 按语言的模型注册表：常驻情况、加载/淘汰次数和最近的事件
+        ModelRegistry::Stats rs = registry_.stats();
+        Napi::Object registry = Napi::Object::New(env);
+        registry.Set("budget_bytes", (double)rs.budget_bytes);
+        registry.Set("resident_bytes", (double)rs.resident_bytes);
+        registry.Set("loads", (double)rs.loads);
+        registry.Set("load_failures", (double)rs.load_failures);
+        registry.Set("evictions", (double)rs.evictions);
+        Napi::Object languages = Napi::Object::New(env);
+        for (const auto &l : rs.languages)
+        {
+            Napi::Object lObj = Napi::Object::New(env);
+            lObj.Set("model_path", l.model_path);
+            lObj.Set("voice", l.voice);
+            lObj.Set("resident", l.resident);
+            lObj.Set("bytes", (double)l.bytes);
+            lObj.Set("loads", (double)l.loads);
+            lObj.Set("evictions", (double)l.evictions);
+            lObj.Set("hits", (double)l.hits);
+            languages.Set(l.language, lObj);
+        }
+        registry.Set("languages", languages);
+        Napi::Array events = Napi::Array::New(env, rs.events.size());
+        for (size_t i = 0; i < rs.events.size(); ++i)
+        {
+            const ModelEvent &e = rs.events[i];
+            Napi::Object eObj = Napi::Object::New(env);
+            eObj.Set("type", modelEventName(e.type));
+            eObj.Set("language", e.language);
+            eObj.Set("bytes", (double)e.bytes);
+            if (e.type == ModelEventType::Load)
+            {
+                eObj.Set("load_ms", e.load_ms);
+            }
+            eObj.Set("time", (double)e.unix_ms);
+            events[i] = eObj;
+        }
+        registry.Set("events", events);
+        obj.Set("registry", registry);
+
+        return obj;
+    }
+    // 设置推理结果缓存的上限: setCacheLimits(maxBytes, [maxEntries])，maxBytes 为 0 表示关闭缓存
+    Napi::Value SetCacheLimits(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber())
+        {
+            Napi::TypeError::New(env, "Expected (maxBytes, [maxEntries])").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        double max_bytes = info[0].As<Napi::Number>().DoubleValue();
+        double max_entries = (double)EMISSION_CACHE_DEFAULT_ENTRIES;
+        if (info.Length() >= 2 && info[1].IsNumber())
+        {
+            max_entries = info[1].As<Napi::Number>().DoubleValue();
+        }
+        cache_.setLimits(max_bytes > 0 ? (size_t)max_bytes : 0, max_entries > 0 ? (size_t)max_entries : 0);
+        return env.Undefined();
+    }
+    Napi::Value ClearCache(const Napi::CallbackInfo &info)
+    {
+        cache_.clear();
+        return info.Env().Undefined();
+    }
+    Napi::Value ResetStats(const Napi::CallbackInfo &info)
+    {
+        stats_.reset();
+        cost_.resetStats();
+        return info.Env().Undefined();
+    }
+    // 开启 ORT 算子级 profiling: startProfiling(runs, [tracePrefix])
+    Napi::Value StartProfiling(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber())
+        {
+            Napi::TypeError::New(env, "Expected run count").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        int runs = info[0].As<Napi::Number>().Int32Value();
+        std::string prefix;
+        if (info.Length() >= 2 && info[1].IsString())
+        {
+            prefix = info[1].As<Napi::String>();
+        }
+
+        if (!SyncEngine(env, language_))
+        {
+            return env.Null();
+        }
+        if (!engine_->startProfiling(runs, prefix))
+        {
+            Napi::Error::New(env, "Failed to start profiling").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        return env.Undefined();
+    }
+    Napi::Value StopProfiling(const Napi::CallbackInfo &info)
+    {
+        return Napi::Boolean::New(info.Env(), engine_->stopProfiling());
+    }
+    // 最近一次 profiling 的热点报告，没有时返回 null
+    Napi::Value GetProfileReport(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+        if (!engine_->hasProfileReport())
+        {
+            return env.Null();
+        }
+
+        const ProfileReport &r = engine_->getProfileReport();
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("runs", r.runs);
+        obj.Set("model_run_us", r.model_run_us);
+        obj.Set("kernel_us", r.kernel_us);
+        obj.Set("categories", ProfileEntriesToArray(env, r.categories));
+        obj.Set("op_types", ProfileEntriesToArray(env, r.op_types));
+        obj.Set("nodes", ProfileEntriesToArray(env, r.nodes));
+        if (!r.trace_path.empty())
+        {
+            obj.Set("trace_path", r.trace_path);
+        }
+        return obj;
+    }
+    // 设置原生日志级别: "debug" / "info" / "warning" / "error" / "off"
+    Napi::Value SetLogLevel(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        LogLevel level;
+        if (info.Length() < 1 || !info[0].IsString() || !parseLogLevel(info[0].As<Napi::String>(), level))
+        {
+            Napi::TypeError::New(env, "Expected one of: debug, info, warning, error, off").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        setLogLevel(level);
+        return env.Undefined();
+    }
+    Napi::Value Phonemize(const Napi::CallbackInfo &info)
     {
         Napi::Env env = info.Env();
 
@@ -240,6 +1767,113 @@ private:
         std::string phones = phonemizer_->convertToIPA(text);
         return Napi::String::New(env, phones);
     }
+    // analyze 返回值里的 words 转回对齐结果 (只取切片需要的得分和帧号)
+    static std::vector<WordAnalysis> WordsFromResult(const Napi::Object &result)
+    {
+        std::vector<WordAnalysis> words;
+        if (!result.Has("words") || !result.Get("words").IsArray())
+            return words;
+
+        Napi::Array wordsArr = result.Get("words").As<Napi::Array>();
+        words.resize(wordsArr.Length());
+        for (uint32_t i = 0; i < wordsArr.Length(); ++i)
+        {
+            if (!wordsArr.Get(i).IsObject())
+                continue;
+            Napi::Object wObj = wordsArr.Get(i).As<Napi::Object>();
+            WordAnalysis &w = words[i];
+            if (wObj.Get("word").IsString())
+                w.word = wObj.Get("word").As<Napi::String>();
+            w.word_score = wObj.Get("score").IsNumber() ? wObj.Get("score").As<Napi::Number>().FloatValue() : SCORE_FLOOR;
+            w.skipped = wObj.Get("skipped").IsBoolean() && wObj.Get("skipped").As<Napi::Boolean>();
+            if (!wObj.Get("phonemes").IsArray())
+                continue;
+
+            Napi::Array pArr = wObj.Get("phonemes").As<Napi::Array>();
+            for (uint32_t j = 0; j < pArr.Length(); ++j)
+            {
+                if (!pArr.Get(j).IsObject())
+                    continue;
+                Napi::Object pObj = pArr.Get(j).As<Napi::Object>();
+                if (!pObj.Get("start_frame").IsNumber() || !pObj.Get("end_frame").IsNumber())
+                    continue;
+                PhonemeDetail d;
+                d.start_frame = pObj.Get("start_frame").As<Napi::Number>().Int32Value();
+                d.end_frame = pObj.Get("end_frame").As<Napi::Number>().Int32Value();
+                w.details.push_back(d);
+            }
+        }
+        return words;
+    }
+
+    // 按 analyze 的结果切出得分最低的几个词的音频: sliceWords(pcmData, sampleRate, channels, result, [options])
+    // options: { maxClips, padMs, maxScore }。直接从传入的原始 PCM 上切 (不重新解码、不重采样)，
+    // 每段编码成 16-bit 单声道 WAV，返回 [{ words, text, score, start_ms, end_ms, wav }] (按时间顺序)
+    Napi::Value SliceWords(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 4 || !info[0].IsTypedArray() || !info[1].IsNumber() || !info[2].IsNumber() || !info[3].IsObject())
+        {
+            Napi::TypeError::New(env, "Expected (pcmData, sampleRate, channels, result, [options])").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Float32Array pcmData = info[0].As<Napi::Float32Array>();
+        int sampleRate = info[1].As<Napi::Number>().Int32Value();
+        int channels = info[2].As<Napi::Number>().Int32Value();
+        if (sampleRate <= 0 || channels <= 0)
+        {
+            Napi::RangeError::New(env, "Invalid sample rate or channel count").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        ClipOptions options;
+        if (info.Length() >= 5 && info[4].IsObject())
+        {
+            Napi::Object obj = info[4].As<Napi::Object>();
+            if (obj.Has("maxClips") && obj.Get("maxClips").IsNumber())
+            {
+                options.max_clips = obj.Get("maxClips").As<Napi::Number>().Int32Value();
+            }
+            if (obj.Has("padMs") && obj.Get("padMs").IsNumber())
+            {
+                options.pad_ms = obj.Get("padMs").As<Napi::Number>().Int32Value();
+            }
+            if (obj.Has("maxScore") && obj.Get("maxScore").IsNumber())
+            {
+                options.max_score = obj.Get("maxScore").As<Napi::Number>().FloatValue();
+            }
+        }
+
+        std::vector<WordAnalysis> words = WordsFromResult(info[3].As<Napi::Object>());
+        size_t totalFrames = pcmData.ElementLength() / channels;
+        std::vector<WordClip> clips = planWordClips(words, totalFrames, sampleRate, options);
+
+        Napi::Array arr = Napi::Array::New(env, clips.size());
+        std::vector<uint8_t> wav;
+        for (size_t i = 0; i < clips.size(); ++i)
+        {
+            const WordClip &clip = clips[i];
+            encodeWavClip(pcmData.Data(), channels, sampleRate, clip.begin, clip.end, wav);
+
+            Napi::Object cObj = Napi::Object::New(env);
+            Napi::Array wArr = Napi::Array::New(env, clip.words.size());
+            for (size_t k = 0; k < clip.words.size(); ++k)
+            {
+                wArr[k] = Napi::Number::New(env, clip.words[k]);
+            }
+            cObj.Set("words", wArr);
+            cObj.Set("text", clip.text);
+            cObj.Set("score", clip.score);
+            cObj.Set("start_ms", clip.begin * 1000.0 / sampleRate);
+            cObj.Set("end_ms", clip.end * 1000.0 / sampleRate);
+            cObj.Set("wav", Napi::Buffer<uint8_t>::Copy(env, wav.data(), wav.size()));
+            arr[i] = cObj;
+        }
+        return arr;
+    }
+
     Napi::Value SetLanguage(const Napi::CallbackInfo &info)
     {
         Napi::Env env = info.Env();
@@ -251,12 +1885,35 @@ private:
         }
 
         std::string lang = info[0].As<Napi::String>();
-        bool success = phonemizer_->setVoice(lang);
+        bool success = phonemizer_->setVoice(registry_.voiceFor(lang));
         if (!success)
         {
             Napi::Error::New(env, "Failed to set language/voice").ThrowAsJavaScriptException();
             return env.Null();
         }
+        language_ = lang;
+        active_thresholds_ = thresholds_.select(language_);
+        return env.Undefined();
+    }
+    // 加载按口音/音素的阈值表 (thresholds.json)，立即按当前口音生效，不需要重建
+    Napi::Value LoadThresholds(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsString())
+        {
+            Napi::TypeError::New(env, "Expected a path to thresholds.json").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        ThresholdSet loaded;
+        if (!loaded.loadFromJson(info[0].As<Napi::String>()))
+        {
+            Napi::Error::New(env, "Failed to load thresholds").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        thresholds_ = std::move(loaded);
+        active_thresholds_ = thresholds_.select(language_);
         return env.Undefined();
     }
 };
@@ -264,7 +1921,10 @@ private:
 // 模块注册入口
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
-    return SpeechEngine::Init(env, exports);
+    AddonData *data = new AddonData();
+    env.SetInstanceData(data);
+    JsCancelToken::Init(env, exports, data);
+    return SpeechEngine::Init(env, exports, data);
 }
 
 NODE_API_MODULE(speech_node, Init)
\ No newline at end of file
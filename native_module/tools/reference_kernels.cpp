@@ -0,0 +1,426 @@
+#include "reference_kernels.h"
+#include "AudioFrontEnd.h"
+#include "Thresholds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string_view>
+
+namespace reference {
+
+// 与 Align.cpp 的 NEG_INF 相同
+static const float NEG_INF = -1e9f;
+
+void logSoftmax(float* logits, int time_steps, int vocab_size)
+{
+    for (int t = 0; t < time_steps; ++t) {
+        float* frame_data = logits + (size_t)t * vocab_size;
+
+        float max_val = -std::numeric_limits<float>::infinity();
+        for (int v = 0; v < vocab_size; ++v) {
+            if (frame_data[v] > max_val) max_val = frame_data[v];
+        }
+
+        float sum_exp = 0.0f;
+        for (int v = 0; v < vocab_size; ++v) {
+            sum_exp += std::exp(frame_data[v] - max_val);
+        }
+
+        float log_sum_exp = std::log(sum_exp);
+        for (int v = 0; v < vocab_size; ++v) {
+            frame_data[v] = (frame_data[v] - max_val) - log_sum_exp;
+        }
+    }
+}
+
+void mixToMono(std::vector<float>& audio, unsigned int channels, size_t total_frames)
+{
+    if (channels == 1) return;
+
+    for (size_t i = 0; i < total_frames; ++i) {
+        float sum = 0.0f;
+        for (unsigned int c = 0; c < channels; ++c) {
+            sum += audio[i * channels + c];
+        }
+        audio[i] = sum / channels;
+    }
+    audio.erase(audio.begin() + total_frames, audio.end());
+}
+
+void resampleAudio(std::vector<float>& audio, unsigned int src_rate)
+{
+    if (src_rate == TARGET_SAMPLE_RATE) return;
+
+    double ratio = (double)src_rate / TARGET_SAMPLE_RATE;
+    size_t output_size = (size_t)(audio.size() / ratio);
+
+    std::vector<float> resampled(output_size);
+    for (size_t i = 0; i < output_size; ++i) {
+        double src_index = i * ratio;
+        size_t idx = (size_t)std::floor(src_index);
+        float frac = (float)(src_index - idx);
+        if (idx + 1 < audio.size()) {
+            resampled[i] = audio[idx] * (1.0f - frac) + audio[idx + 1] * frac;
+        }
+        else {
+            resampled[i] = audio[idx];
+        }
+    }
+    audio = std::move(resampled);
+}
+
+static size_t utf8Length(unsigned char c)
+{
+    if ((c & 0x80) == 0) return 1;
+    if ((c & 0xE0) == 0xC0) return 2;
+    if ((c & 0xF0) == 0xE0) return 3;
+    if ((c & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+static bool endsWithLongMark(std::string_view s)
+{
+    return s.size() >= 2 && (unsigned char)s[s.size() - 2] == 0xCB && (unsigned char)s[s.size() - 1] == 0x90;
+}
+
+std::vector<std::string> tokenizeIPA(const std::string& raw_ipa, const Vocab& vocab)
+{
+    // 1. 去掉重音符、空格、下划线和不换行空格；末尾截断的 UTF-8 字符连同后面的内容一起丢掉
+    std::string clean;
+    for (size_t i = 0; i < raw_ipa.size();) {
+        size_t len = utf8Length((unsigned char)raw_ipa[i]);
+        if (i + len > raw_ipa.size()) break;
+        std::string_view symbol(raw_ipa.data() + i, len);
+        if (symbol != "ˈ" && symbol != "ˌ" && symbol != " " && symbol != "_" && symbol != "\u00A0") {
+            clean.append(symbol.data(), symbol.size());
+        }
+        i += len;
+    }
+
+    // 2. 从长到短 (最多 8 字节) 最大正向匹配；后面紧跟长音符时不接受没带长音符的切分
+    std::vector<std::string> tokens;
+    std::string_view view(clean);
+    for (size_t i = 0; i < clean.size();) {
+        size_t max_len = std::min<size_t>(std::min<size_t>(8, vocab.maxTokenBytes()), clean.size() - i);
+        size_t matched = 0;
+        for (size_t len = max_len; len >= 1; --len) {
+            std::string_view sub = view.substr(i, len);
+            if (!vocab.contains(sub)) continue;
+            bool next_is_colon = i + len + 1 < clean.size() && endsWithLongMark(view.substr(i + len, 2));
+            if (next_is_colon && !endsWithLongMark(sub)) continue;
+            matched = len;
+            break;
+        }
+
+        if (matched > 0) {
+            tokens.emplace_back(view.substr(i, matched));
+            i += matched;
+        }
+        else {
+            i += utf8Length((unsigned char)clean[i]);
+        }
+    }
+    return tokens;
+}
+
+bool calculateGOP(const EmissionView& em, const Vocab& vocab, std::vector<WordAnalysis>& words, int blank_idx)
+{
+    if (words.empty()) return false;
+
+    // 1. 扁平化目标序列，词表外的音素跳过
+    struct Target {
+        int word;
+        int token_id;
+        std::string text;
+    };
+    std::vector<Target> targets;
+    for (size_t w = 0; w < words.size(); ++w) {
+        words[w].details.clear();
+        words[w].word_score = 0.0f;
+        words[w].variant = 0;
+        words[w].skipped = false;
+        for (const auto& p : words[w].phonemes) {
+            int id = vocab.find(p);
+            if (id >= 0) targets.push_back({ (int)w, id, p });
+        }
+    }
+    if (targets.empty()) return false;
+
+    // 2. 扩展状态 [b, A, b, B, b]
+    std::vector<int> states;
+    states.reserve(targets.size() * 2 + 1);
+    for (const auto& t : targets) {
+        states.push_back(blank_idx);
+        states.push_back(t.token_id);
+    }
+    states.push_back(blank_idx);
+
+    const int T = em.frames;
+    const int S = (int)states.size();
+    if (T <= 0) return false;
+
+    // 3. 完整 DP 表和回溯表
+    std::vector<float> dp((size_t)T * S, NEG_INF);
+    std::vector<int> backtrack((size_t)T * S, -1);
+    dp[0] = em.logProb(0, states[0]);
+    if (S > 1) dp[1] = em.logProb(0, states[1]);
+
+    for (int t = 1; t < T; ++t) {
+        const float* prev = dp.data() + (size_t)(t - 1) * S;
+        for (int s = 0; s < S; ++s) {
+            int token = states[s];
+            float best = NEG_INF;
+            int best_prev = -1;
+
+            if (prev[s] > NEG_INF && prev[s] > best) {
+                best = prev[s];
+                best_prev = s;
+            }
+            if (s > 0 && prev[s - 1] > NEG_INF && prev[s - 1] > best) {
+                best = prev[s - 1];
+                best_prev = s - 1;
+            }
+            if (s > 1 && token != blank_idx && states[s - 1] == blank_idx && states[s - 2] != token &&
+                prev[s - 2] > NEG_INF && prev[s - 2] > best) {
+                best = prev[s - 2];
+                best_prev = s - 2;
+            }
+
+            if (best_prev != -1) {
+                dp[(size_t)t * S + s] = best + em.logProb(t, token);
+                backtrack[(size_t)t * S + s] = best_prev;
+            }
+        }
+    }
+
+    // 4. 终点：最后一个 blank 或最后一个音素，相同时取音素
+    const float* last = dp.data() + (size_t)(T - 1) * S;
+    float score_blank = last[S - 1];
+    float score_last = S > 1 ? last[S - 2] : NEG_INF;
+    int current_s = score_blank > score_last ? S - 1 : S - 2;
+    if (current_s < 0 || last[current_s] <= NEG_INF) return false;
+
+    std::vector<int> path(T);
+    for (int t = T - 1; t >= 0; --t) {
+        path[t] = current_s;
+        current_s = backtrack[(size_t)t * S + current_s];
+    }
+
+    // 5. 每个音素在路径上的时间跨度和平均对数概率
+    for (size_t i = 0; i < targets.size(); ++i) {
+        const Target& target = targets[i];
+        int state = (int)i * 2 + 1;
+
+        PhonemeDetail detail;
+        detail.ipa = target.text;
+        detail.token_id = target.token_id;
+        float sum = 0.0f;
+        int count = 0;
+        for (int t = 0; t < T; ++t) {
+            if (path[t] != state) continue;
+            if (detail.start_frame == -1) detail.start_frame = t + em.frame_offset;
+            detail.end_frame = t + em.frame_offset;
+            sum += em.logProb(t, target.token_id);
+            count++;
+        }
+        detail.score = count > 0 ? sum / count : SCORE_FLOOR;
+        detail.is_good = detail.score > THRESHOLD_GOOD;
+        detail.is_excellent = detail.score > THRESHOLD_EXCELLENT;
+        words[target.word].details.push_back(detail);
+    }
+
+    // 6. 单词平均分 (不计没检测到的音素)
+    for (auto& w : words) {
+        float total = 0.0f;
+        int valid = 0;
+        for (const auto& d : w.details) {
+            if (d.score > SCORE_UNDETECTED) {
+                total += d.score;
+                valid++;
+            }
+        }
+        w.word_score = valid > 0 ? total / valid : SCORE_FLOOR;
+    }
+    return true;
+}
+
+// 线性 CTC 链上的一个状态。optional 的 blank 可以被跳过 (相邻音素不同时)，非 optional 的 blank 至少占一帧
+struct ChainState {
+    int token;
+    bool optional;
+};
+
+// 链上的 Viterbi，转移顺序和终点规则与 calculateGOP 相同
+static bool chainViterbi(const EmissionView& em, const std::vector<ChainState>& states, int blank_idx,
+                         std::vector<int>& path, float& score)
+{
+    const int T = em.frames;
+    const int S = (int)states.size();
+    if (T <= 0 || S == 0) return false;
+
+    auto skippable = [&](int s) { return states[s].token == blank_idx && states[s].optional; };
+
+    std::vector<float> dp((size_t)T * S, NEG_INF);
+    std::vector<int> backtrack((size_t)T * S, -1);
+    dp[0] = em.logProb(0, states[0].token);
+    if (S > 1 && skippable(0)) dp[1] = em.logProb(0, states[1].token);
+
+    for (int t = 1; t < T; ++t) {
+        const float* prev = dp.data() + (size_t)(t - 1) * S;
+        for (int s = 0; s < S; ++s) {
+            int token = states[s].token;
+            float best = NEG_INF;
+            int best_prev = -1;
+
+            if (prev[s] > NEG_INF && prev[s] > best) {
+                best = prev[s];
+                best_prev = s;
+            }
+            if (s > 0 && prev[s - 1] > NEG_INF && prev[s - 1] > best) {
+                best = prev[s - 1];
+                best_prev = s - 1;
+            }
+            if (s > 1 && token != blank_idx && skippable(s - 1) && states[s - 2].token != token &&
+                prev[s - 2] > NEG_INF && prev[s - 2] > best) {
+                best = prev[s - 2];
+                best_prev = s - 2;
+            }
+
+            if (best_prev != -1) {
+                dp[(size_t)t * S + s] = best + em.logProb(t, token);
+                backtrack[(size_t)t * S + s] = best_prev;
+            }
+        }
+    }
+
+    const float* last = dp.data() + (size_t)(T - 1) * S;
+    int current_s = S - 1;
+    if (S > 1 && skippable(S - 1) && !(last[S - 1] > last[S - 2])) current_s = S - 2;
+    if (last[current_s] <= NEG_INF) return false;
+    score = last[current_s];
+
+    path.assign(T, -1);
+    for (int t = T - 1; t >= 0; --t) {
+        path[t] = current_s;
+        current_s = backtrack[(size_t)t * S + current_s];
+    }
+    return true;
+}
+
+bool calculateGOPWithSkips(const EmissionView& em, const Vocab& vocab, std::vector<WordAnalysis>& words,
+                           float skip_penalty, int blank_idx)
+{
+    const size_t n = words.size();
+    if (n == 0 || n > 16) return false;
+
+    std::vector<std::vector<int>> tokens(n);
+    for (size_t w = 0; w < n; ++w) {
+        for (const auto& p : words[w].phonemes) {
+            int id = vocab.find(p);
+            if (id >= 0) tokens[w].push_back(id);
+        }
+        if (tokens[w].empty()) return false;
+    }
+
+    // 逐个枚举跳过的词 (bit w 为 1 表示跳过词 w)，取扣分后得分最高的
+    float best_score = NEG_INF;
+    uint32_t best_mask = 0;
+    std::vector<int> best_path, best_label_state;
+    bool found = false;
+    for (uint32_t mask = 0; mask < (1u << n); ++mask) {
+        auto blanks = [&](int count, bool optional, std::vector<ChainState>& chain) {
+            for (int k = 0; k < count; ++k) chain.push_back({ blank_idx, optional });
+        };
+        std::vector<ChainState> chain;
+        std::vector<int> label_state; // 未跳过的词的音素依次对应的链状态
+        int skipped = 0, run = 0;
+        bool any_kept = false;
+        for (size_t w = 0; w < n; ++w) {
+            if (mask & (1u << w)) {
+                skipped++;
+                run++;
+                continue;
+            }
+            // 跳过的词要穿过它们之间的词间 blank：开头连续 k 个至少 k 帧，中间连续 k (>= 2) 个至少 k - 1 帧
+            if (!any_kept) {
+                if (run == 0) blanks(1, true, chain);
+                else blanks(run, false, chain);
+            }
+            else if (run >= 2) blanks(run - 1, false, chain);
+            else blanks(1, true, chain);
+            run = 0;
+            any_kept = true;
+
+            for (size_t i = 0; i < tokens[w].size(); ++i) {
+                if (i > 0) blanks(1, true, chain);
+                label_state.push_back((int)chain.size());
+                chain.push_back({ tokens[w][i], true });
+            }
+        }
+        // 结尾连续 k 个至少 k 帧；全部跳过时经过所有 n + 1 个词间 blank
+        if (!any_kept) blanks((int)n + 1, false, chain);
+        else if (run == 0) blanks(1, true, chain);
+        else blanks(run, false, chain);
+
+        std::vector<int> path;
+        float score = 0.0f;
+        if (!chainViterbi(em, chain, blank_idx, path, score)) continue;
+        score -= skip_penalty * skipped;
+        if (!found || score > best_score) {
+            found = true;
+            best_score = score;
+            best_mask = mask;
+            best_path = std::move(path);
+            best_label_state = std::move(label_state);
+        }
+    }
+    if (!found) return false;
+
+    // 回填：跳过的词按标准发音列出音素并记最低分，其余与 calculateGOP 相同
+    size_t next_label = 0;
+    for (size_t w = 0; w < n; ++w) {
+        WordAnalysis& word = words[w];
+        word.details.clear();
+        word.variant = 0;
+        word.skipped = (best_mask & (1u << w)) != 0;
+        size_t k = 0;
+        for (const auto& p : word.phonemes) {
+            PhonemeDetail detail;
+            detail.ipa = p;
+            detail.token_id = vocab.find(p);
+            if (detail.token_id < 0) continue;
+            detail.score = SCORE_FLOOR;
+            if (!word.skipped) {
+                int state = best_label_state[next_label + k++];
+                float sum = 0.0f;
+                int count = 0;
+                for (int t = 0; t < em.frames; ++t) {
+                    if (best_path[t] != state) continue;
+                    if (detail.start_frame == -1) detail.start_frame = t + em.frame_offset;
+                    detail.end_frame = t + em.frame_offset;
+                    sum += em.logProb(t, detail.token_id);
+                    count++;
+                }
+                if (count > 0) detail.score = sum / count;
+                detail.is_good = detail.score > THRESHOLD_GOOD;
+                detail.is_excellent = detail.score > THRESHOLD_EXCELLENT;
+            }
+            word.details.push_back(detail);
+        }
+        next_label += k;
+
+        float total = 0.0f;
+        int valid = 0;
+        for (const auto& d : word.details) {
+            if (d.score > SCORE_UNDETECTED) {
+                total += d.score;
+                valid++;
+            }
+        }
+        word.word_score = valid > 0 ? total / valid : SCORE_FLOOR;
+    }
+    return true;
+}
+
+} // namespace reference
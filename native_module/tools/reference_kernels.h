@@ -0,0 +1,45 @@
+#pragma once
+
+// 冻结的参考实现 (speech_verify 用)
+// 基线提交 (4b5ad07 "baseline") 里 Align.cpp、ModelRunner.cpp 前端和 Phonemizer.cpp 分词的语义等价移植：
+// 改写到 Vocab / EmissionView 接口上，但保留原来的计算顺序和平局规则，只作为差分校验的标准答案。
+// calculateGOPWithSkips 是基线里没有的功能，按跳词规则穷举实现。
+// src/ 里的实现改快之后，用 speech_verify 对比两者的结果；这里的代码不要跟着改，
+// 除非有意修改了内核的行为 (那时连同校验容差一起更新，并在提交说明里写清楚)。
+
+#include <string>
+#include <vector>
+#include "Emission.h"
+#include "Phonemizer.h"
+#include "Vocab.h"
+
+namespace reference {
+
+// computeLogSoftmax：逐帧 max -> sum(exp) -> log，原地改写
+void logSoftmax(float* logits, int time_steps, int vocab_size);
+
+// mixToMono / resampleAudio：交错多声道取平均，线性插值重采样到 16k
+void mixToMono(std::vector<float>& audio, unsigned int channels, size_t total_frames);
+void resampleAudio(std::vector<float>& audio, unsigned int src_rate);
+
+// tokenizeIPA：去掉重音符和空格后按词表最大正向匹配，词表外的字符跳过
+std::vector<std::string> tokenizeIPA(const std::string& raw_ipa, const Vocab& vocab);
+
+/**
+ * calculateGOP (没有备选发音、不跳词、不分段时的行为)：
+ * 线性 CTC 扩展状态 [b, p1, b, p2, ..., b] 上的 Viterbi，转移顺序 停留 -> 前进 -> 跳过 blank，
+ * 得分相同时先检查的转移胜出；音素得分为对齐段内对数概率的平均，
+ * is_good / is_excellent 按内置阈值判定
+ */
+bool calculateGOP(const EmissionView& em, const Vocab& vocab, std::vector<WordAnalysis>& words, int blank_idx = 0);
+
+/**
+ * calculateGOP 开启整词跳过 (LatticeOptions::allow_skip) 时的行为，不经过发音格，直接穷举：
+ * 对每一种跳词组合在剩下的词上做线性 CTC Viterbi，每跳过一个词扣 skip_penalty，取总分最高的组合。
+ * 跳过的词仍要穿过词间 blank (开头或结尾连续 k 个词至少 k 帧，中间连续 k >= 2 个词至少 k - 1 帧)。
+ * 只支持没有备选发音、每个词都有有效音素的输入，词数不超过 16
+ */
+bool calculateGOPWithSkips(const EmissionView& em, const Vocab& vocab, std::vector<WordAnalysis>& words,
+                           float skip_penalty, int blank_idx = 0);
+
+} // namespace reference
@@ -0,0 +1,648 @@
+// 离线批量评分工具
+// 读取 manifest (JSONL: 每行 {"wav": 路径, "text": 参考文本, "id": 可选}) 或目录
+// (目录下每个 xxx.wav 配一个同名 xxx.txt 作为参考文本)，用线程池并行评分，
+// 按输入顺序输出 JSONL / CSV 结果，并统计吞吐量。
+//
+// 用法:
+//   speech_batch --model wav2vec2.onnx --vocab vocab.json --espeak <espeak-ng-data 父目录>
+//                (--manifest list.jsonl | --dir recordings/)
+//                [--out results.jsonl] [--format jsonl|csv] [--threads N]
+//                [--voice en-us] [--stats stats.json] [--detailed] [--segmented] [--verbose]
+//                [--save-emissions <dir> [--emission-encoding fp32|fp16|int8] [--emission-top-k N]]
+//                [--from-emissions <dir>] [--thresholds thresholds.json]
+//                [--precheck [--max-per 0.8]] [--beam N]
+//
+// --save-emissions 把每条录音的推理结果存成 <dir>/<id>.emis；之后阈值或参考文本变了，
+// 用 --from-emissions 直接从存档重新评分，不再加载模型、不再推理 (此时 --model 可省略)
+// 存档默认 fp32 稠密，读回时直接映射不解码；--emission-encoding fp16 / int8 体积更小，读回时解码成 fp32
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <json.hpp>
+
+#include "ModelRunner.h"
+#include "Phonemizer.h"
+#include "Align.h"
+#include "WavReader.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "EmissionFile.h"
+#include "Transcript.h"
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct BatchOptions {
+    std::string model_path;
+    std::string vocab_path;
+    std::string espeak_path;
+    std::string manifest_path;
+    std::string dir_path;
+    std::string out_path;     // 为空则写到 stdout
+    std::string stats_path;
+    std::string format = "jsonl";
+    std::string voice = "en-us";
+    int threads = 0;          // 0 = 硬件线程数
+    bool detailed = false;    // 扩展评分 (竞争音素、似然比 GOP、替换提示)
+    bool segmented = false;   // 长段落分段并行对齐
+    std::string save_emissions_dir; // 推理结果存档目录
+    std::string from_emissions_dir; // 从存档评分 (不推理)
+    EmissionEncoding emission_encoding = EmissionEncoding::Float32; // fp32 稠密存档打开时零拷贝
+    int emission_top_k = 0;
+    std::string thresholds_path;    // 按口音/音素的阈值表，按 --voice 选择
+    PrecheckOptions precheck;       // 自由解码预检，对不上的录音不做对齐
+    TranscriptOptions decode;
+    bool verbose = false;
+};
+
+struct BatchJob {
+    std::string id;
+    std::string wav_path;
+    std::string text;
+};
+
+struct BatchResult {
+    bool done = false;
+    bool ok = false;
+    std::string error;
+    std::vector<WordAnalysis> words;
+    float overall_score = SCORE_FLOOR;
+    double duration_sec = 0.0; // 音频时长 (16k 重采样后)
+    double elapsed_ms = 0.0;   // 单条处理耗时
+    bool prechecked = false;
+    bool mismatch = false;     // 预检判定音频和文本对不上，没有对齐
+    float phone_error_rate = 0.0f;
+    StageTimings timings;      // 分阶段耗时
+};
+
+static void printUsage()
+{
+    std::cerr << "Usage: speech_batch --model <onnx> --vocab <json> --espeak <dir>\n"
+              << "                    (--manifest <jsonl> | --dir <folder>)\n"
+              << "                    [--out <file>] [--format jsonl|csv] [--threads N]\n"
+              << "                    [--voice en-us] [--stats <json>] [--detailed] [--segmented] [--verbose]\n"
+              << "                    [--save-emissions <dir> [--emission-encoding fp32|fp16|int8] [--emission-top-k N]]\n"
+              << "                    [--from-emissions <dir>] [--thresholds <json>]\n"
+              << "                    [--precheck [--max-per 0.8]] [--beam N]" << std::endl;
+}
+
+static bool parseArgs(int argc, char** argv, BatchOptions& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&](std::string& dst) {
+            if (i + 1 >= argc) return false;
+            dst = argv[++i];
+            return true;
+        };
+
+        bool ok = true;
+        if (arg == "--model") ok = next(opt.model_path);
+        else if (arg == "--vocab") ok = next(opt.vocab_path);
+        else if (arg == "--espeak") ok = next(opt.espeak_path);
+        else if (arg == "--manifest") ok = next(opt.manifest_path);
+        else if (arg == "--dir") ok = next(opt.dir_path);
+        else if (arg == "--out") ok = next(opt.out_path);
+        else if (arg == "--stats") ok = next(opt.stats_path);
+        else if (arg == "--format") ok = next(opt.format);
+        else if (arg == "--voice") ok = next(opt.voice);
+        else if (arg == "--threads") {
+            std::string v;
+            ok = next(v);
+            if (ok) opt.threads = std::atoi(v.c_str());
+        }
+        else if (arg == "--detailed") opt.detailed = true;
+        else if (arg == "--segmented") opt.segmented = true;
+        else if (arg == "--thresholds") ok = next(opt.thresholds_path);
+        else if (arg == "--precheck") opt.precheck.enabled = true;
+        else if (arg == "--max-per") {
+            std::string v;
+            ok = next(v);
+            if (ok) opt.precheck.max_phone_error_rate = (float)std::atof(v.c_str());
+        }
+        else if (arg == "--beam") {
+            std::string v;
+            ok = next(v);
+            if (ok) opt.decode.beam_width = std::atoi(v.c_str());
+        }
+        else if (arg == "--save-emissions") ok = next(opt.save_emissions_dir);
+        else if (arg == "--from-emissions") ok = next(opt.from_emissions_dir);
+        else if (arg == "--emission-encoding") {
+            std::string v;
+            ok = next(v) && parseEmissionEncoding(v, opt.emission_encoding);
+        }
+        else if (arg == "--emission-top-k") {
+            std::string v;
+            ok = next(v);
+            if (ok) opt.emission_top_k = std::atoi(v.c_str());
+        }
+        else if (arg == "--verbose") opt.verbose = true;
+        else {
+            std::cerr << "[Error] Unknown argument: " << arg << std::endl;
+            return false;
+        }
+
+        if (!ok) {
+            std::cerr << "[Error] Missing value for " << arg << std::endl;
+            return false;
+        }
+    }
+
+    bool from_emissions = !opt.from_emissions_dir.empty();
+    if ((opt.model_path.empty() && !from_emissions) || opt.vocab_path.empty() || opt.espeak_path.empty()) return false;
+    if (from_emissions && !opt.save_emissions_dir.empty()) return false;
+    if (opt.manifest_path.empty() == opt.dir_path.empty()) return false;
+    if (opt.format != "jsonl" && opt.format != "csv") return false;
+    return true;
+}
+
+// 读取 JSONL manifest，相对路径按 manifest 所在目录解析
+static bool loadManifest(const std::string& path, std::vector<BatchJob>& jobs)
+{
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::cerr << "[Error] Cannot open manifest: " << path << std::endl;
+        return false;
+    }
+
+    fs::path base = fs::path(path).parent_path();
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(f, line)) {
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        try {
+            json j = json::parse(line);
+            BatchJob job;
+            job.wav_path = j.contains("wav") ? j["wav"].get<std::string>() : j.at("path").get<std::string>();
+            job.text = j.at("text").get<std::string>();
+            if (j.contains("id")) {
+                job.id = j["id"].is_string() ? j["id"].get<std::string>() : j["id"].dump();
+            }
+            else {
+                job.id = job.wav_path;
+            }
+
+            fs::path wav(job.wav_path);
+            if (wav.is_relative()) job.wav_path = (base / wav).string();
+            jobs.push_back(std::move(job));
+        }
+        catch (const json::exception& e) {
+            std::cerr << "[Warning] Skipping manifest line " << line_no << ": " << e.what() << std::endl;
+        }
+    }
+    return true;
+}
+
+// 扫描目录：xxx.wav + xxx.txt
+static bool loadDirectory(const std::string& dir, std::vector<BatchJob>& jobs)
+{
+    std::error_code ec;
+    std::vector<fs::path> wavs;
+    for (const auto& entry : fs::recursive_directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file()) continue;
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == ".wav") wavs.push_back(entry.path());
+    }
+    if (ec) {
+        std::cerr << "[Error] Cannot scan directory: " << dir << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+
+    // 保证输出顺序稳定
+    std::sort(wavs.begin(), wavs.end());
+
+    for (const auto& wav : wavs) {
+        fs::path txt = wav;
+        txt.replace_extension(".txt");
+        std::ifstream tf(txt);
+        if (!tf.is_open()) {
+            std::cerr << "[Warning] No reference text for " << wav.string() << std::endl;
+            continue;
+        }
+        std::stringstream ss;
+        ss << tf.rdbuf();
+        std::string text = ss.str();
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) text.pop_back();
+
+        BatchJob job;
+        job.id = fs::relative(wav, dir, ec).string();
+        job.wav_path = wav.string();
+        job.text = text;
+        jobs.push_back(std::move(job));
+    }
+    return true;
+}
+
+static json resultToJson(size_t index, const BatchJob& job, const BatchResult& r)
+{
+    json j;
+    j["index"] = index;
+    j["id"] = job.id;
+    j["wav"] = job.wav_path;
+    j["text"] = job.text;
+    j["ok"] = r.ok;
+    j["duration_sec"] = r.duration_sec;
+    j["elapsed_ms"] = r.elapsed_ms;
+    json tj;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        if (r.timings.measured[s]) tj[std::string(stageName((Stage)s)) + "_ms"] = r.timings.ms[s];
+    }
+    j["timings"] = tj;
+    if (!r.ok) {
+        j["error"] = r.error;
+        return j;
+    }
+
+    j["overall_score"] = r.overall_score;
+    if (r.prechecked) {
+        j["mismatch"] = r.mismatch;
+        j["phone_error_rate"] = r.phone_error_rate;
+    }
+    json words = json::array();
+    for (const auto& w : r.words) {
+        json wj;
+        wj["word"] = w.word;
+        wj["score"] = w.word_score;
+        json phs = json::array();
+        for (const auto& d : w.details) {
+            json pj = {
+                { "ipa", d.ipa },
+                { "score", d.score },
+                { "is_good", d.is_good },
+                { "is_excellent", d.is_excellent },
+                { "start_frame", d.start_frame },
+                { "end_frame", d.end_frame },
+            };
+            if (d.hint != GopHint::None) {
+                pj["posterior"] = d.posterior;
+                pj["gop_lr"] = d.gop_lr;
+                pj["hint"] = gopHintName(d.hint);
+                if (d.hint == GopHint::Substitution) pj["substitute"] = d.substitute_ipa;
+                json cs = json::array();
+                for (const auto& c : d.competitors) cs.push_back({ { "ipa", c.ipa }, { "posterior", c.posterior } });
+                pj["competitors"] = cs;
+            }
+            phs.push_back(pj);
+        }
+        wj["phonemes"] = phs;
+        words.push_back(wj);
+    }
+    j["words"] = words;
+    return j;
+}
+
+static std::string csvEscape(const std::string& s)
+{
+    if (s.find_first_of(",\"\n\r") == std::string::npos) return s;
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += "\"\"";
+        else out += c;
+    }
+    out += "\"";
+    return out;
+}
+
+static void writeResult(std::ostream& out, const std::string& format, size_t index, const BatchJob& job, const BatchResult& r)
+{
+    if (format == "csv") {
+        out << index << ',' << csvEscape(job.id) << ',' << csvEscape(job.wav_path) << ','
+            << (r.ok ? 1 : 0) << ',' << (r.ok ? r.overall_score : SCORE_FLOOR) << ','
+            << r.duration_sec << ',' << r.elapsed_ms << ',' << r.words.size() << ','
+            << csvEscape(r.error) << '\n';
+    }
+    else {
+        out << resultToJson(index, job, r).dump(-1, ' ', false, json::error_handler_t::replace) << '\n';
+    }
+}
+
+// 存档文件名：<dir>/<id>.emis，id 里的路径分隔符换成下划线 (speech_calibrate 按同样的规则找存档)
+static std::string emissionFileName(const BatchJob& job)
+{
+    std::string name = job.id;
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':') c = '_';
+    }
+    return name + ".emis";
+}
+
+static std::string emissionPath(const std::string& dir, const BatchJob& job)
+{
+    return (fs::path(dir) / emissionFileName(job)).string();
+}
+
+// 不同 id 换完分隔符后可能同名 (a/b 和 a_b)，会互相覆盖或读错存档，开始之前就报错。
+// 按不区分大小写比较：Windows 和 macOS 默认的文件系统上只差大小写也是同一个文件
+static bool checkEmissionNames(const std::vector<BatchJob>& jobs)
+{
+    std::map<std::string, const BatchJob*> seen;
+    for (const auto& job : jobs) {
+        std::string key = emissionFileName(job);
+        for (char& c : key) c = (char)std::tolower((unsigned char)c);
+        auto it = seen.emplace(key, &job).first;
+        if (it->second != &job) {
+            std::cerr << "[Error] Jobs \"" << it->second->id << "\" and \"" << job.id
+                      << "\" map to the same emission archive " << emissionFileName(job) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 对齐 + 算分 (推理结果来自 runner 或存档)
+static void alignOne(const EmissionView& em, const Vocab& vocab, Phonemizer& phonemizer, const GopOptions& gop_options,
+                     const BatchOptions& opt, const BatchJob& job, BatchResult& r)
+{
+    {
+        ScopedStageTimer g2p_timer(&r.timings, Stage::G2P);
+        r.words = phonemizer.analyzeText(job.text);
+    }
+
+    if (opt.precheck.enabled) {
+        ScopedStageTimer decode_timer(&r.timings, Stage::Decode);
+        Transcript transcript = decodeTranscript(em, vocab, r.words, 0, opt.decode);
+        r.prechecked = true;
+        r.phone_error_rate = transcript.phoneErrorRate();
+        r.mismatch = !transcriptMatches(transcript, opt.precheck);
+    }
+    if (r.mismatch) {
+        markWordsUnaligned(r.words, vocab);
+        r.overall_score = calculateOverallScore(r.words);
+        r.ok = true;
+        return;
+    }
+
+    ScopedStageTimer align_timer(&r.timings, Stage::Align);
+    if (!calculateGOP(em, vocab, r.words, 0, &r.timings, gop_options)) {
+        r.error = "Alignment failed";
+    }
+    else {
+        r.overall_score = calculateOverallScore(r.words);
+        r.ok = true;
+    }
+}
+
+// 从存档评分，不碰模型
+static void scoreFromEmissions(const ModelRunner& runner, Phonemizer& phonemizer, const GopOptions& gop_options,
+                               const BatchOptions& opt, const BatchJob& job, BatchResult& r)
+{
+    ScopedStageTimer frontend_timer(&r.timings, Stage::FrontEnd);
+    EmissionFile file;
+    bool loaded = file.open(emissionPath(opt.from_emissions_dir, job));
+    frontend_timer.stop();
+
+    if (!loaded) {
+        r.error = "Failed to open emission file";
+        return;
+    }
+    if (file.info().vocab_hash != runner.getVocab().fingerprint()) {
+        r.error = "Emission file was produced with a different vocab";
+        return;
+    }
+
+    r.duration_sec = (double)file.info().audio_samples / TARGET_SAMPLE_RATE;
+    r.timings.frames = file.info().frames;
+    r.timings.vocab_size = file.info().vocab;
+    alignOne(file.view(), runner.getVocab(), phonemizer, gop_options, opt, job, r);
+}
+
+// 单条评分：每个线程持有自己的 runner (共享模型)，Phonemizer 内部串行调用 espeak
+static void scoreOne(ModelRunner& runner, Phonemizer& phonemizer, const GopOptions& gop_options, const BatchOptions& opt,
+                     const BatchJob& job, BatchResult& r)
+{
+    auto t0 = Clock::now();
+    ScopedStageTimer total_timer(&r.timings, Stage::Total);
+
+    if (!opt.from_emissions_dir.empty()) {
+        scoreFromEmissions(runner, phonemizer, gop_options, opt, job, r);
+    }
+    else {
+        ScopedStageTimer frontend_timer(&r.timings, Stage::FrontEnd);
+        bool loaded = streamWavFile(job.wav_path, runner);
+        frontend_timer.stop();
+
+        if (!loaded) {
+            r.error = "Failed to open WAV file";
+        }
+        else {
+            r.duration_sec = (double)runner.getAudioSize() / TARGET_SAMPLE_RATE;
+            if (!runner.runInference(&r.timings)) {
+                r.error = "Inference execution failed";
+            }
+            else {
+                if (!opt.save_emissions_dir.empty()) {
+                    EmissionFileInfo info;
+                    info.model_hash = runner.getModelHash();
+                    info.vocab_hash = runner.getVocab().fingerprint();
+                    info.encoding = opt.emission_encoding;
+                    info.top_k = opt.emission_top_k;
+                    info.audio_samples = runner.getAudioSize();
+                    // 存档失败不影响本次评分
+                    writeEmissionFile(emissionPath(opt.save_emissions_dir, job), runner.getEmissions(), info);
+                }
+                alignOne(runner.getEmissions(), runner.getVocab(), phonemizer, gop_options, opt, job, r);
+            }
+        }
+    }
+
+    total_timer.stop();
+    r.elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+int main(int argc, char** argv)
+{
+    BatchOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        printUsage();
+        return 2;
+    }
+
+    // 批处理时逐条的 [Info] 日志没有意义，默认只保留警告和错误
+    if (!opt.verbose) setLogLevel(LogLevel::Warning);
+
+    std::vector<BatchJob> jobs;
+    bool loaded = opt.manifest_path.empty() ? loadDirectory(opt.dir_path, jobs) : loadManifest(opt.manifest_path, jobs);
+    if (!loaded) return 1;
+    if (jobs.empty()) {
+        std::cerr << "[Error] No jobs to process." << std::endl;
+        return 1;
+    }
+    if ((!opt.save_emissions_dir.empty() || !opt.from_emissions_dir.empty()) && !checkEmissionNames(jobs)) {
+        return 1;
+    }
+
+    // 1. 加载共享模型 (只占一份内存)。从存档评分时只需要词表
+    ModelRunner master;
+    if (opt.from_emissions_dir.empty() && !master.loadModel(opt.model_path)) {
+        return 1;
+    }
+    if (!master.loadVocab(opt.vocab_path)) {
+        return 1;
+    }
+    if (!opt.save_emissions_dir.empty()) {
+        std::error_code ec;
+        fs::create_directories(opt.save_emissions_dir, ec);
+        if (ec) {
+            std::cerr << "[Error] Cannot create " << opt.save_emissions_dir << ": " << ec.message() << std::endl;
+            return 1;
+        }
+    }
+
+    // 2. 初始化 G2P
+    Phonemizer phonemizer(opt.espeak_path, master.getVocab(), opt.voice);
+    if (!phonemizer.isInitialized()) {
+        std::cerr << "[Error] Failed to initialize Espeak" << std::endl;
+        return 1;
+    }
+
+    std::shared_ptr<const ThresholdTable> thresholds = ThresholdTable::builtin();
+    if (!opt.thresholds_path.empty()) {
+        ThresholdSet set;
+        if (!set.loadFromJson(opt.thresholds_path)) return 1;
+        thresholds = set.select(opt.voice);
+    }
+
+    int threads = opt.threads > 0 ? opt.threads : (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    threads = std::min<int>(threads, (int)jobs.size());
+
+    std::cerr << "[Batch] " << jobs.size() << " recordings, " << threads << " worker threads" << std::endl;
+
+    // 3. 输出
+    std::ofstream out_file;
+    if (!opt.out_path.empty()) {
+        out_file.open(opt.out_path, std::ios::binary);
+        if (!out_file.is_open()) {
+            std::cerr << "[Error] Cannot open output: " << opt.out_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = opt.out_path.empty() ? std::cout : out_file;
+    if (opt.format == "csv") {
+        out << "index,id,wav,ok,overall_score,duration_sec,elapsed_ms,word_count,error\n";
+    }
+
+    // 4. 工作线程：从共享计数器领取任务，结果写入各自的槽位
+    std::vector<BatchResult> results(jobs.size());
+    std::atomic<size_t> next_job{ 0 };
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+
+    auto wall_start = Clock::now();
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int w = 0; w < threads; ++w) {
+        workers.emplace_back([&]() {
+            ModelRunner runner;
+            runner.shareModelFrom(master);
+            GopOptions gop_options;
+            gop_options.detailed = opt.detailed;
+            gop_options.segment.enabled = opt.segmented;
+            gop_options.thresholds = thresholds;
+
+            for (;;) {
+                size_t i = next_job.fetch_add(1);
+                if (i >= jobs.size()) break;
+
+                BatchResult r;
+                scoreOne(runner, phonemizer, gop_options, opt, jobs[i], r);
+
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    results[i] = std::move(r);
+                    results[i].done = true;
+                }
+                done_cv.notify_one();
+            }
+        });
+    }
+
+    // 5. 主线程按输入顺序写出已完成的连续前缀，写完立即释放结果内存
+    size_t written = 0;
+    size_t ok_count = 0;
+    double total_audio_sec = 0.0;
+    std::vector<double> latencies;
+    latencies.reserve(jobs.size());
+    PipelineStats stage_stats;
+
+    while (written < jobs.size()) {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&]() { return results[written].done; });
+
+        while (written < jobs.size() && results[written].done) {
+            BatchResult r = std::move(results[written]);
+            lock.unlock();
+
+            writeResult(out, opt.format, written, jobs[written], r);
+            if (r.ok) ok_count++;
+            total_audio_sec += r.duration_sec;
+            latencies.push_back(r.elapsed_ms);
+            stage_stats.record(r.timings, r.ok);
+
+            written++;
+            if (written % 100 == 0) {
+                double sec = std::chrono::duration<double>(Clock::now() - wall_start).count();
+                std::cerr << "[Batch] " << written << "/" << jobs.size() << " (" << (written / sec) << " files/s)" << std::endl;
+            }
+            lock.lock();
+        }
+    }
+
+    for (auto& t : workers) t.join();
+    out.flush();
+
+    // 6. 吞吐统计
+    double wall_sec = std::chrono::duration<double>(Clock::now() - wall_start).count();
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) {
+        if (latencies.empty()) return 0.0;
+        size_t k = (size_t)std::min<double>(latencies.size() - 1, p * (latencies.size() - 1) + 0.5);
+        return latencies[k];
+    };
+
+    json stats;
+    stats["files"] = jobs.size();
+    stats["ok"] = ok_count;
+    stats["failed"] = jobs.size() - ok_count;
+    stats["threads"] = threads;
+    stats["wall_sec"] = wall_sec;
+    stats["audio_sec"] = total_audio_sec;
+    stats["files_per_sec"] = wall_sec > 0 ? jobs.size() / wall_sec : 0.0;
+    stats["realtime_factor"] = wall_sec > 0 ? total_audio_sec / wall_sec : 0.0;
+    stats["latency_ms"] = { { "p50", pct(0.50) }, { "p95", pct(0.95) }, { "p99", pct(0.99) }, { "max", latencies.empty() ? 0.0 : latencies.back() } };
+
+    PipelineStats::Snapshot snap = stage_stats.snapshot();
+    json stages;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const StageSummary& st = snap.stages[s];
+        stages[stageName((Stage)s)] = { { "mean", st.mean }, { "p50", st.p50 }, { "p95", st.p95 }, { "p99", st.p99 }, { "max", st.max } };
+    }
+    stats["stages_ms"] = stages;
+
+    std::cerr << "[Batch] Done. " << stats.dump(2) << std::endl;
+
+    if (!opt.stats_path.empty()) {
+        std::ofstream sf(opt.stats_path);
+        sf << stats.dump(2) << std::endl;
+    }
+
+    return ok_count == jobs.size() ? 0 : 1;
+}
@@ -0,0 +1,540 @@
+// 原生流水线基准测试
+// 分阶段测量前端 (mixToMono / resampleAudio / normalizeAudio)、推理 (runInference /
+// computeLogSoftmax)、G2P (analyzeText / cleanAndTokenizeIPA) 和对齐 (calculateGOP)，
+// 覆盖不同音频长度、声道数和采样率。输出 Google Benchmark 兼容的 JSON，
+// 可以用 --baseline 和上一个版本的结果对比，发现性能回退。
+//
+// 用法:
+//   speech_bench --resources <含 test.wav 和 courses/ 的目录>
+//                [--model wav2vec2.onnx --vocab vocab.json] [--espeak <espeak-ng-data 父目录>]
+//                [--out bench.json] [--filter <名字子串>] [--min-time 0.5] [--max-iters 1000]
+//                [--baseline old.json] [--tolerance 0.10] [--tag v1.2.0]
+//
+// 没有提供模型时跳过推理和对齐，没有提供 espeak 时跳过 G2P。
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <json.hpp>
+#include "dr_wav.h"
+
+#include "AudioFrontEnd.h"
+#include "ModelRunner.h"
+#include "Phonemizer.h"
+#include "Align.h"
+#include "WavReader.h"
+#include "Log.h"
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    std::string resources_dir;
+    std::string model_path;
+    std::string vocab_path;
+    std::string espeak_path;
+    std::string out_path;
+    std::string filter;
+    std::string baseline_path;
+    std::string tag;
+    double min_time = 0.5;   // 每个用例至少运行的秒数
+    int max_iters = 1000;
+    double tolerance = 0.10; // 与基线相比允许的变慢比例
+};
+
+struct BenchResult {
+    std::string name;
+    int iterations = 0;
+    double mean_ns = 0, median_ns = 0, p95_ns = 0, min_ns = 0, stddev_ns = 0;
+    double items_per_iter = 0; // 每次迭代处理的数据量 (样本 / 帧 / 文本条数)
+    std::string items_label;
+    // 描述输入规模的计数器 (如帧数 T、音素数 P)。不放进用例名，基线按名字匹配时不受输入细节变化影响
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+// ==========================================
+// 计时框架
+// ==========================================
+class BenchRunner {
+public:
+    BenchRunner(const BenchOptions& opt, std::ostream& out) : opt_(opt), out_(out) {}
+
+    // fn 执行一次迭代并返回被测部分的耗时 (纳秒)，这样每次迭代的准备工作可以不计入
+    void run(const std::string& name, double items, const std::string& items_label, const std::function<double()>& fn,
+             const std::vector<std::pair<std::string, double>>& counters = {})
+    {
+        if (!opt_.filter.empty() && name.find(opt_.filter) == std::string::npos) return;
+
+        fn(); // 预热 (缓存、分配器、ORT arena)
+
+        std::vector<double> samples;
+        double total = 0.0;
+        auto start = Clock::now();
+        while ((int)samples.size() < opt_.max_iters) {
+            double ns = fn();
+            samples.push_back(ns);
+            total += ns;
+            double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            if (elapsed >= opt_.min_time && samples.size() >= 3) break;
+        }
+
+        BenchResult r;
+        r.name = name;
+        r.iterations = (int)samples.size();
+        r.items_per_iter = items;
+        r.items_label = items_label;
+        r.counters = counters;
+        r.mean_ns = total / samples.size();
+
+        double var = 0.0;
+        for (double v : samples) var += (v - r.mean_ns) * (v - r.mean_ns);
+        r.stddev_ns = std::sqrt(var / samples.size());
+
+        std::sort(samples.begin(), samples.end());
+        r.min_ns = samples.front();
+        r.median_ns = samples[samples.size() / 2];
+        r.p95_ns = samples[std::min(samples.size() - 1, (size_t)(samples.size() * 0.95))];
+
+        out_ << std::left << std::setw(58) << name << std::right
+             << std::setw(12) << std::fixed << std::setprecision(3) << r.mean_ns / 1e6 << " ms"
+             << std::setw(12) << r.p95_ns / 1e6 << " ms p95"
+             << std::setw(8) << r.iterations << " it";
+        if (items > 0) {
+            out_ << std::setw(14) << std::setprecision(1) << items / (r.mean_ns / 1e9) << " " << items_label << "/s";
+        }
+        for (const auto& c : counters) {
+            out_ << "  " << c.first << "=" << std::setprecision(0) << c.second;
+        }
+        out_ << std::endl;
+
+        results_.push_back(r);
+    }
+
+    const std::vector<BenchResult>& results() const { return results_; }
+
+private:
+    const BenchOptions& opt_;
+    std::ostream& out_;
+    std::vector<BenchResult> results_;
+};
+
+template <typename F>
+static double timeNs(F&& f)
+{
+    auto t0 = Clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+// ==========================================
+// 测试数据
+// ==========================================
+
+// 把 test.wav 变换成指定采样率 / 声道数 / 长度 (只用于构造数据，不是被测对象)
+static std::vector<float> makeFixture(const std::vector<float>& mono, unsigned int src_rate,
+                                      unsigned int dst_rate, unsigned int channels, int repeat)
+{
+    double ratio = (double)src_rate / dst_rate;
+    size_t n = (size_t)(mono.size() / ratio);
+    std::vector<float> one(n);
+    for (size_t i = 0; i < n; ++i) {
+        double pos = i * ratio;
+        size_t k = (size_t)pos;
+        float frac = (float)(pos - k);
+        float a = mono[std::min(k, mono.size() - 1)];
+        float b = mono[std::min(k + 1, mono.size() - 1)];
+        one[i] = a + (b - a) * frac;
+    }
+
+    std::vector<float> out;
+    out.reserve(n * channels * repeat);
+    for (int r = 0; r < repeat; ++r) {
+        for (size_t i = 0; i < n; ++i) {
+            for (unsigned int c = 0; c < channels; ++c) {
+                // 各声道稍有差别，避免编译器/硬件对相同数据的特殊优化
+                out.push_back(one[i] * (1.0f - 0.1f * c));
+            }
+        }
+    }
+    return out;
+}
+
+static std::vector<std::string> loadCourseTexts(const std::string& courses_dir)
+{
+    std::vector<std::string> texts;
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(courses_dir, ec)) {
+        if (e.path().extension() == ".json") files.push_back(e.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& f : files) {
+        std::ifstream in(f);
+        try {
+            json j = json::parse(in);
+            for (const auto& course : j) {
+                for (const auto& item : course.at("content")) {
+                    std::string t = item.at("text").get<std::string>();
+                    if (!t.empty() && t.back() != '.') t += '.'; // 与 SpeechService.analyzeRaw 一致
+                    texts.push_back(t);
+                }
+            }
+        }
+        catch (const json::exception& e) {
+            std::cerr << "[Warning] Skipping course file " << f.string() << ": " << e.what() << std::endl;
+        }
+    }
+    return texts;
+}
+
+static std::string joinTexts(const std::vector<std::string>& texts, size_t count)
+{
+    std::string s;
+    for (size_t i = 0; i < count && !texts.empty(); ++i) {
+        if (!s.empty()) s += ' ';
+        s += texts[i % texts.size()];
+    }
+    return s;
+}
+
+// ==========================================
+// 输出
+// ==========================================
+static json toJson(const BenchOptions& opt, const std::vector<BenchResult>& results)
+{
+    std::time_t now = std::time(nullptr);
+    char date[64];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    json ctx;
+    ctx["date"] = date;
+    ctx["num_cpus"] = std::thread::hardware_concurrency();
+#ifdef NDEBUG
+    ctx["library_build_type"] = "release";
+#else
+    ctx["library_build_type"] = "debug";
+#endif
+    ctx["tag"] = opt.tag;
+    ctx["min_time"] = opt.min_time;
+
+    json arr = json::array();
+    for (const auto& r : results) {
+        json b;
+        b["name"] = r.name;
+        b["run_name"] = r.name;
+        b["run_type"] = "iteration";
+        b["iterations"] = r.iterations;
+        b["real_time"] = r.mean_ns;
+        b["cpu_time"] = r.mean_ns;
+        b["time_unit"] = "ns";
+        b["median_ns"] = r.median_ns;
+        b["p95_ns"] = r.p95_ns;
+        b["min_ns"] = r.min_ns;
+        b["stddev_ns"] = r.stddev_ns;
+        if (r.items_per_iter > 0) {
+            b["items_per_second"] = r.items_per_iter / (r.mean_ns / 1e9);
+            b["items_label"] = r.items_label;
+        }
+        // 和 Google Benchmark 的用户计数器一样直接作为字段输出
+        for (const auto& c : r.counters) b[c.first] = c.second;
+        arr.push_back(b);
+    }
+
+    json j;
+    j["context"] = ctx;
+    j["benchmarks"] = arr;
+    return j;
+}
+
+// 与基线比较，返回变慢超过容忍度的用例数
+static int compareBaseline(const BenchOptions& opt, const std::vector<BenchResult>& results, std::ostream& report)
+{
+    std::ifstream in(opt.baseline_path);
+    if (!in.is_open()) {
+        std::cerr << "[Error] Cannot open baseline: " << opt.baseline_path << std::endl;
+        return -1;
+    }
+
+    std::map<std::string, double> base;
+    try {
+        json j = json::parse(in);
+        for (const auto& b : j.at("benchmarks")) {
+            base[b.at("name").get<std::string>()] = b.at("real_time").get<double>();
+        }
+    }
+    catch (const json::exception& e) {
+        std::cerr << "[Error] Invalid baseline JSON: " << e.what() << std::endl;
+        return -1;
+    }
+
+    int regressions = 0;
+    report << "\nComparison against " << opt.baseline_path << " (tolerance " << opt.tolerance * 100 << "%)" << std::endl;
+    for (const auto& r : results) {
+        auto it = base.find(r.name);
+        if (it == base.end() || it->second <= 0) continue;
+
+        double ratio = r.mean_ns / it->second;
+        bool slow = ratio > 1.0 + opt.tolerance;
+        if (slow) regressions++;
+        report << std::left << std::setw(58) << r.name << std::right << std::fixed << std::setprecision(3)
+               << std::setw(8) << ratio << "x" << (slow ? "  REGRESSION" : "") << std::endl;
+    }
+    return regressions;
+}
+
+static void printUsage()
+{
+    std::cerr << "Usage: speech_bench --resources <dir> [--model <onnx> --vocab <json>] [--espeak <dir>]\n"
+              << "                    [--out <json>] [--filter <substr>] [--min-time <sec>] [--max-iters N]\n"
+              << "                    [--baseline <json>] [--tolerance 0.10] [--tag <label>]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto val = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (a == "--resources") opt.resources_dir = val();
+        else if (a == "--model") opt.model_path = val();
+        else if (a == "--vocab") opt.vocab_path = val();
+        else if (a == "--espeak") opt.espeak_path = val();
+        else if (a == "--out") opt.out_path = val();
+        else if (a == "--filter") opt.filter = val();
+        else if (a == "--baseline") opt.baseline_path = val();
+        else if (a == "--tag") opt.tag = val();
+        else if (a == "--min-time") opt.min_time = std::atof(val().c_str());
+        else if (a == "--max-iters") opt.max_iters = std::atoi(val().c_str());
+        else if (a == "--tolerance") opt.tolerance = std::atof(val().c_str());
+        else {
+            printUsage();
+            return 2;
+        }
+    }
+    if (opt.resources_dir.empty()) {
+        printUsage();
+        return 2;
+    }
+    if (opt.max_iters < 1) opt.max_iters = 1;
+
+    // 流水线内部的 [Info] 日志会混进报告，只保留警告和错误
+    setLogLevel(LogLevel::Warning);
+    std::ostream& report = std::cout;
+
+    std::string wav_path = (fs::path(opt.resources_dir) / "test.wav").string();
+    unsigned int wav_channels = 0, wav_rate = 0;
+    drwav_uint64 wav_frames = 0;
+    float* wav_data = drwav_open_file_and_read_pcm_frames_f32(wav_path.c_str(), &wav_channels, &wav_rate, &wav_frames, NULL);
+    if (!wav_data) {
+        std::cerr << "[Error] Cannot read fixture: " << wav_path << std::endl;
+        return 1;
+    }
+    std::vector<float> base_mono(wav_frames);
+    for (drwav_uint64 i = 0; i < wav_frames; ++i) {
+        float s = 0.0f;
+        for (unsigned int c = 0; c < wav_channels; ++c) s += wav_data[i * wav_channels + c];
+        base_mono[i] = s / wav_channels;
+    }
+    drwav_free(wav_data, NULL);
+
+    std::vector<std::string> texts = loadCourseTexts((fs::path(opt.resources_dir) / "courses").string());
+
+    report << "Fixture: " << wav_path << " (" << wav_rate << " Hz, " << wav_channels << " ch, "
+           << (double)wav_frames / wav_rate << " s), " << texts.size() << " course texts" << std::endl;
+
+    BenchRunner bench(opt, report);
+
+    const unsigned int rates[] = { 16000, 44100, 48000 };
+    const unsigned int channel_counts[] = { 1, 2 };
+    const int lengths[] = { 1, 4, 16 };
+
+    // ==========================================
+    // 1. 音频前端
+    // ==========================================
+    for (unsigned int rate : rates) {
+        for (unsigned int ch : channel_counts) {
+            for (int len : lengths) {
+                std::vector<float> input = makeFixture(base_mono, wav_rate, rate, ch, len);
+                size_t frames = input.size() / ch;
+                std::string suffix = "/" + std::to_string(rate) + "Hz/" + std::to_string(ch) + "ch/" + std::to_string(len) + "x";
+                double seconds = (double)frames / rate;
+
+                std::vector<float> work;
+                work.reserve(input.size());
+
+                if (ch > 1) {
+                    bench.run("frontend/mixToMono" + suffix, (double)frames, "frames", [&]() {
+                        work.assign(input.begin(), input.end());
+                        return timeNs([&]() { mixToMono(work, ch, frames); });
+                    });
+                }
+
+                std::vector<float> mono = input;
+                mixToMono(mono, ch, frames);
+
+                if (ch == 1 && rate != TARGET_SAMPLE_RATE) {
+                    bench.run("frontend/resampleAudio" + suffix, (double)frames, "frames", [&]() {
+                        work.assign(mono.begin(), mono.end());
+                        return timeNs([&]() { resampleAudio(work, rate); });
+                    });
+                }
+
+                std::vector<float> resampled = mono;
+                resampleAudio(resampled, rate);
+
+                if (ch == 1) {
+                    bench.run("frontend/normalizeAudio" + suffix, (double)resampled.size(), "samples", [&]() {
+                        work.assign(resampled.begin(), resampled.end());
+                        return timeNs([&]() { normalizeAudio(work); });
+                    });
+                }
+
+                // 整个 loadAudio (含拷贝) 以音频秒数为吞吐单位
+                ModelRunner runner;
+                bench.run("frontend/loadAudio" + suffix, seconds, "audio_sec", [&]() {
+                    return timeNs([&]() { runner.loadAudio(input.data(), input.size(), rate, ch); });
+                });
+            }
+        }
+    }
+
+    // 文件解码路径 (mmap + 分块解码 + 流式前端)
+    {
+        ModelRunner runner;
+        bench.run("decode/streamWavFile/test.wav", (double)wav_frames / wav_rate, "audio_sec", [&]() {
+            return timeNs([&]() { streamWavFile(wav_path, runner); });
+        });
+    }
+
+    // ==========================================
+    // 2. 推理 & LogSoftmax
+    // ==========================================
+    ModelRunner model;
+    bool has_model = !opt.model_path.empty() && !opt.vocab_path.empty() &&
+                     model.loadModel(opt.model_path) && model.loadVocab(opt.vocab_path);
+    if (!has_model) {
+        report << "(skipping inference and alignment benchmarks: no model/vocab)" << std::endl;
+    }
+
+    int vocab_size = has_model ? (int)model.getVocab().size() : 0;
+    for (int len : lengths) {
+        std::vector<float> input = makeFixture(base_mono, wav_rate, TARGET_SAMPLE_RATE, 1, len);
+        double seconds = (double)input.size() / TARGET_SAMPLE_RATE;
+        std::string suffix = "/" + std::to_string(len) + "x";
+
+        if (has_model) {
+            model.loadAudio(input.data(), input.size(), TARGET_SAMPLE_RATE, 1);
+            // runInference 包含 session->Run、logits 拷贝和 LogSoftmax
+            bench.run("model/runInference" + suffix, seconds, "audio_sec", [&]() {
+                return timeNs([&]() { model.runInference(); });
+            });
+            vocab_size = model.getVocabSize();
+        }
+
+        // LogSoftmax 不依赖模型：Wav2Vec2 每 320 个样本 (20ms) 一帧
+        int T = std::max(1, (int)(input.size() / 320));
+        int V = vocab_size > 0 ? vocab_size : 392;
+        std::vector<float> logits((size_t)T * V);
+        std::mt19937 rng(42);
+        std::normal_distribution<float> dist(0.0f, 4.0f);
+        for (float& x : logits) x = dist(rng);
+
+        std::vector<float> work(logits.size());
+        bench.run("model/computeLogSoftmax" + suffix, (double)T, "frames", [&]() {
+            std::copy(logits.begin(), logits.end(), work.begin());
+            return timeNs([&]() { computeLogSoftmax(work.data(), T, V); });
+        }, { { "V", (double)V } });
+    }
+
+    // ==========================================
+    // 3. G2P
+    // ==========================================
+    Phonemizer* phonemizer = nullptr;
+    if (!opt.espeak_path.empty()) {
+        phonemizer = new Phonemizer(opt.espeak_path, model.getVocab(), "en-us");
+        if (!phonemizer->isInitialized() || model.getVocab().empty()) {
+            delete phonemizer;
+            phonemizer = nullptr;
+        }
+    }
+
+    if (!phonemizer) {
+        report << "(skipping G2P benchmarks: no espeak data or vocab)" << std::endl;
+    }
+    else if (!texts.empty()) {
+        bench.run("g2p/analyzeText/all_courses", (double)texts.size(), "texts", [&]() {
+            return timeNs([&]() {
+                for (const auto& t : texts) phonemizer->analyzeText(t);
+            });
+        });
+
+        std::string paragraph = joinTexts(texts, texts.size());
+        bench.run("g2p/analyzeText/paragraph", 1.0, "texts", [&]() {
+            return timeNs([&]() { phonemizer->analyzeText(paragraph); });
+        });
+
+        std::vector<std::string> raw_ipas;
+        for (const auto& t : texts) {
+            for (const auto& w : phonemizer->analyzeText(t)) raw_ipas.push_back(w.raw_ipa);
+        }
+        bench.run("g2p/cleanAndTokenizeIPA/all_courses", (double)raw_ipas.size(), "words", [&]() {
+            return timeNs([&]() {
+                for (const auto& ipa : raw_ipas) phonemizer->cleanAndTokenizeIPA(ipa);
+            });
+        });
+    }
+
+    // ==========================================
+    // 4. 强制对齐
+    // ==========================================
+    if (has_model && phonemizer && !texts.empty()) {
+        for (int len : lengths) {
+            std::vector<float> input = makeFixture(base_mono, wav_rate, TARGET_SAMPLE_RATE, 1, len);
+            model.loadAudio(input.data(), input.size(), TARGET_SAMPLE_RATE, 1);
+            if (!model.runInference()) continue;
+
+            // 文本长度与音频长度同比增长 (每倍音频对应一条课程句子)
+            std::vector<WordAnalysis> words = phonemizer->analyzeText(joinTexts(texts, len));
+            size_t phonemes = 0;
+            for (const auto& w : words) phonemes += w.phonemes.size();
+
+            bench.run("align/calculateGOP/" + std::to_string(len) + "x", (double)model.getTimeSteps(), "frames", [&]() {
+                std::vector<WordAnalysis> ws = words;
+                return timeNs([&]() { calculateGOP(model, ws, 0); });
+            }, { { "T", (double)model.getTimeSteps() }, { "P", (double)phonemes } });
+        }
+    }
+    delete phonemizer;
+
+    // ==========================================
+    // 输出 & 回归检查
+    // ==========================================
+    if (!opt.out_path.empty()) {
+        std::ofstream out(opt.out_path);
+        out << toJson(opt, bench.results()).dump(2) << std::endl;
+        report << "\nWrote " << bench.results().size() << " results to " << opt.out_path << std::endl;
+    }
+
+    int rc = 0;
+    if (!opt.baseline_path.empty()) {
+        int regressions = compareBaseline(opt, bench.results(), report);
+        if (regressions < 0) rc = 1;
+        else if (regressions > 0) rc = 3;
+    }
+    return rc;
+}
@@ -0,0 +1,455 @@
+// 阈值校准工具
+// 用人工标注过的语料拟合 is_good / is_excellent 的阈值 (按口音、按音素)，输出 thresholds.json，
+// 由 SpeechEngine.loadThresholds() 或 speech_batch --thresholds 加载。
+//
+// 推理结果从 speech_batch --save-emissions 生成的存档 (<dir>/<id>.emis) 读取，不需要重新推理；
+// 提供 --model 时，缺少存档的录音会现场推理并补存档。对齐在线程池里并行，几万条语料几分钟即可跑完。
+//
+// 用法:
+//   speech_calibrate --vocab vocab.json --espeak <espeak-ng-data 父目录>
+//                    --manifest labeled.jsonl --emissions <dir>
+//                    [--model wav2vec2.onnx] [--out thresholds.json] [--report report.json]
+//                    [--threads N] [--min-samples 30] [--voice en-us]
+//
+// manifest 每行: {"id": ..., "wav": ..., "text": ..., "language": "en-us" (可选，默认 --voice),
+//                 "labels": [[1, 1, 0], [2, 2], ...]   每个词的每个标准音素一个标签
+//              或 "word_labels": [1, 0, 2, ...]}       每个词一个标签 (词内所有音素共用)
+// 标签: 0 = 读错, 1 = 合格, 2 = 优秀
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <json.hpp>
+
+#include "ModelRunner.h"
+#include "Phonemizer.h"
+#include "Align.h"
+#include "WavReader.h"
+#include "EmissionFile.h"
+#include "Thresholds.h"
+#include "Log.h"
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct CalibrateOptions {
+    std::string model_path;     // 可选，只用来补缺失的存档
+    std::string vocab_path;
+    std::string espeak_path;
+    std::string manifest_path;
+    std::string emissions_dir;
+    std::string out_path = "thresholds.json";
+    std::string report_path;
+    std::string voice = "en-us";
+    int threads = 0;
+    int min_samples = 30;       // 音素两类样本都至少这么多才单独拟合
+};
+
+struct LabeledJob {
+    std::string id;
+    std::string wav_path;
+    std::string text;
+    std::string language;
+    std::vector<std::vector<int>> labels; // 按词、按音素；word_labels 时每个词只有一个元素
+    bool word_level = false;
+};
+
+// 一个带标签的音素得分
+struct Sample {
+    std::string ipa;
+    float score;
+    int label;
+};
+
+static void printUsage()
+{
+    std::cerr << "Usage: speech_calibrate --vocab <json> --espeak <dir> --manifest <jsonl> --emissions <dir>\n"
+              << "                        [--model <onnx>] [--out thresholds.json] [--report <json>]\n"
+              << "                        [--threads N] [--min-samples 30] [--voice en-us]" << std::endl;
+}
+
+static bool parseArgs(int argc, char** argv, CalibrateOptions& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&](std::string& dst) {
+            if (i + 1 >= argc) return false;
+            dst = argv[++i];
+            return true;
+        };
+
+        bool ok = true;
+        std::string v;
+        if (arg == "--model") ok = next(opt.model_path);
+        else if (arg == "--vocab") ok = next(opt.vocab_path);
+        else if (arg == "--espeak") ok = next(opt.espeak_path);
+        else if (arg == "--manifest") ok = next(opt.manifest_path);
+        else if (arg == "--emissions") ok = next(opt.emissions_dir);
+        else if (arg == "--out") ok = next(opt.out_path);
+        else if (arg == "--report") ok = next(opt.report_path);
+        else if (arg == "--voice") ok = next(opt.voice);
+        else if (arg == "--threads") {
+            ok = next(v);
+            if (ok) opt.threads = std::atoi(v.c_str());
+        }
+        else if (arg == "--min-samples") {
+            ok = next(v);
+            if (ok) opt.min_samples = std::max(1, std::atoi(v.c_str()));
+        }
+        else {
+            std::cerr << "[Error] Unknown argument: " << arg << std::endl;
+            return false;
+        }
+
+        if (!ok) {
+            std::cerr << "[Error] Missing value for " << arg << std::endl;
+            return false;
+        }
+    }
+    return !opt.vocab_path.empty() && !opt.espeak_path.empty() && !opt.manifest_path.empty() && !opt.emissions_dir.empty();
+}
+
+static bool loadManifest(const CalibrateOptions& opt, std::vector<LabeledJob>& jobs)
+{
+    std::ifstream f(opt.manifest_path);
+    if (!f.is_open()) {
+        std::cerr << "[Error] Cannot open manifest: " << opt.manifest_path << std::endl;
+        return false;
+    }
+
+    fs::path base = fs::path(opt.manifest_path).parent_path();
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(f, line)) {
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        try {
+            json j = json::parse(line);
+            LabeledJob job;
+            job.text = j.at("text").get<std::string>();
+            job.language = j.value("language", opt.voice);
+            if (j.contains("wav")) {
+                job.wav_path = j["wav"].get<std::string>();
+                fs::path wav(job.wav_path);
+                if (wav.is_relative()) job.wav_path = (base / wav).string();
+            }
+            if (j.contains("id")) {
+                job.id = j["id"].is_string() ? j["id"].get<std::string>() : j["id"].dump();
+            }
+            else {
+                job.id = j.at("wav").get<std::string>();
+            }
+
+            if (j.contains("labels")) {
+                job.labels = j["labels"].get<std::vector<std::vector<int>>>();
+            }
+            else {
+                for (int l : j.at("word_labels").get<std::vector<int>>()) job.labels.push_back({ l });
+                job.word_level = true;
+            }
+            jobs.push_back(std::move(job));
+        }
+        catch (const json::exception& e) {
+            std::cerr << "[Warning] Skipping manifest line " << line_no << ": " << e.what() << std::endl;
+        }
+    }
+    return true;
+}
+
+// 与 speech_batch --save-emissions 相同的命名
+static std::string emissionPath(const std::string& dir, const std::string& id)
+{
+    std::string name = id;
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':') c = '_';
+    }
+    return (fs::path(dir) / (name + ".emis")).string();
+}
+
+// 对齐一条语料，把带标签的音素得分追加到 out。返回 false 表示这条没法用
+static bool collectSamples(ModelRunner& runner, bool has_model, Phonemizer& phonemizer, const CalibrateOptions& opt,
+                           const LabeledJob& job, std::vector<Sample>& out)
+{
+    std::string path = emissionPath(opt.emissions_dir, job.id);
+    EmissionFile file;
+    EmissionView em;
+
+    if (file.open(path)) {
+        if (file.info().vocab_hash != runner.getVocab().fingerprint()) {
+            LOG_WARNING("[Warning] " << job.id << ": emission file uses a different vocab, skipped.");
+            return false;
+        }
+        em = file.view();
+    }
+    else if (has_model && !job.wav_path.empty()) {
+        if (!streamWavFile(job.wav_path, runner) || !runner.runInference()) return false;
+
+        EmissionFileInfo info;
+        info.model_hash = runner.getModelHash();
+        info.vocab_hash = runner.getVocab().fingerprint();
+        info.audio_samples = runner.getAudioSize();
+        writeEmissionFile(path, runner.getEmissions(), info);
+        em = runner.getEmissions();
+    }
+    else {
+        return false;
+    }
+
+    std::vector<WordAnalysis> words = phonemizer.analyzeText(job.text);
+    if (words.size() != job.labels.size()) {
+        LOG_WARNING("[Warning] " << job.id << ": " << job.labels.size() << " word labels for " << words.size() << " words, skipped.");
+        return false;
+    }
+    if (!calculateGOP(em, runner.getVocab(), words, 0)) return false;
+
+    for (size_t w = 0; w < words.size(); ++w) {
+        const auto& details = words[w].details;
+        const auto& labels = job.labels[w];
+
+        if (job.word_level) {
+            for (const auto& d : details) out.push_back({ d.ipa, d.score, labels[0] });
+        }
+        else if (words[w].variant == 0 && labels.size() == details.size()) {
+            // 音素级标签对应标准发音；选中了备选发音或个数对不上时没法对应，跳过这个词
+            for (size_t i = 0; i < details.size(); ++i) out.push_back({ details[i].ipa, details[i].score, labels[i] });
+        }
+    }
+    return true;
+}
+
+// 拟合结果
+struct FitResult {
+    float threshold = 0.0f;
+    double balanced_accuracy = 0.0;
+    size_t positives = 0;
+    size_t negatives = 0;
+};
+
+// 在 score > t 判为正类的规则下，找使平衡准确率 (TPR + TNR) / 2 最高的 t
+// scored 按分数升序排好，正类为 label >= min_label
+static FitResult fitThreshold(const std::vector<std::pair<float, int>>& scored, int min_label)
+{
+    FitResult r;
+    for (const auto& s : scored) {
+        if (s.second >= min_label) r.positives++;
+        else r.negatives++;
+    }
+    if (r.positives == 0 || r.negatives == 0) return r;
+
+    // 阈值放在第 i 个样本之下：前 i 个判负，其余判正
+    size_t neg_below = 0, pos_below = 0;
+    double best = -1.0;
+    for (size_t i = 0; i <= scored.size(); ++i) {
+        if (i == 0 || i == scored.size() || scored[i].first != scored[i - 1].first) {
+            double tnr = (double)neg_below / r.negatives;
+            double tpr = (double)(r.positives - pos_below) / r.positives;
+            double acc = 0.5 * (tpr + tnr);
+            if (acc > best) {
+                best = acc;
+                if (i == 0) r.threshold = scored[0].first - 0.01f;
+                else if (i == scored.size()) r.threshold = scored.back().first;
+                else r.threshold = 0.5f * (scored[i - 1].first + scored[i].first);
+            }
+        }
+        if (i < scored.size()) {
+            if (scored[i].second >= min_label) pos_below++;
+            else neg_below++;
+        }
+    }
+    r.balanced_accuracy = best;
+    return r;
+}
+
+static double balancedAccuracy(const std::vector<std::pair<float, int>>& scored, int min_label, float threshold)
+{
+    size_t tp = 0, tn = 0, p = 0, n = 0;
+    for (const auto& s : scored) {
+        bool positive = s.second >= min_label;
+        bool predicted = s.first > threshold;
+        if (positive) { p++; if (predicted) tp++; }
+        else { n++; if (!predicted) tn++; }
+    }
+    if (p == 0 || n == 0) return 0.0;
+    return 0.5 * ((double)tp / p + (double)tn / n);
+}
+
+// 单个音素的拟合结果向语言默认值收缩：样本少时更接近默认值
+static float shrink(float fitted, size_t n, float fallback, int min_samples)
+{
+    return (float)((n * (double)fitted + min_samples * (double)fallback) / (n + min_samples));
+}
+
+// 拟合一种口音的阈值表
+static std::shared_ptr<ThresholdTable> fitLanguage(const std::vector<Sample>& samples, int min_samples, json& report)
+{
+    auto table = std::make_shared<ThresholdTable>();
+
+    std::vector<std::pair<float, int>> all;
+    std::map<std::string, std::vector<std::pair<float, int>>> by_phoneme;
+    for (const auto& s : samples) {
+        all.emplace_back(s.score, s.label);
+        by_phoneme[s.ipa].emplace_back(s.score, s.label);
+    }
+    std::sort(all.begin(), all.end());
+
+    // 1. 全部音素一起拟合口音默认值；某一类样本不够时保留内置值
+    PhonemeThreshold defaults;
+    FitResult good = fitThreshold(all, 1);
+    FitResult excellent = fitThreshold(all, 2);
+    if (good.positives >= (size_t)min_samples && good.negatives >= (size_t)min_samples) defaults.good = good.threshold;
+    if (excellent.positives >= (size_t)min_samples && excellent.negatives >= (size_t)min_samples) defaults.excellent = excellent.threshold;
+    defaults.excellent = std::max(defaults.excellent, defaults.good);
+    table->setDefaults(defaults);
+
+    report["samples"] = all.size();
+    report["default"] = {
+        { "good", defaults.good },
+        { "excellent", defaults.excellent },
+        { "good_balanced_accuracy", balancedAccuracy(all, 1, defaults.good) },
+        { "builtin_good_balanced_accuracy", balancedAccuracy(all, 1, THRESHOLD_GOOD) },
+    };
+
+    // 2. 样本足够的音素单独拟合
+    json phonemes = json::object();
+    for (auto& kv : by_phoneme) {
+        auto& scored = kv.second;
+        std::sort(scored.begin(), scored.end());
+
+        FitResult g = fitThreshold(scored, 1);
+        FitResult e = fitThreshold(scored, 2);
+        bool fit_good = g.positives >= (size_t)min_samples && g.negatives >= (size_t)min_samples;
+        bool fit_excellent = e.positives >= (size_t)min_samples && e.negatives >= (size_t)min_samples;
+
+        json pj = { { "samples", scored.size() }, { "positives", g.positives } };
+        if (fit_good || fit_excellent) {
+            PhonemeThreshold t = defaults;
+            if (fit_good) t.good = shrink(g.threshold, scored.size(), defaults.good, min_samples);
+            if (fit_excellent) t.excellent = shrink(e.threshold, scored.size(), defaults.excellent, min_samples);
+            t.excellent = std::max(t.excellent, t.good);
+            table->setPhoneme(kv.first, t);
+
+            pj["good"] = t.good;
+            pj["excellent"] = t.excellent;
+            pj["good_balanced_accuracy"] = balancedAccuracy(scored, 1, t.good);
+        }
+        pj["default_good_balanced_accuracy"] = balancedAccuracy(scored, 1, defaults.good);
+        phonemes[kv.first] = pj;
+    }
+    report["phonemes"] = phonemes;
+    return table;
+}
+
+int main(int argc, char** argv)
+{
+    CalibrateOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        printUsage();
+        return 2;
+    }
+    setLogLevel(LogLevel::Warning);
+
+    std::vector<LabeledJob> jobs;
+    if (!loadManifest(opt, jobs)) return 1;
+    if (jobs.empty()) {
+        std::cerr << "[Error] No labeled utterances." << std::endl;
+        return 1;
+    }
+
+    ModelRunner master;
+    bool has_model = !opt.model_path.empty();
+    if (has_model && !master.loadModel(opt.model_path)) return 1;
+    if (!master.loadVocab(opt.vocab_path)) return 1;
+    if (has_model) {
+        std::error_code ec;
+        fs::create_directories(opt.emissions_dir, ec);
+    }
+
+    Phonemizer phonemizer(opt.espeak_path, master.getVocab(), opt.voice);
+    if (!phonemizer.isInitialized()) {
+        std::cerr << "[Error] Failed to initialize Espeak" << std::endl;
+        return 1;
+    }
+
+    // 按口音分组：同一组共用一个 espeak 口音
+    std::map<std::string, std::vector<const LabeledJob*>> by_language;
+    for (const auto& job : jobs) by_language[job.language].push_back(&job);
+
+    int threads = opt.threads > 0 ? opt.threads : (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+
+    auto wall_start = Clock::now();
+    ThresholdSet result;
+    json report;
+    report["languages"] = json::object();
+    size_t used_total = 0;
+
+    for (const auto& group : by_language) {
+        const std::string& language = group.first;
+        const auto& group_jobs = group.second;
+        if (!phonemizer.setVoice(language)) {
+            std::cerr << "[Warning] Unknown voice " << language << ", " << group_jobs.size() << " utterances skipped." << std::endl;
+            continue;
+        }
+
+        // 每个线程收集自己的样本，最后合并
+        int n_threads = std::min<int>(threads, (int)group_jobs.size());
+        std::vector<std::vector<Sample>> per_thread(n_threads);
+        std::atomic<size_t> next_job{ 0 };
+        std::atomic<size_t> used{ 0 };
+
+        std::vector<std::thread> workers;
+        for (int w = 0; w < n_threads; ++w) {
+            workers.emplace_back([&, w]() {
+                ModelRunner runner;
+                runner.shareModelFrom(master);
+                for (;;) {
+                    size_t i = next_job.fetch_add(1);
+                    if (i >= group_jobs.size()) break;
+                    if (collectSamples(runner, has_model, phonemizer, opt, *group_jobs[i], per_thread[w])) used++;
+                }
+            });
+        }
+        for (auto& t : workers) t.join();
+
+        std::vector<Sample> samples;
+        for (auto& v : per_thread) {
+            samples.insert(samples.end(), std::make_move_iterator(v.begin()), std::make_move_iterator(v.end()));
+        }
+
+        json lang_report;
+        lang_report["utterances"] = group_jobs.size();
+        lang_report["used"] = used.load();
+        result.set(language, fitLanguage(samples, opt.min_samples, lang_report));
+        report["languages"][language] = lang_report;
+        used_total += used.load();
+
+        std::cerr << "[Calibrate] " << language << ": " << used.load() << "/" << group_jobs.size() << " utterances, "
+                  << samples.size() << " phonemes" << std::endl;
+    }
+
+    double wall_sec = std::chrono::duration<double>(Clock::now() - wall_start).count();
+    report["wall_sec"] = wall_sec;
+    report["utterances_per_sec"] = wall_sec > 0 ? used_total / wall_sec : 0.0;
+
+    if (result.empty() || !result.saveToJson(opt.out_path)) {
+        std::cerr << "[Error] Nothing calibrated." << std::endl;
+        return 1;
+    }
+    std::cerr << "[Calibrate] Thresholds written to " << opt.out_path << " (" << wall_sec << " s)" << std::endl;
+
+    if (!opt.report_path.empty()) {
+        std::ofstream rf(opt.report_path);
+        rf << report.dump(2) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,798 @@
+// 评分流水线各组件的行为测试 (不需要模型和 espeak)
+// 覆盖：推理结果缓存、.emis 存档、阈值表、CTC 解码、取消 / 截止时间、请求调度、模型版本和多语言注册表、准入估算。
+// 模型注册表的 LRU 淘汰需要真的加载模型：设置 SPEECH_TEST_MODEL 和 SPEECH_TEST_VOCAB 时才检查，否则只检查不加载的部分。
+//
+// 用法:
+//   speech_components_test [--filter <测试名子串>]
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Align.h"
+#include "Cancel.h"
+#include "CostModel.h"
+#include "CtcDecode.h"
+#include "EmissionCache.h"
+#include "EmissionFile.h"
+#include "Lattice.h"
+#include "Log.h"
+#include "ModelRegistry.h"
+#include "ModelStore.h"
+#include "Scheduler.h"
+#include "Thresholds.h"
+#include "Vocab.h"
+
+#include "test_check.h"
+
+using Clock = std::chrono::steady_clock;
+
+// 临时目录下的文件，测试结束时删除
+static std::string tempPath(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("speech_components_test_" + name)).u8string();
+}
+
+// 在 timeout 内等 cond 成立 (后台线程的效果)
+template <typename Cond>
+static bool waitFor(Cond cond, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000))
+{
+    auto until = Clock::now() + timeout;
+    while (!cond()) {
+        if (Clock::now() > until) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// 每帧的 argmax 为 labels[t] (-0.1)，其余 token 为 -5
+static std::vector<float> peakyMatrix(const std::vector<int>& labels, int vocab)
+{
+    std::vector<float> m(labels.size() * vocab, -5.0f);
+    for (size_t t = 0; t < labels.size(); ++t) m[t * vocab + labels[t]] = -0.1f;
+    return m;
+}
+
+static EmissionView viewOf(const std::vector<float>& data, int vocab)
+{
+    EmissionView v;
+    v.data = data.data();
+    v.vocab = vocab;
+    v.frames = (int)(data.size() / vocab);
+    return v;
+}
+
+static std::shared_ptr<const EmissionMatrix> makeMatrix(int frames, int vocab, float fill)
+{
+    auto m = std::make_shared<EmissionMatrix>();
+    m->frames = frames;
+    m->vocab = vocab;
+    m->data.assign((size_t)frames * vocab, fill);
+    return m;
+}
+
+// ==========================================
+// EmissionCache
+// ==========================================
+
+// 条目数满时淘汰最久未用的：find 会把条目移到最近使用的位置
+static void testCacheLruOrder()
+{
+    EmissionCache cache(1 << 20, 2);
+    cache.insert(1, makeMatrix(10, 10, -1.0f));
+    cache.insert(2, makeMatrix(10, 10, -2.0f));
+    CHECK(cache.find(1) != nullptr);
+    cache.insert(3, makeMatrix(10, 10, -3.0f));
+
+    CHECK(cache.find(2) == nullptr);
+    CHECK(cache.find(1) != nullptr);
+    CHECK(cache.find(3) != nullptr);
+    EmissionCache::Stats s = cache.stats();
+    CHECK(s.entries == 2);
+    CHECK(s.evictions == 1);
+    CHECK(s.hits == 3);
+    CHECK(s.misses == 1);
+}
+
+// 字节数超限同样按 LRU 淘汰；单个超过上限的矩阵不缓存；被淘汰的矩阵由持有者保活
+static void testCacheByteLimit()
+{
+    const size_t one = makeMatrix(10, 10, 0.0f)->bytes();
+    EmissionCache cache(2 * one + one / 2, 16);
+    cache.insert(1, makeMatrix(10, 10, -1.0f));
+    cache.insert(2, makeMatrix(10, 10, -2.0f));
+    std::shared_ptr<const EmissionMatrix> held = cache.find(1);
+    cache.insert(3, makeMatrix(10, 10, -3.0f));
+    CHECK(cache.find(2) == nullptr);
+    CHECK(cache.stats().bytes == 2 * one);
+
+    cache.insert(4, makeMatrix(100, 10, -4.0f));
+    CHECK(cache.find(4) == nullptr);
+    CHECK(cache.stats().entries == 2);
+
+    cache.insert(5, makeMatrix(10, 10, -5.0f));
+    cache.insert(6, makeMatrix(10, 10, -6.0f));
+    CHECK(cache.find(1) == nullptr);
+    CHECK(held && held->data.size() == 100 && held->data[0] == -1.0f);
+
+    cache.setLimits(0, 0);
+    CHECK(cache.stats().entries == 0);
+    cache.insert(7, makeMatrix(1, 1, 0.0f));
+    CHECK(cache.find(7) == nullptr);
+}
+
+// ==========================================
+// EmissionFile (.emis)
+// ==========================================
+
+// fp16：相对误差 2^-11 (非规格化数另有 2^-25 的绝对误差)
+static float fp16Bound(float x)
+{
+    return std::ldexp(std::fabs(x), -11) + std::ldexp(1.0f, -25);
+}
+
+// int8：见 EmissionFile.h，低于 EMISSION_INT8_FLOOR 的读回为 EMISSION_INT8_FLOOR
+static float int8Bound(float x)
+{
+    float clipped = std::fabs(std::max(EMISSION_INT8_FLOOR, x));
+    return std::sqrt(-EMISSION_INT8_FLOOR * clipped) / 255.0f - EMISSION_INT8_FLOOR / (255.0f * 255.0f) + 1e-6f;
+}
+
+static void testEmissionFileRoundTrip()
+{
+    const int T = 7, V = 40;
+    std::vector<float> data((size_t)T * V);
+    for (int t = 0; t < T; ++t) {
+        for (int v = 0; v < V; ++v) {
+            // 覆盖 0 附近、常见范围和低于 int8 下限的值
+            data[(size_t)t * V + v] = -std::pow(1.37f, (float)((t * V + v) % 17)) + 1.0f - 0.01f * v - (v == 39 ? 100.0f : 0.0f);
+        }
+    }
+    EmissionView em = viewOf(data, V);
+    const std::string path = tempPath("roundtrip.emis");
+
+    for (EmissionEncoding enc : { EmissionEncoding::Float32, EmissionEncoding::Float16, EmissionEncoding::Int8 }) {
+        EmissionFileInfo info;
+        info.model_hash = 0x1234;
+        info.vocab_hash = 0x5678;
+        info.encoding = enc;
+        info.audio_samples = 16000;
+        CHECK(writeEmissionFile(path, em, info));
+
+        EmissionFile file;
+        CHECK(file.open(path));
+        if (!file.isOpen()) continue;
+        CHECK(file.info().frames == T);
+        CHECK(file.info().vocab == V);
+        CHECK(file.info().encoding == enc);
+        CHECK(file.info().model_hash == 0x1234);
+        CHECK(file.info().vocab_hash == 0x5678);
+        CHECK(file.info().audio_samples == 16000);
+
+        EmissionView got = file.view();
+        int outside = 0;
+        for (int t = 0; t < T; ++t) {
+            for (int v = 0; v < V; ++v) {
+                float x = em.logProb(t, v), y = got.logProb(t, v);
+                float bound = enc == EmissionEncoding::Float32 ? 0.0f : enc == EmissionEncoding::Float16 ? fp16Bound(x) : int8Bound(x);
+                float expected = enc == EmissionEncoding::Int8 ? std::max(EMISSION_INT8_FLOOR, x) : x;
+                if (!(std::fabs(y - expected) <= bound)) outside++;
+            }
+        }
+        CHECK(outside == 0);
+
+        std::shared_ptr<const EmissionMatrix> m = file.toMatrix();
+        CHECK(m && m->frames == T && m->vocab == V && m->data.size() == data.size());
+        file.close();
+    }
+
+    // top-k：保留的 token 原样，其余 token 平分剩下的概率 (都低于保留的最小值)
+    EmissionFileInfo info;
+    info.top_k = 3;
+    CHECK(writeEmissionFile(path, em, info));
+    EmissionFile file;
+    CHECK(file.open(path));
+    if (file.isOpen()) {
+        EmissionView got = file.view();
+        for (int t = 0; t < T; ++t) {
+            std::vector<float> row(em.row(t), em.row(t) + V);
+            std::sort(row.begin(), row.end(), std::greater<float>());
+            int kept = 0;
+            for (int v = 0; v < V; ++v) {
+                if (got.logProb(t, v) == em.logProb(t, v) && em.logProb(t, v) >= row[2]) kept++;
+                else CHECK(got.logProb(t, v) <= row[2]);
+            }
+            CHECK(kept == 3);
+        }
+        file.close();
+    }
+    std::filesystem::remove(std::filesystem::u8path(path));
+}
+
+// 文件头不对或数据区被截断的存档拒绝打开
+static void testEmissionFileRejectsCorrupt()
+{
+    std::vector<float> data(4 * 8, -1.0f);
+    const std::string path = tempPath("corrupt.emis");
+    CHECK(writeEmissionFile(path, viewOf(data, 8), EmissionFileInfo()));
+
+    std::vector<char> bytes;
+    {
+        std::ifstream in(std::filesystem::u8path(path), std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto rewrite = [&](const std::vector<char>& b) {
+        std::ofstream out(std::filesystem::u8path(path), std::ios::binary | std::ios::trunc);
+        out.write(b.data(), (std::streamsize)b.size());
+    };
+
+    EmissionFile file;
+    std::vector<char> truncated(bytes.begin(), bytes.end() - 4);
+    rewrite(truncated);
+    CHECK(!file.open(path));
+    CHECK(!file.isOpen());
+
+    std::vector<char> bad_magic = bytes;
+    bad_magic[0] ^= 0x20;
+    rewrite(bad_magic);
+    CHECK(!file.open(path));
+
+    std::vector<char> header_only(bytes.begin(), bytes.begin() + 10);
+    rewrite(header_only);
+    CHECK(!file.open(path));
+
+    CHECK(!file.open(tempPath("missing.emis")));
+    std::filesystem::remove(std::filesystem::u8path(path));
+}
+
+// ==========================================
+// ThresholdTable / ThresholdSet
+// ==========================================
+
+static void testThresholdLookup()
+{
+    ThresholdTable table;
+    table.setDefaults({ -1.0f, -2.0f });
+    table.setPhoneme("θ", { -1.5f, -3.0f });
+
+    CHECK(table.lookup("θ").good == -3.0f);
+    CHECK(table.lookup("θ").excellent == -1.5f);
+    CHECK(table.lookup("s").good == -2.0f);
+    CHECK(table.isGood("θ", -2.9f));
+    CHECK(!table.isGood("s", -2.9f));
+    // 严格大于
+    CHECK(!table.isGood("s", -2.0f));
+    CHECK(!table.isExcellent("θ", -1.5f));
+    CHECK(table.isExcellent("θ", -1.4f));
+
+    auto builtin = ThresholdTable::builtin();
+    CHECK(builtin->lookup("θ").good == THRESHOLD_GOOD);
+    CHECK(builtin->lookup("θ").excellent == THRESHOLD_EXCELLENT);
+}
+
+static std::shared_ptr<const ThresholdTable> tableWithGood(float good)
+{
+    auto t = std::make_shared<ThresholdTable>();
+    t->setDefaults({ THRESHOLD_EXCELLENT, good });
+    return t;
+}
+
+// 精确匹配 -> 语言前缀 -> "default" -> 内置表
+static void testThresholdSelect()
+{
+    ThresholdSet set;
+    CHECK(set.select("en-us") == ThresholdTable::builtin());
+
+    set.set("en-us", tableWithGood(-2.1f));
+    set.set("en", tableWithGood(-2.2f));
+    set.set("default", tableWithGood(-2.3f));
+    CHECK(set.select("en-us")->defaults().good == -2.1f);
+    CHECK(set.select("en-gb")->defaults().good == -2.2f);
+    CHECK(set.select("en")->defaults().good == -2.2f);
+    CHECK(set.select("fr")->defaults().good == -2.3f);
+}
+
+// 存盘再读回一致；只写了 good 的音素，excellent 沿用该口音的默认值
+static void testThresholdJson()
+{
+    const std::string path = tempPath("thresholds.json");
+    auto table = std::make_shared<ThresholdTable>();
+    table->setDefaults({ -0.8f, -2.4f });
+    table->setPhoneme("ð", { -1.2f, -3.3f });
+    ThresholdSet out;
+    out.set("en-us", table);
+    CHECK(out.saveToJson(path));
+
+    ThresholdSet in;
+    CHECK(in.loadFromJson(path));
+    auto t = in.select("en-us");
+    CHECK(t->defaults().excellent == -0.8f);
+    CHECK(t->defaults().good == -2.4f);
+    CHECK(t->lookup("ð").excellent == -1.2f);
+    CHECK(t->lookup("ð").good == -3.3f);
+
+    {
+        std::ofstream f(std::filesystem::u8path(path), std::ios::trunc);
+        f << R"({ "version": 1, "languages": { "en": { "default": { "excellent": -0.5, "good": -2.0 },
+                 "phonemes": { "θ": { "good": -3.0 } } } } })";
+    }
+    ThresholdSet partial;
+    CHECK(partial.loadFromJson(path));
+    CHECK(partial.select("en")->lookup("θ").good == -3.0f);
+    CHECK(partial.select("en")->lookup("θ").excellent == -0.5f);
+
+    CHECK(!partial.loadFromJson(tempPath("missing.json")));
+    std::filesystem::remove(std::filesystem::u8path(path));
+}
+
+// ==========================================
+// CtcDecode
+// ==========================================
+
+// argmax:  b a a b a c c b b b d b  (blank = 0)
+static const std::vector<int> DECODE_LABELS = { 0, 1, 1, 0, 1, 2, 2, 0, 0, 0, 3, 0 };
+
+static void testGreedyDecode()
+{
+    std::vector<float> m = peakyMatrix(DECODE_LABELS, 4);
+    std::vector<CtcToken> tokens = greedyDecode(viewOf(m, 4), 0);
+    CHECK(tokens.size() == 4);
+    if (tokens.size() != 4) return;
+    // 被 blank 隔开的重复 token 是两个，连续的相同帧合并
+    CHECK(tokens[0].token_id == 1 && tokens[0].start_frame == 1 && tokens[0].end_frame == 2);
+    CHECK(tokens[1].token_id == 1 && tokens[1].start_frame == 4 && tokens[1].end_frame == 4);
+    CHECK(tokens[2].token_id == 2 && tokens[2].start_frame == 5 && tokens[2].end_frame == 6);
+    CHECK(tokens[3].token_id == 3 && tokens[3].start_frame == 10 && tokens[3].end_frame == 10);
+
+    CHECK(greedyDecode(viewOf(peakyMatrix({ 0, 0, 0 }, 4), 4), 0).empty());
+}
+
+// 束宽 1 等同贪心；峰值明显的矩阵上更宽的束结果一样
+static void testBeamDecode()
+{
+    std::vector<float> m = peakyMatrix(DECODE_LABELS, 4);
+    std::vector<CtcToken> greedy = greedyDecode(viewOf(m, 4), 0);
+    for (int width : { 1, 4 }) {
+        std::vector<CtcToken> beam = beamDecode(viewOf(m, 4), 0, width);
+        CHECK(beam.size() == greedy.size());
+        for (size_t i = 0; i < beam.size() && i < greedy.size(); ++i) {
+            CHECK(beam[i].token_id == greedy[i].token_id);
+            CHECK(beam[i].start_frame == greedy[i].start_frame);
+        }
+    }
+}
+
+// 开头和结尾的静音不算停顿
+static void testFindPauses()
+{
+    std::vector<float> m = peakyMatrix(DECODE_LABELS, 4);
+    std::vector<CtcPause> pauses = findPauses(viewOf(m, 4), 0, 3);
+    CHECK(pauses.size() == 1);
+    if (!pauses.empty()) CHECK(pauses[0].start_frame == 7 && pauses[0].end_frame == 10 && pauses[0].length() == 3);
+
+    pauses = findPauses(viewOf(m, 4), 0, 1);
+    CHECK(pauses.size() == 2);
+    if (pauses.size() == 2) CHECK(pauses[0].start_frame == 3 && pauses[0].end_frame == 4);
+}
+
+// ==========================================
+// CancelToken
+// ==========================================
+
+// 只有第一次取消生效；回调只调用一次，注销后不再调用，取消后注册的回调立即调用
+static void testCancelCallbacks()
+{
+    CancelToken token;
+    CHECK(!token.isCancelled());
+    CHECK(token.reason() == CancelReason::None);
+
+    std::atomic<int> calls{ 0 }, removed_calls{ 0 };
+    token.addCallback([&]() { calls++; });
+    int id = token.addCallback([&]() { removed_calls++; });
+    token.removeCallback(id);
+
+    token.cancel(CancelReason::Cancelled);
+    token.cancel(CancelReason::DeadlineExceeded);
+    CHECK(token.isCancelled());
+    CHECK(token.reason() == CancelReason::Cancelled);
+    CHECK(calls == 1);
+    CHECK(removed_calls == 0);
+
+    std::atomic<int> late{ 0 };
+    token.addCallback([&]() { late++; });
+    CHECK(late == 1);
+
+    {
+        CancelToken scoped;
+        std::atomic<int> n{ 0 };
+        {
+            ScopedCancelCallback cb(&scoped, [&]() { n++; });
+        }
+        scoped.cancel();
+        CHECK(n == 0);
+    }
+}
+
+// 截止时间由计时线程触发，没有人轮询回调也会执行
+static void testCancelDeadline()
+{
+    CancelToken token;
+    std::atomic<int> calls{ 0 };
+    token.addCallback([&]() { calls++; });
+    token.setDeadline(Clock::now() + std::chrono::milliseconds(20));
+    CHECK(token.hasDeadline());
+    CHECK(waitFor([&]() { return calls.load() == 1; }));
+    CHECK(token.isCancelled());
+    CHECK(token.reason() == CancelReason::DeadlineExceeded);
+    CHECK(std::string(cancelReasonName(token.reason())) != cancelReasonName(CancelReason::Cancelled));
+}
+
+static Vocab buildTestVocab()
+{
+    std::map<std::string, int> ids = { { "<pad>", 0 }, { "a", 1 }, { "b", 2 }, { "c", 3 } };
+    Vocab vocab;
+    vocab.build(ids);
+    return vocab;
+}
+
+static WordAnalysis makeWord(const std::vector<std::string>& phonemes)
+{
+    WordAnalysis w;
+    for (const auto& p : phonemes) w.word += p;
+    w.clean_word = w.word;
+    w.phonemes = phonemes;
+    return w;
+}
+
+// 已取消的令牌让 Viterbi 在第一次检查时退出 (两种实现、线性格和带跳词的格都一样)，不取消时同样的输入能对齐
+static void testCancelViterbi()
+{
+    const Vocab vocab = buildTestVocab();
+    std::vector<int> labels;
+    for (int t = 0; t < 4000; ++t) labels.push_back(t % 4 == 0 ? 0 : 1 + (t / 1000) % 3);
+    std::vector<float> m = peakyMatrix(labels, 4);
+    EmissionView em = viewOf(m, 4);
+    std::vector<WordAnalysis> words = { makeWord({ "a", "b" }), makeWord({ "c", "a" }) };
+
+    for (bool allow_skip : { false, true }) {
+        LatticeOptions lo;
+        lo.allow_skip = allow_skip;
+        CtcLattice lattice = buildLattice(words, vocab, 0, lo);
+        CHECK(lattice.linear == !allow_skip);
+
+        std::vector<int> path;
+        CHECK(viterbiLattice(em, lattice, path));
+        CHECK((int)path.size() == em.frames);
+
+        CancelToken token;
+        token.cancel();
+        path.clear();
+        CHECK(!viterbiLattice(em, lattice, path, &token));
+        CHECK(!viterbiLatticeLowMemory(em, lattice, path, &token));
+        CHECK(path.empty());
+    }
+
+    CancelToken token;
+    GopOptions options;
+    std::vector<WordAnalysis> scored = words;
+    CHECK(calculateGOP(em, vocab, scored, 0, nullptr, options));
+    options.cancel = &token;
+    token.cancel(CancelReason::DeadlineExceeded);
+    CHECK(!calculateGOP(em, vocab, scored, 0, nullptr, options));
+}
+
+// ==========================================
+// RequestScheduler
+// ==========================================
+
+// 唯一的工作线程被占住时先后到达后台和交互请求：放开后先执行交互请求
+static void testSchedulerInteractiveFirst()
+{
+    std::mutex order_mutex;
+    std::vector<std::string> order;
+    auto log = [&](const std::string& name) {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back(name);
+    };
+
+    std::promise<void> started, release;
+    std::shared_future<void> gate = release.get_future().share();
+    {
+        SchedulerOptions options;
+        options.workers = 1;
+        RequestScheduler scheduler(options);
+        CHECK(scheduler.submit(Priority::Interactive, [&](double) {
+            started.set_value();
+            gate.wait();
+            log("blocker");
+        }));
+        started.get_future().wait();
+
+        CHECK(scheduler.submit(Priority::Background, [&](double) { log("background-1"); }));
+        CHECK(scheduler.submit(Priority::Background, [&](double) { log("background-2"); }));
+        CHECK(scheduler.submit(Priority::Interactive, [&](double) { log("interactive"); }));
+        CHECK(scheduler.stats().classes[(int)Priority::Background].queued == 2);
+        release.set_value();
+        CHECK(waitFor([&]() { return scheduler.idle(); }));
+        CHECK(scheduler.stats().classes[(int)Priority::Background].completed == 2);
+    }
+    CHECK((order == std::vector<std::string>{ "blocker", "interactive", "background-1", "background-2" }));
+}
+
+// 队列满时拒绝 (任务不执行)；同时执行的后台任务不超过上限
+static void testSchedulerLimits()
+{
+    std::atomic<int> ran{ 0 };
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+    {
+        SchedulerOptions options;
+        options.workers = 2;
+        options.max_background_running = 1;
+        options.max_queued[(int)Priority::Interactive] = 1;
+        options.max_queued[(int)Priority::Background] = 1;
+        RequestScheduler scheduler(options);
+
+        auto blocking = [&](double) {
+            gate.wait();
+            ran++;
+        };
+        CHECK(scheduler.submit(Priority::Background, blocking));
+        CHECK(waitFor([&]() { return scheduler.stats().classes[(int)Priority::Background].running == 1; }));
+        // 第二个后台任务有空闲线程也只能排队
+        CHECK(scheduler.submit(Priority::Background, blocking));
+        CHECK(!scheduler.submit(Priority::Background, blocking));
+        CHECK(scheduler.submit(Priority::Interactive, blocking));
+        CHECK(waitFor([&]() { return scheduler.stats().classes[(int)Priority::Interactive].running == 1; }));
+
+        RequestScheduler::Stats s = scheduler.stats();
+        CHECK(s.classes[(int)Priority::Background].running == 1);
+        CHECK(s.classes[(int)Priority::Background].queued == 1);
+        CHECK(s.classes[(int)Priority::Background].rejected == 1);
+
+        CHECK(scheduler.submit(Priority::Interactive, blocking));
+        CHECK(!scheduler.submit(Priority::Interactive, blocking));
+        CHECK(scheduler.stats().classes[(int)Priority::Interactive].rejected == 1);
+        release.set_value();
+    }
+    CHECK(ran == 4);
+}
+
+// ==========================================
+// ModelStore / ModelRegistry
+// ==========================================
+
+// publish 只是指针交换：已经拿到的旧句柄照常可用
+static void testModelStorePublish()
+{
+    ModelStore store;
+    CHECK(store.acquire() == nullptr);
+    CHECK(store.version() == 0);
+
+    auto first = std::make_shared<ModelRunner>();
+    ModelSource a;
+    a.model_path = "a.onnx";
+    CHECK(store.publish(first, a) == 1);
+    std::shared_ptr<const ModelRunner> held = store.acquire();
+    CHECK(held == first);
+
+    auto second = std::make_shared<ModelRunner>();
+    ModelSource b;
+    b.model_path = "b.onnx";
+    CHECK(store.publish(second, b) == 2);
+    CHECK(store.acquire() == second);
+    CHECK(store.source().model_path == "b.onnx");
+    CHECK(held == first);
+
+    first.reset();
+    CHECK(held.use_count() == 1);
+}
+
+// 加载失败时当前版本不变；后台加载失败时回调 ok = false、version = 0
+static void testModelStoreLoadFailure()
+{
+    ModelStore store;
+    auto current = std::make_shared<ModelRunner>();
+    store.publish(current, ModelSource());
+
+    ModelSource missing;
+    missing.model_path = tempPath("missing.onnx");
+    missing.vocab_path = tempPath("missing.json");
+    CHECK(!store.load(missing));
+    CHECK(store.version() == 1);
+    CHECK(store.acquire() == current);
+
+    std::promise<std::pair<bool, uint64_t>> result;
+    CHECK(store.loadAsync(missing, [&](bool ok, uint64_t version) { result.set_value({ ok, version }); }));
+    auto r = result.get_future().get();
+    CHECK(!r.first);
+    CHECK(r.second == 0);
+    CHECK(waitFor([&]() { return !store.isLoading(); }));
+    CHECK(store.version() == 1);
+}
+
+static void testModelRegistryFailures()
+{
+    ModelRegistry registry;
+    CHECK(!registry.has("en"));
+    CHECK(registry.acquire("en") == nullptr);
+    CHECK(registry.voiceFor("fr") == "fr");
+
+    ModelSource missing;
+    missing.model_path = tempPath("missing.onnx");
+    registry.registerLanguage("en", missing);
+    registry.registerLanguage("en-gb", missing, "en-gb-x-rp");
+    CHECK(registry.has("en"));
+    CHECK(registry.voiceFor("en") == "en");
+    CHECK(registry.voiceFor("en-gb") == "en-gb-x-rp");
+
+    CHECK(registry.acquire("en") == nullptr);
+    ModelRegistry::Stats s = registry.stats();
+    CHECK(s.load_failures == 1);
+    CHECK(s.loads == 0);
+    CHECK(s.resident_bytes == 0);
+    CHECK(!s.events.empty() && s.events.back().type == ModelEventType::LoadFailed && s.events.back().language == "en");
+}
+
+// 超出预算时淘汰最久未用的语言 (刚加载的除外)，被淘汰的句柄照常可用
+static void testModelRegistryLru()
+{
+    const char* model = std::getenv("SPEECH_TEST_MODEL");
+    const char* vocab = std::getenv("SPEECH_TEST_VOCAB");
+    if (!model || !vocab) {
+        std::cout << "  (set SPEECH_TEST_MODEL and SPEECH_TEST_VOCAB to check eviction)" << std::endl;
+        return;
+    }
+
+    ModelSource source;
+    source.model_path = model;
+    source.vocab_path = vocab;
+    const size_t bytes = estimateModelBytes(source, false);
+    CHECK(bytes > 0);
+
+    ModelRegistry registry(2 * bytes);
+    for (const char* lang : { "a", "b", "c" }) registry.registerLanguage(lang, source);
+
+    auto a = registry.acquire("a");
+    auto b = registry.acquire("b");
+    CHECK(a && b && a != b);
+    CHECK(registry.acquire("a") == a);
+    auto c = registry.acquire("c");
+    CHECK(c != nullptr);
+
+    ModelRegistry::Stats s = registry.stats();
+    CHECK(s.loads == 3);
+    CHECK(s.evictions == 1);
+    CHECK(s.resident_bytes == 2 * bytes);
+    for (const auto& l : s.languages) CHECK(l.resident == (l.language != "b"));
+    CHECK(!s.events.empty() && s.events.back().type == ModelEventType::Evict && s.events.back().language == "b");
+    CHECK(b.use_count() == 1);
+
+    // 再次使用被淘汰的语言时重新加载
+    CHECK(registry.acquire("b") != nullptr);
+    CHECK(registry.stats().loads == 4);
+}
+
+// ==========================================
+// CostModel
+// ==========================================
+
+// 依次尝试原方式和低内存方式；degrade 为 false 时直接拒绝
+static void testCostModelPlan()
+{
+    CostModel cost;
+    const uint64_t T = 3000, V = 392, S = 400;
+    CostEstimate full = cost.estimate(0, T, V, S, false);
+    CostEstimate low = cost.estimate(0, T, V, S, true);
+    CHECK(low.align_bytes < full.align_bytes);
+    CHECK(low.align_ms > full.align_ms);
+    CHECK(full.inference_bytes == 0 && full.inference_ms == 0.0);
+    CHECK(cost.estimate(T * 320, T, V, S, false).inference_bytes > 0);
+
+    AdmissionPolicy policy;
+    CHECK(cost.plan(policy, 0, T, V, S).decision == AdmissionDecision::Full);
+
+    policy.max_bytes = low.peakBytes();
+    Admission a = cost.plan(policy, 0, T, V, S);
+    CHECK(a.decision == AdmissionDecision::LowMemory);
+    CHECK(a.estimate.align_bytes == low.align_bytes);
+
+    policy.max_bytes = low.peakBytes() - 1;
+    a = cost.plan(policy, 0, T, V, S);
+    CHECK(a.decision == AdmissionDecision::Rejected);
+    CHECK(a.reason.find("memory") != std::string::npos);
+
+    policy.max_bytes = low.peakBytes();
+    policy.degrade = false;
+    CHECK(cost.plan(policy, 0, T, V, S).decision == AdmissionDecision::Rejected);
+
+    // 低内存方式更慢，时间预算不够时不降级
+    AdmissionPolicy timed;
+    timed.max_bytes = low.peakBytes();
+    timed.max_ms = full.totalMs();
+    a = cost.plan(timed, 0, T, V, S);
+    CHECK(a.decision == AdmissionDecision::Rejected);
+    CHECK(a.reason.find("time") != std::string::npos);
+
+    cost.record(AdmissionDecision::LowMemory);
+    cost.record(AdmissionDecision::LowMemory);
+    cost.record(AdmissionDecision::Rejected);
+    CostModel::Stats s = cost.stats();
+    CHECK(s.decisions[(int)AdmissionDecision::Full] == 0);
+    CHECK(s.decisions[(int)AdmissionDecision::LowMemory] == 2);
+    CHECK(s.decisions[(int)AdmissionDecision::Rejected] == 1);
+    cost.resetStats();
+    CHECK(cost.stats().decisions[(int)AdmissionDecision::LowMemory] == 0);
+}
+
+// 完成的请求按滑动平均校准耗时系数；分段对齐不校准对齐系数
+static void testCostModelObserve()
+{
+    CostModel cost;
+    const CostModel::Coefficients before = cost.stats().coefficients;
+
+    StageTimings t;
+    t.frames = 100;
+    t.states = 50;
+    t.segments = 1;
+    t.add(Stage::Inference, 300.0);
+    t.add(Stage::LogSoftmax, 100.0);
+    t.add(Stage::Align, 100 * 50 * (before.align_ns_per_cell + 10.0) * 1e-6);
+    cost.observe(t, false);
+
+    CostModel::Coefficients after = cost.stats().coefficients;
+    CHECK(std::fabs(after.inference_ms_per_frame - (before.inference_ms_per_frame + 0.1 * (4.0 - before.inference_ms_per_frame))) < 1e-9);
+    CHECK(std::fabs(after.align_ns_per_cell - (before.align_ns_per_cell + 1.0)) < 1e-6);
+
+    StageTimings segmented = t;
+    segmented.segments = 3;
+    segmented.measured[(int)Stage::Inference] = false;
+    cost.observe(segmented, false);
+    CHECK(cost.stats().coefficients.align_ns_per_cell == after.align_ns_per_cell);
+    CHECK(cost.stats().coefficients.inference_ms_per_frame == after.inference_ms_per_frame);
+
+    StageTimings empty;
+    cost.observe(empty, false);
+    CHECK(cost.stats().coefficients.inference_ms_per_frame == after.inference_ms_per_frame);
+}
+
+int main(int argc, char** argv)
+{
+    // 加载失败、文件损坏都会打日志，这里只关心结果
+    setLogLevel(LogLevel::Off);
+
+    return runTests("speech_components_test", {
+        { "emissionCache/lruOrder", testCacheLruOrder },
+        { "emissionCache/byteLimit", testCacheByteLimit },
+        { "emissionFile/roundTrip", testEmissionFileRoundTrip },
+        { "emissionFile/rejectsCorrupt", testEmissionFileRejectsCorrupt },
+        { "thresholds/lookup", testThresholdLookup },
+        { "thresholds/select", testThresholdSelect },
+        { "thresholds/json", testThresholdJson },
+        { "ctcDecode/greedy", testGreedyDecode },
+        { "ctcDecode/beam", testBeamDecode },
+        { "ctcDecode/pauses", testFindPauses },
+        { "cancel/callbacks", testCancelCallbacks },
+        { "cancel/deadline", testCancelDeadline },
+        { "cancel/viterbi", testCancelViterbi },
+        { "scheduler/interactiveFirst", testSchedulerInteractiveFirst },
+        { "scheduler/limits", testSchedulerLimits },
+        { "modelStore/publish", testModelStorePublish },
+        { "modelStore/loadFailure", testModelStoreLoadFailure },
+        { "modelRegistry/failures", testModelRegistryFailures },
+        { "modelRegistry/lru", testModelRegistryLru },
+        { "costModel/plan", testCostModelPlan },
+        { "costModel/observe", testCostModelObserve },
+    }, argc, argv);
+}
@@ -0,0 +1,485 @@
+// 常驻评分服务 (Linux / macOS，无界面)
+// 模型只加载一次常驻内存，通过本地 Unix 套接字接收请求 (PCM + 参考文本)，
+// 返回打包好的评分结果。协议见 src/WireProtocol.h。
+// 每个连接一个 I/O 线程，推理和对齐交给固定大小的工作线程池，排队满了直接回 Busy。
+//
+// 用法:
+//   speech_daemon --model wav2vec2.onnx --vocab vocab.json --espeak <espeak-ng-data 父目录>
+//                 [--socket /tmp/speech.sock] [--socket-mode 660] [--workers N] [--intra-threads N]
+//                 [--max-queue N] [--voice en-us] [--thresholds thresholds.json] [--max-per 0.8]
+//                 [--max-request-mb N] [--verbose]
+//
+// SIGINT / SIGTERM 时停止接受新连接，处理完已收到的请求后退出并打印统计
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <json.hpp>
+
+#include "ModelRunner.h"
+#include "Phonemizer.h"
+#include "Align.h"
+#include "CostModel.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Scheduler.h"
+#include "Thresholds.h"
+#include "Transcript.h"
+#include "WireProtocol.h"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct DaemonOptions {
+    std::string model_path;
+    std::string vocab_path;
+    std::string espeak_path;
+    std::string socket_path = "/tmp/speech.sock";
+    std::string socket_mode;  // 八进制，如 660；为空时沿用 umask
+    std::string voice = "en-us";
+    std::string thresholds_path;
+    int workers = 0;          // 0 = 硬件线程数 / intra_threads
+    int intra_threads = 1;    // 每个请求的推理线程数；并发靠 workers，单请求不抢核
+    size_t max_queue = 64;    // 排队上限，满了回 Busy
+    float max_phone_error_rate = 0.8f;
+    uint64_t max_request_bytes = 0; // 单个请求的内存预算，超出时改用低内存对齐，仍超出回 TooLarge
+    bool verbose = false;
+};
+
+static std::atomic<bool> g_stop{ false };
+
+static void onSignal(int)
+{
+    g_stop.store(true);
+}
+
+static void printUsage()
+{
+    std::cerr << "Usage: speech_daemon --model <onnx> --vocab <json> --espeak <dir>\n"
+              << "                     [--socket <path>] [--socket-mode 660] [--workers N] [--intra-threads N]\n"
+              << "                     [--max-queue N] [--voice en-us] [--thresholds <json>] [--max-per 0.8]\n"
+              << "                     [--max-request-mb N] [--verbose]" << std::endl;
+}
+
+static bool parseArgs(int argc, char** argv, DaemonOptions& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&](std::string& dst) {
+            if (i + 1 >= argc) return false;
+            dst = argv[++i];
+            return true;
+        };
+
+        bool ok = true;
+        std::string v;
+        if (arg == "--model") ok = next(opt.model_path);
+        else if (arg == "--vocab") ok = next(opt.vocab_path);
+        else if (arg == "--espeak") ok = next(opt.espeak_path);
+        else if (arg == "--socket") ok = next(opt.socket_path);
+        else if (arg == "--socket-mode") ok = next(opt.socket_mode);
+        else if (arg == "--voice") ok = next(opt.voice);
+        else if (arg == "--thresholds") ok = next(opt.thresholds_path);
+        else if (arg == "--workers") {
+            ok = next(v);
+            if (ok) opt.workers = std::atoi(v.c_str());
+        }
+        else if (arg == "--intra-threads") {
+            ok = next(v);
+            if (ok) opt.intra_threads = std::max(1, std::atoi(v.c_str()));
+        }
+        else if (arg == "--max-queue") {
+            ok = next(v);
+            if (ok) opt.max_queue = (size_t)std::max(1, std::atoi(v.c_str()));
+        }
+        else if (arg == "--max-per") {
+            ok = next(v);
+            if (ok) opt.max_phone_error_rate = (float)std::atof(v.c_str());
+        }
+        else if (arg == "--max-request-mb") {
+            ok = next(v);
+            if (ok) opt.max_request_bytes = (uint64_t)std::max(0.0, std::atof(v.c_str()) * 1024 * 1024);
+        }
+        else if (arg == "--verbose") opt.verbose = true;
+        else {
+            std::cerr << "[Error] Unknown argument: " << arg << std::endl;
+            return false;
+        }
+
+        if (!ok) {
+            std::cerr << "[Error] Missing value for " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (opt.model_path.empty() || opt.vocab_path.empty() || opt.espeak_path.empty()) return false;
+    if (opt.socket_path.size() >= sizeof(sockaddr_un::sun_path)) {
+        std::cerr << "[Error] Socket path too long: " << opt.socket_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 常驻状态：模型、G2P 和工作线程池，所有连接共用
+struct Daemon {
+    DaemonOptions opt;
+    ModelRunner master;
+    std::unique_ptr<Phonemizer> phonemizer;
+    std::shared_ptr<const ThresholdTable> thresholds;
+    std::unique_ptr<RequestScheduler> scheduler;
+    PipelineStats stats;
+    CostModel cost;
+    std::atomic<uint64_t> busy{ 0 };
+    std::atomic<uint64_t> bad_requests{ 0 };
+};
+
+static void fillResponse(const std::vector<WordAnalysis>& words, WireResponse& resp)
+{
+    resp.words.clear();
+    resp.words.reserve(words.size());
+    for (const auto& w : words) {
+        WireWord ww;
+        ww.word = w.word;
+        ww.score = w.word_score;
+        ww.variant = (uint8_t)std::min(w.variant, 255);
+        ww.flags = w.skipped ? WIRE_WORD_SKIPPED : 0;
+        ww.phonemes.reserve(w.details.size());
+        for (const auto& d : w.details) {
+            WirePhoneme wp;
+            wp.ipa = d.ipa;
+            wp.score = d.score;
+            wp.start_frame = d.start_frame;
+            wp.end_frame = d.end_frame;
+            wp.flags = (uint8_t)((d.is_good ? WIRE_PHONEME_GOOD : 0) | (d.is_excellent ? WIRE_PHONEME_EXCELLENT : 0));
+            ww.phonemes.push_back(std::move(wp));
+        }
+        resp.words.push_back(std::move(ww));
+    }
+}
+
+// 在工作线程上执行：推理 + (可选预检) + 对齐
+static void scoreRequest(Daemon& d, const WireRequest& req, WireResponse& resp)
+{
+    StageTimings timings;
+    ScopedStageTimer total_timer(&timings, Stage::Total);
+
+    // 前端之前按输入长度预估，超预算的请求连下混和重采样也不做
+    AdmissionPolicy policy;
+    policy.max_bytes = d.opt.max_request_bytes;
+    uint64_t audio_samples = resampledLength(req.pcm.size() / req.channels, req.sample_rate); // validateRequest 已检查过声道数
+    Admission admission = d.cost.plan(policy, audio_samples, framesForSamples(audio_samples),
+                                      d.master.getVocab().idCount(), estimateStatesFromText(req.text));
+    if (admission.decision == AdmissionDecision::Rejected) {
+        d.cost.record(AdmissionDecision::Rejected);
+        resp.status = WireStatus::TooLarge;
+        resp.error = admission.reason;
+        d.stats.record(timings, false);
+        return;
+    }
+
+    ModelRunner runner;
+    runner.shareModelFrom(d.master);
+
+    ScopedStageTimer frontend_timer(&timings, Stage::FrontEnd);
+    runner.loadAudio(req.pcm.data(), req.pcm.size(), req.sample_rate, req.channels);
+    frontend_timer.stop();
+    timings.input_samples = runner.getInputSamples();
+    timings.audio_samples = runner.getAudioSize();
+
+    if (!runner.runInference(&timings)) {
+        resp.status = WireStatus::Failed;
+        resp.error = "Inference execution failed";
+        d.stats.record(timings, false);
+        return;
+    }
+    const EmissionView em = runner.getEmissions();
+    resp.frames = (uint32_t)em.frames;
+
+    ScopedStageTimer g2p_timer(&timings, Stage::G2P);
+    std::vector<WordAnalysis> words = d.phonemizer->analyzeText(req.text);
+    g2p_timer.stop();
+
+    bool mismatch = false;
+    if (req.flags & WIRE_FLAG_PRECHECK) {
+        ScopedStageTimer decode_timer(&timings, Stage::Decode);
+        PrecheckOptions precheck;
+        precheck.enabled = true;
+        precheck.max_phone_error_rate = d.opt.max_phone_error_rate;
+        mismatch = !transcriptMatches(decodeTranscript(em, d.master.getVocab(), words, 0), precheck);
+    }
+
+    if (mismatch) {
+        markWordsUnaligned(words, d.master.getVocab());
+        resp.flags |= WIRE_RESULT_MISMATCH;
+    }
+    else {
+        admission = d.cost.plan(policy, 0, em.frames, em.vocab, estimateLatticeStates(words.data(), words.size(), d.master.getVocab()));
+        d.cost.record(admission.decision);
+        if (admission.decision == AdmissionDecision::Rejected) {
+            resp.status = WireStatus::TooLarge;
+            resp.error = admission.reason;
+            d.stats.record(timings, false);
+            return;
+        }
+
+        ScopedStageTimer align_timer(&timings, Stage::Align);
+        GopOptions gop;
+        gop.segment.enabled = (req.flags & WIRE_FLAG_SEGMENTED) != 0;
+        gop.thresholds = d.thresholds;
+        if (admission.decision == AdmissionDecision::LowMemory) {
+            gop.low_memory = true;
+            gop.segment.enabled = true;
+        }
+        if (!calculateGOP(em, d.master.getVocab(), words, 0, &timings, gop)) {
+            resp.status = WireStatus::Failed;
+            resp.error = "Alignment failed";
+            d.stats.record(timings, false);
+            return;
+        }
+    }
+
+    resp.overall_score = calculateOverallScore(words);
+    fillResponse(words, resp);
+    total_timer.stop();
+    d.stats.record(timings, true);
+    d.cost.observe(timings, admission.decision == AdmissionDecision::LowMemory);
+}
+
+// 请求合法性检查，不合法时返回说明
+static std::string validateRequest(const WireRequest& req)
+{
+    if (req.sample_rate < 1000 || req.sample_rate > 384000) return "Unsupported sample rate";
+    if (req.channels < 1 || req.channels > 8) return "Unsupported channel count";
+    if (req.pcm.empty() || req.pcm.size() % req.channels != 0) return "PCM sample count is not a multiple of channels";
+    if (req.text.empty()) return "Empty reference text";
+    return std::string();
+}
+
+// 处理一个请求帧，返回要写回的响应
+static void handleFrame(Daemon& d, const std::vector<uint8_t>& frame, WireResponse& resp)
+{
+    auto received = Clock::now();
+    auto request = std::make_shared<WireRequest>();
+    if (!decodeRequest(frame.data(), frame.size(), *request)) {
+        d.bad_requests++;
+        resp.status = WireStatus::BadRequest;
+        resp.error = "Malformed request frame";
+        return;
+    }
+    resp.request_id = request->request_id;
+
+    std::string invalid = validateRequest(*request);
+    if (!invalid.empty()) {
+        d.bad_requests++;
+        resp.status = WireStatus::BadRequest;
+        resp.error = invalid;
+        return;
+    }
+
+    auto result = std::make_shared<std::promise<WireResponse>>();
+    std::future<WireResponse> done = result->get_future();
+    bool queued = d.scheduler->submit(Priority::Interactive, [&d, request, result](double wait_ms) {
+        WireResponse r;
+        r.request_id = request->request_id;
+        r.queue_ms = (float)wait_ms;
+        scoreRequest(d, *request, r);
+        result->set_value(std::move(r));
+    });
+    if (!queued) {
+        d.busy++;
+        resp.status = WireStatus::Busy;
+        resp.error = "Server queue is full";
+        return;
+    }
+
+    resp = done.get();
+    resp.server_ms = (float)std::chrono::duration<double, std::milli>(Clock::now() - received).count();
+}
+
+// 连接线程：同一连接上的请求按顺序处理
+static void serveConnection(Daemon& d, int fd)
+{
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> out;
+    while (readFrame(fd, frame)) {
+        WireResponse resp;
+        handleFrame(d, frame, resp);
+        if (resp.status != WireStatus::Ok) {
+            LOG_INFO("[Info] Request " << resp.request_id << ": " << wireStatusName(resp.status) << " (" << resp.error << ")");
+        }
+        encodeResponse(resp, out);
+        if (!writeFrame(fd, out)) break;
+    }
+}
+
+static int openListener(const DaemonOptions& opt)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "[Error] socket(): " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, opt.socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // 上次异常退出留下的套接字文件
+    ::unlink(opt.socket_path.c_str());
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 64) < 0) {
+        std::cerr << "[Error] Cannot listen on " << opt.socket_path << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    if (!opt.socket_mode.empty()) {
+        ::chmod(opt.socket_path.c_str(), (mode_t)std::strtol(opt.socket_mode.c_str(), nullptr, 8));
+    }
+    return fd;
+}
+
+static void printStats(const Daemon& d, double uptime_sec)
+{
+    PipelineStats::Snapshot snap = d.stats.snapshot();
+    RequestScheduler::Stats sched = d.scheduler->stats();
+    const RequestScheduler::ClassStats& q = sched.classes[(int)Priority::Interactive];
+
+    json stats;
+    stats["uptime_sec"] = uptime_sec;
+    stats["requests"] = snap.requests;
+    stats["failures"] = snap.failures;
+    stats["busy"] = d.busy.load();
+    stats["bad_requests"] = d.bad_requests.load();
+    CostModel::Stats cs = d.cost.stats();
+    stats["admission"] = { { "full", cs.decisions[(int)AdmissionDecision::Full] },
+                           { "low_memory", cs.decisions[(int)AdmissionDecision::LowMemory] },
+                           { "rejected", cs.decisions[(int)AdmissionDecision::Rejected] } };
+    stats["workers"] = sched.workers;
+    stats["queue_wait_ms"] = { { "mean", q.wait_ms.mean }, { "p50", q.wait_ms.p50 }, { "p95", q.wait_ms.p95 }, { "p99", q.wait_ms.p99 }, { "max", q.wait_ms.max } };
+    json stages;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const StageSummary& st = snap.stages[s];
+        stages[stageName((Stage)s)] = { { "mean", st.mean }, { "p50", st.p50 }, { "p95", st.p95 }, { "p99", st.p99 }, { "max", st.max } };
+    }
+    stats["stages_ms"] = stages;
+    std::cerr << "[Daemon] " << stats.dump(2) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    Daemon d;
+    DaemonOptions& opt = d.opt;
+    if (!parseArgs(argc, argv, opt)) {
+        printUsage();
+        return 2;
+    }
+    if (!opt.verbose) setLogLevel(LogLevel::Warning);
+
+    // 1. 模型、词表、G2P 和阈值表只加载一次
+    d.master.setIntraOpThreads(opt.intra_threads);
+    if (!d.master.loadModel(opt.model_path) || !d.master.loadVocab(opt.vocab_path)) {
+        return 1;
+    }
+    d.phonemizer.reset(new Phonemizer(opt.espeak_path, d.master.getVocab(), opt.voice));
+    if (!d.phonemizer->isInitialized()) {
+        std::cerr << "[Error] Failed to initialize Espeak" << std::endl;
+        return 1;
+    }
+    d.thresholds = ThresholdTable::builtin();
+    if (!opt.thresholds_path.empty()) {
+        ThresholdSet set;
+        if (!set.loadFromJson(opt.thresholds_path)) return 1;
+        d.thresholds = set.select(opt.voice);
+    }
+
+    // 2. 工作线程池：默认让 workers x intra_threads 大致等于核数
+    SchedulerOptions sched;
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    sched.workers = opt.workers > 0 ? opt.workers : std::max(1, cores / opt.intra_threads);
+    sched.max_queued[(int)Priority::Interactive] = opt.max_queue;
+    sched.max_queued[(int)Priority::Background] = 0;
+    d.scheduler.reset(new RequestScheduler(sched));
+
+    // 3. 信号：客户端断开时写失败返回 EPIPE 而不是杀掉进程
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    int listen_fd = openListener(opt);
+    if (listen_fd < 0) return 1;
+    std::cerr << "[Daemon] Listening on " << opt.socket_path << " (" << sched.workers << " workers x "
+              << opt.intra_threads << " intra-op threads, queue " << opt.max_queue << ")" << std::endl;
+
+    auto started = Clock::now();
+    std::mutex conn_mutex;
+    std::list<std::pair<int, std::thread>> connections;
+    std::list<int> finished; // 已经结束、等待回收的连接 fd
+
+    // 4. 接受连接。poll 带超时，以便及时看到退出信号
+    while (!g_stop.load()) {
+        pollfd pfd{ listen_fd, POLLIN, 0 };
+        int n = ::poll(&pfd, 1, 200);
+        if (n < 0 && errno != EINTR) {
+            std::cerr << "[Error] poll(): " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        // 回收已经结束的连接线程
+        {
+            std::lock_guard<std::mutex> lock(conn_mutex);
+            for (int fd : finished) {
+                auto it = std::find_if(connections.begin(), connections.end(), [fd](const auto& c) { return c.first == fd; });
+                if (it != connections.end()) {
+                    it->second.join();
+                    ::close(fd);
+                    connections.erase(it);
+                }
+            }
+            finished.clear();
+        }
+
+        if (n <= 0 || !(pfd.revents & POLLIN)) continue;
+        int client = ::accept(listen_fd, nullptr, nullptr);
+        if (client < 0) continue;
+
+        std::lock_guard<std::mutex> lock(conn_mutex);
+        connections.emplace_back(client, std::thread([&d, &conn_mutex, &finished, client]() {
+            serveConnection(d, client);
+            std::lock_guard<std::mutex> finished_lock(conn_mutex);
+            finished.push_back(client);
+        }));
+    }
+
+    // 5. 退出：不再接受连接，唤醒阻塞在 read 上的连接线程，已提交的请求仍会算完
+    std::cerr << "[Daemon] Shutting down..." << std::endl;
+    ::close(listen_fd);
+    ::unlink(opt.socket_path.c_str());
+    {
+        std::lock_guard<std::mutex> lock(conn_mutex);
+        for (auto& c : connections) ::shutdown(c.first, SHUT_RD);
+    }
+    for (auto& c : connections) {
+        c.second.join();
+        ::close(c.first);
+    }
+
+    printStats(d, std::chrono::duration<double>(Clock::now() - started).count());
+    d.scheduler.reset();
+    return 0;
+}
@@ -0,0 +1,247 @@
+// speech_daemon 压测工具
+// 开 N 个客户端连接，每个连接循环发送同一段录音 (上一条回复收到后再发下一条)，
+// 统计吞吐 (req/s) 和端到端延迟分位数，以及服务端报告的排队时间。
+//
+// 用法:
+//   speech_loadgen --wav sample.wav --text "reference text" [--socket /tmp/speech.sock]
+//                  [--clients N] (--requests N | --duration SEC) [--segmented] [--precheck]
+//                  [--out report.json]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <json.hpp>
+
+#include "dr_wav.h"
+#include "WireProtocol.h"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct LoadOptions {
+    std::string socket_path = "/tmp/speech.sock";
+    std::string wav_path;
+    std::string text;
+    std::string out_path;
+    int clients = 4;
+    int requests = 0;       // 总请求数，0 = 按 duration
+    double duration_sec = 10.0;
+    uint16_t flags = 0;
+};
+
+// 全部客户端的统计 (持锁写入)
+struct LoadStats {
+    std::mutex mutex;
+    std::vector<double> latency_ms;
+    std::vector<double> queue_ms;
+    uint64_t ok = 0;
+    uint64_t busy = 0;
+    uint64_t failed = 0;       // 服务端返回 BadRequest / Failed
+    uint64_t disconnected = 0; // 连接失败或中途断开
+};
+
+static void printUsage()
+{
+    std::cerr << "Usage: speech_loadgen --wav <file> --text <reference> [--socket <path>]\n"
+              << "                      [--clients N] (--requests N | --duration SEC) [--segmented] [--precheck]\n"
+              << "                      [--out <json>]" << std::endl;
+}
+
+static bool parseArgs(int argc, char** argv, LoadOptions& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&](std::string& dst) {
+            if (i + 1 >= argc) return false;
+            dst = argv[++i];
+            return true;
+        };
+
+        bool ok = true;
+        std::string v;
+        if (arg == "--socket") ok = next(opt.socket_path);
+        else if (arg == "--wav") ok = next(opt.wav_path);
+        else if (arg == "--text") ok = next(opt.text);
+        else if (arg == "--out") ok = next(opt.out_path);
+        else if (arg == "--clients") {
+            ok = next(v);
+            if (ok) opt.clients = std::max(1, std::atoi(v.c_str()));
+        }
+        else if (arg == "--requests") {
+            ok = next(v);
+            if (ok) opt.requests = std::max(0, std::atoi(v.c_str()));
+        }
+        else if (arg == "--duration") {
+            ok = next(v);
+            if (ok) opt.duration_sec = std::atof(v.c_str());
+        }
+        else if (arg == "--segmented") opt.flags |= WIRE_FLAG_SEGMENTED;
+        else if (arg == "--precheck") opt.flags |= WIRE_FLAG_PRECHECK;
+        else {
+            std::cerr << "[Error] Unknown argument: " << arg << std::endl;
+            return false;
+        }
+
+        if (!ok) {
+            std::cerr << "[Error] Missing value for " << arg << std::endl;
+            return false;
+        }
+    }
+    return !opt.wav_path.empty() && !opt.text.empty() && opt.socket_path.size() < sizeof(sockaddr_un::sun_path);
+}
+
+static int connectTo(const std::string& path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv)
+{
+    LoadOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        printUsage();
+        return 2;
+    }
+    if (opt.text.size() > WIRE_MAX_TEXT_BYTES) {
+        std::cerr << "[Error] Reference text too long: " << opt.text.size() << " bytes (max " << WIRE_MAX_TEXT_BYTES
+                  << ")" << std::endl;
+        return 1;
+    }
+
+    // 按原始采样率和声道发送，重采样由服务端完成 (和应用里录音上传的路径一致)
+    unsigned int channels = 0, rate = 0;
+    drwav_uint64 frames = 0;
+    float* data = drwav_open_file_and_read_pcm_frames_f32(opt.wav_path.c_str(), &channels, &rate, &frames, NULL);
+    if (!data) {
+        std::cerr << "[Error] Cannot read WAV: " << opt.wav_path << std::endl;
+        return 1;
+    }
+    WireRequest request;
+    request.flags = opt.flags;
+    request.sample_rate = rate;
+    request.channels = (uint16_t)channels;
+    request.pcm.assign(data, data + frames * channels);
+    request.text = opt.text;
+    drwav_free(data, NULL);
+
+    std::cerr << "[Loadgen] " << opt.wav_path << " (" << (double)frames / rate << " s), " << opt.clients << " clients, "
+              << (opt.requests > 0 ? std::to_string(opt.requests) + " requests" : std::to_string(opt.duration_sec) + " s")
+              << std::endl;
+
+    LoadStats stats;
+    std::atomic<int> remaining{ opt.requests };
+    auto started = Clock::now();
+    auto deadline = started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.duration_sec));
+
+    // 取下一个请求的名额：按请求数时扣计数，按时长时看时间
+    auto takeTicket = [&]() {
+        if (opt.requests > 0) return remaining.fetch_sub(1) > 0;
+        return Clock::now() < deadline;
+    };
+
+    std::vector<std::thread> clients;
+    for (int c = 0; c < opt.clients; ++c) {
+        clients.emplace_back([&, c]() {
+            int fd = connectTo(opt.socket_path);
+            if (fd < 0) {
+                std::lock_guard<std::mutex> lock(stats.mutex);
+                stats.disconnected++;
+                return;
+            }
+
+            WireRequest req = request;
+            std::vector<uint8_t> body, reply;
+            uint32_t seq = 0;
+            while (takeTicket()) {
+                req.request_id = ((uint32_t)c << 24) | (seq++ & 0xFFFFFF);
+                encodeRequest(req, body); // 文本长度启动时已检查过
+
+                auto t0 = Clock::now();
+                WireResponse resp;
+                bool ok = writeFrame(fd, body) && readFrame(fd, reply) && decodeResponse(reply.data(), reply.size(), resp);
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+                if (!ok) {
+                    std::lock_guard<std::mutex> lock(stats.mutex);
+                    stats.disconnected++;
+                    break;
+                }
+                if (resp.status == WireStatus::Busy) {
+                    {
+                        std::lock_guard<std::mutex> lock(stats.mutex);
+                        stats.busy++;
+                    }
+                    // 服务端队列满：稍等再发，否则只是在空转刷 Busy
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock(stats.mutex);
+                if (resp.status == WireStatus::Ok) {
+                    stats.ok++;
+                    stats.latency_ms.push_back(ms);
+                    stats.queue_ms.push_back(resp.queue_ms);
+                }
+                else if (stats.failed++ == 0) {
+                    std::cerr << "[Warning] Server returned " << wireStatusName(resp.status) << ": " << resp.error << std::endl;
+                }
+            }
+            ::close(fd);
+        });
+    }
+    for (auto& t : clients) t.join();
+    double wall_sec = std::chrono::duration<double>(Clock::now() - started).count();
+
+    auto summarize = [](std::vector<double>& v) {
+        std::sort(v.begin(), v.end());
+        auto pct = [&](double p) {
+            if (v.empty()) return 0.0;
+            size_t k = (size_t)std::min<double>(v.size() - 1, p * (v.size() - 1) + 0.5);
+            return v[k];
+        };
+        double sum = 0.0;
+        for (double x : v) sum += x;
+        return json{ { "mean", v.empty() ? 0.0 : sum / v.size() }, { "p50", pct(0.50) }, { "p95", pct(0.95) },
+                     { "p99", pct(0.99) }, { "max", v.empty() ? 0.0 : v.back() } };
+    };
+
+    json report;
+    report["clients"] = opt.clients;
+    report["wall_sec"] = wall_sec;
+    report["ok"] = stats.ok;
+    report["busy"] = stats.busy;
+    report["failed"] = stats.failed;
+    report["disconnected"] = stats.disconnected;
+    report["requests_per_sec"] = wall_sec > 0 ? stats.ok / wall_sec : 0.0;
+    report["realtime_factor"] = wall_sec > 0 ? stats.ok * ((double)frames / rate) / wall_sec : 0.0;
+    report["latency_ms"] = summarize(stats.latency_ms);
+    report["queue_ms"] = summarize(stats.queue_ms);
+
+    std::cout << report.dump(2) << std::endl;
+    if (!opt.out_path.empty()) {
+        std::ofstream f(opt.out_path);
+        f << report.dump(2) << std::endl;
+    }
+    return stats.failed == 0 && stats.disconnected == 0 ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+// speech_daemon 套接字协议的测试 (编解码往返、边界和畸形输入)
+//
+// 用法:
+//   speech_protocol_test [--filter <测试名子串>]
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "WireProtocol.h"
+
+#include "test_check.h"
+
+static WireRequest makeRequest(size_t text_bytes)
+{
+    WireRequest req;
+    req.request_id = 0x01020304;
+    req.flags = WIRE_FLAG_SEGMENTED | WIRE_FLAG_PRECHECK;
+    req.sample_rate = 44100;
+    req.channels = 2;
+    for (int i = 0; i < 320; ++i) req.pcm.push_back((float)i / 320.0f - 0.5f);
+    req.text.assign(text_bytes, 'a');
+    return req;
+}
+
+static void testRequestRoundTrip()
+{
+    WireRequest in = makeRequest(0);
+    in.text = "héllo wörld";
+    std::vector<uint8_t> body;
+    WireRequest out;
+    CHECK(encodeRequest(in, body));
+    CHECK(decodeRequest(body.data(), body.size(), out));
+    CHECK(out.request_id == in.request_id);
+    CHECK(out.flags == in.flags);
+    CHECK(out.sample_rate == in.sample_rate);
+    CHECK(out.channels == in.channels);
+    CHECK(out.pcm == in.pcm);
+    CHECK(out.text == in.text);
+}
+
+// text_bytes 是 u16：上限以内原样往返，超过上限拒绝编码 (不截断，否则服务端会给另一句话打分)
+static void testRequestTextBoundary()
+{
+    std::vector<uint8_t> body;
+    for (size_t len : { (size_t)0, (size_t)1, WIRE_MAX_TEXT_BYTES }) {
+        WireRequest in = makeRequest(len);
+        WireRequest out;
+        CHECK(encodeRequest(in, body));
+        CHECK(decodeRequest(body.data(), body.size(), out));
+        CHECK(out.text == in.text);
+        CHECK(out.pcm == in.pcm);
+    }
+
+    std::vector<uint8_t> before = { 1, 2, 3 };
+    body = before;
+    CHECK(!encodeRequest(makeRequest(WIRE_MAX_TEXT_BYTES + 1), body));
+    CHECK(body == before);
+}
+
+// 按 body 布局改写 offset 处的 u32 / u16 (小端)
+static void putU32(std::vector<uint8_t>& body, size_t offset, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) body[offset + i] = (uint8_t)(v >> (8 * i));
+}
+
+static void putU16(std::vector<uint8_t>& body, size_t offset, uint16_t v)
+{
+    body[offset] = (uint8_t)v;
+    body[offset + 1] = (uint8_t)(v >> 8);
+}
+
+// magic、版本不对，或者 sample_count / text_bytes 与 body 长度对不上 (多或少) 的请求一律拒绝
+static void testRequestMalformed()
+{
+    std::vector<uint8_t> good;
+    CHECK(encodeRequest(makeRequest(5), good));
+    WireRequest out;
+
+    std::vector<uint8_t> body = good;
+    putU32(body, 0, WIRE_RESPONSE_MAGIC);
+    CHECK(!decodeRequest(body.data(), body.size(), out));
+
+    body = good;
+    putU16(body, 4, WIRE_VERSION + 1);
+    CHECK(!decodeRequest(body.data(), body.size(), out));
+
+    // sample_count 在偏移 20，text_bytes 在偏移 18
+    body = good;
+    putU32(body, 20, 321);
+    CHECK(!decodeRequest(body.data(), body.size(), out));
+    putU32(body, 20, 0x40000000);
+    CHECK(!decodeRequest(body.data(), body.size(), out));
+
+    body = good;
+    putU16(body, 18, 6);
+    CHECK(!decodeRequest(body.data(), body.size(), out));
+
+    body = good;
+    body.push_back(0);
+    CHECK(!decodeRequest(body.data(), body.size(), out));
+
+    for (size_t len : { (size_t)0, (size_t)3, (size_t)23, good.size() - 1 }) {
+        CHECK(!decodeRequest(good.data(), len, out));
+    }
+    CHECK(decodeRequest(good.data(), good.size(), out));
+}
+
+// 响应同样不接受截断
+static void testResponseTruncated()
+{
+    WireResponse in;
+    in.request_id = 7;
+    in.overall_score = 0.5f;
+    WireWord word;
+    word.word = "hello";
+    WirePhoneme phoneme;
+    phoneme.ipa = "h";
+    word.phonemes.push_back(phoneme);
+    in.words.push_back(word);
+
+    std::vector<uint8_t> body;
+    WireResponse out;
+    encodeResponse(in, body);
+    CHECK(decodeResponse(body.data(), body.size(), out));
+    CHECK(out.words.size() == 1 && out.words[0].phonemes.size() == 1 && out.words[0].phonemes[0].ipa == "h");
+    for (size_t len = 0; len < body.size(); ++len) {
+        CHECK(!decodeResponse(body.data(), len, out));
+    }
+}
+
+// 向管道写入原始字节后关闭写端，返回读端
+static int pipeWith(const std::vector<uint8_t>& bytes)
+{
+    int fds[2];
+    if (::pipe(fds) != 0) return -1;
+    size_t written = 0;
+    while (written < bytes.size()) {
+        ssize_t n = ::write(fds[1], bytes.data() + written, bytes.size() - written);
+        if (n <= 0) break;
+        written += (size_t)n;
+    }
+    ::close(fds[1]);
+    return fds[0];
+}
+
+// 长度前缀超过 WIRE_MAX_FRAME_BYTES 时不分配、直接拒绝；帧体不足前缀声明的长度时拒绝；长度前缀本身不完整也拒绝
+static void testFrameMalformed()
+{
+    std::vector<uint8_t> body;
+
+    uint32_t too_big = WIRE_MAX_FRAME_BYTES + 1;
+    std::vector<uint8_t> bytes = { (uint8_t)too_big, (uint8_t)(too_big >> 8), (uint8_t)(too_big >> 16), (uint8_t)(too_big >> 24) };
+    int fd = pipeWith(bytes);
+    CHECK(fd >= 0);
+    CHECK(!readFrame(fd, body));
+    CHECK(body.empty());
+    ::close(fd);
+
+    bytes = { 0xFF, 0xFF, 0xFF, 0xFF };
+    fd = pipeWith(bytes);
+    CHECK(!readFrame(fd, body));
+    ::close(fd);
+
+    bytes = { 100, 0, 0, 0 };
+    bytes.resize(4 + 10, 0xAB);
+    fd = pipeWith(bytes);
+    CHECK(!readFrame(fd, body));
+    ::close(fd);
+
+    bytes = { 100, 0 };
+    fd = pipeWith(bytes);
+    CHECK(!readFrame(fd, body));
+    ::close(fd);
+
+    fd = pipeWith({});
+    CHECK(!readFrame(fd, body));
+    ::close(fd);
+}
+
+// writeFrame / readFrame 往返，连续的两帧按边界分开
+static void testFrameRoundTrip()
+{
+    int fds[2];
+    CHECK(::pipe(fds) == 0);
+    std::vector<uint8_t> first;
+    CHECK(encodeRequest(makeRequest(3), first));
+    std::vector<uint8_t> second = { 1, 2, 3 };
+    CHECK(writeFrame(fds[1], first));
+    CHECK(writeFrame(fds[1], second));
+    CHECK(writeFrame(fds[1], {}));
+    ::close(fds[1]);
+
+    std::vector<uint8_t> body;
+    CHECK(readFrame(fds[0], body) && body == first);
+    CHECK(readFrame(fds[0], body) && body == second);
+    CHECK(readFrame(fds[0], body) && body.empty());
+    CHECK(!readFrame(fds[0], body));
+    ::close(fds[0]);
+}
+
+int main(int argc, char** argv)
+{
+    return runTests("speech_protocol_test", {
+        { "request/roundTrip", testRequestRoundTrip },
+        { "request/textBoundary", testRequestTextBoundary },
+        { "request/malformed", testRequestMalformed },
+        { "response/truncated", testResponseTruncated },
+        { "frame/malformed", testFrameMalformed },
+        { "frame/roundTrip", testFrameRoundTrip },
+    }, argc, argv);
+}
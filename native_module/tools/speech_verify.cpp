@@ -0,0 +1,887 @@
+// 内核差分校验
+// 用随机输入和刻意构造的边界输入，对比 src/ 里的对齐、前端和分词内核与 reference_kernels 里冻结的
+// 参考实现：返回值、对齐路径 (每个音素的起止帧) 和分词结果必须完全一致，得分和样本值在容差内一致。
+// 同一轮里统计参考实现和各个变体的耗时，给出加速比。有不一致时退出码为 1。
+//
+// 用法:
+//   speech_verify [--cases 200] [--seed 1] [--repeat 3] [--tolerance 1e-5]
+//                 [--filter <内核名/变体名子串>] [--json report.json] [--verbose]
+//
+// 不需要模型和 espeak，输入全部由 --seed 决定，不一致的用例按 "内核 #序号 标签" 报告，
+// 同样的 --seed 和 --cases 可以复现。给内核换新的实现时，把它加进 main 里对应内核的变体列表。
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "AudioFrontEnd.h"
+#include "ModelRunner.h"
+#include "Phonemizer.h"
+#include "Align.h"
+#include "Thresholds.h"
+#include "Log.h"
+
+#include "reference_kernels.h"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+using Rng = std::mt19937_64;
+
+struct VerifyOptions {
+    int cases = 200;           // 每个内核的随机用例数 (另有固定的边界用例)
+    uint64_t seed = 1;
+    int repeat = 3;            // 每个用例每个实现运行的次数，计时取最小值
+    double tolerance = 1e-5;   // 浮点结果的相对误差 (绝对值小于 1 时按绝对误差)
+    std::string filter;
+    std::string json_path;
+    bool verbose = false;      // 打印所有不一致的用例 (默认每个变体只打印前几个)
+};
+
+// 一个内核的一种实现
+template <typename Fn>
+struct Variant {
+    std::string name;
+    Fn fn;
+};
+
+struct VariantReport {
+    std::string kernel;
+    std::string variant;
+    int cases = 0;
+    int failures = 0;
+    double max_error = 0.0;  // 浮点结果的最大相对误差
+    double reference_ns = 0.0;
+    double variant_ns = 0.0;
+    std::vector<std::string> messages; // 不一致的用例
+};
+
+/**
+ * 一个内核的校验：同一批用例分别交给参考实现和每个变体，逐个比较输出。
+ * exec 运行一次实现并返回耗时 (纳秒，只计被测调用)；compare 返回空串表示一致，否则是差异说明
+ */
+template <typename Case, typename Output, typename Fn>
+struct Kernel {
+    std::string name;
+    std::vector<Case> cases;
+    Fn reference;
+    std::vector<Variant<Fn>> variants;
+    std::function<double(const Fn&, const Case&, Output&)> exec;
+    std::function<std::string(const Case&, const Output&, const Output&, const VerifyOptions&, double&)> compare;
+};
+
+static const int MAX_PRINTED_FAILURES = 5;
+
+template <typename F>
+static double timeNs(F&& f)
+{
+    auto t0 = Clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+// 两个浮点数在容差内一致：NaN 只和 NaN 一致，无穷只和同号无穷一致
+static bool closeEnough(float a, float b, double tolerance, double& error)
+{
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    if (std::isinf(a) || std::isinf(b)) return a == b;
+    double diff = std::fabs((double)a - b);
+    double scale = std::max(1.0, std::max(std::fabs((double)a), std::fabs((double)b)));
+    error = std::max(error, diff / scale);
+    return diff <= tolerance * scale;
+}
+
+static std::string compareSamples(const std::vector<float>& ref, const std::vector<float>& got, double tolerance, double& error)
+{
+    if (ref.size() != got.size()) {
+        return "length " + std::to_string(got.size()) + ", expected " + std::to_string(ref.size());
+    }
+    for (size_t i = 0; i < ref.size(); ++i) {
+        if (!closeEnough(ref[i], got[i], tolerance, error)) {
+            std::ostringstream msg;
+            msg << "[" << i << "] = " << std::setprecision(9) << got[i] << ", expected " << ref[i];
+            return msg.str();
+        }
+    }
+    return "";
+}
+
+template <typename Case, typename Output, typename Fn>
+static void runKernel(const Kernel<Case, Output, Fn>& kernel, const VerifyOptions& opt, std::vector<VariantReport>& reports)
+{
+    std::vector<VariantReport> local;
+    std::vector<const Variant<Fn>*> selected;
+    for (const auto& v : kernel.variants) {
+        if (!opt.filter.empty() && (kernel.name + "/" + v.name).find(opt.filter) == std::string::npos) continue;
+        VariantReport r;
+        r.kernel = kernel.name;
+        r.variant = v.name;
+        local.push_back(r);
+        selected.push_back(&v);
+    }
+    if (selected.empty()) return;
+
+    Output expected, actual;
+    for (size_t c = 0; c < kernel.cases.size(); ++c) {
+        const Case& input = kernel.cases[c];
+
+        double ref_ns = std::numeric_limits<double>::max();
+        for (int r = 0; r < opt.repeat; ++r) ref_ns = std::min(ref_ns, kernel.exec(kernel.reference, input, expected));
+
+        for (size_t k = 0; k < selected.size(); ++k) {
+            double ns = std::numeric_limits<double>::max();
+            for (int r = 0; r < opt.repeat; ++r) ns = std::min(ns, kernel.exec(selected[k]->fn, input, actual));
+
+            VariantReport& report = local[k];
+            report.cases++;
+            report.reference_ns += ref_ns;
+            report.variant_ns += ns;
+            std::string diff = kernel.compare(input, expected, actual, opt, report.max_error);
+            if (!diff.empty()) {
+                report.failures++;
+                report.messages.push_back(kernel.name + " #" + std::to_string(c) + " " + input.label + ": " + diff);
+            }
+        }
+    }
+    reports.insert(reports.end(), local.begin(), local.end());
+}
+
+// ==========================================
+// 测试词表
+// ==========================================
+
+// 与 wav2vec2 音素模型的词表结构相同：0 号是 blank (<pad>)，特殊符号在前，
+// 有单字节、双字节、带长音符和多字符 (双元音、塞擦音) 的音素，还有单独的长音符
+static Vocab buildTestVocab()
+{
+    static const char* TOKENS[] = {
+        "<pad>", "<s>", "</s>", "<unk>", "|",
+        "a", "b", "d", "e", "f", "h", "i", "j", "k", "l", "m", "n", "o", "p", "s", "t", "u", "v", "w", "z",
+        "æ", "ð", "ŋ", "ɑ", "ɔ", "ə", "ɚ", "ɛ", "ɡ", "ɪ", "ɹ", "ʃ", "ʊ", "ʌ", "ʒ", "θ", "ː",
+        "ɑː", "iː", "uː", "ɜː", "ɔː", "aɪ", "aʊ", "eɪ", "oʊ", "ɔɪ", "tʃ", "dʒ", "tʃʰ",
+    };
+    std::map<std::string, int> ids;
+    for (const char* t : TOKENS) ids.emplace(t, (int)ids.size());
+    Vocab vocab;
+    vocab.build(ids);
+    return vocab;
+}
+
+// 可以作为对齐目标的音素 (跳过特殊符号和单独的长音符)
+static std::vector<std::string> phoneInventory(const Vocab& vocab)
+{
+    std::vector<std::string> phones;
+    for (int id = 5; id < vocab.idCount(); ++id) {
+        if (vocab.token(id) != "ː") phones.push_back(vocab.token(id));
+    }
+    return phones;
+}
+
+// 随机 logits -> 对数概率 (用参考实现归一化，矩阵本身只是输入数据)
+static std::vector<float> randomLogProbs(Rng& rng, int T, int V, float scale)
+{
+    std::normal_distribution<float> normal(0.0f, scale);
+    std::vector<float> m((size_t)T * V);
+    for (float& x : m) x = normal(rng);
+    reference::logSoftmax(m.data(), T, V);
+    return m;
+}
+
+// ==========================================
+// 1. computeLogSoftmax
+// ==========================================
+struct SoftmaxCase {
+    std::string label;
+    int frames = 0;
+    int vocab = 0;
+    std::vector<float> logits;
+};
+
+using SoftmaxFn = std::function<void(float*, int, int)>;
+
+static std::vector<SoftmaxCase> softmaxCases(Rng& rng, int count)
+{
+    std::vector<SoftmaxCase> cases;
+    const int vocab_sizes[] = { 1, 2, 3, 31, 32, 33, 392 };
+    auto add = [&](const std::string& label, int T, int V, const std::function<float(int, int)>& value) {
+        SoftmaxCase c;
+        c.label = label + " T=" + std::to_string(T) + " V=" + std::to_string(V);
+        c.frames = T;
+        c.vocab = V;
+        c.logits.resize((size_t)T * V);
+        for (int t = 0; t < T; ++t) {
+            for (int v = 0; v < V; ++v) c.logits[(size_t)t * V + v] = value(t, v);
+        }
+        cases.push_back(std::move(c));
+    };
+
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float inf = std::numeric_limits<float>::infinity();
+    for (int V : vocab_sizes) {
+        add("empty", 0, V, [](int, int) { return 0.0f; });
+        add("constant", 5, V, [](int, int) { return 3.0f; });
+        add("huge", 5, V, [&](int, int) { return normal(rng) * 1e30f; });
+        add("large-offset", 5, V, [&](int, int) { return 1e4f + normal(rng); });
+        // 部分 -inf (被屏蔽的 token)，最后一帧全部是 -inf
+        add("masked", 6, V, [&](int t, int) { return (t == 5 || unit(rng) < 0.3f) ? -inf : normal(rng) * 5.0f; });
+    }
+
+    std::uniform_int_distribution<int> pick_vocab(0, (int)(sizeof(vocab_sizes) / sizeof(vocab_sizes[0])) - 1);
+    std::uniform_int_distribution<int> pick_frames(1, 300);
+    const float scales[] = { 1.0f, 10.0f, 100.0f };
+    for (int i = 0; i < count; ++i) {
+        float scale = scales[i % 3];
+        add("random x" + std::to_string((int)scale), pick_frames(rng), vocab_sizes[pick_vocab(rng)],
+            [&](int, int) { return normal(rng) * scale; });
+    }
+    return cases;
+}
+
+// ==========================================
+// 2. mixToMono / resampleAudio
+// ==========================================
+struct AudioCase {
+    std::string label;
+    unsigned int rate = 16000;
+    unsigned int channels = 1;
+    size_t frames = 0;
+    std::vector<float> samples; // 交错多声道
+};
+
+using MixFn = std::function<void(std::vector<float>&, unsigned int, size_t)>;
+using ResampleFn = std::function<void(std::vector<float>&, unsigned int)>;
+
+static std::vector<AudioCase> audioCases(Rng& rng, int count)
+{
+    // 常见采样率，加上不整除 16k 的奇数采样率
+    const unsigned int rates[] = { 7999, 8000, 11025, 16000, 16001, 22050, 32001, 44100, 48000, 96000 };
+    const unsigned int channel_counts[] = { 1, 2, 3, 6 };
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    auto make = [&](unsigned int rate, unsigned int channels, size_t frames, const std::string& kind) {
+        AudioCase c;
+        c.label = kind + " " + std::to_string(rate) + "Hz " + std::to_string(channels) + "ch " + std::to_string(frames) + " frames";
+        c.rate = rate;
+        c.channels = channels;
+        c.frames = frames;
+        c.samples.resize(frames * channels);
+        float freq = 100.0f + 900.0f * unit(rng);
+        for (size_t i = 0; i < frames; ++i) {
+            float s = 0.5f * std::sin(6.2831853f * freq * i / rate);
+            for (unsigned int ch = 0; ch < channels; ++ch) {
+                // 满幅方波 (削波) 和带噪声的正弦交替出现
+                c.samples[i * channels + ch] = kind == "clipped" ? (s >= 0.0f ? 1.0f : -1.0f) : s * (1.0f - 0.1f * ch) + noise(rng);
+            }
+        }
+        return c;
+    };
+
+    std::vector<AudioCase> cases;
+    for (unsigned int rate : rates) {
+        for (unsigned int channels : channel_counts) {
+            for (size_t frames : { (size_t)0, (size_t)1, (size_t)2, (size_t)3 }) {
+                cases.push_back(make(rate, channels, frames, "short"));
+            }
+        }
+    }
+
+    std::uniform_int_distribution<int> pick_rate(0, (int)(sizeof(rates) / sizeof(rates[0])) - 1);
+    std::uniform_int_distribution<int> pick_channels(0, 3);
+    for (int i = 0; i < count; ++i) {
+        unsigned int rate = rates[pick_rate(rng)];
+        // 最长约 2 秒，长度不对齐任何块大小
+        size_t frames = (size_t)(unit(rng) * 2 * rate) + 4;
+        cases.push_back(make(rate, channel_counts[pick_channels(rng)], frames, i % 4 == 0 ? "clipped" : "tone"));
+    }
+    return cases;
+}
+
+// ==========================================
+// 3. cleanAndTokenizeIPA
+// ==========================================
+struct TokenizeCase {
+    std::string label;
+    std::string ipa;
+};
+
+using TokenizeFn = std::function<std::vector<std::string>(const std::string&, const Vocab&)>;
+
+static std::vector<TokenizeCase> tokenizeCases(Rng& rng, const Vocab& vocab, int count)
+{
+    std::vector<TokenizeCase> cases;
+    auto add = [&](const std::string& label, const std::string& ipa) { cases.push_back({ label, ipa }); };
+
+    add("empty", "");
+    add("stress only", "ˈˌ _\u00A0");
+    add("long vowels", "ɑːiːuːɜːɔː");
+    add("long mark after short-only vowel", "æːeː");
+    add("digraph vs long mark", "aɪːtʃːtʃʰ");
+    add("unknown chars", "həˈloʊ ʔ wɜːld Q");
+    add("4-byte char", "a\xF0\x9F\x99\x82" "b");
+    add("truncated tail", "ab\xC9");
+    add("truncated middle", "a\xE2\x82" "bc");
+    add("stray continuation", "\x80" "a\xBF" "b");
+
+    // 随机拼接：词表里的 token、重音符、空白和词表外的字符
+    std::vector<std::string> fragments = phoneInventory(vocab);
+    const char* noise[] = { "ˈ", "ˌ", " ", "_", "\u00A0", "ː", "ʔ", "Q", "\xF0\x9F\x99\x82", "\xC9", "\x80" };
+    std::uniform_int_distribution<int> pick_len(1, 40);
+    std::uniform_int_distribution<size_t> pick_phone(0, fragments.size() - 1);
+    std::uniform_int_distribution<size_t> pick_noise(0, sizeof(noise) / sizeof(noise[0]) - 1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < count; ++i) {
+        std::string s;
+        int n = pick_len(rng);
+        for (int k = 0; k < n; ++k) s += unit(rng) < 0.8f ? fragments[pick_phone(rng)] : noise[pick_noise(rng)];
+        add("random " + std::to_string(n), s);
+    }
+    return cases;
+}
+
+// ==========================================
+// 4. calculateGOP
+// ==========================================
+struct AlignCase {
+    std::string label;
+    int frames = 0;
+    int vocab = 0;
+    std::vector<float> log_probs;
+    std::vector<WordAnalysis> words;
+
+    EmissionView view() const
+    {
+        EmissionView v;
+        v.data = log_probs.data();
+        v.frames = frames;
+        v.vocab = vocab;
+        return v;
+    }
+};
+
+struct AlignOutput {
+    bool ok = false;
+    std::vector<WordAnalysis> words;
+};
+
+using AlignFn = std::function<bool(const EmissionView&, const Vocab&, std::vector<WordAnalysis>&, int)>;
+
+// 对齐目标展开后的长度：音素数 L 和相邻重复音素的对数 R (两者之间必须有 blank)，最少需要 L + R 帧
+static void targetShape(const std::vector<WordAnalysis>& words, const Vocab& vocab, std::vector<int>& targets, int& repeats)
+{
+    targets.clear();
+    repeats = 0;
+    for (const auto& w : words) {
+        for (const auto& p : w.phonemes) {
+            int id = vocab.find(p);
+            if (id < 0) continue;
+            if (!targets.empty() && targets.back() == id) repeats++;
+            targets.push_back(id);
+        }
+    }
+}
+
+static WordAnalysis makeWord(const std::vector<std::string>& phonemes)
+{
+    WordAnalysis w;
+    for (const auto& p : phonemes) w.word += p;
+    w.clean_word = w.word;
+    w.raw_ipa = w.word;
+    w.phonemes = phonemes;
+    return w;
+}
+
+// 随机单词列表：有意制造词内和跨词的重复音素 (考验跳过 blank 的规则)，偶尔夹带词表外的音素
+static std::vector<WordAnalysis> randomWords(Rng& rng, const std::vector<std::string>& phones)
+{
+    std::uniform_int_distribution<int> pick_words(1, 6), pick_len(1, 5);
+    std::uniform_int_distribution<size_t> pick_phone(0, phones.size() - 1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<WordAnalysis> words;
+    std::string last;
+    int n = pick_words(rng);
+    for (int w = 0; w < n; ++w) {
+        std::vector<std::string> ph;
+        if (unit(rng) < 0.05f) {
+            ph = { "ʔ" }; // 没有有效音素的词
+        }
+        else {
+            int len = pick_len(rng);
+            for (int k = 0; k < len; ++k) {
+                std::string p = phones[pick_phone(rng)];
+                if (!last.empty() && unit(rng) < (k == 0 ? 0.2f : 0.3f)) p = last;
+                if (unit(rng) < 0.05f) ph.push_back("ʔ");
+                ph.push_back(p);
+                last = p;
+            }
+        }
+        words.push_back(makeWord(ph));
+    }
+    return words;
+}
+
+// 沿一条合法的 CTC 路径 (随机时长) 给目标 token 高分，模拟读对了的录音
+static std::vector<float> peakyLogProbs(Rng& rng, const std::vector<int>& targets, int T, int V, int blank_idx)
+{
+    const size_t L = targets.size();
+    std::vector<int> target_len(L, 1), blank_len(L + 1, 0);
+    int used = (int)L;
+    for (size_t k = 1; k < L; ++k) {
+        if (targets[k] == targets[k - 1]) {
+            blank_len[k] = 1;
+            used++;
+        }
+    }
+    std::uniform_int_distribution<size_t> pick_slot(0, 2 * L);
+    for (int extra = T - used; extra > 0; --extra) {
+        size_t slot = pick_slot(rng);
+        if (slot < L) target_len[slot]++;
+        else blank_len[slot - L]++;
+    }
+
+    std::vector<int> labels;
+    for (size_t k = 0; k < L; ++k) {
+        labels.insert(labels.end(), blank_len[k], blank_idx);
+        labels.insert(labels.end(), target_len[k], targets[k]);
+    }
+    labels.insert(labels.end(), blank_len[L], blank_idx);
+
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> m((size_t)T * V);
+    for (int t = 0; t < T; ++t) {
+        for (int v = 0; v < V; ++v) m[(size_t)t * V + v] = normal(rng) + (v == labels[t] ? 8.0f : 0.0f);
+    }
+    reference::logSoftmax(m.data(), T, V);
+    return m;
+}
+
+static std::vector<AlignCase> alignCases(Rng& rng, const Vocab& vocab, int count)
+{
+    const int V = vocab.idCount();
+    const std::vector<std::string> phones = phoneInventory(vocab);
+    std::vector<AlignCase> cases;
+
+    auto add = [&](const std::string& label, std::vector<WordAnalysis> words, int T, const std::string& matrix) {
+        std::vector<int> targets;
+        int repeats = 0;
+        targetShape(words, vocab, targets, repeats);
+
+        AlignCase c;
+        c.frames = std::max(0, T);
+        c.vocab = V;
+        c.words = std::move(words);
+        c.label = matrix + " T=" + std::to_string(c.frames) + " L=" + std::to_string(targets.size()) +
+                  " R=" + std::to_string(repeats) + " (" + label + ")";
+        if (matrix == "peaky" && !targets.empty() && c.frames >= (int)targets.size() + repeats) {
+            c.log_probs = peakyLogProbs(rng, targets, c.frames, V, 0);
+        }
+        else if (matrix == "uniform") {
+            // 所有 token 概率相同：每一步转移都是平局，检验平局时选哪条转移
+            c.log_probs.assign((size_t)c.frames * V, -std::log((float)V));
+        }
+        else if (matrix == "quantized") {
+            // 取整数值的 logits，大量平局
+            std::uniform_int_distribution<int> level(0, 2);
+            c.log_probs.resize((size_t)c.frames * V);
+            for (float& x : c.log_probs) x = (float)level(rng);
+            reference::logSoftmax(c.log_probs.data(), c.frames, V);
+        }
+        else {
+            c.log_probs = randomLogProbs(rng, c.frames, V, 3.0f);
+        }
+        cases.push_back(std::move(c));
+    };
+
+    // 固定的边界用例
+    const std::vector<WordAnalysis> ll = { makeWord({ "l", "l" }) };
+    const std::vector<WordAnalysis> cross = { makeWord({ "h", "ɛ", "l" }), makeWord({ "l", "oʊ" }) };
+    add("no words", {}, 10, "random");
+    add("only unknown phonemes", { makeWord({ "ʔ" }) }, 10, "random");
+    add("no frames", ll, 0, "random");
+    add("single frame single phone", { makeWord({ "ə" }) }, 1, "random");
+    add("repeat within word, tight", ll, 3, "peaky");
+    add("repeat within word, infeasible", ll, 2, "random");
+    add("repeat across words, tight", cross, 6, "peaky");
+    add("repeat across words, infeasible", cross, 5, "random");
+    add("repeat across words, T < S", cross, 8, "uniform");
+    add("all ties", cross, 40, "uniform");
+    add("long run of one phone", { makeWord({ "s", "s", "s", "s" }) }, 7, "quantized");
+
+    const char* matrices[] = { "random", "peaky", "quantized", "uniform" };
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < count; ++i) {
+        std::vector<WordAnalysis> words = randomWords(rng, phones);
+        std::vector<int> targets;
+        int repeats = 0;
+        targetShape(words, vocab, targets, repeats);
+        const int L = (int)targets.size();
+        const int min_frames = L + repeats;
+        const int S = 2 * L + 1;
+
+        // 帧数：刚好够 / 差一帧 / 比状态数少 / 正常 / 很长
+        int T = 0;
+        std::string shape;
+        switch (i % 5) {
+        case 0: T = min_frames; shape = "tight"; break;
+        case 1: T = min_frames - 1; shape = "infeasible"; break;
+        case 2: T = min_frames + (int)(unit(rng) * (S - min_frames)); shape = "T < S"; break;
+        case 3: T = S + (int)(unit(rng) * 3 * S) + 10; shape = "normal"; break;
+        default: T = 10 * S; shape = "long"; break;
+        }
+        add(shape, std::move(words), T, matrices[(i / 5) % 4]);
+    }
+    return cases;
+}
+
+// 整词跳过的扣分 (比默认值小，随机矩阵上跳词和不跳词都会出现)
+static const float SKIP_PENALTY = 4.0f;
+
+/**
+ * 允许跳词时的用例：每个音素在整句里只出现一次 (不同的跳词组合对应不同的音素序列，不会出现平局)。
+ * 矩阵只在一部分词上沿 CTC 路径给高分，其余的词是噪声，模拟漏读
+ */
+static std::vector<AlignCase> skipCases(Rng& rng, const Vocab& vocab, int count)
+{
+    const int V = vocab.idCount();
+    std::vector<std::string> phones = phoneInventory(vocab);
+    std::vector<AlignCase> cases;
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    auto add = [&](const std::string& label, std::vector<WordAnalysis> words, const std::vector<bool>& read, int T) {
+        std::vector<int> targets;
+        for (size_t w = 0; w < words.size(); ++w) {
+            if (!read[w]) continue;
+            for (const auto& p : words[w].phonemes) targets.push_back(vocab.find(p));
+        }
+
+        AlignCase c;
+        c.frames = T;
+        c.vocab = V;
+        c.words = std::move(words);
+        c.label = "T=" + std::to_string(T) + " read " + std::to_string(std::count(read.begin(), read.end(), true)) + "/" +
+                  std::to_string(read.size()) + " words (" + label + ")";
+        c.log_probs = targets.empty() || T < (int)targets.size() ? randomLogProbs(rng, T, V, 3.0f)
+                                                                 : peakyLogProbs(rng, targets, T, V, 0);
+        cases.push_back(std::move(c));
+    };
+
+    // 固定用例：只读了 "a b c d" 的首尾两个词，b 和 c 都要跳过 (扣两次分)
+    add("skip two inner words", { makeWord({ "a" }), makeWord({ "b" }), makeWord({ "k" }), makeWord({ "d" }) },
+        { true, false, false, true }, 20);
+    add("skip leading words", { makeWord({ "a", "n" }), makeWord({ "b" }), makeWord({ "k", "s" }) }, { false, false, true }, 20);
+    add("skip trailing words", { makeWord({ "a", "n" }), makeWord({ "b" }), makeWord({ "k", "s" }) }, { true, false, false }, 20);
+    add("nothing read", { makeWord({ "a" }), makeWord({ "b" }) }, { false, false }, 12);
+
+    std::uniform_int_distribution<int> pick_words(1, 5), pick_len(1, 3);
+    for (int i = 0; i < count; ++i) {
+        std::shuffle(phones.begin(), phones.end(), rng);
+        size_t next = 0;
+        std::vector<WordAnalysis> words;
+        std::vector<bool> read;
+        int S = 1;
+        int n = pick_words(rng);
+        for (int w = 0; w < n; ++w) {
+            std::vector<std::string> ph;
+            int len = pick_len(rng);
+            for (int k = 0; k < len; ++k) ph.push_back(phones[next++]);
+            words.push_back(makeWord(ph));
+            read.push_back(unit(rng) < 0.6f);
+            S += 2 * len;
+        }
+        // 帧数：偏紧 (跳词时穿过词间 blank 的帧数要求起作用) / 正常
+        bool tight = i % 3 == 0;
+        int T = tight ? S / 2 + 1 + (int)(unit(rng) * S / 2) : S + (int)(unit(rng) * 3 * S) + 10;
+        add(tight ? "tight" : "normal", std::move(words), read, T);
+    }
+    return cases;
+}
+
+static bool sameFlags(const PhonemeDetail& a, const PhonemeDetail& b, double tolerance)
+{
+    if (a.is_good == b.is_good && a.is_excellent == b.is_excellent) return true;
+    // 得分在容差内但恰好落在阈值两边时不算不一致
+    auto nearThreshold = [&](float score) {
+        return std::fabs(score - THRESHOLD_GOOD) <= tolerance || std::fabs(score - THRESHOLD_EXCELLENT) <= tolerance;
+    };
+    return nearThreshold(a.score) && nearThreshold(b.score);
+}
+
+static std::string compareAlignment(const AlignOutput& ref, const AlignOutput& got, const VerifyOptions& opt, double& error)
+{
+    if (ref.ok != got.ok) return std::string("returned ") + (got.ok ? "true" : "false") + ", expected " + (ref.ok ? "true" : "false");
+    if (!ref.ok) return "";
+
+    for (size_t w = 0; w < ref.words.size(); ++w) {
+        const WordAnalysis& a = ref.words[w];
+        const WordAnalysis& b = got.words[w];
+        std::string where = "word " + std::to_string(w);
+        if (a.skipped != b.skipped || a.variant != b.variant) return where + ": skipped/variant differ";
+        if (a.details.size() != b.details.size()) {
+            return where + ": " + std::to_string(b.details.size()) + " phonemes, expected " + std::to_string(a.details.size());
+        }
+        for (size_t i = 0; i < a.details.size(); ++i) {
+            const PhonemeDetail& x = a.details[i];
+            const PhonemeDetail& y = b.details[i];
+            std::string at = where + " phoneme " + std::to_string(i) + " (" + x.ipa + ")";
+            if (x.ipa != y.ipa || x.token_id != y.token_id) return at + ": got " + y.ipa;
+            if (x.start_frame != y.start_frame || x.end_frame != y.end_frame) {
+                return at + ": frames [" + std::to_string(y.start_frame) + ", " + std::to_string(y.end_frame) + "], expected [" +
+                       std::to_string(x.start_frame) + ", " + std::to_string(x.end_frame) + "]";
+            }
+            if (!closeEnough(x.score, y.score, opt.tolerance, error)) {
+                return at + ": score " + std::to_string(y.score) + ", expected " + std::to_string(x.score);
+            }
+            if (!sameFlags(x, y, opt.tolerance)) return at + ": is_good/is_excellent differ";
+        }
+        if (!closeEnough(a.word_score, b.word_score, opt.tolerance, error)) {
+            return where + ": word_score " + std::to_string(b.word_score) + ", expected " + std::to_string(a.word_score);
+        }
+    }
+    return "";
+}
+
+// ==========================================
+// 报告
+// ==========================================
+static void printReport(const std::vector<VariantReport>& reports, const VerifyOptions& opt, std::ostream& out)
+{
+    out << std::left << std::setw(16) << "kernel" << std::setw(36) << "variant" << std::right
+        << std::setw(7) << "cases" << std::setw(7) << "fail" << std::setw(11) << "max err"
+        << std::setw(12) << "ref ms" << std::setw(12) << "impl ms" << std::setw(10) << "speedup" << std::endl;
+    for (const auto& r : reports) {
+        out << std::left << std::setw(16) << r.kernel << std::setw(36) << r.variant << std::right
+            << std::setw(7) << r.cases << std::setw(7) << r.failures
+            << std::setw(11) << std::scientific << std::setprecision(1) << r.max_error
+            << std::setw(12) << std::fixed << std::setprecision(3) << r.reference_ns / 1e6
+            << std::setw(12) << r.variant_ns / 1e6
+            << std::setw(9) << std::setprecision(2) << (r.variant_ns > 0 ? r.reference_ns / r.variant_ns : 0.0) << "x" << std::endl;
+    }
+
+    for (const auto& r : reports) {
+        size_t shown = opt.verbose ? r.messages.size() : std::min<size_t>(r.messages.size(), MAX_PRINTED_FAILURES);
+        for (size_t i = 0; i < shown; ++i) out << "[Mismatch] " << r.variant << ": " << r.messages[i] << std::endl;
+        if (shown < r.messages.size()) out << "[Mismatch] " << r.variant << ": ... " << r.messages.size() - shown << " more (--verbose)" << std::endl;
+    }
+}
+
+static bool writeJson(const std::vector<VariantReport>& reports, const VerifyOptions& opt)
+{
+    json j;
+    j["seed"] = opt.seed;
+    j["cases"] = opt.cases;
+    j["tolerance"] = opt.tolerance;
+    j["results"] = json::array();
+    for (const auto& r : reports) {
+        j["results"].push_back({
+            { "kernel", r.kernel },
+            { "variant", r.variant },
+            { "cases", r.cases },
+            { "failures", r.failures },
+            { "max_error", r.max_error },
+            { "reference_ns", r.reference_ns },
+            { "variant_ns", r.variant_ns },
+            { "speedup", r.variant_ns > 0 ? r.reference_ns / r.variant_ns : 0.0 },
+            { "mismatches", r.messages },
+        });
+    }
+    std::ofstream out(opt.json_path);
+    if (!out) return false;
+    out << j.dump(2) << std::endl;
+    return true;
+}
+
+static void printUsage()
+{
+    std::cerr << "Usage: speech_verify [--cases 200] [--seed 1] [--repeat 3] [--tolerance 1e-5]\n"
+              << "                     [--filter <kernel/variant>] [--json report.json] [--verbose]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    VerifyOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto val = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (a == "--cases") opt.cases = std::atoi(val().c_str());
+        else if (a == "--seed") opt.seed = std::strtoull(val().c_str(), nullptr, 10);
+        else if (a == "--repeat") opt.repeat = std::atoi(val().c_str());
+        else if (a == "--tolerance") opt.tolerance = std::atof(val().c_str());
+        else if (a == "--filter") opt.filter = val();
+        else if (a == "--json") opt.json_path = val();
+        else if (a == "--verbose") opt.verbose = true;
+        else {
+            printUsage();
+            return 2;
+        }
+    }
+    if (opt.cases < 0) opt.cases = 0;
+    if (opt.repeat < 1) opt.repeat = 1;
+
+    // 分词遇到词表外字符、对齐失败都会打日志，这里只关心结果
+    setLogLevel(LogLevel::Off);
+
+    Rng rng(opt.seed);
+    const Vocab vocab = buildTestVocab();
+    std::vector<VariantReport> reports;
+
+    // 每个内核的变体列表：第一个总是 src/ 里的当前实现
+    {
+        Kernel<SoftmaxCase, std::vector<float>, SoftmaxFn> k;
+        k.name = "logSoftmax";
+        k.cases = softmaxCases(rng, opt.cases);
+        k.reference = reference::logSoftmax;
+        k.variants = { { "computeLogSoftmax", computeLogSoftmax } };
+        k.exec = [](const SoftmaxFn& fn, const SoftmaxCase& c, std::vector<float>& out) {
+            out = c.logits;
+            return timeNs([&]() { fn(out.data(), c.frames, c.vocab); });
+        };
+        k.compare = [](const SoftmaxCase&, const std::vector<float>& ref, const std::vector<float>& got, const VerifyOptions& o, double& err) {
+            return compareSamples(ref, got, o.tolerance, err);
+        };
+        runKernel(k, opt, reports);
+    }
+
+    const std::vector<AudioCase> audio = audioCases(rng, opt.cases);
+    {
+        Kernel<AudioCase, std::vector<float>, MixFn> k;
+        k.name = "mixToMono";
+        k.cases = audio;
+        k.reference = reference::mixToMono;
+        k.variants = { { "mixToMono", mixToMono } };
+        k.exec = [](const MixFn& fn, const AudioCase& c, std::vector<float>& out) {
+            out = c.samples;
+            return timeNs([&]() { fn(out, c.channels, c.frames); });
+        };
+        k.compare = [](const AudioCase&, const std::vector<float>& ref, const std::vector<float>& got, const VerifyOptions& o, double& err) {
+            return compareSamples(ref, got, o.tolerance, err);
+        };
+        runKernel(k, opt, reports);
+    }
+    {
+        // 重采样的输入是参考实现混好的单声道
+        std::vector<AudioCase> mono = audio;
+        for (auto& c : mono) {
+            reference::mixToMono(c.samples, c.channels, c.frames);
+            c.channels = 1;
+        }
+
+        Kernel<AudioCase, std::vector<float>, ResampleFn> k;
+        k.name = "resampleAudio";
+        k.cases = std::move(mono);
+        k.reference = reference::resampleAudio;
+        k.variants = { { "resampleAudio", resampleAudio } };
+        k.exec = [](const ResampleFn& fn, const AudioCase& c, std::vector<float>& out) {
+            out = c.samples;
+            return timeNs([&]() { fn(out, c.rate); });
+        };
+        k.compare = [](const AudioCase&, const std::vector<float>& ref, const std::vector<float>& got, const VerifyOptions& o, double& err) {
+            return compareSamples(ref, got, o.tolerance, err);
+        };
+        runKernel(k, opt, reports);
+    }
+    {
+        Kernel<TokenizeCase, std::vector<std::string>, TokenizeFn> k;
+        k.name = "tokenizeIPA";
+        k.cases = tokenizeCases(rng, vocab, opt.cases);
+        k.reference = reference::tokenizeIPA;
+        k.variants = { { "tokenizeIPA", tokenizeIPA } };
+        k.exec = [&vocab](const TokenizeFn& fn, const TokenizeCase& c, std::vector<std::string>& out) {
+            return timeNs([&]() { out = fn(c.ipa, vocab); });
+        };
+        k.compare = [](const TokenizeCase&, const std::vector<std::string>& ref, const std::vector<std::string>& got, const VerifyOptions&, double&) {
+            if (ref == got) return std::string();
+            std::string s = "got";
+            for (const auto& t : got) s += " [" + t + "]";
+            s += ", expected";
+            for (const auto& t : ref) s += " [" + t + "]";
+            return s;
+        };
+        runKernel(k, opt, reports);
+    }
+    {
+        Kernel<AlignCase, AlignOutput, AlignFn> k;
+        k.name = "calculateGOP";
+        k.cases = alignCases(rng, vocab, opt.cases);
+        k.reference = [](const EmissionView& em, const Vocab& v, std::vector<WordAnalysis>& words, int blank) {
+            return reference::calculateGOP(em, v, words, blank);
+        };
+        k.variants = {
+            { "calculateGOP", [](const EmissionView& em, const Vocab& v, std::vector<WordAnalysis>& words, int blank) {
+                  return calculateGOP(em, v, words, blank);
+              } },
+            { "calculateGOP/low_memory", [](const EmissionView& em, const Vocab& v, std::vector<WordAnalysis>& words, int blank) {
+                  GopOptions options;
+                  options.low_memory = true;
+                  return calculateGOP(em, v, words, blank, nullptr, options);
+              } },
+        };
+        k.exec = [&vocab](const AlignFn& fn, const AlignCase& c, AlignOutput& out) {
+            out.words = c.words;
+            return timeNs([&]() { out.ok = fn(c.view(), vocab, out.words, 0); });
+        };
+        k.compare = [](const AlignCase&, const AlignOutput& ref, const AlignOutput& got, const VerifyOptions& o, double& err) {
+            return compareAlignment(ref, got, o, err);
+        };
+        runKernel(k, opt, reports);
+    }
+
+    {
+        Kernel<AlignCase, AlignOutput, AlignFn> k;
+        k.name = "allowSkip";
+        k.cases = skipCases(rng, vocab, opt.cases);
+        k.reference = [](const EmissionView& em, const Vocab& v, std::vector<WordAnalysis>& words, int blank) {
+            return reference::calculateGOPWithSkips(em, v, words, SKIP_PENALTY, blank);
+        };
+        auto skipping = [](bool low_memory) {
+            return [low_memory](const EmissionView& em, const Vocab& v, std::vector<WordAnalysis>& words, int blank) {
+                GopOptions options;
+                options.lattice.allow_skip = true;
+                options.lattice.skip_penalty = SKIP_PENALTY;
+                options.low_memory = low_memory;
+                return calculateGOP(em, v, words, blank, nullptr, options);
+            };
+        };
+        k.variants = {
+            { "calculateGOP/allow_skip", skipping(false) },
+            { "calculateGOP/allow_skip/low_memory", skipping(true) },
+        };
+        k.exec = [&vocab](const AlignFn& fn, const AlignCase& c, AlignOutput& out) {
+            out.words = c.words;
+            return timeNs([&]() { out.ok = fn(c.view(), vocab, out.words, 0); });
+        };
+        k.compare = [](const AlignCase&, const AlignOutput& ref, const AlignOutput& got, const VerifyOptions& o, double& err) {
+            return compareAlignment(ref, got, o, err);
+        };
+        runKernel(k, opt, reports);
+    }
+
+    std::cout << "Seed " << opt.seed << ", " << opt.cases << " random cases per kernel, tolerance " << opt.tolerance << std::endl;
+    printReport(reports, opt, std::cout);
+
+    if (!opt.json_path.empty() && !writeJson(reports, opt)) {
+        std::cerr << "[Error] Cannot write " << opt.json_path << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    for (const auto& r : reports) failures += r.failures;
+    if (failures > 0) {
+        std::cout << failures << " mismatching case(s)." << std::endl;
+        return 1;
+    }
+    std::cout << "All kernels match the reference." << std::endl;
+    return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// speech_*_test 共用的最小测试框架
+// 每个测试是一个无参函数，CHECK 失败时打印位置和表达式并继续执行 (一次运行看到所有失败)；
+// runTests 按 --filter 选择测试，全部通过时返回 0，否则返回 1。
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct TestCase {
+    const char* name;
+    void (*fn)();
+};
+
+struct TestState {
+    int checks = 0;
+    int failures = 0;
+};
+
+inline TestState& testState()
+{
+    static TestState state;
+    return state;
+}
+
+inline bool testCheck(bool ok, const char* expr, const char* file, int line)
+{
+    TestState& s = testState();
+    s.checks++;
+    if (!ok) {
+        s.failures++;
+        std::cerr << "  [Fail] " << file << ":" << line << ": " << expr << std::endl;
+    }
+    return ok;
+}
+
+#define CHECK(cond) testCheck((cond), #cond, __FILE__, __LINE__)
+
+inline int runTests(const char* program, const std::vector<TestCase>& tests, int argc, char** argv)
+{
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else {
+            std::cerr << "Usage: " << program << " [--filter <substr>]" << std::endl;
+            return 2;
+        }
+    }
+
+    int run = 0, failed = 0;
+    for (const auto& t : tests) {
+        if (!filter.empty() && std::string(t.name).find(filter) == std::string::npos) continue;
+        int before = testState().failures;
+        t.fn();
+        bool ok = testState().failures == before;
+        std::cout << (ok ? "[Pass] " : "[Fail] ") << t.name << std::endl;
+        run++;
+        if (!ok) failed++;
+    }
+    std::cout << run - failed << "/" << run << " tests passed (" << testState().checks << " checks)" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
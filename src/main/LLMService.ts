@@ -69,12 +69,12 @@ class LLMService {
 
   /**
    * 分析音频内容
-   * @param audioBuffer 音频数据 (Buffer)
+   * @param audio 整段音频 (WAV Buffer)，或按词切好的片段 (每段前面附上它的文字说明)
    * @param prompt 分析提示词 (可选)
    * @returns AI 分析结果文本
    */
   async analyzeAudio(
-    audioBuffer: Buffer,
+    audio: Buffer | Array<{ label: string; wav: Buffer }>,
     prompt: string = '请评价这段音频的发音质量。'
   ): Promise<string> {
     if (!this.isConfigured()) {
@@ -91,8 +91,18 @@ class LLMService {
     try {
       // 1. 处理音频
       console.log('[LLM] Processing audio...')
-      const base64Audio = await this.processAudioBuffer(audioBuffer)
-      console.log('[LLM] Audio processed, length:', base64Audio.length)
+      const clips = Buffer.isBuffer(audio) ? [{ label: '', wav: audio }] : audio
+      const audioContent: Array<{ type: string; text?: string; audio?: string }> = []
+      let audioLength = 0
+      for (const clip of clips) {
+        const base64Audio = await this.processAudioBuffer(clip.wav)
+        audioLength += base64Audio.length
+        if (clip.label) {
+          audioContent.push({ type: 'input_text', text: clip.label })
+        }
+        audioContent.push({ type: 'input_audio', audio: base64Audio })
+      }
+      console.log(`[LLM] Audio processed, ${clips.length} clip(s), length:`, audioLength)
 
       // 检查是否已被中断
       if (currentAbortController.signal.aborted) {
@@ -170,10 +180,7 @@ class LLMService {
                     type: 'input_text',
                     text: prompt
                   },
-                  {
-                    type: 'input_audio',
-                    audio: base64Audio
-                  }
+                  ...audioContent
                 ]
               }
             })
@@ -1,26 +1,94 @@
 import { app } from 'electron'
+import fs from 'fs'
+import os from 'os'
 import path from 'path'
 import { createRequire } from 'node:module'
-import type { AnalysisResult } from '../shared/types'
+import type {
+  AnalysisResult,
+  AnalyzeOptions,
+  EmissionSaveOptions,
+  EngineOptions,
+  EngineStats,
+  WordClip,
+  WordClipOptions,
+  ModelReloadResult,
+  NativeCancelToken,
+  NativeLogLevel,
+  ProfileReport
+} from '../shared/types'
 
 const require = createRequire(import.meta.url)
 
 // 定义 C++ 插件的类型接口 (为了代码提示)
 interface NativeAddon {
-  new (modelPath: string, vocabPath: string, espeakPath: string): SpeechEngineInstance
+  SpeechEngine: new (
+    modelPath: string,
+    vocabPath: string,
+    espeakPath: string,
+    options?: EngineOptions
+  ) => SpeechEngineInstance
+  CancelToken: new () => NativeCancelToken
 }
 
 interface SpeechEngineInstance {
   // 重载1: 传文件路径
-  analyze(wavPath: string, text: string): AnalysisResult
+  analyze(wavPath: string, text: string, options?: AnalyzeOptions): AnalysisResult
   // 重载2: 传 PCM 内存数据
-  analyze(pcmData: Float32Array, sampleRate: number, channels: number, text: string): AnalysisResult
+  analyze(
+    pcmData: Float32Array,
+    sampleRate: number,
+    channels: number,
+    text: string,
+    options?: AnalyzeOptions
+  ): AnalysisResult
+  // 同 analyze，但在后台线程上执行；配合 options.cancelToken / deadlineMs 中止
+  analyzeAsync(wavPath: string, text: string, options?: AnalyzeOptions): Promise<AnalysisResult>
+  analyzeAsync(
+    pcmData: Float32Array,
+    sampleRate: number,
+    channels: number,
+    text: string,
+    options?: AnalyzeOptions
+  ): Promise<AnalysisResult>
+  // 复用 analyze 缓存的推理结果，只对新文本重新对齐 (句柄被淘汰时抛异常)
+  rescore(audioHandle: string, text: string, options?: AnalyzeOptions): AnalysisResult
+  rescoreAsync(audioHandle: string, text: string, options?: AnalyzeOptions): Promise<AnalysisResult>
+  setCacheLimits(maxBytes: number, maxEntries?: number): void
+  clearCache(): void
+  // 推理结果存档 (.emis)，之后可以不经过模型直接重新评分
+  saveEmissions(audioHandle: string, path: string, options?: EmissionSaveOptions): void
+  analyzeEmissions(path: string, text: string, options?: AnalyzeOptions): AnalysisResult
+  analyzeEmissionsAsync(path: string, text: string, options?: AnalyzeOptions): Promise<AnalysisResult>
+  // 按口音/音素的阈值表 (thresholds.json)，setLanguage 时自动切换
+  loadThresholds(path: string): void
+  // 后台加载新模型后原子替换，进行中的请求在旧模型上跑完 (vocabPath 省略时沿用当前词表)
+  reloadModel(modelPath: string, vocabPath?: string): Promise<ModelReloadResult>
+  // 为一个语言注册单独的模型，首次使用时才加载 (voice 为 espeak 口音，默认同 language)
+  registerModel(language: string, modelPath: string, vocabPath: string, voice?: string): void
+  setModelMemoryBudget(bytes: number): void
   phonemize(text: string): string
+  // 按分析结果从原始 PCM 上切出得分最低的几个词 (编码成 WAV)
+  sliceWords(
+    pcmData: Float32Array,
+    sampleRate: number,
+    channels: number,
+    result: AnalysisResult,
+    options?: WordClipOptions
+  ): WordClip[]
   setLanguage(lang: string): void
+  getStats(): EngineStats
+  resetStats(): void
+  setLogLevel(level: NativeLogLevel): void
+  startProfiling(runs: number, tracePrefix?: string): void
+  stopProfiling(): boolean
+  getProfileReport(): ProfileReport | null
 }
 
 class SpeechService {
   private engine: SpeechEngineInstance | null = null
+  private addon: NativeAddon | null = null
+  // 正在进行的 analyzeRawAsync 请求，新请求开始时取消它
+  private pendingAnalysis: NativeCancelToken | null = null
 
   private isInitialized = false
 
@@ -48,7 +116,8 @@ class SpeechService {
         }
 
         console.log(`[SpeechService] Loading addon from: ${addonPath}`)
-        const NativeModule = require(addonPath) as { SpeechEngine: NativeAddon }
+        const NativeModule = require(addonPath) as NativeAddon
+        this.addon = NativeModule
 
         // 2. 智能处理资源路径
         const resPath = app.isPackaged
@@ -58,11 +127,30 @@ class SpeechService {
         console.log('[SpeechService] Loading AI Models from:', resPath)
 
         // 3. 实例化 C++ 对象
+        // 交互请求用一半的核做推理，后台任务 (历史重评分等) 只用一个，避免拖慢练习页面
         this.engine = new NativeModule.SpeechEngine(
           path.join(resPath, 'models/wav2vec2.onnx'),
           path.join(resPath, 'models/vocab.json'),
-          resPath
+          resPath,
+          {
+            intraOpThreads: Math.max(1, Math.floor(os.cpus().length / 2)),
+            backgroundIntraOpThreads: 1,
+            // 同时常驻的其他语言模型不超过 1 GB，超出时卸载最久没用的
+            modelMemoryBudgetMB: 1024,
+            // 一分钟左右的录音约 1.5 GB；更长的上传直接拒绝，不拖慢其他请求
+            maxRequestMemoryMB: 2048
+          }
         )
+        this.registerLanguageModels(path.join(resPath, 'models/languages'))
+        // 校准过的阈值表是可选的，没有时用内置阈值
+        const thresholdsPath = path.join(resPath, 'models/thresholds.json')
+        if (fs.existsSync(thresholdsPath)) {
+          this.engine.loadThresholds(thresholdsPath)
+        }
+        // 打包后不需要逐次请求的 [Info] 日志
+        if (app.isPackaged) {
+          this.engine.setLogLevel('warning')
+        }
 
         this.isInitialized = true
         console.log('[SpeechService] Speech Engine initialized successfully.')
@@ -77,14 +165,14 @@ class SpeechService {
   /**
    * 通过文件路径分析 (传统方式)
    */
-  public analyze(wavPath: string, text: string): AnalysisResult {
+  public analyze(wavPath: string, text: string, options?: AnalyzeOptions): AnalysisResult {
     if (!this.isInitialized || !this.engine) {
       throw new Error('Speech Engine is not ready.')
     }
 
     try {
       console.time('InferenceFile')
-      const result = this.engine.analyze(wavPath, text)
+      const result = this.engine.analyze(wavPath, text, options)
       console.timeEnd('InferenceFile')
       return result
     } catch (e) {
@@ -100,12 +188,14 @@ class SpeechService {
    * @param sampleRate - 采样率 (例如 16000)
    * @param channels - 通道数 (通常为 1)
    * @param text - 目标文本
+   * @param options - 可选，{ detailed: true } 开启扩展评分
    */
   public analyzeRaw(
     pcmData: Float32Array,
     sampleRate: number,
     channels: number,
-    text: string
+    text: string,
+    options?: AnalyzeOptions
   ): AnalysisResult {
     if (!this.isInitialized || !this.engine) {
       throw new Error('Speech Engine is not ready.')
@@ -117,7 +207,7 @@ class SpeechService {
       }
       console.time('InferenceRaw')
       // 直接调用 C++ 的重载方法
-      const result = this.engine.analyze(pcmData, sampleRate, channels, text)
+      const result = this.engine.analyze(pcmData, sampleRate, channels, text, options)
       console.timeEnd('InferenceRaw')
       return result
     } catch (e) {
@@ -126,6 +216,183 @@ class SpeechService {
     }
   }
 
+  /**
+   * analyzeRaw 的异步版本：在后台线程上推理和对齐，不阻塞主进程。
+   * 同一时间只保留最新的一次请求，之前还没完成的请求会被取消并以 ANALYSIS_CANCELLED 失败
+   */
+  public async analyzeRawAsync(
+    pcmData: Float32Array,
+    sampleRate: number,
+    channels: number,
+    text: string,
+    options?: AnalyzeOptions
+  ): Promise<AnalysisResult> {
+    if (!this.isInitialized || !this.engine || !this.addon) {
+      throw new Error('Speech Engine is not ready.')
+    }
+
+    if (text[text.length - 1] !== '.') {
+      text += '.'
+    }
+
+    this.cancelAnalysis()
+    const token = new this.addon.CancelToken()
+    this.pendingAnalysis = token
+
+    try {
+      return await this.engine.analyzeAsync(pcmData, sampleRate, channels, text, {
+        ...options,
+        priority: 'interactive',
+        cancelToken: token
+      })
+    } catch (e) {
+      const code = (e as { code?: string }).code
+      if (code === 'ECANCELED') {
+        console.log('[SpeechService] Analysis cancelled by a newer request')
+        throw new Error('ANALYSIS_CANCELLED')
+      }
+      if (code === 'ETIMEDOUT') {
+        console.warn('[SpeechService] Analysis deadline exceeded')
+        throw new Error('ANALYSIS_TIMEOUT')
+      }
+      console.error('[SpeechService] C++ Async Error:', e)
+      throw new Error('Raw Analysis failed inside native module.')
+    } finally {
+      if (this.pendingAnalysis === token) {
+        this.pendingAnalysis = null
+      }
+    }
+  }
+
+  /**
+   * 取消正在进行的 analyzeRawAsync (例如用户开始重新录音)
+   */
+  public cancelAnalysis(): void {
+    if (this.pendingAnalysis) {
+      this.pendingAnalysis.cancel()
+      this.pendingAnalysis = null
+    }
+  }
+
+  /**
+   * 参考文本改了 (或换了口音) 时重新评分，不再重复推理
+   * @param audioHandle - 之前 analyze / analyzeRaw 返回的 audioHandle
+   */
+  public rescore(audioHandle: string, text: string, options?: AnalyzeOptions): AnalysisResult {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+
+    try {
+      return this.engine.rescore(audioHandle, text, options)
+    } catch (e) {
+      console.error('[SpeechService] C++ Rescore Error:', e)
+      throw new Error('Rescoring failed inside native module.')
+    }
+  }
+
+  /**
+   * 后台重评分 (例如阈值表更新后刷新历史记录)，排在所有交互请求之后
+   */
+  public async rescoreInBackground(
+    audioHandle: string,
+    text: string,
+    options?: AnalyzeOptions
+  ): Promise<AnalysisResult> {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    return await this.engine.rescoreAsync(audioHandle, text, { priority: 'background', ...options })
+  }
+
+  /**
+   * 热切换模型 (比如下载了新版本)：加载在后台线程进行，不影响正在进行的评分。
+   * 加载失败时继续使用旧模型
+   */
+  public async reloadModel(modelPath: string, vocabPath?: string): Promise<ModelReloadResult> {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    const result = await this.engine.reloadModel(modelPath, vocabPath)
+    console.log(`[SpeechService] Model version ${result.version} (${result.hash}) is now active.`)
+    return result
+  }
+
+  /**
+   * 注册 models/languages/<lang>/ 下的按语言模型 (model.onnx + vocab.json)，
+   * 目录名即语言代码，也用作 espeak 口音
+   */
+  private registerLanguageModels(dir: string): void {
+    if (!this.engine || !fs.existsSync(dir)) return
+    for (const entry of fs.readdirSync(dir, { withFileTypes: true })) {
+      if (!entry.isDirectory()) continue
+      const modelPath = path.join(dir, entry.name, 'model.onnx')
+      const vocabPath = path.join(dir, entry.name, 'vocab.json')
+      if (fs.existsSync(modelPath) && fs.existsSync(vocabPath)) {
+        this.engine.registerModel(entry.name, modelPath, vocabPath)
+      }
+    }
+  }
+
+  /**
+   * 后台对 .emis 存档重新评分，排在所有交互请求之后
+   */
+  public async analyzeEmissionsInBackground(
+    filePath: string,
+    text: string,
+    options?: AnalyzeOptions
+  ): Promise<AnalysisResult> {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    return await this.engine.analyzeEmissionsAsync(filePath, text, {
+      priority: 'background',
+      ...options
+    })
+  }
+
+  /**
+   * 把 analyze 缓存的推理结果存成 .emis 文件 (审计存档)
+   */
+  public saveEmissions(audioHandle: string, filePath: string, options?: EmissionSaveOptions): void {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    this.engine.saveEmissions(audioHandle, filePath, options)
+  }
+
+  /**
+   * 对 .emis 存档重新评分 (阈值或参考文本变了之后复核)，不运行模型
+   */
+  public analyzeEmissions(filePath: string, text: string, options?: AnalyzeOptions): AnalysisResult {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+
+    try {
+      return this.engine.analyzeEmissions(filePath, text, options)
+    } catch (e) {
+      console.error('[SpeechService] C++ AnalyzeEmissions Error:', e)
+      throw new Error('Emission file analysis failed inside native module.')
+    }
+  }
+
+  /**
+   * 切出得分最低的几个词的录音片段，只把这些片段交给 LLM 点评
+   */
+  public sliceWorstWords(
+    pcmData: Float32Array,
+    sampleRate: number,
+    channels: number,
+    result: AnalysisResult,
+    options?: WordClipOptions
+  ): WordClip[] {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    return this.engine.sliceWords(pcmData, sampleRate, channels, result, options)
+  }
+
   public phonemize(text: string): string {
     if (!this.isInitialized || !this.engine) {
       throw new Error('Speech Engine is not ready.')
@@ -140,6 +407,51 @@ class SpeechService {
     }
   }
 
+  /**
+   * 获取原生流水线的聚合统计 (各阶段 p50/p95/p99 耗时、计数器)
+   */
+  public getStats(): EngineStats {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    return this.engine.getStats()
+  }
+
+  /**
+   * 对接下来的 runs 次推理开启 ORT 算子级 profiling，跑完后用 getProfileReport() 读取热点报告
+   * @param tracePrefix - 指定时保留原始 trace 文件 (否则写到临时目录并在解析后删除)
+   */
+  public startProfiling(runs: number, tracePrefix?: string): void {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    this.engine.startProfiling(runs, tracePrefix)
+  }
+
+  public getProfileReport(): ProfileReport | null {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    return this.engine.getProfileReport()
+  }
+
+  public setLogLevel(level: NativeLogLevel): void {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    this.engine.setLogLevel(level)
+  }
+
+  /**
+   * 加载阈值表 (由 speech_calibrate 生成)，不需要重启引擎
+   */
+  public loadThresholds(filePath: string): void {
+    if (!this.isInitialized || !this.engine) {
+      throw new Error('Speech Engine is not ready.')
+    }
+    this.engine.loadThresholds(filePath)
+  }
+
   public setLanguage(lang: string): void {
     if (!this.isInitialized || !this.engine) {
       throw new Error('Speech Engine is not ready.')
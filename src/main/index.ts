@@ -8,7 +8,7 @@ import { ttsService } from './TTSService'
 import { llmService } from './LLMService'
 import { settings } from './SettingsService'
 import { scoreService } from './ScoreService'
-import { type SettingsData, type ScoreRecord } from '../shared/types'
+import { type AnalysisResult, type SettingsData, type ScoreRecord } from '../shared/types'
 
 app.commandLine.appendSwitch('no-sandbox')
 // 定义两个窗口变量
@@ -191,48 +191,79 @@ app.whenReady().then(async () => {
     speechService.setLanguage(lang)
   })
 
-  // 分析音频数据 (高性能方式)
-  ipcMain.handle('analyze-raw-audio', (_event, pcmData: Float32Array, text: string) => {
-    const result = speechService.analyzeRaw(pcmData, 16000, 1, text)
-    return result
+  // 分析音频数据 (高性能方式)，在后台线程上执行；新请求会取消还没完成的旧请求。
+  // 结果带波形包络、得分轨和流利度指标，界面画图不需要再遍历 PCM
+  ipcMain.handle('analyze-raw-audio', async (_event, pcmData: Float32Array, text: string) => {
+    return await speechService.analyzeRawAsync(pcmData, 16000, 1, text, {
+      waveform: true,
+      fluency: true
+    })
   })
 
-  ipcMain.handle('llm-analyze-audio', async (_event, pcmArray: number[], prompt: string) => {
-    // 将普通数组转换为 Float32Array
-    const float32Data = new Float32Array(pcmArray)
+  ipcMain.handle('cancel-analysis', () => {
+    speechService.cancelAnalysis()
+  })
 
-    // 将 Float32Array 转换为 Int16 PCM 数据
-    const int16Data = new Int16Array(float32Data.length)
-    for (let i = 0; i < float32Data.length; i++) {
-      int16Data[i] = Math.max(-32768, Math.min(32767, Math.floor(float32Data[i] * 32768)))
+  ipcMain.handle(
+    'llm-analyze-audio',
+    async (_event, pcmArray: number[], prompt: string, result?: AnalysisResult) => {
+      // 将普通数组转换为 Float32Array
+      const float32Data = new Float32Array(pcmArray)
+
+      // 语速和停顿一起告诉模型，只上传片段时也能点评整句的流利度
+      const fluency = result?.fluency
+      if (fluency) {
+        prompt += `\n整句语速 ${fluency.speech_rate.toFixed(1)} 音素/秒，停顿 ${fluency.pauses.length} 次 (共 ${(fluency.pause_ms / 1000).toFixed(1)} 秒)。`
+      }
+
+      // 有评分结果时只上传得分最低的几个词，整段录音作为兜底
+      if (result) {
+        const clips = speechService.sliceWorstWords(float32Data, 16000, 1, result)
+        if (clips.length > 0) {
+          const labeled = clips.map((clip) => ({
+            label: `片段: "${clip.text}" (得分 ${clip.score.toFixed(2)})`,
+            wav: Buffer.from(clip.wav.buffer, clip.wav.byteOffset, clip.wav.byteLength)
+          }))
+          return await llmService.analyzeAudio(
+            labeled,
+            `${prompt}\n以下只附上了得分最低的几个词的录音片段，请重点点评这些词的发音。`
+          )
+        }
+      }
+
+      // 将 Float32Array 转换为 Int16 PCM 数据
+      const int16Data = new Int16Array(float32Data.length)
+      for (let i = 0; i < float32Data.length; i++) {
+        int16Data[i] = Math.max(-32768, Math.min(32767, Math.floor(float32Data[i] * 32768)))
+      }
+
+      // 构建 WAV 文件头 (44字节)
+      const wavHeader = Buffer.alloc(44)
+      const sampleRate = 16000
+      const numChannels = 1
+      const bitDepth = 16
+      const dataLength = int16Data.byteLength
+
+      wavHeader.write('RIFF', 0)
+      wavHeader.writeUInt32LE(36 + dataLength, 4)
+      wavHeader.write('WAVE', 8)
+      wavHeader.write('fmt ', 12)
+      wavHeader.writeUInt32LE(16, 16) // Subchunk1Size
+      wavHeader.writeUInt16LE(1, 20) // AudioFormat (1 = PCM)
+      wavHeader.writeUInt16LE(numChannels, 22)
+      wavHeader.writeUInt32LE(sampleRate, 24)
+      wavHeader.writeUInt32LE(sampleRate * numChannels * (bitDepth / 8), 28) // ByteRate
+      wavHeader.writeUInt16LE(numChannels * (bitDepth / 8), 32) // BlockAlign
+      wavHeader.writeUInt16LE(bitDepth, 34)
+      wavHeader.write('data', 36)
+      wavHeader.writeUInt32LE(dataLength, 40)
+
+      // 组合 WAV 头和 PCM 数据
+      const wavBuffer = Buffer.concat([wavHeader, Buffer.from(int16Data.buffer)])
+
+      return await llmService.analyzeAudio(wavBuffer, prompt)
     }
-
-    // 构建 WAV 文件头 (44字节)
-    const wavHeader = Buffer.alloc(44)
-    const sampleRate = 16000
-    const numChannels = 1
-    const bitDepth = 16
-    const dataLength = int16Data.byteLength
-
-    wavHeader.write('RIFF', 0)
-    wavHeader.writeUInt32LE(36 + dataLength, 4)
-    wavHeader.write('WAVE', 8)
-    wavHeader.write('fmt ', 12)
-    wavHeader.writeUInt32LE(16, 16) // Subchunk1Size
-    wavHeader.writeUInt16LE(1, 20) // AudioFormat (1 = PCM)
-    wavHeader.writeUInt16LE(numChannels, 22)
-    wavHeader.writeUInt32LE(sampleRate, 24)
-    wavHeader.writeUInt32LE(sampleRate * numChannels * (bitDepth / 8), 28) // ByteRate
-    wavHeader.writeUInt16LE(numChannels * (bitDepth / 8), 32) // BlockAlign
-    wavHeader.writeUInt16LE(bitDepth, 34)
-    wavHeader.write('data', 36)
-    wavHeader.writeUInt32LE(dataLength, 40)
-
-    // 组合 WAV 头和 PCM 数据
-    const wavBuffer = Buffer.concat([wavHeader, Buffer.from(int16Data.buffer)])
-
-    return await llmService.analyzeAudio(wavBuffer, prompt)
-  })
+  )
 
   // TTS 相关 API
   ipcMain.handle('tts-synthesize', async (_event, text: string, langCode: string) => {
@@ -18,12 +18,18 @@ declare global {
       setEspeakLanguage: (lang: string) => Promise<void>
       // 分析音频
       analyzeRawAudio: (pcmData: Float32Array, text: string) => Promise<AnalysisResult>
+      // 取消正在进行的分析 (被取消的 analyzeRawAudio 以 ANALYSIS_CANCELLED 失败)
+      cancelAnalysis: () => Promise<void>
       ttsSynthesize: (text: string, langCode: string) => Promise<ArrayBuffer>
       ttsGetLanguages: () => Promise<Array<{ code: string; name: string; voice: string }>>
       ttsIsConfigured: () => Promise<boolean>
 
       // LLM 音频分析
-      llmAnalyzeAudio: (audioBuffer: number[], prompt: string) => Promise<string>
+      llmAnalyzeAudio: (
+        audioBuffer: number[],
+        prompt: string,
+        result?: AnalysisResult
+      ) => Promise<string>
 
       // 获取设置
       getSettings: () => Promise<SettingsData>
@@ -1,6 +1,6 @@
 import { contextBridge, ipcRenderer } from 'electron'
 import { electronAPI } from '@electron-toolkit/preload'
-import { SettingsData, ScoreRecord } from '../shared/types'
+import { AnalysisResult, SettingsData, ScoreRecord } from '../shared/types'
 
 // Custom APIs for renderer
 const api = {
@@ -10,6 +10,7 @@ const api = {
   setEspeakLanguage: (lang: string) => ipcRenderer.invoke('set-espeak-language', lang),
   analyzeRawAudio: (pcmData: Float32Array, text: string) =>
     ipcRenderer.invoke('analyze-raw-audio', pcmData, text),
+  cancelAnalysis: (): Promise<void> => ipcRenderer.invoke('cancel-analysis'),
   // TTS APIs
   ttsSynthesize: (text: string, langCode: string): Promise<ArrayBuffer> =>
     ipcRenderer.invoke('tts-synthesize', text, langCode),
@@ -17,8 +18,9 @@ const api = {
     ipcRenderer.invoke('tts-get-languages'),
   ttsIsConfigured: (): Promise<boolean> => ipcRenderer.invoke('tts-is-configured'),
   // LLM 音频分析
-  llmAnalyzeAudio: (audioBuffer: number[], prompt: string): Promise<string> =>
-    ipcRenderer.invoke('llm-analyze-audio', audioBuffer, prompt),
+  // 传入评分结果时只上传得分最低的几个词的片段
+  llmAnalyzeAudio: (audioBuffer: number[], prompt: string, result?: AnalysisResult): Promise<string> =>
+    ipcRenderer.invoke('llm-analyze-audio', audioBuffer, prompt, result),
   // Settings APIs
   getSettings: (): Promise<SettingsData> => ipcRenderer.invoke('get-settings'),
   updateSettings: (newSettings: Partial<SettingsData>): Promise<void> =>
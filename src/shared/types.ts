@@ -18,15 +18,408 @@ export interface CourseSummary extends Omit<Course, 'content'> {
   count: number
 }
 
+// analyze 的可选参数
+export interface AnalyzeOptions {
+  // 扩展评分：top-k 竞争音素、似然比 GOP 和替换提示
+  detailed?: boolean
+  topK?: number
+  // 发音格：允许整词漏读 (每跳一个词扣 skipPenalty 对数分，默认 10)
+  allowSkip?: boolean
+  skipPenalty?: number
+  // 选择备选发音时扣的对数分，默认 0
+  variantPenalty?: number
+  // 用这些口音生成备选发音，如 ['en-gb']
+  variantVoices?: string[]
+  // 指定备选发音，如 { either: ['aɪðɚ'] }
+  variants?: Record<string, string[]>
+  // 长段落：在句间停顿处切段，各段并行对齐 (失败时自动退回整段对齐)
+  segmented?: boolean
+  // 分段对齐最多用几个线程，0 = 全部
+  alignThreads?: number
+  // 返回自由解码的音素转写，以及和参考文本的插入/删除/替换
+  transcript?: boolean
+  // 自由解码的束宽，1 = 贪心 (默认)
+  beamWidth?: number
+  // 预检：音频明显不是这句话 (静音、读错句子) 时跳过对齐，结果带 mismatch: true
+  precheck?: boolean
+  // 预检的音素错误率上限，默认 0.8
+  maxPhoneErrorRate?: number
+  // 返回波形包络和帧级得分轨 (结果里的 waveform)
+  waveform?: boolean
+  // 返回语速、停顿、单词时长和能量 (结果里的 fluency)
+  fluency?: boolean
+  // 音素之间连续 blank 至少这么长才算停顿，默认 260
+  minPauseMs?: number
+  // 取消令牌 (原生 CancelToken，只在主进程里可用)：取消后请求以 code 'ECANCELED' 失败
+  cancelToken?: NativeCancelToken
+  // 截止时间 (从调用时刻算起的毫秒数，含排队时间)，超时后推理和对齐尽快中止，请求以 code 'ETIMEDOUT' 失败
+  deadlineMs?: number
+  // 异步请求的优先级，默认 interactive；background 排在所有交互请求之后，推理线程更少
+  priority?: RequestPriority
+}
+
+export type RequestPriority = 'interactive' | 'background'
+
+export type CancelReason = 'none' | 'cancelled' | 'deadline_exceeded'
+
+// 原生插件导出的 CancelToken，一个令牌可以传给多个请求，取消后不能复用
+export interface NativeCancelToken {
+  cancel(): void
+  isCancelled(): boolean
+  reason(): CancelReason
+}
+
+export interface PhoneEdit {
+  op: 'substitution' | 'insertion' | 'deletion'
+  word: number
+  phoneme?: number
+  expected?: string
+  actual?: string
+  start_frame?: number
+  end_frame?: number
+}
+
+export interface TranscriptResult {
+  phones: string[]
+  phone_error_rate: number
+  expected: number
+  substitutions: number
+  insertions: number
+  deletions: number
+  edits: PhoneEdit[]
+}
+
+export type GopHint = 'correct' | 'substitution' | 'unclear'
+
+export interface PhonemeResult {
+  ipa: string
+  score: number
+  is_good: boolean
+  is_excellent?: boolean
+  start_frame?: number
+  end_frame?: number
+  // 以下字段只在 detailed 模式下返回
+  posterior?: number
+  gop_lr?: number
+  hint?: GopHint
+  substitute?: string
+  competitors?: Array<{ ipa: string; posterior: number }>
+}
+
 export interface AnalysisResult {
   overall_score: number
   words: Array<{
     word: string
     score: number
-    phonemes: Array<{ ipa: string; score: number; is_good: boolean }>
+    // 对齐选中的发音：0 为标准发音，k 为第 k 个备选发音
+    variant?: number
+    // 整词漏读 (仅在 allowSkip 时出现)
+    skipped?: boolean
+    phonemes: Array<PhonemeResult>
   }>
+  // 原生流水线各阶段耗时 (毫秒) 和计数器
+  timings?: AnalysisTimings
+  // 这段音频推理结果的缓存句柄，换文本重新评分时传给 rescore
+  audioHandle?: string
+  // 推理结果来自缓存 (跳过了前端和推理)
+  cached?: boolean
+  // 开启 precheck 时：音频和文本对不上，没有做对齐 (所有音素记最低分)
+  mismatch?: boolean
+  // 开启 transcript 或预检失败时返回
+  transcript?: TranscriptResult
+  // 对齐前的资源估算和执行方式 (预检失败时没有)
+  admission?: AdmissionInfo
+  // 开启 waveform 时返回
+  waveform?: WaveformData
+  // 开启 fluency 时返回 (预检失败时没有)
+  fluency?: FluencyMetrics
+}
+
+// 流利度指标：从对齐路径上的音素段和 blank 段算出，不再扫一遍音频
+export interface FluencyMetrics {
+  // 对上帧的音素数
+  phones: number
+  // 第一个音素开始到最后一个音素结束 (含停顿)
+  speech_ms: number
+  // speech_ms 扣掉停顿
+  articulation_ms: number
+  // 音素 / 秒：speech_rate 含停顿，articulation_rate 不含
+  speech_rate: number
+  articulation_rate: number
+  // 实际时长 / 典型时长，> 1 说得比典型语速慢
+  tempo: number
+  pause_ms: number
+  // after_word: 停顿前最后一个读出的词 (result.words 下标)
+  pauses: Array<{ start_ms: number; duration_ms: number; after_word: number }>
+  // 与 result.words 一一对应，漏读或没有对齐位置的词为 null。
+  // z: 按整句语速缩放后的时长 z 分数，> 0 拖长，< 0 吞音；energy_db: 词内平均 RMS 能量 (dBFS)
+  words: Array<{ duration_ms: number; expected_ms: number; z: number; energy_db: number } | null>
+  // 逐帧 RMS 能量 (dBFS)，帧长 frame_ms；从存档读回的推理结果为空
+  frame_ms: number
+  energy_db: Float32Array
 }
 
+// 前端算出的 16k 单声道波形包络 + 按 CTC 帧展开的得分轨，画图时按像素取数，不需要原始 PCM
+export interface WaveformData {
+  sample_rate: number
+  samples: number
+  // peaks[0] 每块的样本数，往上每层翻倍
+  block: number
+  // 多分辨率 min/max：peaks[k] 为 [min0, max0, min1, max1, ...]，最后一层只有一块。
+  // 从存档读回的推理结果 (analyzeEmissions) 没有音频，为空数组
+  peaks: Float32Array[]
+  // 模型帧长 (毫秒)
+  frame_ms: number
+  // 每帧所属音素的得分，不属于任何音素 (blank、漏读) 的帧为 NaN
+  score_track: Float32Array
+}
+
+// 超出 maxRequestMemoryMB / maxRequestMs 时改用低内存对齐 (low_memory)，仍超出则拒绝 (code 'E2BIG')
+export interface AdmissionInfo {
+  decision: 'full' | 'low_memory'
+  // 推理和对齐两者中较大的峰值
+  estimated_bytes: number
+  estimated_ms: number
+  inference_bytes: number
+  align_bytes: number
+}
+
+export interface AnalysisTimings {
+  frontend_ms: number
+  inference_ms: number
+  log_softmax_ms: number
+  g2p_ms: number
+  align_ms: number
+  decode_ms: number
+  total_ms: number
+  input_samples: number
+  audio_samples: number
+  frames: number
+  vocab_size: number
+  states: number
+  phonemes: number
+  words: number
+  segments: number
+  bytes_allocated: number
+  // 异步请求在调度器里排队的时间
+  queue_ms?: number
+}
+
+export type PipelineStage =
+  | 'frontend'
+  | 'inference'
+  | 'log_softmax'
+  | 'g2p'
+  | 'align'
+  | 'decode'
+  | 'total'
+
+export interface StageStats {
+  count: number
+  mean_ms: number
+  p50_ms: number
+  p95_ms: number
+  p99_ms: number
+  max_ms: number
+}
+
+// engine.getStats() 的返回值：分位数基于最近 1024 次请求
+export interface EngineStats {
+  requests: number
+  failures: number
+  // 被取消或超时的请求 (不计入 requests / failures)
+  cancelled: number
+  stages: Record<PipelineStage, StageStats>
+  counters: {
+    input_samples: number
+    audio_samples: number
+    frames: number
+    states: number
+    bytes_allocated: number
+    max_bytes_allocated: number
+  }
+  cache: EmissionCacheStats
+  scheduler: SchedulerStats
+  model: ModelStats
+  registry: ModelRegistryStats
+  admission: AdmissionStats
+}
+
+export interface AdmissionStats {
+  // 0 = 不限制
+  max_bytes: number
+  max_ms: number
+  over_budget: 'degrade' | 'reject'
+  full: number
+  low_memory: number
+  rejected: number
+  // 按完成的请求校准的耗时系数
+  inference_ms_per_frame: number
+  align_ns_per_cell: number
+}
+
+// 当前生效的模型版本 (reloadModel 每成功一次加一)
+export interface ModelStats {
+  version: number
+  path: string
+  // 模型文件内容指纹 (16 位十六进制)
+  hash: string
+  // 是否有后台加载正在进行
+  loading: boolean
+}
+
+export interface ModelReloadResult {
+  version: number
+  hash: string
+}
+
+export interface ModelRegistryLanguageStats {
+  model_path: string
+  voice: string
+  // 当前是否已加载
+  resident: boolean
+  // 估算的常驻内存 (ONNX 文件大小)，未加载时为 0
+  bytes: number
+  loads: number
+  evictions: number
+  hits: number
+}
+
+export interface ModelEvent {
+  type: 'load' | 'load_failed' | 'evict'
+  language: string
+  bytes: number
+  // 只有 load 事件有
+  load_ms?: number
+  // Unix 毫秒时间戳
+  time: number
+}
+
+// registerModel 注册的按语言模型：首次使用时加载，超出预算时淘汰最久未用的
+export interface ModelRegistryStats {
+  // 0 = 不限制
+  budget_bytes: number
+  resident_bytes: number
+  loads: number
+  load_failures: number
+  evictions: number
+  languages: Record<string, ModelRegistryLanguageStats>
+  // 最近 32 条事件，旧的在前
+  events: ModelEvent[]
+}
+
+export interface SchedulerClassStats {
+  queued: number
+  running: number
+  max_queued: number
+  submitted: number
+  // 队列满被拒绝 (code 'EBUSY')
+  rejected: number
+  completed: number
+  wait_mean_ms: number
+  wait_p50_ms: number
+  wait_p95_ms: number
+  wait_p99_ms: number
+  wait_max_ms: number
+}
+
+// 异步请求调度器：各优先级的队列深度和排队时间 (分位数基于最近 1024 个请求)
+export interface SchedulerStats {
+  workers: number
+  max_background_running: number
+  interactive: SchedulerClassStats
+  background: SchedulerClassStats
+}
+
+// new SpeechEngine(..., options) 的引擎选项
+export interface EngineOptions {
+  // 交互请求的推理线程数，默认 1
+  intraOpThreads?: number
+  // 后台请求的推理线程数，小于 intraOpThreads 时单独建一个 session (多占一份模型内存)
+  backgroundIntraOpThreads?: number
+  // 异步请求的工作线程数，默认 2
+  workers?: number
+  // 同时执行的后台请求上限，默认 1
+  maxBackgroundRunning?: number
+  // 各优先级的排队上限，默认 16 / 256
+  maxInteractiveQueue?: number
+  maxBackgroundQueue?: number
+  // registerModel 注册的模型常驻内存上限 (MB)，默认不限制
+  modelMemoryBudgetMB?: number
+  // 单个请求的预估峰值内存 / 耗时上限，默认不限制
+  maxRequestMemoryMB?: number
+  maxRequestMs?: number
+  // 超出上限时：degrade (默认) 先改用低内存对齐，仍超出才拒绝；reject 直接拒绝
+  overBudget?: 'degrade' | 'reject'
+}
+
+// sliceWords 的选项
+export interface WordClipOptions {
+  // 最多选几个词 (按得分从低到高，0 = 不限)，默认 3；相邻的片段重叠时合并成一段
+  maxClips?: number
+  // 每段前后各多留的时长，默认 150
+  padMs?: number
+  // 只选得分低于它的词，默认不限
+  maxScore?: number
+}
+
+// 按词切出的一段原始录音 (16-bit 单声道 WAV，保持原采样率)
+export interface WordClip {
+  // 包含的词 (result.words 下标)
+  words: number[]
+  text: string
+  // 其中最低的词得分
+  score: number
+  start_ms: number
+  end_ms: number
+  wav: Uint8Array
+}
+
+// saveEmissions 的存档选项
+export interface EmissionSaveOptions {
+  // 默认 fp32 (打开时零拷贝)；fp16 体积减半，int8 再减半 (评分误差约 0.01)，打开时都要解码
+  encoding?: 'fp32' | 'fp16' | 'int8'
+  // 每帧只保留概率最高的 topK 个 token (有损)，0 = 全部
+  topK?: number
+}
+
+export interface EmissionCacheStats {
+  hits: number
+  misses: number
+  evictions: number
+  entries: number
+  bytes: number
+  max_bytes: number
+  max_entries: number
+}
+
+export interface OpProfileEntry {
+  name: string
+  op_type: string
+  category: string
+  calls: number
+  total_us: number
+  mean_us: number
+  percent: number
+  output_bytes: number
+  activation_bytes: number
+  parameter_bytes: number
+}
+
+// engine.getProfileReport() 的返回值，各列表按 total_us 降序
+export interface ProfileReport {
+  runs: number
+  model_run_us: number
+  kernel_us: number
+  // 模块类别: feature_extractor / feature_projection / positional_conv / attention / ffn / layer_norm / lm_head / other
+  categories: OpProfileEntry[]
+  op_types: OpProfileEntry[]
+  nodes: OpProfileEntry[]
+  trace_path?: string
+}
+
+export type NativeLogLevel = 'debug' | 'info' | 'warning' | 'error' | 'off'
+
 export interface SettingsData {
   AZURE_TTS_KEY: string
   AZURE_TTS_REGION: string